@@ -0,0 +1,74 @@
+#include "BedCommandQueue.h"
+
+// Ids wrap; compare by signed distance.
+static inline bool idBefore(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+
+BedCommandQueue::BedCommandQueue() {
+    for (uint32_t i = 0; i < BED_CMD_QUEUE_LEN; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+}
+
+uint32_t BedCommandQueue::push(BedCommand cmd) {
+    uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (id == 0) id = nextId.fetch_add(1, std::memory_order_relaxed) + 1;
+    cmd.id = id;
+
+    if (cmd.type == BedCommandType::STOP) {
+        uint32_t cur = stopId.load(std::memory_order_relaxed);
+        while ((cur == 0 || idBefore(cur, id)) &&
+               !stopId.compare_exchange_weak(cur, id, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        return id;
+    }
+
+    // Bounded MPMC ring (per-cell sequence numbers): claim a slot by advancing
+    // tail, fill it, then publish by bumping the cell's sequence.
+    uint32_t pos = tail.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+        cell = &cells[pos & (BED_CMD_QUEUE_LEN - 1)];
+        const int32_t diff = (int32_t)(cell->seq.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return 0;   // full
+        } else {
+            pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+    cell->cmd = cmd;
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return id;
+}
+
+bool BedCommandQueue::drain(Batch &out) {
+    out = Batch{};
+    const uint32_t stop = stopId.load(std::memory_order_acquire);
+    if (stop != appliedStopId) {
+        appliedStopId = stop;
+        out.stop = true;
+        out.lastId = stop;
+    }
+
+    for (;;) {
+        Cell &cell = cells[head & (BED_CMD_QUEUE_LEN - 1)];
+        if ((int32_t)(cell.seq.load(std::memory_order_acquire) - (head + 1)) < 0) break;   // empty
+        const BedCommand cmd = cell.cmd;
+        cell.seq.store(head + BED_CMD_QUEUE_LEN, std::memory_order_release);
+        ++head;
+
+        // Anything issued before the newest STOP is cancelled by it.
+        if (appliedStopId != 0 && idBefore(cmd.id, appliedStopId)) {
+            out.superseded++;
+            continue;
+        }
+        if (out.hasMotion) {
+            if (idBefore(cmd.id, out.motion.id)) { out.superseded++; continue; }
+            out.superseded++;
+        }
+        out.motion = cmd;
+        out.hasMotion = true;
+    }
+
+    if (out.hasMotion && (out.lastId == 0 || idBefore(out.lastId, out.motion.id))) out.lastId = out.motion.id;
+    return out.stop || out.hasMotion || out.superseded > 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include "BedConfig.h"
+#include "BedDriver.h"
+
+// Bounded lock-free command ring: any number of producers (httpd workers,
+// Matter), one consumer (the motion task). STOP bypasses the ring through an
+// atomic "latest stop id" so it can never be refused or stuck behind motion.
+class BedCommandQueue {
+public:
+    // What the motion task should do after one drain().
+    struct Batch {
+        bool stop = false;          // apply STOP first
+        bool hasMotion = false;     // then this command
+        BedCommand motion;
+        uint32_t lastId = 0;        // newest id covered by this batch
+        uint32_t superseded = 0;    // motion commands dropped (latest-wins / preempted by STOP)
+    };
+
+    BedCommandQueue();
+
+    // Assigns an id and queues the command. Returns 0 if the ring is full
+    // (never for STOP).
+    uint32_t push(BedCommand cmd);
+
+    // Consumer only. Collapses everything queued so far into at most one STOP
+    // followed by the newest motion command queued after it.
+    bool drain(Batch &out);
+
+private:
+    static_assert((BED_CMD_QUEUE_LEN & (BED_CMD_QUEUE_LEN - 1)) == 0, "BED_CMD_QUEUE_LEN must be a power of two");
+
+    struct Cell {
+        std::atomic<uint32_t> seq;  // == slot position when free, position + 1 when filled
+        BedCommand cmd;
+    };
+
+    Cell cells[BED_CMD_QUEUE_LEN];
+    std::atomic<uint32_t> tail{0};      // producers
+    uint32_t head = 0;                  // consumer
+    std::atomic<uint32_t> nextId{0};
+    std::atomic<uint32_t> stopId{0};    // newest STOP requested
+    uint32_t appliedStopId = 0;         // newest STOP handed to the consumer
+};
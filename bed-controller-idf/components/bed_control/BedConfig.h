@@ -5,7 +5,14 @@
 // --- PINS ---
 // --- Motor + transfer configuration ---
 // 0 = relay-based drive, 1 = DRV8871 (PWM sign-magnitude)
+#ifndef BED_MOTOR_DRIVER_DRV8871
 #define BED_MOTOR_DRIVER_DRV8871 0
+#endif
+// 1 = no motor wiring: bed 0 is driven through its own RF remote protocol
+// (RfBedDriver, WL102 transmitter on RF_TX_PIN)
+#ifndef BED_DRIVER_RF
+#define BED_DRIVER_RF 0
+#endif
 // 0 = single transfer GPIO, 1 = per-direction transfer GPIOs
 #define BED_TRANSFER_MODE_MULTI 1
 
@@ -49,6 +56,9 @@
 #define OPTO_IN_3         36
 #define OPTO_IN_4         39
 
+// WL102 data (RF builds; FOOT_DOWN's relay pin is free then, as in mb-rf-tx)
+#define RF_TX_PIN         19
+
 #elif CONFIG_IDF_TARGET_ESP32S3
 // ESP32-S3 pinout (safe GPIOs; avoid USB D+/D-, strapping pins)
 #define HEAD_UP_PIN       4
@@ -71,22 +81,159 @@
 #define OPTO_IN_2         36
 #define OPTO_IN_3         37
 #define OPTO_IN_4         38
+
+// WL102 data (RF builds; HEAD_UP's relay pin is free then)
+#define RF_TX_PIN         4
+
+// Second base (split king, BED_COUNT 2): its own motor, transfer and opto set
+#define BED2_HEAD_UP_PIN      13
+#define BED2_HEAD_DOWN_PIN    14
+#define BED2_FOOT_UP_PIN      18
+#define BED2_FOOT_DOWN_PIN    21
+#if BED_TRANSFER_MODE_MULTI
+#define BED2_TRANSFER_HEAD_UP_PIN    47
+#define BED2_TRANSFER_HEAD_DOWN_PIN  48
+#define BED2_TRANSFER_FOOT_UP_PIN    39
+#define BED2_TRANSFER_FOOT_DOWN_PIN  40
+#else
+#define BED2_TRANSFER_PIN     47
+#endif
+// GPIO3 is a strapping pin; the opto pull-up keeps it high through reset
+#define BED2_OPTO_IN_1        1
+#define BED2_OPTO_IN_2        3
+#define BED2_OPTO_IN_3        41
+#define BED2_OPTO_IN_4        42
 #else
 #error "Unsupported IDF target for bed pin mapping"
 #endif
 
+// Bases driven by this controller (each its own BedControl, NVS namespace
+// and wired remote; see BedPins). The second base only has a pin map on S3.
+#ifndef BED_COUNT
+#define BED_COUNT 1
+#endif
+#if BED_COUNT > 1 && !defined(BED2_HEAD_UP_PIN)
+#error "BED_COUNT 2 needs a BED2_* pin map for this target"
+#endif
+#if BED_COUNT > 1 && BED_MOTOR_DRIVER_DRV8871
+#error "Two DRV8871 bases need 8 motor LEDC channels; only relay builds support BED_COUNT 2"
+#endif
+#if BED_DRIVER_RF && BED_MOTOR_DRIVER_DRV8871
+#error "The RF backend books full-speed runs; build it with BED_MOTOR_DRIVER_DRV8871 0"
+#endif
+
+// RF remote protocol (RfBedDriver). Command nibble of each motor relay; a
+// frame for several closed relays carries the OR of their codes.
+#define RF_CMD_HEAD_UP      0x4
+#define RF_CMD_HEAD_DOWN    0x2
+#define RF_CMD_FOOT_UP      0x1
+#define RF_CMD_FOOT_DOWN    0x8
+// Idle line between two repeats of a held frame
+#define RF_FRAME_GAP_US     10000
+
 // Motor PWM (DRV8871)
 #define MOTOR_PWM_FREQ_HZ   20000
 #define MOTOR_PWM_DUTY_MAX  1023  // 10-bit
-#define MOTOR_PWM_RAMP_STEP 64
+#define MOTOR_PWM_RAMP_MS   400   // S-curve 0 -> full duty (and back on a preset's soft stop)
+// ARRIVE_TOGETHER slows the shorter preset leg down to no less than this
+// share of full duty (the actuators stall below it); it starts late instead.
+#define MOTOR_PWM_SYNC_MIN_PERMILLE 400
 #define MOTOR_PWM_TIMER     LEDC_TIMER_1
 
 // --- LOGIC ---
 #define RELAY_ON          0
 #define RELAY_OFF         1
 
+// Relay sequencing (see RelaySequencer). After a motor relay opens, neither
+// relay of that axis closes again for its dead-time (break-before-make on
+// reversal; covers contact bounce and the motor's back-EMF).
+#define HEAD_RELAY_DEAD_MS        100
+#define FOOT_RELAY_DEAD_MS        100
+// A transfer relay stays open this long before it closes again
+#define TRANSFER_RELAY_DEAD_MS    20
+// Transfer relays close this long before their motor relay and open this long
+// after it, so their contacts never make or break motor current
+#define RELAY_TRANSFER_SETTLE_MS  20
+// The second motor starts this long after the first so inrush peaks don't add
+#define RELAY_MOTOR_STAGGER_MS    250
+
 #define HEAD_MAX_MS_DEFAULT 25000
 #define FOOT_MAX_MS_DEFAULT 40000
 #define LIMIT_MIN_MS        5000    // Prevent unrealistically low limits
 #define LIMIT_MAX_MS        60000   // Prevent runaway high limits
 #define SYNC_EXTRA_MS     10000
+
+// Motion model bounds (see AxisMotionModel)
+#define MOTION_RATE_MIN_PERMILLE  500
+#define MOTION_RATE_MAX_PERMILLE  2000
+#define MOTION_LATENCY_MAX_MS     2000
+// A timed end-to-end run this close to the model is sensor noise (ACS712 period
+// and tick), not a rate to learn
+#define MOTION_LEARN_MIN_MS       300
+
+// Current-sensed end stop: ignore drops this early in a run (inrush/start lag)
+#define CURRENT_ENDSTOP_MIN_RUN_MS 1500
+// Mean delay from stall to the first idle sample (half the 200 ms ACS712 period)
+#define CURRENT_ENDSTOP_LAG_MS     100
+// Both axes driven: the drop is credited to one axis only if it was expected
+// to reach its end at least this much later than the other
+#define CURRENT_ENDSTOP_ATTRIB_GAP_MS 3000
+// Without a current sensor, a run counts as resting on the end switch only
+// after overrunning the estimated end by this much (presets overrun SYNC_EXTRA_MS)
+#define ENDSTOP_CONFIRM_OVERRUN_MS (SYNC_EXTRA_MS / 2)
+
+// Position uncertainty: error bound (travel-ms) added per finished run.
+// App runs are relay-timed; remote presses also carry debounce/sampling error.
+#define UNCERT_RUN_MS             50
+#define UNCERT_TRAVEL_PERMILLE    20
+#define UNCERT_REMOTE_RUN_MS      80
+#define UNCERT_REMOTE_PERMILLE    30
+// Runs to an end overrun it by the bound plus this margin (short re-home)...
+#define UNCERT_HOME_MARGIN_MS     500
+// ...unless the bound exceeds this, which schedules a full SYNC_EXTRA_MS re-home
+#define REHOME_THRESHOLD_MS       3000
+// Targets this close to an end are routed via the end once a re-home is due
+#define REHOME_NEAR_MS            5000
+
+// Position journal: persist once nothing has moved for this long
+#define POS_JOURNAL_IDLE_MS 2000
+// ...or at the first stop once the pending position is this old (continuous use)
+#define POS_JOURNAL_MAX_DIRTY_MS 30000
+
+// Move telemetry (MotionTelemetry): RAM ring of the last N moves (40 bytes
+// each), written behind to NVS while idle once this many are unsaved...
+#define BED_TELEMETRY_RECORDS     128
+#define TELEMETRY_FLUSH_RECORDS   32
+// ...or the oldest unsaved one is this old
+#define TELEMETRY_FLUSH_MAX_MS    (15 * 60 * 1000)
+
+// Call trace (TraceBedDriver): RAM for the records, allocated on the first
+// Bed.Command TRACE_START. About 5 bytes per motion-task tick, so 32 KB holds
+// roughly a minute of remote-driven motion or an hour of idle.
+#ifndef BED_TRACE_BYTES
+#define BED_TRACE_BYTES     (32 * 1024)
+#endif
+
+// Motion task scheduling (event-driven; woken early by commands/edges/timers)
+#define BED_TICK_FAST_MS    10      // PWM ramp, remote-driven motion
+#define BED_TICK_MOTION_MS  100     // app-driven motion (LED refresh, snapshot)
+#define BED_TICK_IDLE_MS    1000    // idle heartbeat
+
+// Remote optos: the GPIO ISR timestamps every edge into a queue; by default
+// a level counts as stable once no edge has followed it for OPTO_DEBOUNCE_MS.
+// Mode and threshold are per channel in NVS (see OptoDebouncer).
+#define OPTO_DEBOUNCE_MS    8
+#define OPTO_EDGE_QUEUE_LEN 32      // edges between two motion-task wakeups
+// Edge/stable history readers (SSE) drain by sequence number (power of two);
+// must cover the edges of one reader poll period, bounces included.
+#define OPTO_EVENT_LOG_LEN  64
+
+// Remote gestures (see RemoteGestures): a press this short is a tap, and the
+// next tap of a double/triple must start within the gap of the last release.
+#define GESTURE_TAP_MAX_MS  400
+#define GESTURE_TAP_GAP_MS  400
+
+// Asynchronous command queue (power of two). STOP has its own lane and never
+// occupies a slot; motion commands coalesce, so this only has to absorb
+// bursts between two motion-task wakeups.
+#define BED_CMD_QUEUE_LEN   8
@@ -13,6 +13,7 @@
 #include "esp_timer.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include <cstdio>
 #include <cstring>
 #include <cmath>
 #include <algorithm>
@@ -32,6 +33,315 @@ std::string activeCommandLog = "IDLE"; // Changed from String to std::string
 #define LEDC_CHANNEL_G          LEDC_CHANNEL_1
 #define LEDC_CHANNEL_B          LEDC_CHANNEL_2
 
+// --- MOTION MODEL ---
+static inline int32_t modelRate(const AxisMotionModel &m, MotionDir dir) {
+    return (dir == MotionDir::UP) ? m.upRatePermille : m.downRatePermille;
+}
+
+// Positions, run times and their timestamps are kept in microseconds so that
+// short runs don't each lose a fraction of a millisecond; the API, the journal
+// and the planner see milliseconds.
+static inline int32_t usToMs(int64_t us) {
+    return (int32_t)((us + (us >= 0 ? 500 : -500)) / 1000);
+}
+
+// Travel (us) covered by relayUs of drive. The stop latency (coast) only counts
+// once the relay has been released.
+static int64_t travelForRelayUs(const AxisMotionModel &m, MotionDir dir, int64_t relayUs, bool released) {
+    int64_t movingUs = relayUs - (int64_t)m.startLatencyMs * 1000;
+    if (movingUs <= 0) return 0;
+    if (released) movingUs += (int64_t)m.stopLatencyMs * 1000;
+    return (movingUs * modelRate(m, dir) + 500) / 1000;
+}
+
+// Inverse of travelForRelayUs(..., true) in ms: relay-on time that covers travelMs.
+static int32_t relayMsForTravel(const AxisMotionModel &m, MotionDir dir, int32_t travelMs) {
+    const int32_t rate = modelRate(m, dir);
+    const int32_t movingMs = (int32_t)(((int64_t)travelMs * 1000 + rate - 1) / rate);
+    return std::max(movingMs + m.startLatencyMs - m.stopLatencyMs, m.startLatencyMs + 1);
+}
+
+// --- DRV8871 RAMP PROFILE ---
+// Duty follows a smoothstep S-curve s(x) = 3x^2 - 2x^3 (zero slope at both
+// ends) over MOTOR_PWM_RAMP_MS: up from the start of a run, and at the end of
+// a preset leg back down from wherever it had got to (soft stop). x and s are
+// Q16 fixed point.
+static inline int64_t sCurveQ16(int64_t x) {
+    x = std::max<int64_t>(0, std::min<int64_t>(65536, x));
+    return (x * x * (3 * 65536 - 2 * x)) >> 32;
+}
+
+// Ramp position (Q16) runMs into a run; legMs < 0 means no soft stop.
+static inline int64_t rampPosQ16(int64_t runMs, int32_t legMs) {
+    const int64_t up = std::min<int64_t>(65536, std::max<int64_t>(0, runMs) * 65536 / MOTOR_PWM_RAMP_MS);
+    if (legMs < 0 || runMs <= legMs) return up;
+    const int64_t top = std::min<int64_t>(65536, (int64_t)legMs * 65536 / MOTOR_PWM_RAMP_MS);
+    return std::max<int64_t>(0, top - (runMs - legMs) * 65536 / MOTOR_PWM_RAMP_MS);
+}
+
+// How long a preset leg keeps driving after its deadline while it ramps down.
+static inline int32_t softStopMs(int32_t legMs) {
+#if BED_MOTOR_DRIVER_DRV8871
+    return std::min<int32_t>(legMs, MOTOR_PWM_RAMP_MS);
+#else
+    (void)legMs;
+    return 0;
+#endif
+}
+
+#if BED_MOTOR_DRIVER_DRV8871
+// Full-duty drive (ms) in the first t ms of the ramp-up:
+// ramp * (x^3 - x^4 / 2) with x = t / ramp, then 1:1 once at full duty.
+static int32_t rampDriveMs(int32_t t) {
+    if (t <= 0) return 0;
+    if (t >= MOTOR_PWM_RAMP_MS) return MOTOR_PWM_RAMP_MS / 2 + (t - MOTOR_PWM_RAMP_MS);
+    const int64_t x = (int64_t)t * 65536 / MOTOR_PWM_RAMP_MS;
+    const int64_t x3 = (((x * x) >> 16) * x) >> 16;
+    const int64_t x4 = (x3 * x) >> 16;
+    return (int32_t)(((int64_t)MOTOR_PWM_RAMP_MS * (x3 - x4 / 2)) >> 16);
+}
+#endif
+
+#if BED_MOTOR_DRIVER_DRV8871
+// Relay-equivalent drive of a preset leg with deadline legMs, ramping to duty
+// and back down in its soft stop. The start latency counts as full duty.
+static int32_t relayEquivMs(const AxisMotionModel &m, int32_t legMs, int32_t duty) {
+    const int32_t lat = m.startLatencyMs;
+    if (legMs <= lat) return legMs;
+    const int32_t drive = legMs >= MOTOR_PWM_RAMP_MS ? legMs : 2 * rampDriveMs(legMs);
+    return lat + (int32_t)((int64_t)(drive - rampDriveMs(lat)) * duty / MOTOR_PWM_DUTY_MAX);
+}
+#endif
+
+// Deadline for a preset leg worth relayMs of relay drive (see driveUsAt()).
+// From MOTOR_PWM_RAMP_MS on the soft stop gives back what the soft start
+// cost, apart from the part of the ramp hidden in the start latency; shorter
+// legs never reach full duty and run longer, as do legs at reduced duty.
+static int32_t rampedLegMs(const AxisMotionModel &m, int32_t relayMs, int32_t duty = MOTOR_PWM_DUTY_MAX) {
+#if BED_MOTOR_DRIVER_DRV8871
+    if (relayMs <= 0) return relayMs;
+    int32_t lo = 0, hi = (int32_t)((int64_t)relayMs * MOTOR_PWM_DUTY_MAX / duty) + MOTOR_PWM_RAMP_MS;
+    while (lo < hi) {
+        const int32_t mid = (lo + hi) / 2;
+        if (relayEquivMs(m, mid, duty) >= relayMs) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+#else
+    (void)m;
+    (void)duty;
+    return relayMs;
+#endif
+}
+
+// Returns how far the travel ran past an end (0 if it stayed inside).
+static inline int64_t applyTravel(int64_t &posUs, MotionDir dir, int64_t travelUs, int32_t maxMs) {
+    const int64_t maxUs = (int64_t)maxMs * 1000;
+    posUs += (dir == MotionDir::UP) ? travelUs : -travelUs;
+    int64_t overrun = 0;
+    if (posUs > maxUs) { overrun = posUs - maxUs; posUs = maxUs; }
+    if (posUs < 0) { overrun = -posUs; posUs = 0; }
+    return overrun;
+}
+
+// Error bound one finished run of `travel` adds to the position estimate.
+static inline int32_t uncertGrowth(int32_t travel, bool remote) {
+    return remote ? UNCERT_REMOTE_RUN_MS + travel * UNCERT_REMOTE_PERMILLE / 1000
+                  : UNCERT_RUN_MS + travel * UNCERT_TRAVEL_PERMILLE / 1000;
+}
+
+// Books a finished run's error and decides whether it proved the end stop. A
+// run that overran the estimated end by more than the error bound must be
+// resting on the end switch, so the bound collapses to zero; a smaller overrun
+// may just be estimate error.
+static inline MotionDir settleRun(MotionDir dir, int64_t travelUs, int64_t overrunUs, bool remote,
+                                  int32_t &uncert, int32_t maxMs) {
+    const int32_t travel = usToMs(travelUs);
+    const int32_t overrun = usToMs(overrunUs);
+    uncert = std::min(maxMs, uncert + uncertGrowth(travel, remote));
+    if (overrun > 0 && overrun >= std::min<int32_t>(ENDSTOP_CONFIRM_OVERRUN_MS, uncert + UNCERT_HOME_MARGIN_MS / 2)) {
+        uncert = 0;
+        return dir;
+    }
+    return MotionDir::STOPPED;
+}
+
+// Relay time setTarget() schedules for one axis (0 = within deadband, no move).
+// Runs that end on a limit overrun it by the error bound plus a margin, so
+// they land on the end switch; only once the bound passes REHOME_THRESHOLD_MS
+// do they pay the full SYNC_EXTRA_MS re-home.
+static int32_t presetLegMs(const AxisMotionModel &m, int32_t pos, int32_t target, int32_t maxMs, int32_t uncert) {
+    const int32_t diff = target - pos;
+    if (std::abs(diff) <= 100) return 0;
+    const MotionDir dir = diff > 0 ? MotionDir::UP : MotionDir::DOWN;
+    if (target != 0 && target != maxMs) return rampedLegMs(m, relayMsForTravel(m, dir, std::abs(diff)));
+    const int32_t bound = uncert + uncertGrowth(std::abs(diff), false);
+    if (bound >= REHOME_THRESHOLD_MS) return relayMsForTravel(m, dir, std::abs(diff)) + SYNC_EXTRA_MS;
+    return rampedLegMs(m, relayMsForTravel(m, dir, std::abs(diff) + bound + UNCERT_HOME_MARGIN_MS));
+}
+
+// Uncertainty after a preset leg from pos to target.
+static inline int32_t legUncert(int32_t pos, int32_t target, int32_t maxMs, int32_t uncert) {
+    if (std::abs(target - pos) <= 100) return uncert;
+    if (target == 0 || target == maxMs) return 0;
+    return std::min(maxMs, uncert + uncertGrowth(std::abs(target - pos), false));
+}
+
+// How a preset runs its legs under an ArrivalPolicy. With both axes moving,
+// the leader's relay closes first; the follower starts lagMs after that (the
+// sequencer still holds it RELAY_MOTOR_STAGGER_MS apart), or once the
+// leader's leg has ended.
+struct PresetPlan {
+    int32_t headLegMs = 0;      // deadline from the relay closing, before any soft stop (0 = stays)
+    int32_t footLegMs = 0;
+    int32_t headDuty = MOTOR_PWM_DUTY_MAX;  // DRV8871 duty the leg ramps to
+    int32_t footDuty = MOTOR_PWM_DUTY_MAX;
+    bool footLeads = false;
+    int32_t lagMs = 0;          // -1: the follower starts once the leader's leg has ended
+    int32_t spanMs = 0;         // request until the last leg ends, starting from rest
+};
+
+static inline int32_t legEndMs(int32_t legMs) { return legMs + softStopMs(legMs); }
+
+// DRV8871: stretches a leg at reduced duty so that it (soft stop included)
+// ends endMs after its start. Never below MOTOR_PWM_SYNC_MIN_PERMILLE; the
+// caller delays the start for the rest.
+static void slowLegTo(const AxisMotionModel &m, int32_t &legMs, int32_t &duty, int32_t endMs) {
+#if BED_MOTOR_DRIVER_DRV8871
+    const int32_t target = endMs >= 2 * MOTOR_PWM_RAMP_MS ? endMs - MOTOR_PWM_RAMP_MS : endMs / 2;
+    if (target <= legMs || legMs <= m.startLatencyMs) return;
+    const int32_t relayMs = relayEquivMs(m, legMs, MOTOR_PWM_DUTY_MAX);
+    const int64_t full = relayEquivMs(m, target, MOTOR_PWM_DUTY_MAX) - m.startLatencyMs;
+    if (full <= 0) return;
+    const int32_t minDuty = MOTOR_PWM_DUTY_MAX * MOTOR_PWM_SYNC_MIN_PERMILLE / 1000;
+    duty = (int32_t)std::max<int64_t>(minDuty, ((int64_t)(relayMs - m.startLatencyMs) * MOTOR_PWM_DUTY_MAX + full - 1) / full);
+    if (duty >= MOTOR_PWM_DUTY_MAX) { duty = MOTOR_PWM_DUTY_MAX; return; }
+    legMs = rampedLegMs(m, relayMs, duty);
+#else
+    (void)m; (void)legMs; (void)duty; (void)endMs;
+#endif
+}
+
+static PresetPlan planPreset(ArrivalPolicy policy, const AxisMotionModel &headModel, const AxisMotionModel &footModel,
+                             int32_t headLegMs, int32_t footLegMs) {
+    PresetPlan p;
+    p.headLegMs = headLegMs;
+    p.footLegMs = footLegMs;
+    const int32_t lead = RelaySequencer::startLeadMs(0);
+    if (headLegMs <= 0 || footLegMs <= 0) {
+        p.footLeads = headLegMs <= 0;
+        p.spanMs = std::max(headLegMs, footLegMs) > 0 ? lead + legEndMs(std::max(headLegMs, footLegMs)) : 0;
+        return p;
+    }
+    const bool footLonger = legEndMs(footLegMs) > legEndMs(headLegMs);
+    if (policy == ArrivalPolicy::ARRIVE_TOGETHER) {
+        // The longer leg leads; the shorter one is slowed to fit the time
+        // after the start stagger, and starts late by whatever is left.
+        p.footLeads = footLonger;
+        const int32_t leaderEnd = legEndMs(footLonger ? footLegMs : headLegMs);
+        if (footLonger) slowLegTo(headModel, p.headLegMs, p.headDuty, leaderEnd - RELAY_MOTOR_STAGGER_MS);
+        else slowLegTo(footModel, p.footLegMs, p.footDuty, leaderEnd - RELAY_MOTOR_STAGGER_MS);
+        p.lagMs = leaderEnd - legEndMs(footLonger ? p.headLegMs : p.footLegMs);
+    } else if (policy == ArrivalPolicy::FASTEST_FIRST) {
+        p.footLeads = legEndMs(footLegMs) < legEndMs(headLegMs);
+        p.lagMs = -1;
+    }
+    const int32_t leaderEnd = lead + legEndMs(p.footLeads ? p.footLegMs : p.headLegMs);
+    const int32_t followerStart = std::max(RelaySequencer::startLeadMs(1), p.lagMs < 0 ? leaderEnd : lead + p.lagMs);
+    p.spanMs = std::max(leaderEnd, followerStart + legEndMs(p.footLeads ? p.headLegMs : p.footLegMs));
+    return p;
+}
+
+// Pause between script legs: the actuators coast to rest and every relay
+// serves its dead-time, so the next leg starts from a known state.
+static inline int32_t scriptSettleMs(const AxisMotionModel &head, const AxisMotionModel &foot) {
+    return std::max({ head.stopLatencyMs, foot.stopLatencyMs, RelaySequencer::restMs() });
+}
+
+// Script slot reported while setTarget() runs a re-home route.
+static const int8_t kRehomeRouteSlot = -2;
+
+// Opportunistic re-home: an axis whose error bound is past REHOME_THRESHOLD_MS
+// and whose target lies near an end goes via that end first (one full
+// re-home), then back out to the target. Fills a two-step route script.
+static bool planRehomeRoute(const BedSnapshot &v, int32_t tHead, int32_t tFoot, MotionScript &route) {
+    tHead = std::max<int32_t>(0, std::min(v.headMaxMs, tHead));
+    tFoot = std::max<int32_t>(0, std::min(v.footMaxMs, tFoot));
+    auto viaEnd = [](int32_t pos, int32_t target, int32_t maxMs, int32_t uncert, int32_t &end) {
+        if (target == 0 || target == maxMs || std::abs(target - pos) <= 100) return false;
+        if (uncert + uncertGrowth(std::abs(target - pos), false) < REHOME_THRESHOLD_MS) return false;
+        if (target <= REHOME_NEAR_MS) end = 0;
+        else if (maxMs - target <= REHOME_NEAR_MS) end = maxMs;
+        else return false;
+        return true;
+    };
+    int32_t headEnd = 0, footEnd = 0;
+    const bool head = viaEnd(v.headPosMs, tHead, v.headMaxMs, v.headUncertMs, headEnd);
+    const bool foot = viaEnd(v.footPosMs, tFoot, v.footMaxMs, v.footUncertMs, footEnd);
+    if (!head && !foot) return false;
+    route = MotionScript{};
+    route.stepCount = 2;
+    route.steps[0] = ScriptStep{ScriptOp::MOVE, 0, (uint16_t)(head ? headEnd : tHead), (uint16_t)(foot ? footEnd : tFoot)};
+    route.steps[1] = ScriptStep{ScriptOp::MOVE, 0, head ? (uint16_t)tHead : (uint16_t)SCRIPT_KEEP,
+                                foot ? (uint16_t)tFoot : (uint16_t)SCRIPT_KEEP};
+    return true;
+}
+
+// Walks a script the way stepScript() would, using preset leg times and the
+// waits, to predict how long it runs from (head, foot).
+static int32_t scriptDurationMs(const MotionScript &s, const BedSnapshot &snap) {
+    uint8_t loopLeft[MotionScript::kMaxSteps];
+    std::memset(loopLeft, 0xFF, sizeof(loopLeft));
+    int32_t head = snap.headPosMs, foot = snap.footPosMs;
+    int32_t headUncert = snap.headUncertMs, footUncert = snap.footUncertMs;
+    int64_t total = 0;
+    for (uint8_t pc = 0; pc < s.stepCount; ) {
+        const ScriptStep &step = s.steps[pc];
+        if (step.op == ScriptOp::MOVE) {
+            const int32_t h = (step.headMs == SCRIPT_KEEP) ? head : std::min<int32_t>(step.headMs, snap.headMaxMs);
+            const int32_t f = (step.footMs == SCRIPT_KEEP) ? foot : std::min<int32_t>(step.footMs, snap.footMaxMs);
+            const int32_t spanMs = planPreset(snap.arrival, snap.headModel, snap.footModel,
+                                              presetLegMs(snap.headModel, head, h, snap.headMaxMs, headUncert),
+                                              presetLegMs(snap.footModel, foot, f, snap.footMaxMs, footUncert)).spanMs;
+            if (spanMs > 0) total += spanMs + scriptSettleMs(snap.headModel, snap.footModel);
+            headUncert = legUncert(head, h, snap.headMaxMs, headUncert);
+            footUncert = legUncert(foot, f, snap.footMaxMs, footUncert);
+            if (std::abs(h - head) > 100) head = h;
+            if (std::abs(f - foot) > 100) foot = f;
+            pc++;
+        } else if (step.op == ScriptOp::WAIT) {
+            total += step.headMs;
+            pc++;
+        } else {
+            if (loopLeft[pc] == 0xFF) loopLeft[pc] = step.count;
+            if (loopLeft[pc] > 0) { loopLeft[pc]--; pc = (uint8_t)step.headMs; }
+            else { loopLeft[pc] = 0xFF; pc++; }
+        }
+    }
+    return (int32_t)std::min<int64_t>(total, INT32_MAX);
+}
+
+// What setTarget() reports for a re-home route: the time until its last leg
+// ends, as for a plain preset. The script itself still waits one settle
+// after that before it completes.
+static int32_t rehomeRouteMs(const MotionScript &route, const BedSnapshot &snap) {
+    const int32_t total = scriptDurationMs(route, snap);
+    return total > 0 ? total - scriptSettleMs(snap.headModel, snap.footModel) : 0;
+}
+
+static inline int64_t bookRemoteRun(int64_t &posUs, int64_t baseUs, MotionDir dir, int64_t runUs,
+                                    const AxisMotionModel &m, int32_t maxMs, bool released) {
+    posUs = baseUs;
+    return applyTravel(posUs, dir, travelForRelayUs(m, dir, runUs, released), maxMs);
+}
+
+static void clampModel(AxisMotionModel &m) {
+    m.upRatePermille = std::max<int32_t>(MOTION_RATE_MIN_PERMILLE, std::min<int32_t>(MOTION_RATE_MAX_PERMILLE, m.upRatePermille));
+    m.downRatePermille = std::max<int32_t>(MOTION_RATE_MIN_PERMILLE, std::min<int32_t>(MOTION_RATE_MAX_PERMILLE, m.downRatePermille));
+    m.startLatencyMs = std::max<int32_t>(0, std::min<int32_t>(MOTION_LATENCY_MAX_MS, m.startLatencyMs));
+    m.stopLatencyMs = std::max<int32_t>(0, std::min<int32_t>(MOTION_LATENCY_MAX_MS, m.stopLatencyMs));
+}
+
 int64_t BedControl::millis() {
     return esp_timer_get_time() / 1000;
 }
@@ -68,23 +378,23 @@ void BedControl::getLimits(int32_t &headMaxMs, int32_t &footMaxMs) {
     footMaxMs = state.footMaxMs;
 }
 
-void BedControl::getMotionDirs(std::string &headDir, std::string &footDir) {
+void BedControl::getMotionDirs(MotionDir &headDir, MotionDir &footDir) {
     if (xSemaphoreTake(mutex, portMAX_DELAY)) {
-        headDir = (state.headDir != "STOPPED") ? state.headDir : state.remoteHeadDir;
-        footDir = (state.footDir != "STOPPED") ? state.footDir : state.remoteFootDir;
+        headDir = (state.headDir != MotionDir::STOPPED) ? state.headDir : state.remoteHeadDir;
+        footDir = (state.footDir != MotionDir::STOPPED) ? state.footDir : state.remoteFootDir;
         xSemaphoreGive(mutex);
     } else {
-        headDir = "STOPPED";
-        footDir = "STOPPED";
+        headDir = MotionDir::STOPPED;
+        footDir = MotionDir::STOPPED;
     }
 }
 
 void BedControl::getOptoStates(int &o1, int &o2, int &o3, int &o4) {
     if (xSemaphoreTake(mutex, portMAX_DELAY)) {
-        o1 = state.optoStable[0];
-        o2 = state.optoStable[1];
-        o3 = state.optoStable[2];
-        o4 = state.optoStable[3];
+        o1 = optoDebounce.stable(0);
+        o2 = optoDebounce.stable(1);
+        o3 = optoDebounce.stable(2);
+        o4 = optoDebounce.stable(3);
         xSemaphoreGive(mutex);
     } else {
         o1 = o2 = o3 = o4 = 1;
@@ -106,10 +416,10 @@ void BedControl::getRemoteEventInfo(int64_t &eventMs, int32_t &debounceMs, int8_
 
 void BedControl::getOptoRawStates(int &o1, int &o2, int &o3, int &o4) {
     if (xSemaphoreTake(mutex, portMAX_DELAY)) {
-        o1 = state.optoLastRaw[0];
-        o2 = state.optoLastRaw[1];
-        o3 = state.optoLastRaw[2];
-        o4 = state.optoLastRaw[3];
+        o1 = optoDebounce.raw(0);
+        o2 = optoDebounce.raw(1);
+        o3 = optoDebounce.raw(2);
+        o4 = optoDebounce.raw(3);
         xSemaphoreGive(mutex);
     } else {
         o1 = o2 = o3 = o4 = 1;
@@ -132,104 +442,636 @@ void BedControl::getRemoteEdgeInfo(int64_t &eventMs, int8_t &optoIdx, int8_t &op
 void BedControl::setLimits(int32_t headMaxMs, int32_t footMaxMs) {
     headMaxMs = CLAMP_LIMIT(headMaxMs);
     footMaxMs = CLAMP_LIMIT(footMaxMs);
-    state.headMaxMs = headMaxMs;
-    state.footMaxMs = footMaxMs;
-    setSavedPos("head_max_ms", headMaxMs);
-    setSavedPos("foot_max_ms", footMaxMs);
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        // The end-stop calibration also writes these, from the motion task.
+        state.headMaxMs = headMaxMs;
+        state.footMaxMs = footMaxMs;
+        state.limitsDirty = false;      // superseded; written below
+        // begin() publishes the first snapshot once the rest of state is ready.
+        if (snapshotSeq.load(std::memory_order_relaxed) != 0) publishSnapshot(millis());
+        xSemaphoreGive(mutex);
+        nvs_set_i32(nvsHandle, "head_max_ms", headMaxMs);
+        nvs_set_i32(nvsHandle, "foot_max_ms", footMaxMs);
+        nvs_commit(nvsHandle);
+    }
+}
+
+void BedControl::loadMotionModel() {
+    AxisMotionModel h, f;
+    h.upRatePermille = getSavedPos("h_up_rate", h.upRatePermille);
+    h.downRatePermille = getSavedPos("h_dn_rate", h.downRatePermille);
+    h.startLatencyMs = getSavedPos("h_start_ms", h.startLatencyMs);
+    h.stopLatencyMs = getSavedPos("h_stop_ms", h.stopLatencyMs);
+    f.upRatePermille = getSavedPos("f_up_rate", f.upRatePermille);
+    f.downRatePermille = getSavedPos("f_dn_rate", f.downRatePermille);
+    f.startLatencyMs = getSavedPos("f_start_ms", f.startLatencyMs);
+    f.stopLatencyMs = getSavedPos("f_stop_ms", f.stopLatencyMs);
+    clampModel(h);
+    clampModel(f);
+    state.headModel = h;
+    state.footModel = f;
+}
+
+// Called without the mutex: callers copy the model under it first.
+void BedControl::saveMotionModel(const AxisMotionModel &head, const AxisMotionModel &foot) {
+    nvs_set_i32(nvsHandle, "h_up_rate", head.upRatePermille);
+    nvs_set_i32(nvsHandle, "h_dn_rate", head.downRatePermille);
+    nvs_set_i32(nvsHandle, "h_start_ms", head.startLatencyMs);
+    nvs_set_i32(nvsHandle, "h_stop_ms", head.stopLatencyMs);
+    nvs_set_i32(nvsHandle, "f_up_rate", foot.upRatePermille);
+    nvs_set_i32(nvsHandle, "f_dn_rate", foot.downRatePermille);
+    nvs_set_i32(nvsHandle, "f_start_ms", foot.startLatencyMs);
+    nvs_set_i32(nvsHandle, "f_stop_ms", foot.stopLatencyMs);
+    nvs_commit(nvsHandle);
+}
+
+// Hands out a model or limits learned during motion once both axes are
+// idle, so their commit never lands while a relay is driving.
+bool BedControl::takeLearnedFlush(LearnedFlush &out) {
+    if (!state.modelDirty && !state.limitsDirty) return false;
+    if (state.headDir != MotionDir::STOPPED || state.footDir != MotionDir::STOPPED ||
+        state.remoteHeadDir != MotionDir::STOPPED || state.remoteFootDir != MotionDir::STOPPED) {
+        return false;
+    }
+    out.model = state.modelDirty;
+    out.limits = state.limitsDirty;
+    out.headModel = state.headModel;
+    out.footModel = state.footModel;
+    out.headMaxMs = state.headMaxMs;
+    out.footMaxMs = state.footMaxMs;
+    state.modelDirty = false;
+    state.limitsDirty = false;
+    return true;
+}
+
+// Called without the mutex, from update(); one commit for both.
+void BedControl::saveLearned(const LearnedFlush &learned) {
+    if (learned.limits) {
+        nvs_set_i32(nvsHandle, "head_max_ms", learned.headMaxMs);
+        nvs_set_i32(nvsHandle, "foot_max_ms", learned.footMaxMs);
+    }
+    if (learned.model) saveMotionModel(learned.headModel, learned.footModel);
+    else nvs_commit(nvsHandle);
+}
+
+void BedControl::getMotionModel(AxisMotionModel &head, AxisMotionModel &foot) {
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        head = state.headModel;
+        foot = state.footModel;
+        xSemaphoreGive(mutex);
+    }
+}
+
+void BedControl::setMotionModel(const AxisMotionModel &head, const AxisMotionModel &foot) {
+    AxisMotionModel h = head, f = foot;
+    clampModel(h);
+    clampModel(f);
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        // Stop first so in-flight motion is booked with the model it was planned with.
+        if (state.headDir != MotionDir::STOPPED || state.footDir != MotionDir::STOPPED) syncState();
+        state.headModel = h;
+        state.footModel = f;
+        state.modelDirty = false;       // superseded; written below
+        ESP_LOGI(TAG, "Motion model: head up=%d down=%d start=%d stop=%d | foot up=%d down=%d start=%d stop=%d",
+                 (int)state.headModel.upRatePermille, (int)state.headModel.downRatePermille,
+                 (int)state.headModel.startLatencyMs, (int)state.headModel.stopLatencyMs,
+                 (int)state.footModel.upRatePermille, (int)state.footModel.downRatePermille,
+                 (int)state.footModel.startLatencyMs, (int)state.footModel.stopLatencyMs);
+        publishSnapshot(millis());
+        xSemaphoreGive(mutex);
+        saveMotionModel(h, f);
+        wakeTask();
+    }
+}
+
+// Seeds a trace replay: the bed (stopped) takes over the recorded
+// positions, end stops and position uncertainty, as if it had booted there.
+void BedControl::restorePosition(const BedSnapshot &snap) {
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        state.headPosUs = (int64_t)std::max(0, std::min(state.headMaxMs, snap.headPosMs)) * 1000;
+        state.footPosUs = (int64_t)std::max(0, std::min(state.footMaxMs, snap.footPosMs)) * 1000;
+        state.headEndStop = snap.headEndStop;
+        state.footEndStop = snap.footEndStop;
+        state.headUncertMs = snap.headUncertMs;
+        state.footUncertMs = snap.footUncertMs;
+        markPositionDirty(millis());
+        publishSnapshot(millis());
+        xSemaphoreGive(mutex);
+    }
+}
+
+// NVS "oN_db_mode"/"oN_db_ms" per opto (N = 1..4); anything out of range
+// falls back to WINDOW / OPTO_DEBOUNCE_MS.
+void BedControl::loadOptoDebounce() {
+    for (int i = 0; i < OptoDebouncer::kChannels; ++i) {
+        char modeKey[12], msKey[12];
+        snprintf(modeKey, sizeof(modeKey), "o%d_db_mode", i + 1);
+        snprintf(msKey, sizeof(msKey), "o%d_db_ms", i + 1);
+        DebounceConfig cfg;
+        const int32_t mode = getSavedPos(modeKey, (int32_t)DebounceMode::WINDOW);
+        const int32_t ms = getSavedPos(msKey, OPTO_DEBOUNCE_MS);
+        cfg.mode = mode == (int32_t)DebounceMode::INTEGRATOR ? DebounceMode::INTEGRATOR : DebounceMode::WINDOW;
+        cfg.thresholdMs = (ms >= OPTO_DEBOUNCE_MIN_MS && ms <= OPTO_DEBOUNCE_MAX_MS) ? (uint16_t)ms : OPTO_DEBOUNCE_MS;
+        optoDebounce.configure(i, cfg);
+    }
+}
+
+void BedControl::getOptoDebounce(int ch, DebounceConfig &cfg, DebounceStats &stats) {
+    if (ch < 0 || ch >= OptoDebouncer::kChannels) return;
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        cfg = optoDebounce.config(ch);
+        stats = optoDebounce.stats(ch);
+        xSemaphoreGive(mutex);
+    }
+}
+
+// Takes effect on the channel's next settle, including a burst in progress.
+// Persisted after the mutex is released, like setArrivalPolicy().
+bool BedControl::setOptoDebounce(int ch, DebounceConfig cfg) {
+    if (ch < 0 || ch >= OptoDebouncer::kChannels ||
+        cfg.thresholdMs < OPTO_DEBOUNCE_MIN_MS || cfg.thresholdMs > OPTO_DEBOUNCE_MAX_MS) {
+        return false;
+    }
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        optoDebounce.configure(ch, cfg);
+        ESP_LOGI(TAG, "Opto %d debounce: %s %dms", ch + 1, debounceModeName(cfg.mode), (int)cfg.thresholdMs);
+        xSemaphoreGive(mutex);
+        wakeTask();     // re-arms the opto timer for the new threshold
+        char key[12];
+        snprintf(key, sizeof(key), "o%d_db_mode", ch + 1);
+        nvs_set_i32(nvsHandle, key, (int32_t)cfg.mode);
+        snprintf(key, sizeof(key), "o%d_db_ms", ch + 1);
+        nvs_set_i32(nvsHandle, key, cfg.thresholdMs);
+        nvs_commit(nvsHandle);
+    }
+    return true;
+}
+
+void BedControl::resetOptoDebounceStats() {
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        optoDebounce.resetStats();
+        xSemaphoreGive(mutex);
+    }
+}
+
+// NVS blob "gestures"; missing means the defaults, corrupt is logged and
+// also falls back to them.
+void BedControl::loadGestures() {
+    GestureMap map;
+    size_t len = sizeof(map);
+    const esp_err_t err = nvs_get_blob(nvsHandle, "gestures", &map, &len);
+    if (err != ESP_OK) {
+        map = GestureMap::defaults();
+    } else if (len != map.storedSize() || !map.valid(BED_SCRIPT_SLOTS)) {
+        ESP_LOGW(TAG, "Gesture table is corrupt (len=%u); using the defaults", (unsigned)len);
+        map = GestureMap::defaults();
+    }
+    gestures.setMap(map);
+}
+
+void BedControl::getRemoteGestures(GestureMap &out) {
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        out = gestures.map();
+        xSemaphoreGive(mutex);
+    }
+}
+
+// Drops any half-seen gesture; a press in progress is an ordinary press.
+bool BedControl::setRemoteGestures(const GestureMap &map) {
+    if (!map.valid(BED_SCRIPT_SLOTS)) return false;
+    if (nvs_set_blob(nvsHandle, "gestures", &map, map.storedSize()) != ESP_OK ||
+        nvs_commit(nvsHandle) != ESP_OK) {
+        return false;
+    }
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        gestures.setMap(map);
+        ESP_LOGI(TAG, "Remote gestures: %u binding(s)", (unsigned)map.count);
+        xSemaphoreGive(mutex);
+        wakeTask();     // re-arms the opto timer without the old deadlines
+    }
+    return true;
+}
+
+ArrivalPolicy BedControl::getArrivalPolicy() {
+    ArrivalPolicy policy = ArrivalPolicy::START_TOGETHER;
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        policy = state.arrival;
+        xSemaphoreGive(mutex);
+    }
+    return policy;
+}
+
+// A preset already running keeps the schedule it started with. The flash
+// write happens after the mutex is released so the motion task never waits on it.
+void BedControl::setArrivalPolicy(ArrivalPolicy policy) {
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        state.arrival = policy;
+        ESP_LOGI(TAG, "Preset arrival: %s", arrivalPolicyName(policy));
+        publishSnapshot(millis());
+        xSemaphoreGive(mutex);
+        nvs_set_i32(nvsHandle, "arrival", (int32_t)policy);
+        nvs_commit(nvsHandle);
+    }
+}
+
+// --- MOTOR CURRENT (ACS712) ---
+void BedControl::reportMotorCurrent(bool active, int64_t sinceMs) {
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        const bool wasActive = state.motorCurrentActive == 1;
+        state.motorCurrentActive = active ? 1 : 0;
+        if (!active && wasActive) handleCurrentDrop(sinceMs);
+        publishSnapshot(millis());
+        xSemaphoreGive(mutex);
+        wakeTask();
+    }
+}
+
+// Current fell to idle while a relay is still driving: the actuator stalled on
+// its internal limit switch. The sensor sees the summed supply current, so with
+// both axes driven this only fires once both have stopped.
+void BedControl::handleCurrentDrop(int64_t dropMs) {
+    const bool head = state.headDir != MotionDir::STOPPED && state.headStartUs != 0;
+    const bool foot = state.footDir != MotionDir::STOPPED && state.footStartUs != 0;
+    if (!head && !foot) return;
+
+    // A drop that began before/just after the first start is the previous run
+    // ending. Staged preset legs may start in either order.
+    const int64_t dropUs = dropMs * 1000;
+    const int64_t startUs = (head && foot) ? std::min(state.headStartUs, state.footStartUs)
+                                           : (head ? state.headStartUs : state.footStartUs);
+    if (dropUs - startUs < (int64_t)CURRENT_ENDSTOP_MIN_RUN_MS * 1000) return;
+
+    ESP_LOGI(TAG, "Current drop after %dms with relay on: end stop (head=%s foot=%s)",
+             (int)usToMs(dropUs - startUs), motionDirName(state.headDir), motionDirName(state.footDir));
+    // With both driven the drop only times the later stall. Credit it to the
+    // axis expected to arrive clearly last; otherwise calibrate neither. Staged
+    // preset legs start apart (and with DRV8871 may run at part duty), so
+    // compare when each axis reaches its end, not how long it has left.
+    bool calHead = head, calFoot = foot;
+    if (head && foot) {
+        auto endAtUs = [this](bool h) {
+            const MotionDir dir = h ? state.headDir : state.footDir;
+            const int32_t pos = usToMs(h ? state.headPosUs : state.footPosUs);
+            const int32_t maxMs = h ? state.headMaxMs : state.footMaxMs;
+            int64_t etaMs = relayMsForTravel(h ? state.headModel : state.footModel, dir,
+                                             (dir == MotionDir::UP) ? maxMs - pos : pos);
+#if BED_MOTOR_DRIVER_DRV8871
+            const int32_t duty = h ? state.headDutyTarget : state.footDutyTarget;
+            if (duty > 0) etaMs = etaMs * MOTOR_PWM_DUTY_MAX / duty;
+#endif
+            return (h ? state.headStartUs : state.footStartUs) + etaMs * 1000;
+        };
+        const int64_t headEndUs = endAtUs(true), footEndUs = endAtUs(false);
+        calHead = headEndUs - footEndUs >= (int64_t)CURRENT_ENDSTOP_ATTRIB_GAP_MS * 1000;
+        calFoot = footEndUs - headEndUs >= (int64_t)CURRENT_ENDSTOP_ATTRIB_GAP_MS * 1000;
+    }
+    if (head) stopAtEndStop(true, dropUs, calHead);
+    if (foot) stopAtEndStop(false, dropUs, calFoot);
+    if (state.headPendingDir == MotionDir::STOPPED && state.footPendingDir == MotionDir::STOPPED) {
+        syncState();
+        return;
+    }
+    // The leader of a staged preset stalled before its follower started: end
+    // only the stalled leg and let completePresetAxes() start the follower.
+    const int64_t nowUs = esp_timer_get_time();
+    for (const bool axis : { true, false }) {
+        if (!(axis ? head : foot)) continue;
+#if BED_MOTOR_DRIVER_DRV8871
+        driveAxis(axis, 0, nowUs);
+#endif
+        (axis ? state.headDriveDutyUs : state.footDriveDutyUs) = 0;
+        (axis ? state.headDriveFromUs : state.footDriveFromUs) = -1;
+        (axis ? state.headDutyTarget : state.footDutyTarget) = 0;
+        if (axis) setHeadRelay(true, false);
+        else setFootRelay(true, false);
+    }
+    state.axisStoppedUs = nowUs;
+    completePresetAxes(nowUs);
+}
+
+// A run from one end stop into the other timed the axis' whole travel in dir
+// (mutex held). The moving time of the latest such run per direction is kept
+// for this boot. While only one direction is timed, or both times are within
+// MOTION_LEARN_MIN_MS of the model, the run only recalibrates the limit
+// through the direction's rate. Otherwise the limit and both rates are fitted
+// to the two times with the harmonic mean of the rates held fixed (it sets
+// the unit positions are counted in): the rates take the up/down asymmetry
+// and the limit the travel, so neither absorbs the other's error. The learned
+// model and limit are persisted by the motion task once it is idle.
+void BedControl::learnFullRun(bool head, MotionDir dir, int64_t runUs) {
+    AxisMotionModel &m = head ? state.headModel : state.footModel;
+    int32_t &maxMs = head ? state.headMaxMs : state.footMaxMs;
+    int64_t *timedUs = head ? state.headFullRunUs : state.footFullRunUs;   // [0] up, [1] down
+    const int64_t movingUs = runUs - (int64_t)m.startLatencyMs * 1000;
+    if (movingUs <= 0) return;
+    timedUs[dir == MotionDir::UP ? 0 : 1] = movingUs;
+    const int64_t upUs = timedUs[0], downUs = timedUs[1];
+    auto offModel = [&](int64_t us, int32_t rate) {
+        return std::abs(us - (int64_t)maxMs * 1000000 / rate) >= (int64_t)MOTION_LEARN_MIN_MS * 1000;
+    };
+
+    int32_t newMax;
+    if (upUs == 0 || downUs == 0 || (!offModel(upUs, m.upRatePermille) && !offModel(downUs, m.downRatePermille))) {
+        newMax = CLAMP_LIMIT(usToMs(travelForRelayUs(m, dir, runUs, false)));
+    } else {
+        const int64_t up = m.upRatePermille, down = m.downRatePermille;
+        const int64_t harmonic = 2 * up * down / (up + down);
+        const int64_t travelUs = harmonic * (upUs + downUs) / 2000;
+        newMax = CLAMP_LIMIT(usToMs(travelUs));
+        AxisMotionModel learned = m;
+        learned.upRatePermille = (int32_t)((travelUs * 1000 + upUs / 2) / upUs);
+        learned.downRatePermille = (int32_t)((travelUs * 1000 + downUs / 2) / downUs);
+        clampModel(learned);
+        if (learned.upRatePermille != m.upRatePermille || learned.downRatePermille != m.downRatePermille) {
+            ESP_LOGI(TAG, "Learned %s rates: up %d -> %d  down %d -> %d permille",
+                     head ? "head" : "foot", (int)m.upRatePermille, (int)learned.upRatePermille,
+                     (int)m.downRatePermille, (int)learned.downRatePermille);
+            m = learned;
+            state.modelDirty = true;
+        }
+    }
+    if (newMax != maxMs) {
+        ESP_LOGI(TAG, "Auto-calibrated %s limit: %dms -> %dms (%s run)",
+                 head ? "head" : "foot", (int)maxMs, (int)newMax, motionDirName(dir));
+        maxMs = newMax;
+        state.limitsDirty = true;
+    }
+}
+
+// Pins the axis to the end it ran into. A run that started from the opposite
+// end measured the full travel (see learnFullRun()).
+void BedControl::stopAtEndStop(bool head, int64_t dropUs, bool calibrate) {
+    MotionDir &dir = head ? state.headDir : state.footDir;
+    int64_t &startUs = head ? state.headStartUs : state.footStartUs;
+    int64_t &posUs = head ? state.headPosUs : state.footPosUs;
+    int32_t &maxMs = head ? state.headMaxMs : state.footMaxMs;
+    MotionDir &endStop = head ? state.headEndStop : state.footEndStop;
+
+    // If the other axis was switched off mid-run, the drop may just be that
+    // relay opening after this axis stalled earlier: stop, but don't calibrate.
+    const MotionDir opposite = (dir == MotionDir::UP) ? MotionDir::DOWN : MotionDir::UP;
+    const int64_t fromUs = posUs;
+    uint8_t flags = MOVE_FLAG_END_STOP;
+    if (calibrate && endStop == opposite && state.axisStoppedUs < startUs) {
+        learnFullRun(head, dir, driveUsAt(head, dropUs) - (int64_t)CURRENT_ENDSTOP_LAG_MS * 1000);
+        flags |= MOVE_FLAG_CALIBRATED;
+    }
+    posUs = (dir == MotionDir::UP) ? (int64_t)maxMs * 1000 : 0;
+    endStop = dir;
+    (head ? state.headUncertMs : state.footUncertMs) = 0;
+    recordMove(head, dir, state.isPresetActive ? MoveSource::PRESET : MoveSource::APP, startUs, dropUs, fromUs, flags);
+    dir = MotionDir::STOPPED;
+    startUs = 0;
+}
+
+// Every ACS712 sample: keeps the peak for whichever axes are driven. The
+// sensor sees the summed supply, so two axes moving together share a peak.
+void BedControl::reportMotorCurrentMa(int32_t milliamps) {
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        if (state.headDir != MotionDir::STOPPED || state.remoteHeadDir != MotionDir::STOPPED) {
+            state.headPeakMa = std::max(state.headPeakMa, milliamps);
+        }
+        if (state.footDir != MotionDir::STOPPED || state.remoteFootDir != MotionDir::STOPPED) {
+            state.footPeakMa = std::max(state.footPeakMa, milliamps);
+        }
+        xSemaphoreGive(mutex);
+    }
+}
+
+// --- MOVE TELEMETRY ---
+// Books one finished run into the telemetry ring (mutex held), after its
+// travel has been applied to the position. Resets the axis' per-move inputs.
+void BedControl::recordMove(bool head, MotionDir dir, MoveSource source, int64_t startUs, int64_t endUs,
+                            int64_t fromPosUs, uint8_t flags) {
+    int32_t &cmd = head ? state.headCmdTravelMs : state.footCmdTravelMs;
+    int32_t &peak = head ? state.headPeakMa : state.footPeakMa;
+    const int64_t posUs = head ? state.headPosUs : state.footPosUs;
+    const int64_t runUs = std::max<int64_t>(0, endUs - startUs);
+
+    MoveRecord rec = {};
+    rec.startUs = startUs;
+    rec.runUs = (uint32_t)std::min<int64_t>(runUs, UINT32_MAX);
+    rec.commandedMs = source == MoveSource::PRESET ? cmd : -1;
+    rec.travelMs = usToMs(std::abs(posUs - fromPosUs));
+    rec.endPosMs = usToMs(posUs);
+#if BED_MOTOR_DRIVER_DRV8871
+    // Remote presses bypass the H-bridges; a preset leg that ran to its
+    // deadline also ramped down.
+    if (source != MoveSource::REMOTE) {
+        const int32_t legMs = head ? state.headTargetDuration : state.footTargetDuration;
+        int32_t rampMs = (int32_t)std::min<int64_t>(usToMs(runUs), MOTOR_PWM_RAMP_MS);
+        if (source == MoveSource::PRESET && !(flags & MOVE_FLAG_INTERRUPTED) && runUs >= (int64_t)legMs * 1000) {
+            rampMs += softStopMs(legMs);
+        }
+        rec.rampMs = (uint16_t)rampMs;
+    }
+#endif
+    rec.peakMa = peak < 0 ? 0xFFFF : (uint16_t)std::min<int32_t>(peak, 0xFFFE);
+    rec.axis = head ? 0 : 1;
+    rec.dir = (int8_t)dir;
+    rec.source = (uint8_t)source;
+    rec.flags = flags;
+    telemetry.append(rec, millis());
+    cmd = -1;
+    peak = -1;
+}
+
+size_t BedControl::readTelemetry(uint32_t afterSeq, MoveRecord *out, size_t max) {
+    size_t n = 0;
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        n = telemetry.read(afterSeq, out, max);
+        xSemaphoreGive(mutex);
+    }
+    return n;
 }
 
 // --- FACTORY DEFAULTS ---
 void BedControl::initFactoryDefaults() {
-    size_t required_size;
-    // Check if "zg_label" exists (String check). 
-    // If this fails, it means we have old NVS data or empty NVS.
-    esp_err_t err = nvs_get_str(nvsHandle, "zg_label", NULL, &required_size);
-    
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
+    // Presets live in one blob; older builds' per-field keys are migrated.
+    const PresetTable::Origin origin = presets.load(nvsHandle);
+    if (origin == PresetTable::Origin::FACTORY) {
         ESP_LOGI(TAG, "First Boot: Writing Factory Defaults...");
-        
-        setSavedPos("zg_head", 10000);    setSavedPos("zg_foot", 40000); setSavedLabel("zg_label", "Zero G");
-        setSavedPos("snore_head", 10000); setSavedPos("snore_foot", 0); setSavedLabel("snore_label", "Anti-Snore");
-        setSavedPos("legs_head", 0);      setSavedPos("legs_foot", 43000); setSavedLabel("legs_label", "Legs Up");
-        setSavedPos("p1_head", 0);        setSavedPos("p1_foot", 0); setSavedLabel("p1_label", "P1");
-        setSavedPos("p2_head", 0);        setSavedPos("p2_foot", 0); setSavedLabel("p2_label", "P2");
-
         setSavedPos("head_max_ms", HEAD_MAX_MS_DEFAULT);
         setSavedPos("foot_max_ms", FOOT_MAX_MS_DEFAULT);
+    } else if (origin == PresetTable::Origin::RESET) {
+        ESP_LOGW(TAG, "Saved presets lost; restored factory presets");
     }
 }
 
 // --- INITIALIZATION ---
 void BedControl::begin() {
     mutex = xSemaphoreCreateMutex();
+
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = &BedControl::presetTimerCb;
+    timer_args.arg = this;
+    timer_args.dispatch_method = ESP_TIMER_TASK;
+    timer_args.name = "bed_preset";
+    if (esp_timer_create(&timer_args, &presetTimer) != ESP_OK) {
+        ESP_LOGW(TAG, "Preset timer create failed; presets end on the next tick");
+        presetTimer = nullptr;
+    }
+    timer_args.callback = &BedControl::relayTimerCb;
+    timer_args.name = "bed_relay";
+    if (esp_timer_create(&timer_args, &relayTimer) != ESP_OK) {
+        ESP_LOGW(TAG, "Relay timer create failed; sequenced relays switch on the next tick");
+        relayTimer = nullptr;
+    }
+    timer_args.callback = &BedControl::optoTimerCb;
+    timer_args.name = "bed_opto";
+    if (esp_timer_create(&timer_args, &optoTimer) != ESP_OK) {
+        ESP_LOGW(TAG, "Opto timer create failed; debounce polls on the fast tick");
+        optoTimer = nullptr;
+    }
     
     initGPIO();
     initOptoInputs();
     initPWM();
     initNVS();
+    presetMutex = xSemaphoreCreateMutex();
     
     // Populate defaults if empty
     initFactoryDefaults();
     loadLimits();
-
-    state.currentHeadPosMs = getSavedPos("headPos", 0);
-    state.currentFootPosMs = getSavedPos("footPos", 0);
-    state.headDir = "STOPPED";
-    state.footDir = "STOPPED";
+    loadMotionModel();
+    state.modelDirty = false;
+    state.limitsDirty = false;
+    state.headFullRunUs[0] = state.headFullRunUs[1] = 0;
+    state.footFullRunUs[0] = state.footFullRunUs[1] = 0;
+    loadOptoDebounce();
+    loadGestures();
+
+    loadPosition();
+    telemetry.begin(nvsHandle);
+    state.headDir = MotionDir::STOPPED;
+    state.footDir = MotionDir::STOPPED;
     state.isPresetActive = false;
+    state.arrival = static_cast<ArrivalPolicy>(std::max<int32_t>(0, std::min<int32_t>(
+        (int32_t)ArrivalPolicy::FASTEST_FIRST, getSavedPos("arrival", (int32_t)ArrivalPolicy::START_TOGETHER))));
+    state.headPendingDir = state.footPendingDir = MotionDir::STOPPED;
+    state.pendingStartUs = 0;
     state.headDuty = 0;
     state.headDutyTarget = 0;
     state.footDuty = 0;
     state.footDutyTarget = 0;
-    state.remoteLastMs = millis();
-    state.remoteHeadDir = "STOPPED";
-    state.remoteFootDir = "STOPPED";
+    state.headDutySinceUs = state.footDutySinceUs = esp_timer_get_time();
+    state.headDriveDutyUs = state.footDriveDutyUs = 0;
+    state.headDriveFromUs = state.footDriveFromUs = -1;
+    state.remoteHeadDir = MotionDir::STOPPED;
+    state.remoteFootDir = MotionDir::STOPPED;
+    state.motorCurrentActive = -1;
+    state.lastCommandId = 0;
+    state.scriptActive = false;
+    state.scriptSlot = -1;
+    state.scriptPc = 0;
+    state.scriptLegActive = false;
+    state.scriptWaitUntilMs = 0;
+    state.axisStoppedUs = 0;
+    state.headCmdTravelMs = state.footCmdTravelMs = -1;
+    state.headPeakMa = state.footPeakMa = -1;
+    state.remoteHeadBaseUs = state.headPosUs;
+    state.remoteFootBaseUs = state.footPosUs;
+    state.remoteHeadFromUs = state.remoteFootFromUs = 0;
+    state.remoteHeadRunUs = 0;
+    state.remoteFootRunUs = 0;
     state.remoteEventMs = 0;
     state.remoteDebounceMs = 0;
     state.remoteOptoIdx = -1;
     state.remoteEdgeMs = 0;
     state.remoteEdgeIdx = -1;
     state.remoteEdgeState = 1;
-    for (int i = 0; i < 4; ++i) {
-        state.optoStable[i] = 1;  // pull-ups -> idle high
-        state.optoCounter[i] = 0;
-        state.optoLastRaw[i] = 1;
-    }
+    optoDebounce.reset();  // pull-ups -> idle high
 
-    ESP_LOGI(TAG, "Bed Control Ready. H:%d F:%d", (int)state.currentHeadPosMs, (int)state.currentFootPosMs);
+    publishSnapshot(millis());
+
+    ESP_LOGI(TAG, "Bed Control Ready. H:%d F:%d", (int)usToMs(state.headPosUs), (int)usToMs(state.footPosUs));
 }
 
 void BedControl::initGPIO() {
     gpio_config_t io_conf = {};
     io_conf.intr_type = GPIO_INTR_DISABLE;
     io_conf.mode = GPIO_MODE_OUTPUT;
-    io_conf.pin_bit_mask = (1ULL << HEAD_UP_PIN) | (1ULL << HEAD_DOWN_PIN) | 
-                           (1ULL << FOOT_UP_PIN) | (1ULL << FOOT_DOWN_PIN);
-#if BED_TRANSFER_MODE_MULTI
-    io_conf.pin_bit_mask |= (1ULL << TRANSFER_HEAD_UP_PIN) | (1ULL << TRANSFER_HEAD_DOWN_PIN) |
-                            (1ULL << TRANSFER_FOOT_UP_PIN) | (1ULL << TRANSFER_FOOT_DOWN_PIN);
-#else
-    io_conf.pin_bit_mask |= (1ULL << TRANSFER_PIN);
-#endif
+    io_conf.pin_bit_mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (pins.motor[i] >= 0) io_conf.pin_bit_mask |= 1ULL << pins.motor[i];
+        if (pins.transfer[i] >= 0) io_conf.pin_bit_mask |= 1ULL << pins.transfer[i];
+    }
     io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
     io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
-    gpio_config(&io_conf);
+    if (io_conf.pin_bit_mask) gpio_config(&io_conf);   // none on an RF base
 
-    stopHardware();
-    setTransferSwitch(false);
+    relays.begin(esp_timer_get_time(), pins);
+}
+
+// Timestamps the edge for updateOptoInputs() and wakes the motion task. A
+// full queue drops the edge; update() then picks the level up by polling.
+void IRAM_ATTR BedControl::optoIsr(void* arg) {
+    const OptoIsrArg *a = static_cast<const OptoIsrArg*>(arg);
+    const OptoEdge edge = { esp_timer_get_time(), a->idx, (uint8_t)gpio_get_level(a->pin) };
+    BaseType_t woken = pdFALSE;
+    if (a->self->optoQueue) xQueueSendFromISR(a->self->optoQueue, &edge, &woken);
+    TaskHandle_t task = *static_cast<TaskHandle_t volatile*>(&a->self->motionTask);
+    if (task) vTaskNotifyGiveFromISR(task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void BedControl::optoTimerCb(void* arg) {
+    static_cast<BedControl*>(arg)->wakeTask();
 }
 
 void BedControl::initOptoInputs() {
     gpio_config_t io_conf = {};
-    io_conf.intr_type = GPIO_INTR_DISABLE;
+    io_conf.intr_type = GPIO_INTR_ANYEDGE;
     io_conf.mode = GPIO_MODE_INPUT;
     io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
     io_conf.pull_up_en = GPIO_PULLUP_ENABLE;
-    io_conf.pin_bit_mask = (1ULL << OPTO_IN_1) | (1ULL << OPTO_IN_2) | (1ULL << OPTO_IN_3) | (1ULL << OPTO_IN_4);
-    gpio_config(&io_conf);
+    io_conf.pin_bit_mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (pins.opto[i] >= 0) io_conf.pin_bit_mask |= 1ULL << pins.opto[i];
+    }
+    if (io_conf.pin_bit_mask) gpio_config(&io_conf);
+
+    optoQueue = xQueueCreate(OPTO_EDGE_QUEUE_LEN, sizeof(OptoEdge));
+    if (!optoQueue) ESP_LOGW(TAG, "Opto edge queue create failed; optos are polled");
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGW(TAG, "gpio_install_isr_service failed: %s", esp_err_to_name(err));
+        return;
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (pins.opto[i] < 0) continue;
+        optoIsrArgs[i] = { this, (uint8_t)i, (gpio_num_t)pins.opto[i] };
+        gpio_isr_handler_add((gpio_num_t)pins.opto[i], &BedControl::optoIsr, &optoIsrArgs[i]);
+    }
 }
 
 void BedControl::initPWM() {
+#if BED_MOTOR_DRIVER_DRV8871
+    // Motor PWM timer (shared by every base; configuring it again is harmless)
+    ledc_timer_config_t motor_timer = {
+        .speed_mode       = LEDC_MODE,
+        .duty_resolution  = LEDC_TIMER_10_BIT,
+        .timer_num        = MOTOR_PWM_TIMER,
+        .freq_hz          = MOTOR_PWM_FREQ_HZ,
+        .clk_cfg          = LEDC_AUTO_CLK,
+        .deconfigure      = false
+    };
+    ledc_timer_config(&motor_timer);
+
+    // Motor channels (sign-magnitude: one pin PWM, other low)
+    pwmReady = true;
+    for (int i = 0; i < 4; ++i) {
+        if (pins.motorLedc[i] < 0 || pins.motor[i] < 0) {
+            pwmReady = false;
+            continue;
+        }
+        ledc_channel_config_t m = { .gpio_num = pins.motor[i], .speed_mode = LEDC_MODE, .channel = (ledc_channel_t)pins.motorLedc[i], .intr_type = LEDC_INTR_DISABLE, .timer_sel = MOTOR_PWM_TIMER, .duty = 0, .hpoint = 0, .flags = {} };
+        ledc_channel_config(&m);
+    }
+    if (!pwmReady) ESP_LOGE(TAG, "Motor PWM channels missing in the pin map; bridges stay off");
+#endif
+
+    if (!pins.statusLed) return;
     ledc_timer_config_t ledc_timer = {
         .speed_mode       = LEDC_MODE,
         .duty_resolution  = LEDC_DUTY_RES,
@@ -252,29 +1094,6 @@ void BedControl::initPWM() {
     ledc_channel_config(&c1);
     ledc_channel_config(&c2);
 
-#if BED_MOTOR_DRIVER_DRV8871
-    // Motor PWM timer
-    ledc_timer_config_t motor_timer = {
-        .speed_mode       = LEDC_MODE,
-        .duty_resolution  = LEDC_TIMER_10_BIT,
-        .timer_num        = MOTOR_PWM_TIMER,
-        .freq_hz          = MOTOR_PWM_FREQ_HZ,
-        .clk_cfg          = LEDC_AUTO_CLK,
-        .deconfigure      = false
-    };
-    ledc_timer_config(&motor_timer);
-
-    // Motor channels (sign-magnitude: one pin PWM, other low)
-    ledc_channel_config_t m0 = { .gpio_num = HEAD_UP_PIN, .speed_mode = LEDC_MODE, .channel = LEDC_CHANNEL_3, .intr_type = LEDC_INTR_DISABLE, .timer_sel = MOTOR_PWM_TIMER, .duty = 0, .hpoint = 0, .flags = {} };
-    ledc_channel_config_t m1 = { .gpio_num = HEAD_DOWN_PIN, .speed_mode = LEDC_MODE, .channel = LEDC_CHANNEL_4, .intr_type = LEDC_INTR_DISABLE, .timer_sel = MOTOR_PWM_TIMER, .duty = 0, .hpoint = 0, .flags = {} };
-    ledc_channel_config_t m2 = { .gpio_num = FOOT_UP_PIN, .speed_mode = LEDC_MODE, .channel = LEDC_CHANNEL_5, .intr_type = LEDC_INTR_DISABLE, .timer_sel = MOTOR_PWM_TIMER, .duty = 0, .hpoint = 0, .flags = {} };
-    ledc_channel_config_t m3 = { .gpio_num = FOOT_DOWN_PIN, .speed_mode = LEDC_MODE, .channel = LEDC_CHANNEL_6, .intr_type = LEDC_INTR_DISABLE, .timer_sel = MOTOR_PWM_TIMER, .duty = 0, .hpoint = 0, .flags = {} };
-    ledc_channel_config(&m0);
-    ledc_channel_config(&m1);
-    ledc_channel_config(&m2);
-    ledc_channel_config(&m3);
-#endif
-
     s_ledc_ready = true;
 
     // Boot Flash
@@ -289,13 +1108,13 @@ void BedControl::initNVS() {
         nvs_flash_erase();
         nvs_flash_init();
     }
-    nvs_open("storage", NVS_READWRITE, &nvsHandle);
+    nvs_open(pins.nvsNamespace, NVS_READWRITE, &nvsHandle);
 }
 
 // --- HARDWARE CONTROL ---
 
 void BedControl::setLedColor(uint8_t r, uint8_t g, uint8_t b) {
-    if (!s_ledc_ready) return;
+    if (!pins.statusLed || !s_ledc_ready) return;
     // If off, clear override so status LED patterns can resume.
     if (r == 0 && g == 0 && b == 0) {
         status_led_clear_override();
@@ -305,42 +1124,41 @@ void BedControl::setLedColor(uint8_t r, uint8_t g, uint8_t b) {
 }
 
 void BedControl::updateMotionLed(int64_t now) {
-    static int64_t last_ms = 0;
-    static bool override_active = false;
+    if (!pins.statusLed) return;
     const int64_t kRefreshMs = 150;
     const uint32_t kHoldMs = 300;
-    bool moving = (state.headDir != "STOPPED") || (state.footDir != "STOPPED");
+    bool moving = (state.headDir != MotionDir::STOPPED) || (state.footDir != MotionDir::STOPPED);
 
     if (!moving && !state.isPresetActive) {
-        if (override_active) {
+        if (ledOverride) {
             status_led_clear_override();
-            override_active = false;
+            ledOverride = false;
         }
         return;
     }
 
-    if (now - last_ms < kRefreshMs) {
+    if (now - ledRefreshMs < kRefreshMs) {
         return;
     }
-    last_ms = now;
+    ledRefreshMs = now;
 
     uint8_t r = 0, g = 0, b = 0;
     if (state.isPresetActive) {
         r = 15; g = 13; b = 0; // Preset active: gold (scaled)
-    } else if (state.headDir != "STOPPED" && state.footDir != "STOPPED") {
-        if (state.headDir == "UP" && state.footDir == "UP") {
+    } else if (state.headDir != MotionDir::STOPPED && state.footDir != MotionDir::STOPPED) {
+        if (state.headDir == MotionDir::UP && state.footDir == MotionDir::UP) {
             r = 0; g = 12; b = 12; // All up: teal (scaled)
         } else {
             r = 15; g = 7; b = 0; // All down: warm amber (scaled)
         }
-    } else if (state.headDir != "STOPPED") {
-        if (state.headDir == "UP") {
+    } else if (state.headDir != MotionDir::STOPPED) {
+        if (state.headDir == MotionDir::UP) {
             r = 10; g = 4; b = 15; // Head up: violet (scaled)
         } else {
             r = 15; g = 8; b = 0; // Head down: amber (scaled)
         }
-    } else if (state.footDir != "STOPPED") {
-        if (state.footDir == "UP") {
+    } else if (state.footDir != MotionDir::STOPPED) {
+        if (state.footDir == MotionDir::UP) {
             r = 0; g = 11; b = 15; // Foot up: sky blue (scaled)
         } else {
             r = 15; g = 0; b = 11; // Foot down: magenta (scaled)
@@ -348,97 +1166,199 @@ void BedControl::updateMotionLed(int64_t now) {
     }
 
     status_led_override(r, g, b, kHoldMs);
-    override_active = true;
+    ledOverride = true;
 }
 
 void BedControl::stopHardware() {
     // DRV8871: drive both inputs low to coast/stop
 #if BED_MOTOR_DRIVER_DRV8871
-    state.headDuty = state.headDutyTarget = 0;
-    state.footDuty = state.footDutyTarget = 0;
-    if (s_ledc_ready) {
-        ledc_set_duty(LEDC_MODE, LEDC_CHANNEL_3, 0);
-        ledc_update_duty(LEDC_MODE, LEDC_CHANNEL_3);
-        ledc_set_duty(LEDC_MODE, LEDC_CHANNEL_4, 0);
-        ledc_update_duty(LEDC_MODE, LEDC_CHANNEL_4);
-        ledc_set_duty(LEDC_MODE, LEDC_CHANNEL_5, 0);
-        ledc_update_duty(LEDC_MODE, LEDC_CHANNEL_5);
-        ledc_set_duty(LEDC_MODE, LEDC_CHANNEL_6, 0);
-        ledc_update_duty(LEDC_MODE, LEDC_CHANNEL_6);
-    } else {
-        gpio_set_level((gpio_num_t)HEAD_UP_PIN, 0);
-        gpio_set_level((gpio_num_t)HEAD_DOWN_PIN, 0);
-        gpio_set_level((gpio_num_t)FOOT_UP_PIN, 0);
-        gpio_set_level((gpio_num_t)FOOT_DOWN_PIN, 0);
+    const int64_t nowUs = esp_timer_get_time();
+    driveAxis(true, 0, nowUs);
+    driveAxis(false, 0, nowUs);
+    state.headDutyTarget = state.footDutyTarget = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (pwmReady) {
+            ledc_set_duty(LEDC_MODE, (ledc_channel_t)pins.motorLedc[i], 0);
+            ledc_update_duty(LEDC_MODE, (ledc_channel_t)pins.motorLedc[i]);
+        } else if (pins.motor[i] >= 0) {
+            gpio_set_level((gpio_num_t)pins.motor[i], 0);
+        }
     }
-#else
-    gpio_set_level((gpio_num_t)HEAD_UP_PIN, RELAY_OFF);
-    gpio_set_level((gpio_num_t)HEAD_DOWN_PIN, RELAY_OFF);
-    gpio_set_level((gpio_num_t)FOOT_UP_PIN, RELAY_OFF);
-    gpio_set_level((gpio_num_t)FOOT_DOWN_PIN, RELAY_OFF);
 #endif
+    // Motor relays open now; the transfer relays follow once they settled.
+    setHeadRelay(true, false);
+    setFootRelay(true, false);
     setTransferSwitch(false);
+    serviceRelays();
     setLedColor(0, 0, 0);
     ESP_LOGI(TAG, "Relays: HEAD_UP=0 HEAD_DOWN=0 FOOT_UP=0 FOOT_DOWN=0 (stopHardware)");
 }
 
-static inline void applyHeadPWM(uint32_t duty, bool up) {
-    // Sign-magnitude: one pin PWM, the other low
+// Sign-magnitude: one input PWM, the other low. Driving up puts the duty on
+// the channel of the axis' DOWN pin (upCh/downCh are the LEDC channels of its
+// UP/DOWN motor pins).
+static inline void applyAxisPWM(int upPinCh, int downPinCh, uint32_t duty, bool up) {
 #if !BED_MOTOR_DRIVER_DRV8871
+    (void)upPinCh;
+    (void)downPinCh;
     (void)duty;
     (void)up;
     return;
 #else
-    if (!s_ledc_ready) return;
-    ledc_set_duty(LEDC_MODE, up ? LEDC_CHANNEL_4 : LEDC_CHANNEL_3, duty);
-    ledc_update_duty(LEDC_MODE, up ? LEDC_CHANNEL_4 : LEDC_CHANNEL_3);
-    ledc_set_duty(LEDC_MODE, up ? LEDC_CHANNEL_3 : LEDC_CHANNEL_4, 0);
-    ledc_update_duty(LEDC_MODE, up ? LEDC_CHANNEL_3 : LEDC_CHANNEL_4);
+    const ledc_channel_t on = (ledc_channel_t)(up ? downPinCh : upPinCh);
+    const ledc_channel_t off = (ledc_channel_t)(up ? upPinCh : downPinCh);
+    ledc_set_duty(LEDC_MODE, on, duty);
+    ledc_update_duty(LEDC_MODE, on);
+    ledc_set_duty(LEDC_MODE, off, 0);
+    ledc_update_duty(LEDC_MODE, off);
 #endif
 }
 
-static inline void applyFootPWM(uint32_t duty, bool up) {
-#if !BED_MOTOR_DRIVER_DRV8871
-    (void)duty;
-    (void)up;
-    return;
+// DRV8871: applies one axis' duty on this base's channels (no-op without them).
+void BedControl::applyPWM(bool head, uint32_t duty, bool up) {
+    if (pwmReady) applyAxisPWM(pins.motorLedc[head ? 0 : 2], pins.motorLedc[head ? 1 : 3], duty, up);
+}
+
+static inline RelayChannel motorRelay(bool head, MotionDir dir) {
+    if (head) return dir == MotionDir::UP ? RELAY_HEAD_UP : RELAY_HEAD_DOWN;
+    return dir == MotionDir::UP ? RELAY_FOOT_UP : RELAY_FOOT_DOWN;
+}
+
+// Transfer relay that cuts the wired remote off from this axis/direction.
+static inline RelayChannel transferRelay(bool head, MotionDir dir) {
+#if BED_TRANSFER_MODE_MULTI
+    if (head) return dir == MotionDir::UP ? RELAY_TRANSFER_HEAD_UP : RELAY_TRANSFER_HEAD_DOWN;
+    return dir == MotionDir::UP ? RELAY_TRANSFER_FOOT_UP : RELAY_TRANSFER_FOOT_DOWN;
 #else
-    if (!s_ledc_ready) return;
-    ledc_set_duty(LEDC_MODE, up ? LEDC_CHANNEL_6 : LEDC_CHANNEL_5, duty);
-    ledc_update_duty(LEDC_MODE, up ? LEDC_CHANNEL_6 : LEDC_CHANNEL_5);
-    ledc_set_duty(LEDC_MODE, up ? LEDC_CHANNEL_5 : LEDC_CHANNEL_6, 0);
-    ledc_update_duty(LEDC_MODE, up ? LEDC_CHANNEL_5 : LEDC_CHANNEL_6);
+    (void)head; (void)dir;
+    return RELAY_TRANSFER_HEAD_UP;
 #endif
 }
 
-static inline void setHeadRelay(bool up, bool enable) {
+// Duty x us an axis drove over [fromUs, toUs) at duty. The motion model's
+// start latency is wall time from the moment the bridge first drives, so that
+// window counts as full duty whatever the ramp was doing.
+int64_t BedControl::dutyUs(bool head, int32_t duty, int64_t fromUs, int64_t toUs) const {
+    if (toUs <= fromUs) return 0;
+    const int64_t driveFromUs = head ? state.headDriveFromUs : state.footDriveFromUs;
+    const int32_t lat = (head ? state.headModel : state.footModel).startLatencyMs;
+    int64_t fullUs = 0;
+    if (driveFromUs >= 0) {
+        const int64_t a = std::max(fromUs, driveFromUs);
+        const int64_t b = std::min(toUs, driveFromUs + (int64_t)lat * 1000);
+        if (b > a) fullUs = b - a;
+    }
+    return fullUs * MOTOR_PWM_DUTY_MAX + (toUs - fromUs - fullUs) * duty;
+}
+
+// Books the duty applied so far into the run, then applies the new one
+// (mutex held). Position is integrated against these duty steps, so ramps
+// count at the speed they actually drove.
+void BedControl::driveAxis(bool head, int32_t duty, int64_t nowUs) {
+    int32_t &cur = head ? state.headDuty : state.footDuty;
+    int64_t &since = head ? state.headDutySinceUs : state.footDutySinceUs;
+    int64_t &driven = head ? state.headDriveDutyUs : state.footDriveDutyUs;
+    driven += dutyUs(head, cur, since, nowUs);
+    since = nowUs;
+    if (duty == cur) return;
+    int64_t &driveFrom = head ? state.headDriveFromUs : state.footDriveFromUs;
+    if (driveFrom < 0 && duty > 0) driveFrom = nowUs;
+    cur = duty;
+    const bool up = (head ? state.headDir : state.footDir) != MotionDir::DOWN;
+    applyPWM(head, duty, up);
+}
+
+// DRV8871: moves one axis' duty along the S-curve (mutex held). The ramp
+// starts when the sequencer enables the bridge and, in a preset, turns into
+// the soft stop at the leg's deadline.
+void BedControl::rampAxis(bool head, int64_t nowUs) {
+    const MotionDir dir = head ? state.headDir : state.footDir;
+    int32_t duty = 0;
+    if (dir != MotionDir::STOPPED && relays.closed(motorRelay(head, dir))) {
+        // Sampled mid-tick: the duty holds until the next update()
+        const int64_t runMs = (nowUs - (head ? state.headStartUs : state.footStartUs)) / 1000 + BED_TICK_FAST_MS / 2;
+        const int32_t legMs = state.isPresetActive ? (head ? state.headTargetDuration : state.footTargetDuration) : -1;
+        duty = (int32_t)(((int64_t)(head ? state.headDutyTarget : state.footDutyTarget) *
+                          sCurveQ16(rampPosQ16(runMs, legMs))) >> 16);
+    }
+    driveAxis(head, duty, nowUs);
+}
+
+// Relay-equivalent drive time (us) of the current run at nowUs: wall time
+// since the relay closed, or with DRV8871 the duty-weighted time, so soft
+// start and soft stop count only as far as they moved the axis.
+int64_t BedControl::driveUsAt(bool head, int64_t nowUs) {
 #if BED_MOTOR_DRIVER_DRV8871
-    (void)up;
-    (void)enable;
+    const int32_t duty = head ? state.headDuty : state.footDuty;
+    const int64_t since = head ? state.headDutySinceUs : state.footDutySinceUs;
+    // An end-stop drop is reported late: ticks may already have booked past it
+    const int64_t driven = (head ? state.headDriveDutyUs : state.footDriveDutyUs) +
+                           (nowUs >= since ? dutyUs(head, duty, since, nowUs) : -dutyUs(head, duty, nowUs, since));
+    // Rounded up: any drive past the start latency is motion (and coasts)
+    return (driven + MOTOR_PWM_DUTY_MAX - 1) / MOTOR_PWM_DUTY_MAX;
 #else
+    return nowUs - (head ? state.headStartUs : state.footStartUs);
+#endif
+}
+
+// Relay writes only take effect through serviceRelays(), which switches them
+// in the order and with the gaps RelaySequencer enforces. With DRV8871 the
+// motor channels have no pin and just gate the PWM ramp.
+void BedControl::setHeadRelay(bool up, bool enable) {
     if (!enable) {
-        gpio_set_level((gpio_num_t)HEAD_UP_PIN, RELAY_OFF);
-        gpio_set_level((gpio_num_t)HEAD_DOWN_PIN, RELAY_OFF);
+        relays.request(RELAY_HEAD_UP, false);
+        relays.request(RELAY_HEAD_DOWN, false);
         return;
     }
-    gpio_set_level((gpio_num_t)HEAD_UP_PIN, up ? RELAY_ON : RELAY_OFF);
-    gpio_set_level((gpio_num_t)HEAD_DOWN_PIN, up ? RELAY_OFF : RELAY_ON);
-#endif
+    relays.request(up ? RELAY_HEAD_UP : RELAY_HEAD_DOWN, true);
 }
 
-static inline void setFootRelay(bool up, bool enable) {
-#if BED_MOTOR_DRIVER_DRV8871
-    (void)up;
-    (void)enable;
-#else
+void BedControl::setFootRelay(bool up, bool enable) {
     if (!enable) {
-        gpio_set_level((gpio_num_t)FOOT_UP_PIN, RELAY_OFF);
-        gpio_set_level((gpio_num_t)FOOT_DOWN_PIN, RELAY_OFF);
+        relays.request(RELAY_FOOT_UP, false);
+        relays.request(RELAY_FOOT_DOWN, false);
         return;
     }
-    gpio_set_level((gpio_num_t)FOOT_UP_PIN, up ? RELAY_ON : RELAY_OFF);
-    gpio_set_level((gpio_num_t)FOOT_DOWN_PIN, up ? RELAY_OFF : RELAY_ON);
-#endif
+    relays.request(up ? RELAY_FOOT_UP : RELAY_FOOT_DOWN, true);
+}
+
+// Applies the relay switches due now and books each axis' motion from the
+// instant its motor relay closes (mutex held). Re-arms relayTimer for the
+// next sequenced switch.
+void BedControl::serviceRelays() {
+    const int64_t nowUs = esp_timer_get_time();
+    const int64_t due = relays.service(nowUs);
+    bool shifted = false;
+    auto syncStart = [&](bool head, MotionDir dir, int64_t &startUs) {
+        if (dir == MotionDir::STOPPED) return;
+        const int64_t closeUs = relays.closeAtUs(motorRelay(head, dir));
+        if (closeUs < 0 || closeUs == startUs) return;
+        startUs = closeUs;
+        shifted = true;
+    };
+    syncStart(true, state.headDir, state.headStartUs);
+    syncStart(false, state.footDir, state.footStartUs);
+    if (shifted && state.isPresetActive) armPresetTimer(nowUs);
+
+    if (relayTimer && due != relayDueUs) {
+        esp_timer_stop(relayTimer);
+        if (due >= 0) esp_timer_start_once(relayTimer, (uint64_t)std::max<int64_t>(0, due - nowUs));
+    }
+    relayDueUs = due;
+}
+
+void BedControl::relayTimerCb(void* arg) {
+    static_cast<BedControl*>(arg)->onRelayDeadline();
+}
+
+// Runs in the esp_timer task when the next sequenced relay switch is due.
+void BedControl::onRelayDeadline() {
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        relayDueUs = -1;
+        serviceRelays();
+        publishSnapshot(millis());
+        xSemaphoreGive(mutex);
+    }
 }
 
 int8_t BedControl::classifyLimit(int32_t pos, int32_t maxVal) {
@@ -448,98 +1368,211 @@ int8_t BedControl::classifyLimit(int32_t pos, int32_t maxVal) {
 }
 
 void BedControl::logLimitTransitions() {
-    int8_t headClass = classifyLimit(state.currentHeadPosMs, state.headMaxMs);
-    int8_t footClass = classifyLimit(state.currentFootPosMs, state.footMaxMs);
-    static int8_t prevHead = 0;
-    static int8_t prevFoot = 0;
-    if (headClass != prevHead) {
+    int8_t headClass = classifyLimit(usToMs(state.headPosUs), state.headMaxMs);
+    int8_t footClass = classifyLimit(usToMs(state.footPosUs), state.footMaxMs);
+    if (headClass != prevHeadLimit) {
         if (headClass == -1) ESP_LOGI(TAG, "Head reached MIN limit (0ms)");
         else if (headClass == 1) ESP_LOGI(TAG, "Head reached MAX limit (%dms)", (int)state.headMaxMs);
-        prevHead = headClass;
+        prevHeadLimit = headClass;
     }
-    if (footClass != prevFoot) {
+    if (footClass != prevFootLimit) {
         if (footClass == -1) ESP_LOGI(TAG, "Foot reached MIN limit (0ms)");
         else if (footClass == 1) ESP_LOGI(TAG, "Foot reached MAX limit (%dms)", (int)state.footMaxMs);
-        prevFoot = footClass;
+        prevFootLimit = footClass;
     }
 }
 
-void BedControl::updateOptoInputs() {
-    const int pins[4] = { OPTO_IN_1, OPTO_IN_2, OPTO_IN_3, OPTO_IN_4 };
-    static bool initialized = false;
-    static int lastStable[4] = {1, 1, 1, 1};
-    static int64_t lastRawChangeMs[4] = {0, 0, 0, 0};
-    if (!initialized) {
-        for (int i = 0; i < 4; ++i) {
-            lastStable[i] = state.optoStable[i];
-            lastRawChangeMs[i] = millis();
+// A raw level read at us (mutex held). Edges come oldest first; a repeat of
+// the current level is a glitch the ISR read back too late, or an edge
+// polling already caught. A change that settled before this edge is reported
+// first, so the event log stays in time order.
+void BedControl::acceptOptoEdge(int idx, int level, int64_t us) {
+    settleOpto(idx, us);
+    if (!optoDebounce.edge(idx, level, us)) return;
+    us = optoDebounce.edgeUs(idx);
+    state.remoteEdgeMs = us / 1000;
+    state.remoteEdgeIdx = (int8_t)idx;
+    state.remoteEdgeState = (int8_t)level;
+    OptoEvent ev = {};
+    ev.us = us;
+    ev.opto = (uint8_t)idx;
+    ev.level = (uint8_t)level;
+    ev.kind = OPTO_EVENT_EDGE;
+    optoEvents.push(ev);
+}
+
+// Publishes a debounced change of opto idx that completed by nowUs. The
+// event is stamped when the level became stable (per the channel's
+// DebounceConfig), not when the task got round to it.
+void BedControl::settleOpto(int idx, int64_t nowUs) {
+    OptoDebouncer::Change change;
+    if (!optoDebounce.settle(idx, nowUs, change)) return;
+    state.remoteEventMs = change.atUs / 1000;
+    state.remoteDebounceMs = change.debounceMs;
+    state.remoteOptoIdx = (int8_t)idx;
+    OptoEvent ev = {};
+    ev.us = change.atUs;
+    ev.debounceMs = (int16_t)std::min<int32_t>(INT16_MAX, change.debounceMs);
+    ev.opto = (uint8_t)idx;
+    ev.level = (uint8_t)change.level;
+    ev.kind = OPTO_EVENT_STABLE;
+    optoEvents.push(ev);
+    gestures.change(idx, change.level == 0, change.firstEdgeUs);
+    ESP_LOGI(TAG, "Opto GPIO %d stable=%d after %dms", pins.opto[idx], change.level, (int)change.debounceMs);
+}
+
+// Queues a recognized gesture's action for the motion task's next pass
+// (mutex held), so it coalesces and is acknowledged like an app command.
+void BedControl::runGesture(const RemoteGestures::Fired &g) {
+    const GestureBinding &b = g.binding;
+    BedCommand cmd;
+    switch (b.action) {
+        case GestureAction::STOP: cmd.type = BedCommandType::STOP; break;
+        case GestureAction::SCRIPT: cmd.type = BedCommandType::RUN_SCRIPT; cmd.script = b.script; break;
+        default: {
+            cmd.type = BedCommandType::SET_TARGET;
+            switch (b.action) {
+                case GestureAction::MAX: cmd.headMs = state.headMaxMs; cmd.footMs = state.footMaxMs; break;
+                case GestureAction::ZERO_G:
+                case GestureAction::ANTI_SNORE:
+                case GestureAction::LEGS_UP:
+                case GestureAction::P1:
+                case GestureAction::P2: {
+                    // Same order as the preset slots.
+                    PresetView p;
+                    getPreset((int)b.action - (int)GestureAction::ZERO_G, p);
+                    cmd.headMs = p.headMs;
+                    cmd.footMs = p.footMs;
+                    break;
+                }
+                default: break;     // FLAT
+            }
+            break;
         }
-        initialized = true;
     }
+    const uint32_t id = commands.push(cmd);
+    ESP_LOGI(TAG, "Remote gesture %s 0x%x -> %s (cmd %u)", gestureKindName(b.kind), (unsigned)b.buttons,
+             gestureActionName(b.action), (unsigned)id);
+    OptoEvent ev = {};
+    ev.us = g.atUs;
+    ev.debounceMs = (int16_t)b.holdMs;
+    ev.opto = b.buttons;
+    ev.level = (uint8_t)b.kind;
+    ev.kind = OPTO_EVENT_GESTURE;
+    ev.action = (uint8_t)b.action;
+    ev.script = b.script;
+    optoEvents.push(ev);
+    wakeTask();
+}
+
+void BedControl::updateOptoInputs(int64_t nowUs) {
+    OptoEdge edge;
+    while (optoQueue && xQueueReceive(optoQueue, &edge, 0) == pdTRUE) {
+        if (edge.idx < 4) acceptOptoEdge(edge.idx, edge.level, std::min(edge.us, nowUs));
+    }
+    // Catches edges the queue dropped (or all of them without the ISR).
     for (int i = 0; i < 4; ++i) {
-        int64_t now = millis();
-        int raw = gpio_get_level((gpio_num_t)pins[i]);
-        if (raw == state.optoLastRaw[i]) {
-            if (state.optoCounter[i] < 3) state.optoCounter[i]++;
-        } else {
-            state.optoLastRaw[i] = raw;
-            state.optoCounter[i] = 0;
-            lastRawChangeMs[i] = now;
-            state.remoteEdgeMs = now;
-            state.remoteEdgeIdx = (int8_t)i;
-            state.remoteEdgeState = (int8_t)raw;
-        }
-        if (state.optoCounter[i] >= 2) {
-            state.optoStable[i] = raw;
-            if (lastStable[i] != state.optoStable[i]) {
-                int32_t debounceMs = (int32_t)(now - lastRawChangeMs[i]);
-                state.remoteEventMs = now;
-                state.remoteDebounceMs = debounceMs;
-                state.remoteOptoIdx = (int8_t)i;
-                ESP_LOGI(TAG, "Opto GPIO %d stable=%d after %dms", pins[i], state.optoStable[i], (int)debounceMs);
-                lastStable[i] = state.optoStable[i];
-            }
-        }
+        if (pins.opto[i] >= 0) acceptOptoEdge(i, gpio_get_level((gpio_num_t)pins.opto[i]), nowUs);
+    }
+
+    // Gestures are decided only up to the first unsettled burst: it may be
+    // the next tap, or the release that cuts a hold short.
+    int64_t nextUs = INT64_MAX, settledUs = nowUs;
+    for (int i = 0; i < 4; ++i) {
+        settleOpto(i, nowUs);
+        nextUs = std::min(nextUs, optoDebounce.dueUs(i));
+        if (optoDebounce.pending(i)) settledUs = std::min(settledUs, optoDebounce.burstUs(i) - 1);
+    }
+    RemoteGestures::Fired gesture;
+    if (gestures.poll(settledUs, gesture)) runGesture(gesture);
+    // A deadline the burst holds back is re-decided when the burst settles.
+    const int64_t gestureUs = gestures.dueUs();
+    if (gestureUs > nowUs) nextUs = std::min(nextUs, gestureUs);
+    if (optoTimer && nextUs != INT64_MAX) {
+        esp_timer_stop(optoTimer);
+        esp_timer_start_once(optoTimer, (uint64_t)std::max<int64_t>(1, nextUs - nowUs));
     }
 }
 
 void BedControl::setTransferSwitch(bool active) {
-    int level = active ? RELAY_ON : !RELAY_ON;
-#if BED_TRANSFER_MODE_MULTI
-    gpio_set_level((gpio_num_t)TRANSFER_HEAD_UP_PIN, level);
-    gpio_set_level((gpio_num_t)TRANSFER_HEAD_DOWN_PIN, level);
-    gpio_set_level((gpio_num_t)TRANSFER_FOOT_UP_PIN, level);
-    gpio_set_level((gpio_num_t)TRANSFER_FOOT_DOWN_PIN, level);
-#else
-    gpio_set_level((gpio_num_t)TRANSFER_PIN, level);
-#endif
+    setTransferRelays(active, active, active, active);
 }
 
-static inline void setTransferRelays(bool headUp, bool headDown, bool footUp, bool footDown) {
+void BedControl::setTransferRelays(bool headUp, bool headDown, bool footUp, bool footDown) {
 #if BED_TRANSFER_MODE_MULTI
-    static bool s_last_head_up = false;
-    static bool s_last_head_down = false;
-    static bool s_last_foot_up = false;
-    static bool s_last_foot_down = false;
-    if (headUp != s_last_head_up || headDown != s_last_head_down ||
-        footUp != s_last_foot_up || footDown != s_last_foot_down) {
+    const bool levels[4] = { headUp, headDown, footUp, footDown };
+    if (memcmp(levels, transferLogged, sizeof(levels)) != 0) {
         ESP_LOGI(TAG, "Transfer relays: HU=%d HD=%d FU=%d FD=%d",
                  headUp ? 1 : 0, headDown ? 1 : 0, footUp ? 1 : 0, footDown ? 1 : 0);
-        s_last_head_up = headUp;
-        s_last_head_down = headDown;
-        s_last_foot_up = footUp;
-        s_last_foot_down = footDown;
-    }
-    gpio_set_level((gpio_num_t)TRANSFER_HEAD_UP_PIN, headUp ? RELAY_ON : RELAY_OFF);
-    gpio_set_level((gpio_num_t)TRANSFER_HEAD_DOWN_PIN, headDown ? RELAY_ON : RELAY_OFF);
-    gpio_set_level((gpio_num_t)TRANSFER_FOOT_UP_PIN, footUp ? RELAY_ON : RELAY_OFF);
-    gpio_set_level((gpio_num_t)TRANSFER_FOOT_DOWN_PIN, footDown ? RELAY_ON : RELAY_OFF);
+        memcpy(transferLogged, levels, sizeof(levels));
+    }
+    relays.request(RELAY_TRANSFER_HEAD_UP, headUp);
+    relays.request(RELAY_TRANSFER_HEAD_DOWN, headDown);
+    relays.request(RELAY_TRANSFER_FOOT_UP, footUp);
+    relays.request(RELAY_TRANSFER_FOOT_DOWN, footDown);
 #else
-    bool any = headUp || headDown || footUp || footDown;
-    gpio_set_level((gpio_num_t)TRANSFER_PIN, any ? RELAY_ON : RELAY_OFF);
+    relays.request(RELAY_TRANSFER_HEAD_UP, headUp || headDown || footUp || footDown);
 #endif
 }
 
+// --- POSITION JOURNAL ---
+void BedControl::loadPosition() {
+    PositionRecord rec = {};
+    if (journal.load(nvsHandle, rec)) {
+        state.headPosUs = (int64_t)rec.headPosMs * 1000;
+        state.footPosUs = (int64_t)rec.footPosMs * 1000;
+        state.headEndStop = static_cast<MotionDir>(rec.headEndStop);
+        state.footEndStop = static_cast<MotionDir>(rec.footEndStop);
+        state.headUncertMs = rec.headUncertDs * 100;
+        state.footUncertMs = rec.footUncertDs * 100;
+        state.posDirty = false;
+        ESP_LOGI(TAG, "Position restored from journal seq=%u", (unsigned)rec.seq);
+    } else {
+        // First boot after the journal was introduced: migrate the legacy keys.
+        state.headPosUs = (int64_t)getSavedPos("headPos", 0) * 1000;
+        state.footPosUs = (int64_t)getSavedPos("footPos", 0) * 1000;
+        state.headEndStop = MotionDir::STOPPED;
+        state.footEndStop = MotionDir::STOPPED;
+        // Nothing known about the error: the first run to an end re-homes.
+        state.headUncertMs = REHOME_THRESHOLD_MS;
+        state.footUncertMs = REHOME_THRESHOLD_MS;
+        state.posDirty = true;
+    }
+    state.headPosUs = std::max<int64_t>(0, std::min<int64_t>((int64_t)state.headMaxMs * 1000, state.headPosUs));
+    state.footPosUs = std::max<int64_t>(0, std::min<int64_t>((int64_t)state.footMaxMs * 1000, state.footPosUs));
+    state.posChangedMs = millis();
+    state.posDirtySinceMs = state.posChangedMs;
+}
+
+void BedControl::markPositionDirty(int64_t now) {
+    if (!state.posDirty) state.posDirtySinceMs = now;
+    state.posDirty = true;
+    state.posChangedMs = now;
+}
+
+// Hands out a record to persist once nothing has moved for POS_JOURNAL_IDLE_MS,
+// so a burst of taps costs one commit instead of one per stop. Under continuous
+// use the first stop after POS_JOURNAL_MAX_DIRTY_MS flushes anyway.
+bool BedControl::takePositionFlush(int64_t now, PositionRecord &rec) {
+    if (!state.posDirty) return false;
+    if (state.headDir != MotionDir::STOPPED || state.footDir != MotionDir::STOPPED ||
+        state.remoteHeadDir != MotionDir::STOPPED || state.remoteFootDir != MotionDir::STOPPED) {
+        return false;
+    }
+    if (now - state.posChangedMs < POS_JOURNAL_IDLE_MS &&
+        now - state.posDirtySinceMs < POS_JOURNAL_MAX_DIRTY_MS) {
+        return false;
+    }
+    rec.headPosMs = usToMs(state.headPosUs);
+    rec.footPosMs = usToMs(state.footPosUs);
+    rec.headEndStop = static_cast<int8_t>(state.headEndStop);
+    rec.footEndStop = static_cast<int8_t>(state.footEndStop);
+    rec.headUncertDs = (uint8_t)std::min<int32_t>(255, (state.headUncertMs + 99) / 100);
+    rec.footUncertDs = (uint8_t)std::min<int32_t>(255, (state.footUncertMs + 99) / 100);
+    state.posDirty = false;
+    return true;
+}
+
 // --- NVS HELPERS ---
 
 int32_t BedControl::getSavedPos(const char* key, int32_t defaultVal) {
@@ -553,108 +1586,189 @@ void BedControl::setSavedPos(const char* key, int32_t val) {
     nvs_commit(nvsHandle);
 }
 
+// Preset slot i from RAM (any task; may be called with the mutex held).
+void BedControl::getPreset(int i, PresetView &out) {
+    if (presetMutex && xSemaphoreTake(presetMutex, portMAX_DELAY)) {
+        out = presets.get(i);
+        xSemaphoreGive(presetMutex);
+    } else {
+        out = PresetTable::factory(i);
+    }
+}
+
+size_t BedControl::listPresets(size_t first, PresetEntry *out, size_t max, PresetStoreInfo &info) {
+    size_t n = 0;
+    if (!presetMutex || !xSemaphoreTake(presetMutex, portMAX_DELAY)) return 0;
+    info = presets.info();
+    for (size_t i = first; i < presets.count() && n < max; ++i) out[n++] = presets.at(i);
+    xSemaphoreGive(presetMutex);
+    return n;
+}
+
+bool BedControl::getPresetById(uint16_t id, PresetEntry &out) {
+    if (!presetMutex || !xSemaphoreTake(presetMutex, portMAX_DELAY)) return false;
+    const int pos = presets.find(id);
+    if (pos >= 0) out = presets.at(pos);
+    xSemaphoreGive(presetMutex);
+    return pos >= 0;
+}
+
+uint16_t BedControl::savePreset(const PresetEntry &preset, int position) {
+    if (!presetMutex || !xSemaphoreTake(presetMutex, portMAX_DELAY)) return 0;
+    const uint16_t id = presets.save(nvsHandle, preset, position);
+    xSemaphoreGive(presetMutex);
+    return id;
+}
+
+bool BedControl::deletePreset(uint16_t id) {
+    if (!presetMutex || !xSemaphoreTake(presetMutex, portMAX_DELAY)) return false;
+    const bool ok = presets.remove(nvsHandle, id);
+    xSemaphoreGive(presetMutex);
+    return ok;
+}
+
 // --- LOGIC & MOVEMENT ---
 
 void BedControl::syncState() {
     int64_t now = millis();
+    const int64_t nowUs = esp_timer_get_time();
     stopHardware();
 
-    if (state.headStartTime != 0 && state.headDir != "STOPPED") {
-        int32_t elapsed = (int32_t)(now - state.headStartTime);
-        if (state.headDir == "UP") state.currentHeadPosMs += elapsed;
-        else state.currentHeadPosMs -= elapsed;
-        
-        if (state.currentHeadPosMs > state.headMaxMs) state.currentHeadPosMs = state.headMaxMs;
-        if (state.currentHeadPosMs < 0) state.currentHeadPosMs = 0;
-        state.headDir = "STOPPED"; state.headStartTime = 0;
+    // A preset leg still running here was cut short (STOP or a new command).
+    const MoveSource source = state.isPresetActive ? MoveSource::PRESET : MoveSource::APP;
+    const uint8_t cut = state.isPresetActive ? MOVE_FLAG_INTERRUPTED : 0;
+    if (state.headStartUs != 0 && state.headDir != MotionDir::STOPPED) {
+        const int64_t fromUs = state.headPosUs;
+        const int64_t elapsed = driveUsAt(true, nowUs);
+        const int64_t travel = travelForRelayUs(state.headModel, state.headDir, elapsed, true);
+        const int64_t overrun = applyTravel(state.headPosUs, state.headDir, travel, state.headMaxMs);
+        state.headEndStop = settleRun(state.headDir, travel, overrun, false, state.headUncertMs, state.headMaxMs);
+        recordMove(true, state.headDir, source, state.headStartUs, nowUs, fromUs,
+                   cut | (state.headEndStop != MotionDir::STOPPED ? MOVE_FLAG_END_STOP : 0));
+        state.headDir = MotionDir::STOPPED; state.headStartUs = 0;
     }
     
-    if (state.footStartTime != 0 && state.footDir != "STOPPED") {
-        int32_t elapsed = (int32_t)(now - state.footStartTime);
-        if (state.footDir == "UP") state.currentFootPosMs += elapsed;
-        else state.currentFootPosMs -= elapsed;
-
-        if (state.currentFootPosMs > state.footMaxMs) state.currentFootPosMs = state.footMaxMs;
-        if (state.currentFootPosMs < 0) state.currentFootPosMs = 0;
-        state.footDir = "STOPPED"; state.footStartTime = 0;
+    if (state.footStartUs != 0 && state.footDir != MotionDir::STOPPED) {
+        const int64_t fromUs = state.footPosUs;
+        const int64_t elapsed = driveUsAt(false, nowUs);
+        const int64_t travel = travelForRelayUs(state.footModel, state.footDir, elapsed, true);
+        const int64_t overrun = applyTravel(state.footPosUs, state.footDir, travel, state.footMaxMs);
+        state.footEndStop = settleRun(state.footDir, travel, overrun, false, state.footUncertMs, state.footMaxMs);
+        recordMove(false, state.footDir, source, state.footStartUs, nowUs, fromUs,
+                   cut | (state.footEndStop != MotionDir::STOPPED ? MOVE_FLAG_END_STOP : 0));
+        state.footDir = MotionDir::STOPPED; state.footStartUs = 0;
     }
 
+    state.headDriveDutyUs = state.footDriveDutyUs = 0;
+    state.headDriveFromUs = state.footDriveFromUs = -1;
+    state.headPendingDir = state.footPendingDir = MotionDir::STOPPED;
+    state.headCmdTravelMs = state.footCmdTravelMs = -1;   // a dropped pending leg never ran
+
+    if (state.isPresetActive && presetTimer) esp_timer_stop(presetTimer);
     state.isPresetActive = false;
-    setTransferSwitch(false);
-    setSavedPos("headPos", state.currentHeadPosMs);
-    setSavedPos("footPos", state.currentFootPosMs);
+    markPositionDirty(now);
 }
 
 void BedControl::stop() {
     if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        state.scriptActive = false;
         syncState();
+        publishSnapshot(millis());
         xSemaphoreGive(mutex);
+        wakeTask();
     }
 }
 
-void BedControl::moveHead(std::string dir) {
+void BedControl::moveHead(MotionDir dir) {
     if (xSemaphoreTake(mutex, portMAX_DELAY)) {
-        syncState(); 
+        state.scriptActive = false;
+        syncState();
+        if (dir == MotionDir::STOPPED) {
+            publishSnapshot(millis());
+            xSemaphoreGive(mutex);
+            wakeTask();
+            return;
+        }
         setTransferRelays(true, true, false, false);
-        state.headStartTime = millis();
+        state.headStartUs = esp_timer_get_time();
         state.headDir = dir;
         state.isPresetActive = false; 
         
-        if (dir == "UP") {
+        if (dir == MotionDir::UP) {
             state.headDutyTarget = MOTOR_PWM_DUTY_MAX;
             state.headDuty = 0;
-            applyHeadPWM(0, true);
+            applyPWM(true, 0, true);
             setHeadRelay(true, true);
         } else {
             state.headDutyTarget = MOTOR_PWM_DUTY_MAX;
             state.headDuty = 0;
-            applyHeadPWM(0, false);
+            applyPWM(true, 0, false);
             setHeadRelay(false, true);
         }
+        serviceRelays();
+        publishSnapshot(millis());
         xSemaphoreGive(mutex);
+        wakeTask();
     }
 }
 
-void BedControl::moveFoot(std::string dir) {
+void BedControl::moveFoot(MotionDir dir) {
      if (xSemaphoreTake(mutex, portMAX_DELAY)) {
-        syncState(); 
+        state.scriptActive = false;
+        syncState();
+        if (dir == MotionDir::STOPPED) {
+            publishSnapshot(millis());
+            xSemaphoreGive(mutex);
+            wakeTask();
+            return;
+        }
         setTransferRelays(false, false, true, true);
-        state.footStartTime = millis();
+        state.footStartUs = esp_timer_get_time();
         state.footDir = dir;
         state.isPresetActive = false; 
         
-        if (dir == "UP") {
+        if (dir == MotionDir::UP) {
             state.footDutyTarget = MOTOR_PWM_DUTY_MAX;
             state.footDuty = 0;
-            applyFootPWM(0, true);
+            applyPWM(false, 0, true);
             setFootRelay(true, true);
         } else {
             state.footDutyTarget = MOTOR_PWM_DUTY_MAX;
             state.footDuty = 0;
-            applyFootPWM(0, false);
+            applyPWM(false, 0, false);
             setFootRelay(false, true);
         }
+        serviceRelays();
+        publishSnapshot(millis());
         xSemaphoreGive(mutex);
+        wakeTask();
     }
 }
 
-void BedControl::moveAll(std::string dir) {
+void BedControl::moveAll(MotionDir dir) {
     if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        state.scriptActive = false;
         syncState();
+        if (dir == MotionDir::STOPPED) {
+            publishSnapshot(millis());
+            xSemaphoreGive(mutex);
+            wakeTask();
+            return;
+        }
         setTransferRelays(true, true, true, true);
-        state.headStartTime = millis();
-        state.footStartTime = millis();
+        state.headStartUs = esp_timer_get_time();
+        state.footStartUs = esp_timer_get_time();
         state.headDir = dir;
         state.footDir = dir;
         state.isPresetActive = false;
 
-        if (dir == "UP") {
+        if (dir == MotionDir::UP) {
             state.headDutyTarget = MOTOR_PWM_DUTY_MAX;
             state.footDutyTarget = MOTOR_PWM_DUTY_MAX;
             state.headDuty = 0;
             state.footDuty = 0;
-            applyHeadPWM(0, true);
-            applyFootPWM(0, true);
+            applyPWM(true, 0, true);
+            applyPWM(false, 0, true);
             setHeadRelay(true, true);
             setFootRelay(true, true);
         } else { // DOWN
@@ -662,196 +1776,685 @@ void BedControl::moveAll(std::string dir) {
             state.footDutyTarget = MOTOR_PWM_DUTY_MAX;
             state.headDuty = 0;
             state.footDuty = 0;
-            applyHeadPWM(0, false);
-            applyFootPWM(0, false);
+            applyPWM(true, 0, false);
+            applyPWM(false, 0, false);
             setHeadRelay(false, true);
             setFootRelay(false, true);
         }
+        serviceRelays();
+        publishSnapshot(millis());
         xSemaphoreGive(mutex);
+        wakeTask();
     }
 }
 
 int32_t BedControl::setTarget(int32_t tHead, int32_t tFoot) {
     int32_t maxDur = 0;
     if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        state.scriptActive = false;
         syncState();
-        
-        if (tHead < 0) tHead = 0;
-        if (tFoot < 0) tFoot = 0;
-        if (tHead > state.headMaxMs) tHead = state.headMaxMs;
-        if (tFoot > state.footMaxMs) tFoot = state.footMaxMs;
-
-        int32_t hDiff = tHead - state.currentHeadPosMs;
-        int32_t fDiff = tFoot - state.currentFootPosMs;
-        int64_t now = millis();
-        setTransferRelays(std::abs(hDiff) > 100, std::abs(hDiff) > 100,
-                          std::abs(fDiff) > 100, std::abs(fDiff) > 100);
-
-        if (std::abs(hDiff) > 100) {
-            state.headStartTime = now;
-            state.headTargetDuration = std::abs(hDiff);
-            if (tHead == 0 || tHead == state.headMaxMs) state.headTargetDuration += SYNC_EXTRA_MS;
-            if (state.headTargetDuration > maxDur) maxDur = state.headTargetDuration;
-            
-            state.headDutyTarget = MOTOR_PWM_DUTY_MAX;
-            state.headDuty = 0;
-            if (hDiff > 0) { state.headDir = "UP"; applyHeadPWM(0, true); setHeadRelay(true, true); }
-            else { state.headDir = "DOWN"; applyHeadPWM(0, false); setHeadRelay(false, true); }
-        }
-
-        if (std::abs(fDiff) > 100) {
-            state.footStartTime = now;
-            state.footTargetDuration = std::abs(fDiff);
-            if (tFoot == 0 || tFoot == state.footMaxMs) state.footTargetDuration += SYNC_EXTRA_MS;
-            if (state.footTargetDuration > maxDur) maxDur = state.footTargetDuration;
-
-            state.footDutyTarget = MOTOR_PWM_DUTY_MAX;
-            state.footDuty = 0;
-            if (fDiff > 0) { state.footDir = "UP"; applyFootPWM(0, true); setFootRelay(true, true); }
-            else { state.footDir = "DOWN"; applyFootPWM(0, false); setFootRelay(false, true); }
-        }
-
-        if (maxDur > 0) {
-            state.isPresetActive = true;
+        const int64_t now = millis();
+        // Publishing first gives the planner the settled position to work from.
+        publishSnapshot(now);
+        MotionScript route;
+        if (planRehomeRoute(snapshot, tHead, tFoot, route)) {
+            ESP_LOGI(TAG, "Re-home due (head=%dms foot=%dms uncertain); routing via the end",
+                     (int)state.headUncertMs, (int)state.footUncertMs);
+            maxDur = rehomeRouteMs(route, snapshot);
+            beginScript(route, kRehomeRouteSlot, now);
         } else {
-            setTransferRelays(false, false, false, false);
+            maxDur = startPreset(tHead, tFoot);
         }
+        publishSnapshot(now);
         xSemaphoreGive(mutex);
+        wakeTask();
     }
     return maxDur;
 }
 
-void BedControl::update() {
-    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
-        int64_t now = millis();
-        updateOptoInputs();
-        updateMotionLed(now);
+// Starts the relay legs for a preset from a stopped state (mutex held), in
+// the order state.arrival asks for. Returns the ms until the last leg ends,
+// 0 if both axes are already within deadband.
+int32_t BedControl::startPreset(int32_t tHead, int32_t tFoot) {
+    const int64_t nowUs = esp_timer_get_time();
+    tHead = std::max<int32_t>(0, std::min(state.headMaxMs, tHead));
+    tFoot = std::max<int32_t>(0, std::min(state.footMaxMs, tFoot));
+
+    const int32_t headPos = usToMs(state.headPosUs), footPos = usToMs(state.footPosUs);
+    const PresetPlan plan = planPreset(state.arrival, state.headModel, state.footModel,
+                                       presetLegMs(state.headModel, headPos, tHead, state.headMaxMs, state.headUncertMs),
+                                       presetLegMs(state.footModel, footPos, tFoot, state.footMaxMs, state.footUncertMs));
+    if (plan.spanMs <= 0) return 0;
+    const bool head = plan.headLegMs > 0, foot = plan.footLegMs > 0;
+    setTransferRelays(head, head, foot, foot);
+    state.headTargetDuration = plan.headLegMs;
+    state.footTargetDuration = plan.footLegMs;
+    state.headDutyTarget = plan.headDuty;
+    state.footDutyTarget = plan.footDuty;
+    state.headCmdTravelMs = head ? std::abs(tHead - headPos) : -1;
+    state.footCmdTravelMs = foot ? std::abs(tFoot - footPos) : -1;
+    const MotionDir headDir = tHead > headPos ? MotionDir::UP : MotionDir::DOWN;
+    const MotionDir footDir = tFoot > footPos ? MotionDir::UP : MotionDir::DOWN;
+
+    // START_TOGETHER leaves the order to the sequencer (head first); the
+    // other policies hold the follower back until its planned start.
+    const bool staged = head && foot && state.arrival != ArrivalPolicy::START_TOGETHER;
+    if (head) {
+        if (staged && plan.footLeads) state.headPendingDir = headDir;
+        else startPresetLeg(true, headDir, nowUs);
+    }
+    if (foot) {
+        if (staged && !plan.footLeads) state.footPendingDir = footDir;
+        else startPresetLeg(false, footDir, nowUs);
+    }
+    serviceRelays();
+
+    // Legs run from their relay closing, after the transfer settle and
+    // (second axis) the start stagger, and end with their soft stop.
+    auto endUs = [](int64_t startUs, int32_t legMs) { return startUs + (int64_t)legEndMs(legMs) * 1000; };
+    int64_t lastUs = nowUs;
+    if (state.headDir != MotionDir::STOPPED) lastUs = endUs(state.headStartUs, state.headTargetDuration);
+    if (state.footDir != MotionDir::STOPPED) lastUs = std::max(lastUs, endUs(state.footStartUs, state.footTargetDuration));
+    if (staged) {
+        const int64_t leaderUs = plan.footLeads ? state.footStartUs : state.headStartUs;
+        state.pendingStartUs = plan.lagMs < 0 ? 0 : leaderUs + (int64_t)plan.lagMs * 1000;
+        const int64_t followerUs = std::max(leaderUs + (int64_t)RELAY_MOTOR_STAGGER_MS * 1000,
+                                            plan.lagMs < 0 ? lastUs : state.pendingStartUs);
+        lastUs = std::max(lastUs, endUs(followerUs, plan.footLeads ? plan.headLegMs : plan.footLegMs));
+        ESP_LOGI(TAG, "Preset %s: %s leads, %s follows %dms later", arrivalPolicyName(state.arrival),
+                 plan.footLeads ? "foot" : "head", plan.footLeads ? "head" : "foot", (int)((followerUs - leaderUs) / 1000));
+    }
+    state.isPresetActive = true;
+    armPresetTimer(nowUs);
+    return (int32_t)((lastUs - nowUs + 999) / 1000);
+}
 
-        int64_t dt = now - state.remoteLastMs;
-        if (dt < 0 || dt > 2000) dt = 0;
-        state.remoteLastMs = now;
+// Drives one preset leg whose duration and duty target are already set
+// (mutex held).
+void BedControl::startPresetLeg(bool head, MotionDir dir, int64_t nowUs) {
+    const bool up = dir == MotionDir::UP;
+    if (head) {
+        state.headStartUs = nowUs;
+        state.headDir = dir;
+        state.headDuty = 0;
+        applyPWM(true, 0, up);
+        setHeadRelay(up, true);
+    } else {
+        state.footStartUs = nowUs;
+        state.footDir = dir;
+        state.footDuty = 0;
+        applyPWM(false, 0, up);
+        setFootRelay(up, true);
+    }
+}
 
-        std::string newRemoteHeadDir = "STOPPED";
-        std::string newRemoteFootDir = "STOPPED";
-        if (state.optoStable[0] == 0 && state.optoStable[1] == 1) newRemoteHeadDir = "UP";
-        else if (state.optoStable[1] == 0 && state.optoStable[0] == 1) newRemoteHeadDir = "DOWN";
-        if (state.optoStable[2] == 0 && state.optoStable[3] == 1) newRemoteFootDir = "UP";
-        else if (state.optoStable[3] == 0 && state.optoStable[2] == 1) newRemoteFootDir = "DOWN";
+// Starts the follower leg of a staged preset once it is due (mutex held).
+void BedControl::startPendingLeg(int64_t nowUs) {
+    const bool head = state.headPendingDir != MotionDir::STOPPED;
+    if (!head && state.footPendingDir == MotionDir::STOPPED) return;
+    if (state.pendingStartUs > 0 ? nowUs < state.pendingStartUs
+                                 : (head ? state.footDir : state.headDir) != MotionDir::STOPPED) {
+        return;
+    }
+    MotionDir &pending = head ? state.headPendingDir : state.footPendingDir;
+    startPresetLeg(head, pending, nowUs);
+    pending = MotionDir::STOPPED;
+    state.pendingStartUs = 0;
+}
+
+// --- MOTION SCRIPTS ---
+
+static void scriptKey(uint8_t slot, char (&key)[8]) {
+    snprintf(key, sizeof(key), "scr_%u", (unsigned)slot);
+}
+
+bool BedControl::loadScript(uint8_t slot, MotionScript &out) {
+    if (slot >= BED_SCRIPT_SLOTS) return false;
+    char key[8];
+    scriptKey(slot, key);
+    out = MotionScript{};
+    size_t len = sizeof(out);
+    if (nvs_get_blob(nvsHandle, key, &out, &len) != ESP_OK) return false;
+    if (len != out.storedSize() || !out.valid()) {
+        ESP_LOGW(TAG, "Script %s is corrupt (len=%u); ignoring", key, (unsigned)len);
+        return false;
+    }
+    return true;
+}
+
+bool BedControl::saveScript(uint8_t slot, const MotionScript &script) {
+    if (slot >= BED_SCRIPT_SLOTS || !script.valid()) return false;
+    char key[8];
+    scriptKey(slot, key);
+    if (nvs_set_blob(nvsHandle, key, &script, script.storedSize()) != ESP_OK) return false;
+    return nvs_commit(nvsHandle) == ESP_OK;
+}
 
-        if (state.headDir != "STOPPED") newRemoteHeadDir = "STOPPED";
-        if (state.footDir != "STOPPED") newRemoteFootDir = "STOPPED";
+void BedControl::clearScript(uint8_t slot) {
+    if (slot >= BED_SCRIPT_SLOTS) return;
+    char key[8];
+    scriptKey(slot, key);
+    nvs_erase_key(nvsHandle, key);
+    nvs_commit(nvsHandle);
+}
 
-        if (dt > 0) {
-            if (newRemoteHeadDir == "UP") state.currentHeadPosMs += (int32_t)dt;
-            else if (newRemoteHeadDir == "DOWN") state.currentHeadPosMs -= (int32_t)dt;
-            if (newRemoteFootDir == "UP") state.currentFootPosMs += (int32_t)dt;
-            else if (newRemoteFootDir == "DOWN") state.currentFootPosMs -= (int32_t)dt;
-            if (state.currentHeadPosMs > state.headMaxMs) state.currentHeadPosMs = state.headMaxMs;
-            if (state.currentHeadPosMs < 0) state.currentHeadPosMs = 0;
-            if (state.currentFootPosMs > state.footMaxMs) state.currentFootPosMs = state.footMaxMs;
-            if (state.currentFootPosMs < 0) state.currentFootPosMs = 0;
+// Motion task: the NVS read happens before the mutex is taken.
+void BedControl::startScript(uint8_t slot) {
+    MotionScript script;
+    const bool ok = loadScript(slot, script);
+    if (!ok) ESP_LOGW(TAG, "Script %u not found; stopping", (unsigned)slot);
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        state.scriptActive = false;
+        syncState();
+        const int64_t now = millis();
+        if (ok) {
+            ESP_LOGI(TAG, "Script %u started (%u steps)", (unsigned)slot, (unsigned)script.stepCount);
+            beginScript(script, (int8_t)slot, now);
         }
+        publishSnapshot(now);
+        xSemaphoreGive(mutex);
+    }
+}
 
-        if (state.remoteHeadDir != "STOPPED" && newRemoteHeadDir == "STOPPED") {
-            setSavedPos("headPos", state.currentHeadPosMs);
+// Mutex held, axes stopped.
+void BedControl::beginScript(const MotionScript &script, int8_t slot, int64_t now) {
+    state.script = script;
+    state.scriptActive = true;
+    state.scriptSlot = slot;
+    state.scriptPc = 0;
+    state.scriptLegActive = false;
+    std::memset(state.scriptLoopLeft, 0xFF, sizeof(state.scriptLoopLeft));
+    state.scriptWaitUntilMs = 0;
+    stepScript(now);
+}
+
+// Runs script steps until one has to wait for a leg or a pause (mutex held).
+// Called whenever a leg or pause may have ended: preset timer, update().
+void BedControl::stepScript(int64_t now) {
+    for (int guard = 0; state.scriptActive && guard < MotionScript::kMaxSteps * 4; ++guard) {
+        if (state.isPresetActive || now < state.scriptWaitUntilMs) return;
+        if (state.scriptLegActive) {
+            // Let the actuators coast to rest so the next leg starts from a
+            // known position (and never reverses a still-moving motor).
+            state.scriptLegActive = false;
+            state.scriptWaitUntilMs = now + scriptSettleMs(state.headModel, state.footModel);
+            if (state.scriptWaitUntilMs > now) { armPresetTimer(now * 1000); return; }
         }
-        if (state.remoteFootDir != "STOPPED" && newRemoteFootDir == "STOPPED") {
-            setSavedPos("footPos", state.currentFootPosMs);
+        if (state.scriptPc >= state.script.stepCount) {
+            ESP_LOGI(TAG, "Script %d complete", (int)state.scriptSlot);
+            state.scriptActive = false;
+            return;
         }
-        state.remoteHeadDir = newRemoteHeadDir;
-        state.remoteFootDir = newRemoteFootDir;
-
-        // PWM ramp for DRV8871
-#if BED_MOTOR_DRIVER_DRV8871
-        if (s_ledc_ready) {
-            if (state.headDir != "STOPPED") {
-                if (state.headDuty < state.headDutyTarget) {
-                    state.headDuty += MOTOR_PWM_RAMP_STEP;
-                    if (state.headDuty > state.headDutyTarget) state.headDuty = state.headDutyTarget;
+        const uint8_t pc = state.scriptPc;
+        const ScriptStep &step = state.script.steps[pc];
+        switch (step.op) {
+            case ScriptOp::MOVE:
+                state.scriptPc++;
+                state.scriptLegActive = startPreset(step.headMs == SCRIPT_KEEP ? usToMs(state.headPosUs) : step.headMs,
+                                                    step.footMs == SCRIPT_KEEP ? usToMs(state.footPosUs) : step.footMs) > 0;
+                break;
+            case ScriptOp::WAIT:
+                state.scriptPc++;
+                state.scriptWaitUntilMs = now + step.headMs;
+                armPresetTimer(now * 1000);
+                break;
+            case ScriptOp::LOOP:
+                if (state.scriptLoopLeft[pc] == 0xFF) state.scriptLoopLeft[pc] = step.count;
+                if (state.scriptLoopLeft[pc] > 0) {
+                    state.scriptLoopLeft[pc]--;
+                    state.scriptPc = (uint8_t)step.headMs;
+                } else {
+                    state.scriptLoopLeft[pc] = 0xFF;   // re-arm for an enclosing loop
+                    state.scriptPc++;
                 }
-                applyHeadPWM(state.headDuty, state.headDir == "UP");
-            } else {
-                applyHeadPWM(0, true);
-            }
+                break;
+        }
+    }
+}
 
-            if (state.footDir != "STOPPED") {
-                if (state.footDuty < state.footDutyTarget) {
-                    state.footDuty += MOTOR_PWM_RAMP_STEP;
-                    if (state.footDuty > state.footDutyTarget) state.footDuty = state.footDutyTarget;
-                }
-                applyFootPWM(state.footDuty, state.footDir == "UP");
+// --- COMMAND QUEUE ---
+
+BedCommandTicket BedControl::submit(const BedCommand &cmd) {
+    BedCommandTicket ticket;
+    ticket.id = commands.push(cmd);
+    if (ticket.id == 0) {
+        ESP_LOGW(TAG, "Command queue full; dropped type=%d", (int)cmd.type);
+        return ticket;
+    }
+    wakeTask();
+
+    // Predict from the published snapshot (at most one tick old) so the
+    // caller never waits for the mutex.
+    BedSnapshot snap;
+    getSnapshot(snap);
+    switch (cmd.type) {
+        case BedCommandType::STOP:
+            ticket.durationMs = std::max(snap.headDir != MotionDir::STOPPED ? snap.headModel.stopLatencyMs : 0,
+                                         snap.footDir != MotionDir::STOPPED ? snap.footModel.stopLatencyMs : 0);
+            break;
+        case BedCommandType::SET_TARGET: {
+            const int32_t tHead = std::max<int32_t>(0, std::min(snap.headMaxMs, cmd.headMs));
+            const int32_t tFoot = std::max<int32_t>(0, std::min(snap.footMaxMs, cmd.footMs));
+            MotionScript route;
+            if (planRehomeRoute(snap, tHead, tFoot, route)) {
+                ticket.durationMs = rehomeRouteMs(route, snap);
             } else {
-                applyFootPWM(0, true);
+                ticket.durationMs = planPreset(snap.arrival, snap.headModel, snap.footModel,
+                                               presetLegMs(snap.headModel, snap.headPosMs, tHead, snap.headMaxMs, snap.headUncertMs),
+                                               presetLegMs(snap.footModel, snap.footPosMs, tFoot, snap.footMaxMs, snap.footUncertMs)).spanMs;
             }
+            break;
+        }
+        case BedCommandType::RUN_SCRIPT: {
+            MotionScript script;
+            if (loadScript(cmd.script, script)) ticket.durationMs = scriptDurationMs(script, snap);
+            break;
         }
+        default:
+            break;  // manual moves run until STOP
+    }
+    ticket.etaMs = millis() + ticket.durationMs;
+    return ticket;
+}
+
+// Motion task: applies what was queued since the last tick. Returns the
+// newest command id covered, or 0 if nothing was pending.
+uint32_t BedControl::runQueuedCommands() {
+    BedCommandQueue::Batch batch;
+    if (!commands.drain(batch)) return 0;
+    if (batch.superseded) ESP_LOGD(TAG, "Coalesced %u queued command(s)", (unsigned)batch.superseded);
+    if (batch.stop) stop();
+    if (batch.hasMotion) {
+        const BedCommand &cmd = batch.motion;
+        switch (cmd.type) {
+            case BedCommandType::MOVE_HEAD: moveHead(cmd.dir); break;
+            case BedCommandType::MOVE_FOOT: moveFoot(cmd.dir); break;
+            case BedCommandType::MOVE_ALL: moveAll(cmd.dir); break;
+            case BedCommandType::SET_TARGET: setTarget(cmd.headMs, cmd.footMs); break;
+            case BedCommandType::RUN_SCRIPT: startScript(cmd.script); break;
+            default: stop(); break;
+        }
+    }
+    return batch.lastId;
+}
+
+void BedControl::attachTask(TaskHandle_t task) {
+    motionTask = task;
+}
+
+void BedControl::wakeTask() {
+    if (motionTask) xTaskNotifyGive(motionTask);
+}
+
+// How long the motion task may sleep: fast only while something needs
+// sampling (PWM ramp, opto debounce, remote-driven dead reckoning).
+uint32_t BedControl::nextTickMs(int64_t now) {
+    // Sequenced relay switches have their own timer; without it, poll.
+    if (!relayTimer && relayDueUs >= 0) return BED_TICK_FAST_MS;
+#if BED_MOTOR_DRIVER_DRV8871
+    // Ramping up, or a preset leg past its deadline ramping down
+    if ((state.headDir != MotionDir::STOPPED && state.headDuty < state.headDutyTarget) ||
+        (state.footDir != MotionDir::STOPPED && state.footDuty < state.footDutyTarget)) {
+        return BED_TICK_FAST_MS;
+    }
+    if (state.isPresetActive &&
+        ((state.headDir != MotionDir::STOPPED && now * 1000 >= state.headStartUs + state.headTargetDuration * 1000LL) ||
+         (state.footDir != MotionDir::STOPPED && now * 1000 >= state.footStartUs + state.footTargetDuration * 1000LL))) {
+        return BED_TICK_FAST_MS;
+    }
 #endif
+    // Debounce windows and gesture deadlines have their own timer; without it, poll.
+    for (int i = 0; i < 4; ++i) {
+        if (!optoTimer && optoDebounce.pending(i)) return BED_TICK_FAST_MS;
+    }
+    if (!optoTimer && gestures.dueUs() != INT64_MAX) return BED_TICK_FAST_MS;
+    if (state.remoteHeadDir != MotionDir::STOPPED || state.remoteFootDir != MotionDir::STOPPED) {
+        return BED_TICK_FAST_MS;
+    }
+    // A held remote button waiting for its transfer relay to release
+    if ((state.headDir == MotionDir::STOPPED && (optoDebounce.stable(0) == 0 || optoDebounce.stable(1) == 0)) ||
+        (state.footDir == MotionDir::STOPPED && (optoDebounce.stable(2) == 0 || optoDebounce.stable(3) == 0))) {
+        return BED_TICK_FAST_MS;
+    }
+    if (state.headDir != MotionDir::STOPPED || state.footDir != MotionDir::STOPPED) {
+        return BED_TICK_MOTION_MS;
+    }
+    if (state.scriptActive) {
+        // Between legs: the preset timer covers pauses; this is the fallback.
+        const int64_t dueIn = state.scriptWaitUntilMs - now;
+        return (uint32_t)std::max<int64_t>(1, std::min<int64_t>(dueIn, BED_TICK_MOTION_MS));
+    }
+    if (state.posDirty) {
+        const int64_t dueIn = std::min(state.posChangedMs + POS_JOURNAL_IDLE_MS,
+                                       state.posDirtySinceMs + POS_JOURNAL_MAX_DIRTY_MS) - now;
+        if (dueIn < BED_TICK_IDLE_MS) return (uint32_t)std::max<int64_t>(1, dueIn);
+    }
+    return BED_TICK_IDLE_MS;
+}
+
+void BedControl::presetTimerCb(void* arg) {
+    static_cast<BedControl*>(arg)->onPresetDeadline();
+}
 
+// Runs in the esp_timer task at the exact end of the earliest preset leg.
+void BedControl::onPresetDeadline() {
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        int64_t now = millis();
         if (state.isPresetActive) {
-            bool headDone = true; bool footDone = true;
-
-            if (state.headDir != "STOPPED") {
-                int32_t elapsed = (int32_t)(now - state.headStartTime);
-                if (elapsed >= state.headTargetDuration) {
-                    applyHeadPWM(0, true);
-                    setHeadRelay(true, false);
-                    state.headDuty = state.headDutyTarget = 0;
-                    
-                    if (state.headDir == "UP") state.currentHeadPosMs += state.headTargetDuration;
-                    else state.currentHeadPosMs -= state.headTargetDuration;
-                    
-                    if (state.currentHeadPosMs > state.headMaxMs) state.currentHeadPosMs = state.headMaxMs;
-                    if (state.currentHeadPosMs < 0) state.currentHeadPosMs = 0;
-
-                    state.headDir = "STOPPED"; state.headStartTime = 0; 
-                } else headDone = false; 
-            }
+            completePresetAxes(esp_timer_get_time());
+            if (state.isPresetActive) armPresetTimer(esp_timer_get_time());
+        }
+        stepScript(now);
+        publishSnapshot(now);
+        xSemaphoreGive(mutex);
+        wakeTask();
+    }
+}
 
-            if (state.footDir != "STOPPED") {
-                int32_t elapsed = (int32_t)(now - state.footStartTime);
-                if (elapsed >= state.footTargetDuration) {
-                    applyFootPWM(0, true);
-                    setFootRelay(true, false);
-                    state.footDuty = state.footDutyTarget = 0;
-                    
-                    if (state.footDir == "UP") state.currentFootPosMs += state.footTargetDuration;
-                    else state.currentFootPosMs -= state.footTargetDuration;
-
-                    if (state.currentFootPosMs > state.footMaxMs) state.currentFootPosMs = state.footMaxMs;
-                    if (state.currentFootPosMs < 0) state.currentFootPosMs = 0;
-
-                    state.footDir = "STOPPED"; state.footStartTime = 0;
-                } else footDone = false; 
-            }
+void BedControl::armPresetTimer(int64_t nowUs) {
+    if (!presetTimer) return;
+    // A leg is due at its deadline, then (DRV8871) once more when its soft
+    // stop has run out.
+    auto legDue = [nowUs](int64_t startUs, int32_t dur) {
+        const int64_t endUs = startUs + (int64_t)dur * 1000;
+        return nowUs < endUs ? endUs : endUs + (int64_t)softStopMs(dur) * 1000;
+    };
+    int64_t due = -1;
+    if (state.headDir != MotionDir::STOPPED) due = legDue(state.headStartUs, state.headTargetDuration);
+    if (state.footDir != MotionDir::STOPPED) {
+        int64_t footDue = legDue(state.footStartUs, state.footTargetDuration);
+        if (due < 0 || footDue < due) due = footDue;
+    }
+    if (state.pendingStartUs > 0 &&
+        (state.headPendingDir != MotionDir::STOPPED || state.footPendingDir != MotionDir::STOPPED)) {
+        if (due < 0 || state.pendingStartUs < due) due = state.pendingStartUs;
+    }
+    const int64_t waitUntilUs = state.scriptWaitUntilMs * 1000;
+    if (state.scriptActive && !state.isPresetActive && waitUntilUs > nowUs) {
+        if (due < 0 || waitUntilUs < due) due = waitUntilUs;
+    }
+    if (due < 0) return;
+    esp_timer_stop(presetTimer);
+    esp_timer_start_once(presetTimer, (uint64_t)std::max<int64_t>(0, due - nowUs));
+}
+
+void BedControl::completePresetAxes(int64_t nowUs) {
+    startPendingLeg(nowUs);
+
+    if (state.headDir != MotionDir::STOPPED) {
+        const int64_t elapsed = nowUs - state.headStartUs;
+        if (elapsed >= (int64_t)(state.headTargetDuration + softStopMs(state.headTargetDuration)) * 1000) {
+#if BED_MOTOR_DRIVER_DRV8871
+            driveAxis(true, 0, nowUs);
+#endif
+            const int64_t runUs = driveUsAt(true, nowUs);
+            state.headDriveDutyUs = 0;
+            state.headDriveFromUs = -1;
+            setHeadRelay(true, false);
+            state.headDutyTarget = 0;
+            const int64_t fromUs = state.headPosUs;
+            const int64_t travel = travelForRelayUs(state.headModel, state.headDir, runUs, true);
+            const int64_t overrun = applyTravel(state.headPosUs, state.headDir, travel, state.headMaxMs);
+            state.headEndStop = settleRun(state.headDir, travel, overrun, false, state.headUncertMs, state.headMaxMs);
+            recordMove(true, state.headDir, MoveSource::PRESET, state.headStartUs, nowUs, fromUs,
+                       state.headEndStop != MotionDir::STOPPED ? MOVE_FLAG_END_STOP : 0);
+
+            state.headDir = MotionDir::STOPPED; state.headStartUs = 0; 
+            state.axisStoppedUs = nowUs;
+        }
+    }
 
-            if (headDone && footDone) {
-                ESP_LOGI(TAG, "Preset movement complete; stopping hardware (head=%dms foot=%dms)", (int)state.currentHeadPosMs, (int)state.currentFootPosMs);
-                syncState(); 
-                ESP_LOGI(TAG, "Preset overrun stopped; state synced.");
+    if (state.footDir != MotionDir::STOPPED) {
+        const int64_t elapsed = nowUs - state.footStartUs;
+        if (elapsed >= (int64_t)(state.footTargetDuration + softStopMs(state.footTargetDuration)) * 1000) {
+#if BED_MOTOR_DRIVER_DRV8871
+            driveAxis(false, 0, nowUs);
+#endif
+            const int64_t runUs = driveUsAt(false, nowUs);
+            state.footDriveDutyUs = 0;
+            state.footDriveFromUs = -1;
+            setFootRelay(true, false);
+            state.footDutyTarget = 0;
+            const int64_t fromUs = state.footPosUs;
+            const int64_t travel = travelForRelayUs(state.footModel, state.footDir, runUs, true);
+            const int64_t overrun = applyTravel(state.footPosUs, state.footDir, travel, state.footMaxMs);
+            state.footEndStop = settleRun(state.footDir, travel, overrun, false, state.footUncertMs, state.footMaxMs);
+            recordMove(false, state.footDir, MoveSource::PRESET, state.footStartUs, nowUs, fromUs,
+                       state.footEndStop != MotionDir::STOPPED ? MOVE_FLAG_END_STOP : 0);
+
+            state.footDir = MotionDir::STOPPED; state.footStartUs = 0;
+            state.axisStoppedUs = nowUs;
+        }
+    }
+
+    // FASTEST_FIRST: the follower starts as soon as the leader's leg ended
+    startPendingLeg(nowUs);
+    serviceRelays();
+    if (state.headDir == MotionDir::STOPPED && state.footDir == MotionDir::STOPPED &&
+        state.headPendingDir == MotionDir::STOPPED && state.footPendingDir == MotionDir::STOPPED) {
+        ESP_LOGI(TAG, "Preset movement complete; stopping hardware (head=%dms foot=%dms)", (int)usToMs(state.headPosUs), (int)usToMs(state.footPosUs));
+        syncState(); 
+        ESP_LOGI(TAG, "Preset overrun stopped; state synced.");
+    }
+}
+
+uint32_t BedControl::update() {
+    uint32_t sleepMs = BED_TICK_FAST_MS;
+    bool flush = false, telemFlush = false, learnedFlush = false;
+    PositionRecord rec = {};
+    LearnedFlush learned;
+    const uint32_t appliedId = runQueuedCommands();
+    if (xSemaphoreTake(mutex, portMAX_DELAY)) {
+        int64_t now = millis();
+        if (appliedId != 0) state.lastCommandId = appliedId;
+        const int64_t nowUs = esp_timer_get_time();
+        if (!relayTimer) serviceRelays();
+        updateOptoInputs(nowUs);
+        updateMotionLed(now);
+
+        MotionDir newRemoteHeadDir = MotionDir::STOPPED;
+        MotionDir newRemoteFootDir = MotionDir::STOPPED;
+        const int o1 = optoDebounce.stable(0), o2 = optoDebounce.stable(1);
+        const int o3 = optoDebounce.stable(2), o4 = optoDebounce.stable(3);
+        if (o1 == 0 && o2 == 1) newRemoteHeadDir = MotionDir::UP;
+        else if (o2 == 0 && o1 == 1) newRemoteHeadDir = MotionDir::DOWN;
+        if (o3 == 0 && o4 == 1) newRemoteFootDir = MotionDir::UP;
+        else if (o4 == 0 && o3 == 1) newRemoteFootDir = MotionDir::DOWN;
+
+        // The remote only drives while its transfer relay is released.
+        const MotionDir pressedHeadDir = newRemoteHeadDir, pressedFootDir = newRemoteFootDir;
+        if (state.headDir != MotionDir::STOPPED ||
+            (newRemoteHeadDir != MotionDir::STOPPED && relays.closed(transferRelay(true, newRemoteHeadDir)))) {
+            newRemoteHeadDir = MotionDir::STOPPED;
+        }
+        if (state.footDir != MotionDir::STOPPED ||
+            (newRemoteFootDir != MotionDir::STOPPED && relays.closed(transferRelay(false, newRemoteFootDir)))) {
+            newRemoteFootDir = MotionDir::STOPPED;
+        }
+        if (state.scriptActive && (newRemoteHeadDir != MotionDir::STOPPED || newRemoteFootDir != MotionDir::STOPPED)) {
+            ESP_LOGI(TAG, "Remote press cancels script %d", (int)state.scriptSlot);
+            state.scriptActive = false;
+        }
+
+        // A remote press is booked like a relay run of the same length, so it
+        // shares the per-direction rates and start/stop latency. It runs from
+        // the opto edge that began it (or the transfer relay releasing, if
+        // later) to the edge that ended it; debounce only delays when that
+        // becomes known. A press cut off by a local move, or by its transfer
+        // relay closing for a leg that starts later, ends now.
+        auto remoteEdgeUs = [&](bool head, MotionDir newDir, int64_t fromUs) {
+            if ((head ? state.headDir : state.footDir) != MotionDir::STOPPED) return nowUs;
+            const MotionDir oldDir = head ? state.remoteHeadDir : state.remoteFootDir;
+            if (newDir == MotionDir::STOPPED && oldDir != MotionDir::STOPPED &&
+                (head ? pressedHeadDir : pressedFootDir) == oldDir) {
+                return std::max(fromUs, nowUs);
+            }
+            const int a = head ? 0 : 2;
+            int64_t us = std::min(nowUs, std::max(optoDebounce.changeUs(a), optoDebounce.changeUs(a + 1)));
+            if (newDir != MotionDir::STOPPED) us = std::max(us, relays.openedAtUs(transferRelay(head, newDir)));
+            return std::max(fromUs, us);
+        };
+        if (newRemoteHeadDir != state.remoteHeadDir) {
+            const int64_t atUs = remoteEdgeUs(true, newRemoteHeadDir, state.remoteHeadFromUs);
+            if (state.remoteHeadDir != MotionDir::STOPPED) {
+                state.remoteHeadRunUs = atUs - state.remoteHeadFromUs;
+                const int64_t fromUs = state.remoteHeadBaseUs;
+                const int64_t overrun = bookRemoteRun(state.headPosUs, state.remoteHeadBaseUs, state.remoteHeadDir,
+                                                      state.remoteHeadRunUs, state.headModel, state.headMaxMs, true);
+                const int64_t travel = travelForRelayUs(state.headModel, state.remoteHeadDir, state.remoteHeadRunUs, true);
+                state.headEndStop = settleRun(state.remoteHeadDir, travel, overrun, true, state.headUncertMs, state.headMaxMs);
+                recordMove(true, state.remoteHeadDir, MoveSource::REMOTE, state.remoteHeadFromUs, atUs, fromUs,
+                           state.headEndStop != MotionDir::STOPPED ? MOVE_FLAG_END_STOP : 0);
+                markPositionDirty(now);
             }
+            state.remoteHeadBaseUs = state.headPosUs;
+            state.remoteHeadFromUs = atUs;
+            state.remoteHeadRunUs = 0;
         }
+        if (newRemoteFootDir != state.remoteFootDir) {
+            const int64_t atUs = remoteEdgeUs(false, newRemoteFootDir, state.remoteFootFromUs);
+            if (state.remoteFootDir != MotionDir::STOPPED) {
+                state.remoteFootRunUs = atUs - state.remoteFootFromUs;
+                const int64_t fromUs = state.remoteFootBaseUs;
+                const int64_t overrun = bookRemoteRun(state.footPosUs, state.remoteFootBaseUs, state.remoteFootDir,
+                                                      state.remoteFootRunUs, state.footModel, state.footMaxMs, true);
+                const int64_t travel = travelForRelayUs(state.footModel, state.remoteFootDir, state.remoteFootRunUs, true);
+                state.footEndStop = settleRun(state.remoteFootDir, travel, overrun, true, state.footUncertMs, state.footMaxMs);
+                recordMove(false, state.remoteFootDir, MoveSource::REMOTE, state.remoteFootFromUs, atUs, fromUs,
+                           state.footEndStop != MotionDir::STOPPED ? MOVE_FLAG_END_STOP : 0);
+                markPositionDirty(now);
+            }
+            state.remoteFootBaseUs = state.footPosUs;
+            state.remoteFootFromUs = atUs;
+            state.remoteFootRunUs = 0;
+        }
+        if (newRemoteHeadDir != MotionDir::STOPPED) {
+            state.remoteHeadRunUs = nowUs - state.remoteHeadFromUs;
+            bookRemoteRun(state.headPosUs, state.remoteHeadBaseUs, newRemoteHeadDir,
+                          state.remoteHeadRunUs, state.headModel, state.headMaxMs, false);
+        }
+        if (newRemoteFootDir != MotionDir::STOPPED) {
+            state.remoteFootRunUs = nowUs - state.remoteFootFromUs;
+            bookRemoteRun(state.footPosUs, state.remoteFootBaseUs, newRemoteFootDir,
+                          state.remoteFootRunUs, state.footModel, state.footMaxMs, false);
+        }
+        state.remoteHeadDir = newRemoteHeadDir;
+        state.remoteFootDir = newRemoteFootDir;
+
+        // S-curve PWM ramp for DRV8871
+#if BED_MOTOR_DRIVER_DRV8871
+        rampAxis(true, nowUs);
+        rampAxis(false, nowUs);
+#endif
+
+        // Normally the preset timer ends each axis on time; this is the fallback.
+        if (state.isPresetActive) completePresetAxes(nowUs);
+        stepScript(now);
+        flush = takePositionFlush(now, rec);
+        telemFlush = telemetry.takeFlush(now, state.headDir == MotionDir::STOPPED && state.footDir == MotionDir::STOPPED &&
+                                              state.remoteHeadDir == MotionDir::STOPPED && state.remoteFootDir == MotionDir::STOPPED);
+        learnedFlush = takeLearnedFlush(learned);
+        sleepMs = nextTickMs(now);
+        publishSnapshot(now);
         xSemaphoreGive(mutex);
     }
+    // Flash write happens outside the mutex so commands never wait on it.
+    if (flush) journal.append(nvsHandle, rec);
+    if (telemFlush) telemetry.flush(nvsHandle);
+    if (learnedFlush) saveLearned(learned);
+    return sleepMs;
+}
+
+void BedControl::computeLivePos(int64_t nowUs, int32_t &headMs, int32_t &footMs) {
+    int64_t head = state.headPosUs, foot = state.footPosUs;
+
+    if (state.headStartUs != 0 && state.headDir != MotionDir::STOPPED) {
+        const int64_t el = driveUsAt(true, nowUs);
+        applyTravel(head, state.headDir, travelForRelayUs(state.headModel, state.headDir, el, false), state.headMaxMs);
+    }
+    if (state.footStartUs != 0 && state.footDir != MotionDir::STOPPED) {
+        const int64_t el = driveUsAt(false, nowUs);
+        applyTravel(foot, state.footDir, travelForRelayUs(state.footModel, state.footDir, el, false), state.footMaxMs);
+    }
+    headMs = usToMs(head);
+    footMs = usToMs(foot);
 }
 
 void BedControl::getLiveStatus(int32_t &head, int32_t &foot) {
     if (xSemaphoreTake(mutex, portMAX_DELAY)) {
-        int64_t now = millis();
-        head = state.currentHeadPosMs; foot = state.currentFootPosMs;
-
-        if (state.headStartTime != 0 && state.headDir != "STOPPED") {
-            int32_t el = (int32_t)(now - state.headStartTime);
-            if (state.headDir == "UP") head += el; else head -= el;
-            
-            if (head > state.headMaxMs) head = state.headMaxMs; 
-            if (head < 0) head = 0;
-        }
-        if (state.footStartTime != 0 && state.footDir != "STOPPED") {
-            int32_t el = (int32_t)(now - state.footStartTime);
-            if (state.footDir == "UP") foot += el; else foot -= el;
-            
-            if (foot > state.footMaxMs) foot = state.footMaxMs; 
-            if (foot < 0) foot = 0;
-        }
+        computeLivePos(esp_timer_get_time(), head, foot);
         xSemaphoreGive(mutex);
     }
 }
+
+// --- SNAPSHOT (seqlock) ---
+
+void BedControl::publishSnapshot(int64_t now) {
+    BedSnapshot next = {};
+    next.statusMs = now;
+    computeLivePos(esp_timer_get_time(), next.headPosMs, next.footPosMs);
+    next.headMaxMs = state.headMaxMs;
+    next.footMaxMs = state.footMaxMs;
+    next.headDir = (state.headDir != MotionDir::STOPPED) ? state.headDir : state.remoteHeadDir;
+    next.footDir = (state.footDir != MotionDir::STOPPED) ? state.footDir : state.remoteFootDir;
+    for (int i = 0; i < 4; ++i) {
+        next.optoStable[i] = (int8_t)optoDebounce.stable(i);
+        next.optoRaw[i] = (int8_t)optoDebounce.raw(i);
+    }
+    next.remoteEventMs = state.remoteEventMs;
+    next.remoteDebounceMs = state.remoteDebounceMs;
+    next.remoteOptoIdx = state.remoteOptoIdx;
+    next.remoteEdgeMs = state.remoteEdgeMs;
+    next.remoteEdgeIdx = state.remoteEdgeIdx;
+    next.remoteEdgeState = state.remoteEdgeState;
+    next.motorCurrentActive = state.motorCurrentActive;
+    next.headEndStop = state.headEndStop;
+    next.footEndStop = state.footEndStop;
+    next.headUncertMs = state.headUncertMs;
+    next.footUncertMs = state.footUncertMs;
+    next.headRehomeDue = state.headUncertMs >= REHOME_THRESHOLD_MS;
+    next.footRehomeDue = state.footUncertMs >= REHOME_THRESHOLD_MS;
+    next.headModel = state.headModel;
+    next.footModel = state.footModel;
+    next.arrival = state.arrival;
+    next.lastCommandId = state.lastCommandId;
+    next.scriptSlot = state.scriptActive ? state.scriptSlot : -1;
+    next.scriptStep = state.scriptPc;
+
+    uint32_t seq = snapshotSeq.load(std::memory_order_relaxed);
+    snapshotSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&snapshot, &next, sizeof(next));
+    snapshotSeq.store(seq + 2, std::memory_order_release);
+}
+
+size_t BedControl::readOptoEvents(uint32_t afterSeq, OptoEvent *out, size_t max) {
+    return optoEvents.read(afterSeq, out, max);
+}
+
+uint32_t BedControl::optoEventSeq() {
+    return optoEvents.lastSeq();
+}
+
+void BedControl::getSnapshot(BedSnapshot &out) {
+    for (int attempt = 0; ; ++attempt) {
+        uint32_t seq = snapshotSeq.load(std::memory_order_acquire);
+        if (seq == 0) {
+            // Nothing published yet (begin() has not run): report idle.
+            out = BedSnapshot{};
+            for (int i = 0; i < 4; ++i) out.optoStable[i] = out.optoRaw[i] = 1;
+            out.remoteOptoIdx = out.remoteEdgeIdx = -1;
+            out.remoteEdgeState = 1;
+            out.motorCurrentActive = -1;
+            out.scriptSlot = -1;
+            return;
+        }
+        if ((seq & 1) == 0) {
+            std::memcpy(&out, &snapshot, sizeof(out));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (snapshotSeq.load(std::memory_order_relaxed) == seq) return;
+        }
+        // Writer is mid-publish; if it got preempted, let it finish.
+        if (attempt >= 3) vTaskDelay(1);
+    }
+}
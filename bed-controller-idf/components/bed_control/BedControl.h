@@ -1,30 +1,57 @@
 #pragma once
+#include <atomic>
 #include <string>
+#include <type_traits>
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 #include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "driver/gpio.h"
+#include "BedCommandQueue.h"
 #include "BedDriver.h"
+#include "BedPins.h"
+#include "MotionTelemetry.h"
+#include "OptoDebouncer.h"
+#include "OptoEventLog.h"
+#include "PositionJournal.h"
+#include "PresetTable.h"
+#include "RelaySequencer.h"
+#include "RemoteGestures.h"
+
+// One opto level change as the GPIO ISR saw it.
+struct OptoEdge {
+    int64_t us;                 // esp_timer time of the interrupt
+    uint8_t idx;                // opto 0-3
+    uint8_t level;
+};
 
 struct BedState {
-    int32_t currentHeadPosMs;
-    int32_t currentFootPosMs;
+    int64_t headPosUs;          // travel position, us (the API reports ms)
+    int64_t footPosUs;
     int32_t headMaxMs;
     int32_t footMaxMs;
-    int64_t headStartTime;
-    int64_t footStartTime;
-    std::string headDir; 
-    std::string footDir; 
+    int64_t headStartUs;        // when the motor relay closed, 0 while stopped
+    int64_t footStartUs;
+    MotionDir headDir;
+    MotionDir footDir;
     int32_t headTargetDuration;
     int32_t footTargetDuration;
     bool isPresetActive;
-    int optoStable[4];
-    int optoCounter[4];
-    int optoLastRaw[4];
-    int64_t remoteLastMs;
-    std::string remoteHeadDir;
-    std::string remoteFootDir;
+    ArrivalPolicy arrival;      // how startPreset() schedules the two legs
+    MotionDir headPendingDir;   // preset leg planned but not started yet (STOPPED = none)
+    MotionDir footPendingDir;
+    int64_t pendingStartUs;     // when the pending leg starts; 0 = once the other leg has ended
+    MotionDir remoteHeadDir;
+    MotionDir remoteFootDir;
+    int64_t remoteHeadBaseUs;   // position when the current remote press began
+    int64_t remoteFootBaseUs;
+    int64_t remoteHeadFromUs;   // opto edge that began the current remote press
+    int64_t remoteFootFromUs;
+    int64_t remoteHeadRunUs;    // length of the current remote press so far
+    int64_t remoteFootRunUs;
     int64_t remoteEventMs;
     int32_t remoteDebounceMs;
     int8_t remoteOptoIdx;
@@ -35,18 +62,57 @@ struct BedState {
     int32_t headDutyTarget;
     int32_t footDuty;
     int32_t footDutyTarget;
+    int64_t headDutySinceUs;    // DRV8871: when headDuty was applied
+    int64_t footDutySinceUs;
+    int64_t headDriveDutyUs;    // DRV8871: duty x us driven so far this run
+    int64_t footDriveDutyUs;
+    int64_t headDriveFromUs;    // DRV8871: when the bridge first drove this run (-1: not yet)
+    int64_t footDriveFromUs;
+    AxisMotionModel headModel;
+    AxisMotionModel footModel;
+    MotionDir headEndStop;      // end the axis is known to rest at (STOPPED = in between)
+    MotionDir footEndStop;
+    int32_t headUncertMs;       // error bound of headPosUs; grows per run, 0 at a proven end
+    int32_t footUncertMs;
+    int8_t motorCurrentActive;  // -1 until the current sensor reports
+    int64_t axisStoppedUs;      // last time a preset leg ended while the other axis ran on
+    int64_t headFullRunUs[2];   // moving time of the last end-to-end run up/down this boot (0 = none)
+    int64_t footFullRunUs[2];
+    bool modelDirty;            // learned motion model newer than NVS
+    bool limitsDirty;           // auto-calibrated limits newer than NVS
+    int32_t headCmdTravelMs;    // travel the running preset leg planned (-1 = open-ended move)
+    int32_t footCmdTravelMs;
+    int32_t headPeakMa;         // ACS712 peak while the axis is driven (-1 = no reading)
+    int32_t footPeakMa;
+    uint32_t lastCommandId;     // newest queued command applied by the motion task
+    MotionScript script;        // copy of the running script
+    bool scriptActive;
+    int8_t scriptSlot;
+    uint8_t scriptPc;           // next step to run
+    bool scriptLegActive;       // a MOVE step is driving; settle its coast before the next step
+    uint8_t scriptLoopLeft[MotionScript::kMaxSteps];   // per LOOP step, 0xFF = not entered
+    int64_t scriptWaitUntilMs;
+    bool posDirty;              // RAM position newer than the journal
+    int64_t posDirtySinceMs;    // first unsaved change
+    int64_t posChangedMs;       // latest unsaved change
 };
+static_assert(std::is_trivially_copyable<BedState>::value, "BedState must stay a POD so it can be snapshotted by copy");
 
 class BedControl : public BedDriver {
 public:
+    // One base on pins; a second BedControl needs its own pins and namespace.
+    explicit BedControl(const BedPins &pins = BedPins::primary()) : pins(pins) {}
+
     void begin() override;
-    void update() override; 
+    uint32_t update() override;
+    void attachTask(TaskHandle_t task) override;
 
     void stop() override;
-    void moveHead(std::string dir) override;
-    void moveFoot(std::string dir) override;
-    void moveAll(std::string dir) override;
+    void moveHead(MotionDir dir) override;
+    void moveFoot(MotionDir dir) override;
+    void moveAll(MotionDir dir) override;
     int32_t setTarget(int32_t head, int32_t foot) override;
+    BedCommandTicket submit(const BedCommand &cmd) override;
 
     void getLiveStatus(int32_t &head, int32_t &foot) override;
     
@@ -57,34 +123,159 @@ public:
     std::string getSavedLabel(const char* key, const char* defaultVal) override;
     void setSavedLabel(const char* key, std::string val) override;
 
+    size_t listPresets(size_t first, PresetEntry *out, size_t max, PresetStoreInfo &info) override;
+    bool getPresetById(uint16_t id, PresetEntry &out) override;
+    uint16_t savePreset(const PresetEntry &preset, int position) override;
+    bool deletePreset(uint16_t id) override;
+
+    bool loadScript(uint8_t slot, MotionScript &out) override;
+    bool saveScript(uint8_t slot, const MotionScript &script) override;
+    void clearScript(uint8_t slot) override;
+
     // Limits
     void getLimits(int32_t &headMaxMs, int32_t &footMaxMs) override;
     void setLimits(int32_t headMaxMs, int32_t footMaxMs) override;
-    void getMotionDirs(std::string &headDir, std::string &footDir) override;
+    void getMotionModel(AxisMotionModel &head, AxisMotionModel &foot) override;
+    void setMotionModel(const AxisMotionModel &head, const AxisMotionModel &foot) override;
+    ArrivalPolicy getArrivalPolicy() override;
+    void setArrivalPolicy(ArrivalPolicy policy) override;
+    void reportMotorCurrent(bool active, int64_t sinceMs) override;
+    void reportMotorCurrentMa(int32_t milliamps) override;
+    size_t readTelemetry(uint32_t afterSeq, MoveRecord *out, size_t max) override;
+    void getMotionDirs(MotionDir &headDir, MotionDir &footDir) override;
     void getOptoStates(int &o1, int &o2, int &o3, int &o4) override;
     void getRemoteEventInfo(int64_t &eventMs, int32_t &debounceMs, int8_t &optoIdx) override;
     void getOptoRawStates(int &o1, int &o2, int &o3, int &o4) override;
     void getRemoteEdgeInfo(int64_t &eventMs, int8_t &optoIdx, int8_t &optoState) override;
+    void getOptoDebounce(int ch, DebounceConfig &cfg, DebounceStats &stats) override;
+    bool setOptoDebounce(int ch, DebounceConfig cfg) override;
+    void resetOptoDebounceStats() override;
+    void getRemoteGestures(GestureMap &out) override;
+    bool setRemoteGestures(const GestureMap &map) override;
+    size_t readOptoEvents(uint32_t afterSeq, OptoEvent *out, size_t max) override;
+    uint32_t optoEventSeq() override;
+    void getSnapshot(BedSnapshot &out) override;
+
+    // Trace replay only: puts a stopped bed at snap's positions, end stops and
+    // uncertainty (the rest of snap is ignored).
+    void restorePosition(const BedSnapshot &snap);
+
+protected:
+    // For a backend that replaces the motor relays (RfBedDriver): called on
+    // every sequenced relay switch, from whichever task switched it, with the
+    // mutex held. Set before begin().
+    void setRelaySink(RelaySequencer::Sink fn, void *ctx) { relays.setSink(fn, ctx); }
 
 private:
+    const BedPins pins;
     BedState state;
     SemaphoreHandle_t mutex;
     nvs_handle_t nvsHandle;
+    TaskHandle_t motionTask = nullptr;     // woken by commands, opto ISR, preset timer
+    esp_timer_handle_t presetTimer = nullptr;
+    esp_timer_handle_t relayTimer = nullptr;
+    esp_timer_handle_t optoTimer = nullptr;    // wakes the task when an opto debounce window closes
+    QueueHandle_t optoQueue = nullptr;         // OptoEdge, filled by optoIsr()
+    struct OptoIsrArg {
+        BedControl *self;
+        uint8_t idx;
+        gpio_num_t pin;
+    };
+    OptoIsrArg optoIsrArgs[4];
+    int64_t relayDueUs = -1;    // when relayTimer fires, -1 if idle
+    bool pwmReady = false;      // DRV8871 channels configured
+    int64_t ledRefreshMs = 0;   // updateMotionLed(): last override sent
+    bool ledOverride = false;
+    int8_t prevHeadLimit = 0;   // logLimitTransitions()
+    int8_t prevFootLimit = 0;
+    bool transferLogged[4] = {};    // setTransferRelays(): last levels logged
+    RelaySequencer relays;      // only touched with the mutex held
+    BedCommandQueue commands;   // producers: any task; consumer: update()
+    PositionJournal journal;    // only touched by begin() and the motion task
+    MotionTelemetry telemetry;  // mutex held, except flush() from the motion task
+    OptoEventLog optoEvents;    // written by updateOptoInputs(), read lock-free
+    OptoDebouncer optoDebounce; // mutex held
+    RemoteGestures gestures;    // mutex held; fed by settleOpto()
+    // Saved presets, served from RAM. presetMutex guards them and serializes
+    // their NVS writes; it may be taken with the mutex held, never the other
+    // way round.
+    PresetTable presets;
+    SemaphoreHandle_t presetMutex = nullptr;
+
+    // Seqlock: odd while publishSnapshot() is writing. Single writer (always
+    // called with the mutex held), any number of lock-free readers.
+    std::atomic<uint32_t> snapshotSeq{0};
+    BedSnapshot snapshot{};
 
     void initGPIO();
     void initPWM();
     void initNVS();
     void initFactoryDefaults();
     void loadLimits();
+    void loadMotionModel();
+    void loadOptoDebounce();
+    void loadGestures();
+    void loadPosition();
+    void markPositionDirty(int64_t now);
+    bool takePositionFlush(int64_t now, PositionRecord &rec);
+    // What the motion task learned under the mutex and writes after releasing it.
+    struct LearnedFlush {
+        bool model;
+        bool limits;
+        AxisMotionModel headModel;
+        AxisMotionModel footModel;
+        int32_t headMaxMs;
+        int32_t footMaxMs;
+    };
+    void saveMotionModel(const AxisMotionModel &head, const AxisMotionModel &foot);
+    bool takeLearnedFlush(LearnedFlush &out);
+    void saveLearned(const LearnedFlush &learned);
     
+    void applyPWM(bool head, uint32_t duty, bool up);
     void setLedColor(uint8_t r, uint8_t g, uint8_t b);
     void updateMotionLed(int64_t now);
     void stopHardware();
     void syncState();
     void setTransferSwitch(bool active);
+    void setTransferRelays(bool headUp, bool headDown, bool footUp, bool footDown);
+    void setHeadRelay(bool up, bool enable);
+    void setFootRelay(bool up, bool enable);
+    void serviceRelays();
+    void onRelayDeadline();
+    static void relayTimerCb(void* arg);
     int64_t millis(); 
     int8_t classifyLimit(int32_t pos, int32_t maxVal);
     void logLimitTransitions();
     void initOptoInputs();
-    void updateOptoInputs();
+    static void optoIsr(void* arg);
+    static void optoTimerCb(void* arg);
+    void acceptOptoEdge(int idx, int level, int64_t us);
+    void settleOpto(int idx, int64_t nowUs);
+    void runGesture(const RemoteGestures::Fired &g);
+    void getPreset(int i, PresetView &out);
+    void updateOptoInputs(int64_t nowUs);
+    void computeLivePos(int64_t nowUs, int32_t &headMs, int32_t &footMs);
+    int64_t dutyUs(bool head, int32_t duty, int64_t fromUs, int64_t toUs) const;
+    int64_t driveUsAt(bool head, int64_t nowUs);
+    void driveAxis(bool head, int32_t duty, int64_t nowUs);
+    void rampAxis(bool head, int64_t nowUs);
+    void completePresetAxes(int64_t nowUs);
+    int32_t startPreset(int32_t tHead, int32_t tFoot);
+    void startPresetLeg(bool head, MotionDir dir, int64_t nowUs);
+    void startPendingLeg(int64_t nowUs);
+    void startScript(uint8_t slot);
+    void beginScript(const MotionScript &script, int8_t slot, int64_t now);
+    void stepScript(int64_t now);
+    void handleCurrentDrop(int64_t dropMs);
+    void stopAtEndStop(bool head, int64_t dropUs, bool calibrate);
+    void learnFullRun(bool head, MotionDir dir, int64_t runUs);
+    void recordMove(bool head, MotionDir dir, MoveSource source, int64_t startUs, int64_t endUs,
+                    int64_t fromPosUs, uint8_t flags);
+    void armPresetTimer(int64_t nowUs);
+    void onPresetDeadline();
+    static void presetTimerCb(void* arg);
+    uint32_t runQueuedCommands();
+    uint32_t nextTickMs(int64_t now);
+    void wakeTask();
+    void publishSnapshot(int64_t now);
 };
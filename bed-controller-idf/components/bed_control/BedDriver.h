@@ -1,5 +1,125 @@
 #pragma once
+#include <stdint.h>
 #include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "MotionScript.h"
+#include "MoveRecord.h"
+#include "OptoDebouncer.h"
+#include "OptoEvent.h"
+#include "PresetTable.h"
+#include "RemoteGestures.h"
+
+// Per-axis motion direction. The sign matches the position delta so callers
+// can integrate with `pos += (int)dir * elapsed`.
+enum class MotionDir : int8_t {
+    DOWN = -1,
+    STOPPED = 0,
+    UP = 1
+};
+
+// Text form used by the RPC/SSE JSON ("UP", "DOWN", "STOPPED").
+inline const char* motionDirName(MotionDir dir) {
+    switch (dir) {
+        case MotionDir::UP: return "UP";
+        case MotionDir::DOWN: return "DOWN";
+        default: return "STOPPED";
+    }
+}
+
+// Per-axis travel model. Positions are in travel-ms (0..*_max_ms, i.e. the
+// nominal full-travel time); the rates convert relay-on time to travel for
+// each direction, and the latencies cover the actuator starting and coasting.
+struct AxisMotionModel {
+    int32_t upRatePermille = 1000;    // travel-ms per 1000 ms of relay-on, moving up
+    int32_t downRatePermille = 1000;  // same, moving down
+    int32_t startLatencyMs = 0;       // relay on -> actuator moving
+    int32_t stopLatencyMs = 0;        // relay off -> actuator stopped
+};
+
+// How a preset schedules its two legs.
+enum class ArrivalPolicy : uint8_t {
+    START_TOGETHER = 0,  // both start at once (the second staggered); the shorter leg ends first
+    ARRIVE_TOGETHER,     // the shorter leg starts late (relays) or runs at reduced duty (DRV8871)
+    FASTEST_FIRST        // one axis at a time, the shorter leg first
+};
+
+// Text form used by the RPC JSON; arrivalPolicyFromName() returns false for
+// anything else.
+inline const char* arrivalPolicyName(ArrivalPolicy p) {
+    switch (p) {
+        case ArrivalPolicy::ARRIVE_TOGETHER: return "ARRIVE_TOGETHER";
+        case ArrivalPolicy::FASTEST_FIRST: return "FASTEST_FIRST";
+        default: return "START_TOGETHER";
+    }
+}
+
+inline bool arrivalPolicyFromName(const char *name, ArrivalPolicy &out) {
+    for (uint8_t i = 0; i <= (uint8_t)ArrivalPolicy::FASTEST_FIRST; ++i) {
+        const ArrivalPolicy p = static_cast<ArrivalPolicy>(i);
+        if (std::string(name) == arrivalPolicyName(p)) { out = p; return true; }
+    }
+    return false;
+}
+
+// Consistent view of everything a status reader needs. Published by the
+// motion task once per tick so readers never take the motion mutex.
+struct BedSnapshot {
+    int64_t statusMs;           // publish time (ms since boot)
+    int32_t headPosMs;          // live position at publish time
+    int32_t footPosMs;
+    int32_t headMaxMs;
+    int32_t footMaxMs;
+    MotionDir headDir;          // local command, falling back to remote motion
+    MotionDir footDir;
+    int8_t optoStable[4];       // debounced (0 = active/low, 1 = idle/high)
+    int8_t optoRaw[4];          // most recent GPIO read
+    int64_t remoteEventMs;
+    int32_t remoteDebounceMs;
+    int8_t remoteOptoIdx;
+    int64_t remoteEdgeMs;
+    int8_t remoteEdgeIdx;
+    int8_t remoteEdgeState;
+    int8_t motorCurrentActive;  // last ACS712 state (-1 = no sensor report yet)
+    MotionDir headEndStop;      // end the axis is known to rest at (STOPPED = in between)
+    MotionDir footEndStop;
+    int32_t headUncertMs;       // error bound of the position estimate (0 = just homed)
+    int32_t footUncertMs;
+    bool headRehomeDue;         // next run to/near an end does a full re-home
+    bool footRehomeDue;
+    AxisMotionModel headModel;  // lets callers predict preset timing without the mutex
+    AxisMotionModel footModel;
+    ArrivalPolicy arrival;      // preset leg scheduling, so callers can predict it too
+    uint32_t lastCommandId;     // newest queued command the motion task has applied
+    int8_t scriptSlot;          // running motion script (-1 = none)
+    uint8_t scriptStep;         // step it is on
+};
+
+// Motion command for the asynchronous queue (see BedDriver::submit()).
+enum class BedCommandType : uint8_t {
+    STOP,
+    MOVE_HEAD,
+    MOVE_FOOT,
+    MOVE_ALL,
+    SET_TARGET,
+    RUN_SCRIPT
+};
+
+struct BedCommand {
+    BedCommandType type = BedCommandType::STOP;
+    MotionDir dir = MotionDir::STOPPED;  // MOVE_*
+    int32_t headMs = 0;                  // SET_TARGET
+    int32_t footMs = 0;
+    uint8_t script = 0;                  // RUN_SCRIPT slot
+    uint32_t id = 0;                     // assigned when queued
+};
+
+// What submit() hands back to the caller straight away.
+struct BedCommandTicket {
+    uint32_t id = 0;            // 0 = queue full, command dropped
+    int32_t durationMs = 0;     // predicted run time (0 for open-ended moves)
+    int64_t etaMs = 0;          // predicted completion, ms since boot
+};
 
 // Abstract interface so different hardware backends (relay, WL101/102, mock)
 // can be swapped without changing higher layers.
@@ -8,13 +128,21 @@ public:
     virtual ~BedDriver() = default;
 
     virtual void begin() = 0;
-    virtual void update() = 0;
+    // Runs one motion tick and returns how long (ms) the motion task may sleep
+    // before the next one. Commands, input edges and deadlines wake the task
+    // registered with attachTask() early via a task notification.
+    virtual uint32_t update() = 0;
+    virtual void attachTask(TaskHandle_t task) = 0;
 
     virtual void stop() = 0;
-    virtual void moveHead(std::string dir) = 0;
-    virtual void moveFoot(std::string dir) = 0;
-    virtual void moveAll(std::string dir) = 0;
+    virtual void moveHead(MotionDir dir) = 0;
+    virtual void moveFoot(MotionDir dir) = 0;
+    virtual void moveAll(MotionDir dir) = 0;
     virtual int32_t setTarget(int32_t head, int32_t foot) = 0;
+    // Queues a motion command for the motion task and returns immediately.
+    // STOP preempts anything still queued; of the other commands only the
+    // newest pending one runs. Safe to call from any task.
+    virtual BedCommandTicket submit(const BedCommand &cmd) = 0;
 
     virtual void getLiveStatus(int32_t &head, int32_t &foot) = 0;
 
@@ -24,12 +152,50 @@ public:
     virtual std::string getSavedLabel(const char* key, const char* defaultVal) = 0;
     virtual void setSavedLabel(const char* key, std::string val) = 0;
 
+    // --- Named presets (display order; ids 1..BED_SAVED_PRESETS are the slots
+    // the keys above name) ---
+    // Copies up to max presets from position first on, and the store's size
+    // and revision.
+    virtual size_t listPresets(size_t first, PresetEntry *out, size_t max, PresetStoreInfo &info) = 0;
+    virtual bool getPresetById(uint16_t id, PresetEntry &out) = 0;
+    // Creates (id 0) or updates a preset and moves it to position (< 0 keeps
+    // its place). Returns its id, 0 if the store is full or the id unknown.
+    virtual uint16_t savePreset(const PresetEntry &preset, int position) = 0;
+    // False for an unknown id or a built-in slot.
+    virtual bool deletePreset(uint16_t id) = 0;
+
+    // --- Motion scripts (slots 0..BED_SCRIPT_SLOTS-1, persisted in NVS) ---
+    virtual bool loadScript(uint8_t slot, MotionScript &out) = 0;
+    virtual bool saveScript(uint8_t slot, const MotionScript &script) = 0;
+    virtual void clearScript(uint8_t slot) = 0;
+
     // --- Limits ---
     virtual void getLimits(int32_t &headMaxMs, int32_t &footMaxMs) = 0;
     virtual void setLimits(int32_t headMaxMs, int32_t footMaxMs) = 0;
 
-    // Motion direction (e.g., "UP", "DOWN", "STOPPED")
-    virtual void getMotionDirs(std::string &headDir, std::string &footDir) = 0;
+    // --- Motion model (persisted in NVS; learned from current-sensed
+    // end-to-end runs, see docs/bed-motion-model.md) ---
+    virtual void getMotionModel(AxisMotionModel &head, AxisMotionModel &foot) = 0;
+    virtual void setMotionModel(const AxisMotionModel &head, const AxisMotionModel &foot) = 0;
+
+    // --- Preset leg scheduling (persisted in NVS; applies from the next preset) ---
+    virtual ArrivalPolicy getArrivalPolicy() = 0;
+    virtual void setArrivalPolicy(ArrivalPolicy policy) = 0;
+
+    // Motor current sensor (ACS712) state change. sinceMs is when the change
+    // actually started (first sample past the threshold), not when it was
+    // confirmed. A drop to idle while a relay is on is treated as an end stop.
+    virtual void reportMotorCurrent(bool active, int64_t sinceMs) = 0;
+    // Every ACS712 sample in mA above the idle baseline; the peak while an
+    // axis is driven goes into its move record.
+    virtual void reportMotorCurrentMa(int32_t milliamps) = 0;
+
+    // --- Move telemetry (RAM ring of finished moves, persisted lazily) ---
+    // Copies up to max records with seq > afterSeq, oldest first.
+    virtual size_t readTelemetry(uint32_t afterSeq, MoveRecord *out, size_t max) = 0;
+
+    // Motion direction (local command, falling back to remote-driven motion)
+    virtual void getMotionDirs(MotionDir &headDir, MotionDir &footDir) = 0;
 
     // Opto input states (raw, 0 = active/low, 1 = idle/high)
     virtual void getOptoStates(int &o1, int &o2, int &o3, int &o4) = 0;
@@ -40,4 +206,27 @@ public:
     // Raw opto states (most recent GPIO read) and raw edge event info.
     virtual void getOptoRawStates(int &o1, int &o2, int &o3, int &o4) = 0;
     virtual void getRemoteEdgeInfo(int64_t &eventMs, int8_t &optoIdx, int8_t &optoState) = 0;
+
+    // Remote opto debounce per channel (0..3) and its bounce statistics.
+    // setOptoDebounce() persists the config; false if it is out of range.
+    virtual void getOptoDebounce(int ch, DebounceConfig &cfg, DebounceStats &stats) = 0;
+    virtual bool setOptoDebounce(int ch, DebounceConfig cfg) = 0;
+    virtual void resetOptoDebounceStats() = 0;
+
+    // Remote-button gestures (double/triple tap, hold) and what they run,
+    // recognized by the motion task (persisted in NVS). setRemoteGestures()
+    // replaces the whole table; false if it is invalid or not saved.
+    virtual void getRemoteGestures(GestureMap &out) = 0;
+    virtual bool setRemoteGestures(const GestureMap &map) = 0;
+
+    // Opto edge/stable history, lock-free. Copies up to max events with
+    // seq > afterSeq, oldest first; a reader that keeps the last seq it got
+    // sees every event once (a seq gap means it fell more than
+    // OPTO_EVENT_LOG_LEN behind). optoEventSeq() is the newest seq, for
+    // readers that only want what comes next.
+    virtual size_t readOptoEvents(uint32_t afterSeq, OptoEvent *out, size_t max) = 0;
+    virtual uint32_t optoEventSeq() = 0;
+
+    // Lock-free copy of the latest published state (preferred for status/SSE).
+    virtual void getSnapshot(BedSnapshot &out) = 0;
 };
@@ -0,0 +1,65 @@
+#pragma once
+#include "BedConfig.h"
+#include "driver/ledc.h"
+
+// Hardware of one bed base (one BedControl): its GPIOs, the LEDC channels of
+// its DRV8871 inputs and the NVS namespace its presets, limits, journal and
+// telemetry live in. -1 = not wired.
+struct BedPins {
+    int motor[4];           // HU, HD, FU, FD: relay coils or DRV8871 inputs
+    int transfer[4];        // same order; single-transfer builds use [0] only
+    int opto[4];            // wired-remote optos (opto n = REMOTE_BTN_* bit n)
+    int motorLedc[4];       // DRV8871: LEDC channel of each motor pin
+    const char *nvsNamespace;
+    bool statusLed;         // drives the shared RGB status LED (one base only)
+
+    // The base on the BedConfig.h pin map; keeps the original "storage" namespace.
+    static BedPins primary() {
+        BedPins p = {
+            { HEAD_UP_PIN, HEAD_DOWN_PIN, FOOT_UP_PIN, FOOT_DOWN_PIN },
+#if BED_TRANSFER_MODE_MULTI
+            { TRANSFER_HEAD_UP_PIN, TRANSFER_HEAD_DOWN_PIN, TRANSFER_FOOT_UP_PIN, TRANSFER_FOOT_DOWN_PIN },
+#else
+            { TRANSFER_PIN, -1, -1, -1 },
+#endif
+            { OPTO_IN_1, OPTO_IN_2, OPTO_IN_3, OPTO_IN_4 },
+            { LEDC_CHANNEL_3, LEDC_CHANNEL_4, LEDC_CHANNEL_5, LEDC_CHANNEL_6 },
+            "storage",
+            true,
+        };
+        return p;
+    }
+
+    // A base driven over RF (RfBedDriver): no relay, transfer or opto GPIOs.
+    // It is bed 0, so it keeps "storage" and the status LED.
+    static BedPins rf() {
+        BedPins p = {
+            { -1, -1, -1, -1 },
+            { -1, -1, -1, -1 },
+            { -1, -1, -1, -1 },
+            { -1, -1, -1, -1 },
+            "storage",
+            true,
+        };
+        return p;
+    }
+
+#ifdef BED2_HEAD_UP_PIN
+    // The split-king second base (BED2_* pins, relay builds only).
+    static BedPins secondary() {
+        BedPins p = {
+            { BED2_HEAD_UP_PIN, BED2_HEAD_DOWN_PIN, BED2_FOOT_UP_PIN, BED2_FOOT_DOWN_PIN },
+#if BED_TRANSFER_MODE_MULTI
+            { BED2_TRANSFER_HEAD_UP_PIN, BED2_TRANSFER_HEAD_DOWN_PIN, BED2_TRANSFER_FOOT_UP_PIN, BED2_TRANSFER_FOOT_DOWN_PIN },
+#else
+            { BED2_TRANSFER_PIN, -1, -1, -1 },
+#endif
+            { BED2_OPTO_IN_1, BED2_OPTO_IN_2, BED2_OPTO_IN_3, BED2_OPTO_IN_4 },
+            { -1, -1, -1, -1 },
+            "bed2",
+            false,
+        };
+        return p;
+    }
+#endif
+};
@@ -1,5 +1,10 @@
 #include "BedService.h"
+#include "BedConfig.h"
+#include "TraceBedDriver.h"
 #include "esp_log.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 
 static const char* TAG = "BedService";
 
@@ -9,25 +14,351 @@ BedService& BedService::instance() {
 }
 
 void BedService::begin(BedDriver* drv) {
-    driver = drv;
-    if (!driver) {
+    if (!drv) {
         ESP_LOGE(TAG, "No driver bound");
         return;
     }
-    driver->begin();
+    if (!presetLock) presetLock = xSemaphoreCreateMutex();
+    if (!tickLock) tickLock = xSemaphoreCreateMutex();
+    drivers[0] = drv;
+    count = 1;
+    linkedBeds.store(false, std::memory_order_relaxed);
+    drv->begin();
+    loadPresets(0);
 }
 
-void BedService::stop() { if (driver) driver->stop(); }
-void BedService::moveHead(const std::string& dir) { if (driver) driver->moveHead(dir); }
-void BedService::moveFoot(const std::string& dir) { if (driver) driver->moveFoot(dir); }
-void BedService::moveAll(const std::string& dir) { if (driver) driver->moveAll(dir); }
-int32_t BedService::setTarget(int32_t headMs, int32_t footMs) { return driver ? driver->setTarget(headMs, footMs) : 0; }
+int BedService::addBed(BedDriver* drv) {
+    if (!drv || count == 0 || count >= BED_SERVICE_MAX_BEDS) {
+        ESP_LOGE(TAG, "Cannot add bed %d", count);
+        return -1;
+    }
+    const int bed = count;
+    drivers[bed] = drv;
+    drv->begin();
+    count = bed + 1;
+    loadPresets(bed);
+    linkedBeds.store(drivers[0]->getSavedPos("bed_linked", 0) != 0, std::memory_order_relaxed);
+    ESP_LOGI(TAG, "Bed %d ready (%d beds, %s)", bed, count, linked() ? "linked" : "independent");
+    return bed;
+}
+
+bool BedService::setLinked(bool on) {
+    if (count < 2) return false;
+    drivers[0]->setSavedPos("bed_linked", on ? 1 : 0);
+    linkedBeds.store(on, std::memory_order_relaxed);
+    ESP_LOGI(TAG, "Beds %s", on ? "linked" : "independent");
+    return true;
+}
 
-void BedService::getLiveStatus(int32_t &headMs, int32_t &footMs) { if (driver) driver->getLiveStatus(headMs, footMs); }
-void BedService::getLimits(int32_t &headMaxMs, int32_t &footMaxMs) { if (driver) driver->getLimits(headMaxMs, footMaxMs); }
-void BedService::setLimits(int32_t headMaxMs, int32_t footMaxMs) { if (driver) driver->setLimits(headMaxMs, footMaxMs); }
+// Runs fn on bed's driver, or on every driver while linked. The tick lock
+// keeps the motion task from running a pass in between.
+template <typename Fn>
+void BedService::fanOut(int bed, Fn &&fn) {
+    if (!validBed(bed)) return;
+    if (count < 2 || !linked()) {
+        fn(bed, drivers[bed]);
+        return;
+    }
+    if (xSemaphoreTake(tickLock, portMAX_DELAY)) {
+        for (int i = 0; i < count; ++i) fn(i, drivers[i]);
+        xSemaphoreGive(tickLock);
+    }
+}
+
+void BedService::attachTask(TaskHandle_t task) {
+    for (int i = 0; i < count; ++i) drivers[i]->attachTask(task);
+}
+
+uint32_t BedService::update() {
+    if (count == 0) return BED_TICK_IDLE_MS;
+    if (count == 1) return drivers[0]->update();
+    uint32_t sleepMs = BED_TICK_IDLE_MS;
+    if (xSemaphoreTake(tickLock, portMAX_DELAY)) {
+        for (int i = 0; i < count; ++i) sleepMs = std::min(sleepMs, drivers[i]->update());
+        xSemaphoreGive(tickLock);
+    }
+    return sleepMs;
+}
 
-int32_t BedService::getSavedPos(const char* key, int32_t def) { return driver ? driver->getSavedPos(key, def) : def; }
-void BedService::setSavedPos(const char* key, int32_t val) { if (driver) driver->setSavedPos(key, val); }
-std::string BedService::getSavedLabel(const char* key, const char* def) { return driver ? driver->getSavedLabel(key, def) : std::string(def); }
-void BedService::setSavedLabel(const char* key, const std::string& val) { if (driver) driver->setSavedLabel(key, val); }
+void BedService::stop(int bed) { fanOut(bed, [](int, BedDriver *d) { d->stop(); }); }
+void BedService::moveHead(MotionDir dir, int bed) { fanOut(bed, [dir](int, BedDriver *d) { d->moveHead(dir); }); }
+void BedService::moveFoot(MotionDir dir, int bed) { fanOut(bed, [dir](int, BedDriver *d) { d->moveFoot(dir); }); }
+void BedService::moveAll(MotionDir dir, int bed) { fanOut(bed, [dir](int, BedDriver *d) { d->moveAll(dir); }); }
+
+int32_t BedService::setTarget(int32_t headMs, int32_t footMs, int bed) {
+    int32_t ms = 0;
+    fanOut(bed, [&](int, BedDriver *d) { ms = std::max(ms, d->setTarget(headMs, footMs)); });
+    return ms;
+}
+
+BedCommandTicket BedService::submit(const BedCommand &cmd, int bed) {
+    BedCommandTicket ticket;
+    fanOut(bed, [&](int i, BedDriver *d) {
+        const BedCommandTicket t = d->submit(cmd);
+        if (i == bed) ticket = t;
+    });
+    return ticket;
+}
+
+void BedService::getLiveStatus(int32_t &headMs, int32_t &footMs, int bed) {
+    if (BedDriver *d = driverFor(bed)) d->getLiveStatus(headMs, footMs);
+}
+void BedService::getMotionDirs(MotionDir &headDir, MotionDir &footDir, int bed) {
+    if (BedDriver *d = driverFor(bed)) { d->getMotionDirs(headDir, footDir); return; }
+    headDir = footDir = MotionDir::STOPPED;
+}
+void BedService::getSnapshot(BedSnapshot &out, int bed) {
+    if (BedDriver *d = driverFor(bed)) { d->getSnapshot(out); return; }
+    out = BedSnapshot{};
+    for (int i = 0; i < 4; ++i) out.optoStable[i] = out.optoRaw[i] = 1;
+    out.remoteOptoIdx = out.remoteEdgeIdx = -1;
+    out.remoteEdgeState = 1;
+    out.motorCurrentActive = -1;
+    out.scriptSlot = -1;
+}
+
+void BedService::getStatusView(StatusView &out, int bed) {
+    getSnapshot(out.snap, bed);
+    out.presets = PresetStoreInfo{};
+    if (validBed(bed)) readPresetCache(bed, -1, nullptr, &out.presets);
+}
+
+// Copies slot i (if >= 0) and/or the store info of bed's cache under the
+// seqlock.
+void BedService::readPresetCache(int bed, int i, PresetView *view, PresetStoreInfo *info) {
+    for (int attempt = 0; ; ++attempt) {
+        const uint32_t seq = presetSeq.load(std::memory_order_acquire);
+        if ((seq & 1) == 0) {
+            if (view) std::memcpy(view, &presets[bed][i], sizeof(*view));
+            if (info) std::memcpy(info, &presetInfo[bed], sizeof(*info));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (presetSeq.load(std::memory_order_relaxed) == seq) return;
+        }
+        // Writer is mid-update; if it got preempted, let it finish.
+        if (attempt >= 3) vTaskDelay(1);
+    }
+}
+
+bool BedService::loadScript(uint8_t slot, MotionScript &out, int bed) {
+    BedDriver *d = driverFor(bed);
+    return d && d->loadScript(slot, out);
+}
+bool BedService::saveScript(uint8_t slot, const MotionScript &script, int bed) {
+    BedDriver *d = driverFor(bed);
+    return d && d->saveScript(slot, script);
+}
+void BedService::clearScript(uint8_t slot, int bed) { if (BedDriver *d = driverFor(bed)) d->clearScript(slot); }
+void BedService::getLimits(int32_t &headMaxMs, int32_t &footMaxMs, int bed) {
+    if (BedDriver *d = driverFor(bed)) d->getLimits(headMaxMs, footMaxMs);
+}
+void BedService::setLimits(int32_t headMaxMs, int32_t footMaxMs, int bed) {
+    if (BedDriver *d = driverFor(bed)) d->setLimits(headMaxMs, footMaxMs);
+}
+
+void BedService::getMotionModel(AxisMotionModel &head, AxisMotionModel &foot, int bed) {
+    if (BedDriver *d = driverFor(bed)) d->getMotionModel(head, foot);
+}
+void BedService::setMotionModel(const AxisMotionModel &head, const AxisMotionModel &foot, int bed) {
+    if (BedDriver *d = driverFor(bed)) d->setMotionModel(head, foot);
+}
+ArrivalPolicy BedService::getArrivalPolicy(int bed) {
+    BedDriver *d = driverFor(bed);
+    return d ? d->getArrivalPolicy() : ArrivalPolicy::START_TOGETHER;
+}
+void BedService::setArrivalPolicy(ArrivalPolicy policy, int bed) { if (BedDriver *d = driverFor(bed)) d->setArrivalPolicy(policy); }
+
+void BedService::reportMotorCurrent(bool active, int64_t sinceMs, int bed) {
+    if (BedDriver *d = driverFor(bed)) d->reportMotorCurrent(active, sinceMs);
+}
+void BedService::reportMotorCurrentMa(int32_t milliamps, int bed) { if (BedDriver *d = driverFor(bed)) d->reportMotorCurrentMa(milliamps); }
+
+size_t BedService::readTelemetry(uint32_t afterSeq, MoveRecord *out, size_t max, int bed) {
+    BedDriver *d = driverFor(bed);
+    return d ? d->readTelemetry(afterSeq, out, max) : 0;
+}
+void BedService::getOptoDebounce(int ch, DebounceConfig &cfg, DebounceStats &stats, int bed) {
+    if (BedDriver *d = driverFor(bed)) d->getOptoDebounce(ch, cfg, stats);
+}
+bool BedService::setOptoDebounce(int ch, DebounceConfig cfg, int bed) {
+    BedDriver *d = driverFor(bed);
+    return d && d->setOptoDebounce(ch, cfg);
+}
+void BedService::resetOptoDebounceStats(int bed) { if (BedDriver *d = driverFor(bed)) d->resetOptoDebounceStats(); }
+size_t BedService::readOptoEvents(uint32_t afterSeq, OptoEvent *out, size_t max, int bed) {
+    BedDriver *d = driverFor(bed);
+    return d ? d->readOptoEvents(afterSeq, out, max) : 0;
+}
+uint32_t BedService::optoEventSeq(int bed) {
+    BedDriver *d = driverFor(bed);
+    return d ? d->optoEventSeq() : 0;
+}
+void BedService::getRemoteGestures(GestureMap &out, int bed) {
+    if (BedDriver *d = driverFor(bed)) d->getRemoteGestures(out);
+    else out = GestureMap{};
+}
+bool BedService::setRemoteGestures(const GestureMap &map, int bed) {
+    BedDriver *d = driverFor(bed);
+    return d && d->setRemoteGestures(map);
+}
+
+void BedService::attachTrace(TraceBedDriver* trace, int bed) {
+    if (validBed(bed)) traces[bed] = trace;
+}
+
+bool BedService::startTrace(int bed) {
+    TraceBedDriver *t = validBed(bed) ? traces[bed] : nullptr;
+    return t && t->startTrace();
+}
+
+void BedService::stopTrace(int bed) {
+    if (TraceBedDriver *t = validBed(bed) ? traces[bed] : nullptr) t->stopTrace();
+}
+
+bool BedService::getTraceStatus(TraceStatus &out, int bed) {
+    TraceBedDriver *t = validBed(bed) ? traces[bed] : nullptr;
+    if (t) t->getTraceStatus(out);
+    return t != nullptr;
+}
+
+size_t BedService::readTrace(size_t offset, uint8_t *out, size_t max, int bed) {
+    TraceBedDriver *t = validBed(bed) ? traces[bed] : nullptr;
+    return t ? t->readTrace(offset, out, max) : 0;
+}
+
+const char* BedService::presetSlotName(int i) {
+    return PresetTable::slotName(i);
+}
+
+int BedService::presetSlotIndex(const char* name) {
+    return PresetTable::slotIndex(name);
+}
+
+void BedService::getPreset(int i, PresetView &out, int bed) {
+    if (i < 0 || i >= BED_SAVED_PRESETS || !validBed(bed)) {
+        out = PresetView{};
+        return;
+    }
+    readPresetCache(bed, i, &out, nullptr);
+}
+
+bool BedService::setPreset(int i, const PresetView &p, int bed) {
+    if (i < 0 || i >= BED_SAVED_PRESETS) return false;
+    PresetEntry e{};
+    e.id = (uint16_t)(i + 1);
+    e.headMs = p.headMs;
+    e.footMs = p.footMs;
+    snprintf(e.label, sizeof(e.label), "%s", p.label);
+    return savePreset(e, -1, bed) != 0;
+}
+
+size_t BedService::listPresets(size_t first, PresetEntry *out, size_t max, PresetStoreInfo &info, int bed) {
+    BedDriver *d = driverFor(bed);
+    info = PresetStoreInfo{};
+    return d ? d->listPresets(first, out, max, info) : 0;
+}
+
+bool BedService::getPresetById(uint16_t id, PresetEntry &out, int bed) {
+    BedDriver *d = driverFor(bed);
+    return d && d->getPresetById(id, out);
+}
+
+uint16_t BedService::savePreset(const PresetEntry &preset, int position, int bed) {
+    BedDriver *d = driverFor(bed);
+    if (!d || !presetLock) return 0;
+    uint16_t id = 0;
+    if (xSemaphoreTake(presetLock, portMAX_DELAY)) {
+        id = d->savePreset(preset, position);
+        refreshPreset(bed, PresetTable::builtin(id) ? id - 1 : -1);
+        xSemaphoreGive(presetLock);
+    }
+    return id;
+}
+
+bool BedService::movePreset(uint16_t id, int position, int bed) {
+    BedDriver *d = driverFor(bed);
+    if (!d || !presetLock) return false;
+    bool ok = false;
+    if (xSemaphoreTake(presetLock, portMAX_DELAY)) {
+        PresetEntry p;
+        ok = d->getPresetById(id, p) && d->savePreset(p, position) == id;
+        refreshPreset(bed, -1);
+        xSemaphoreGive(presetLock);
+    }
+    return ok;
+}
+
+bool BedService::deletePreset(uint16_t id, int bed) {
+    BedDriver *d = driverFor(bed);
+    if (!d || !presetLock) return false;
+    bool ok = false;
+    if (xSemaphoreTake(presetLock, portMAX_DELAY)) {
+        ok = d->deletePreset(id);
+        refreshPreset(bed, -1);
+        xSemaphoreGive(presetLock);
+    }
+    return ok;
+}
+
+bool BedService::applyPreset(uint16_t id, BedCommandTicket &ticket, int bed) {
+    PresetEntry p;
+    if (!getPresetById(id, p, bed)) return false;
+    BedCommand cmd;
+    cmd.type = BedCommandType::SET_TARGET;
+    cmd.headMs = p.headMs;
+    cmd.footMs = p.footMs;
+    ticket = submit(cmd, bed);
+    return true;
+}
+
+void BedService::loadPresets(int bed) {
+    if (xSemaphoreTake(presetLock, portMAX_DELAY)) {
+        for (int i = 0; i < BED_SAVED_PRESETS; ++i) refreshPreset(bed, i);
+        xSemaphoreGive(presetLock);
+    }
+}
+
+void BedService::loadPreset(int bed, int i, PresetView &out) {
+    PresetEntry e;
+    if (!getPresetById((uint16_t)(i + 1), e, bed)) {
+        out = PresetTable::factory(i);
+        return;
+    }
+    out.headMs = e.headMs;
+    out.footMs = e.footMs;
+    std::memcpy(out.label, e.label, sizeof(out.label));
+}
+
+// Re-reads slot i (if >= 0) and the store info into the cache (presetLock
+// held).
+void BedService::refreshPreset(int bed, int i) {
+    PresetView next;
+    if (i >= 0) loadPreset(bed, i, next);
+    PresetStoreInfo info;
+    listPresets(0, nullptr, 0, info, bed);
+
+    const uint32_t seq = presetSeq.load(std::memory_order_relaxed);
+    presetSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    if (i >= 0) std::memcpy(&presets[bed][i], &next, sizeof(next));
+    presetInfo[bed] = info;
+    presetSeq.store(seq + 2, std::memory_order_release);
+}
+
+int32_t BedService::getSavedPos(const char* key, int32_t def, int bed) {
+    BedDriver *d = driverFor(bed);
+    return d ? d->getSavedPos(key, def) : def;
+}
+std::string BedService::getSavedLabel(const char* key, const char* def, int bed) {
+    BedDriver *d = driverFor(bed);
+    return d ? d->getSavedLabel(key, def) : std::string(def);
+}
+
+void BedService::setSavedPos(const char* key, int32_t val, int bed) {
+    BedDriver *d = driverFor(bed);
+    if (d) d->setSavedPos(key, val);
+}
+
+void BedService::setSavedLabel(const char* key, const std::string& val, int bed) {
+    BedDriver *d = driverFor(bed);
+    if (d) d->setSavedLabel(key, val);
+}
@@ -1,32 +1,151 @@
 #pragma once
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "BedDriver.h"
+#include "PresetTable.h"
 #include <string>
 
-// Thin abstraction so Matter/HTTP/UI can share the same control surface.
+#define BED_SERVICE_MAX_BEDS    2       // split king: two bases on one controller
+
+class TraceBedDriver;
+struct TraceStatus;
+
+// Everything /rpc/Bed.Status reports, in one call: the motion snapshot (live
+// positions, directions, limits, optos) and the preset store's size and
+// revision. The presets themselves are paged through listPresets().
+struct StatusView {
+    BedSnapshot snap;
+    PresetStoreInfo presets;
+};
+
+// The one control surface Matter/HTTP/UI and the firmware tasks share; no
+// caller talks to a BedDriver directly. Saved presets are cached here, so
+// status reads never touch a driver.
+//
+// It hosts up to BED_SERVICE_MAX_BEDS bases, each its own driver (pins, NVS
+// namespace, wired remote). Every call takes the bed id (0 = the first base)
+// last; an unknown id acts like an unbound driver. One motion task ticks all
+// of them through update().
 class BedService {
 public:
     static BedService& instance();
 
+    // Binds and starts bed 0, then loads its preset cache.
     void begin(BedDriver* driver);
+    // Binds and starts the next base (after begin(), before the motion task
+    // runs). Returns its id, or -1 if the service is full.
+    int addBed(BedDriver* driver);
+    int bedCount() const { return count; }
+    bool validBed(int bed) const { return bed >= 0 && bed < count; }
+
+    // Linked: stop/move/setTarget/submit addressed to any bed go to every bed.
+    // They are queued under the tick lock, so both bases start on the same
+    // pass of the motion task. Stored in bed 0's NVS; false with one bed.
+    bool setLinked(bool linked);
+    bool linked() const { return linkedBeds.load(std::memory_order_relaxed); }
+
+    // Motion task: every bed wakes the same task, which ticks all of them and
+    // sleeps for the shortest interval any of them asked for.
+    void attachTask(TaskHandle_t task);
+    uint32_t update();
 
     // Movement / presets
-    void stop();
-    void moveHead(const std::string& dir);
-    void moveFoot(const std::string& dir);
-    void moveAll(const std::string& dir);
-    int32_t setTarget(int32_t headMs, int32_t footMs);
+    void stop(int bed = 0);
+    void moveHead(MotionDir dir, int bed = 0);
+    void moveFoot(MotionDir dir, int bed = 0);
+    void moveAll(MotionDir dir, int bed = 0);
+    int32_t setTarget(int32_t headMs, int32_t footMs, int bed = 0);
+    BedCommandTicket submit(const BedCommand &cmd, int bed = 0);   // async; linked: bed's own ticket
 
     // State
-    void getLiveStatus(int32_t &headMs, int32_t &footMs);
-    void getLimits(int32_t &headMaxMs, int32_t &footMaxMs);
-    void setLimits(int32_t headMaxMs, int32_t footMaxMs);
+    void getLiveStatus(int32_t &headMs, int32_t &footMs, int bed = 0);
+    void getMotionDirs(MotionDir &headDir, MotionDir &footDir, int bed = 0);
+    void getSnapshot(BedSnapshot &out, int bed = 0);
+    // Snapshot plus cached preset store info; lock-free, no NVS.
+    void getStatusView(StatusView &out, int bed = 0);
+    void getLimits(int32_t &headMaxMs, int32_t &footMaxMs, int bed = 0);
+    void setLimits(int32_t headMaxMs, int32_t footMaxMs, int bed = 0);
+
+    // Motion model and preset scheduling
+    void getMotionModel(AxisMotionModel &head, AxisMotionModel &foot, int bed = 0);
+    void setMotionModel(const AxisMotionModel &head, const AxisMotionModel &foot, int bed = 0);
+    ArrivalPolicy getArrivalPolicy(int bed = 0);
+    void setArrivalPolicy(ArrivalPolicy policy, int bed = 0);
+
+    // Sensors
+    void reportMotorCurrent(bool active, int64_t sinceMs, int bed = 0);
+    void reportMotorCurrentMa(int32_t milliamps, int bed = 0);
 
-    int32_t getSavedPos(const char* key, int32_t def);
-    void setSavedPos(const char* key, int32_t val);
-    std::string getSavedLabel(const char* key, const char* def);
-    void setSavedLabel(const char* key, const std::string& val);
+    // Telemetry and remote optos
+    size_t readTelemetry(uint32_t afterSeq, MoveRecord *out, size_t max, int bed = 0);
+    void getOptoDebounce(int ch, DebounceConfig &cfg, DebounceStats &stats, int bed = 0);
+    bool setOptoDebounce(int ch, DebounceConfig cfg, int bed = 0);
+    void resetOptoDebounceStats(int bed = 0);
+    size_t readOptoEvents(uint32_t afterSeq, OptoEvent *out, size_t max, int bed = 0);
+    uint32_t optoEventSeq(int bed = 0);
+    void getRemoteGestures(GestureMap &out, int bed = 0);
+    bool setRemoteGestures(const GestureMap &map, int bed = 0);
+
+    // Call trace (docs/bed-trace.md): bed's bound driver is trace, a
+    // TraceBedDriver wrapping the real one. Without one the calls fail.
+    void attachTrace(TraceBedDriver* trace, int bed = 0);
+    bool startTrace(int bed = 0);
+    void stopTrace(int bed = 0);
+    bool getTraceStatus(TraceStatus &out, int bed = 0);
+    // Copies trace bytes from offset; 0 at the end.
+    size_t readTrace(size_t offset, uint8_t *out, size_t max, int bed = 0);
+
+    bool loadScript(uint8_t slot, MotionScript &out, int bed = 0);
+    bool saveScript(uint8_t slot, const MotionScript &script, int bed = 0);
+    void clearScript(uint8_t slot, int bed = 0);
+
+    // Saved presets: slot i is the built-in preset id i + 1 of the driver's
+    // preset store.
+    static const char* presetSlotName(int i);
+    static int presetSlotIndex(const char* name);   // -1 if unknown
+    void getPreset(int i, PresetView &out, int bed = 0);   // from the cache
+    bool setPreset(int i, const PresetView &p, int bed = 0);    // false if not saved
+
+    // Named presets by id, in display order (ids 1..BED_SAVED_PRESETS are the
+    // slots above). Writes refresh the cache.
+    size_t listPresets(size_t first, PresetEntry *out, size_t max, PresetStoreInfo &info, int bed = 0);
+    bool getPresetById(uint16_t id, PresetEntry &out, int bed = 0);
+    uint16_t savePreset(const PresetEntry &preset, int position, int bed = 0);  // 0 = not saved
+    // Moves id to position, keeping its head, foot and label.
+    bool movePreset(uint16_t id, int position, int bed = 0);
+    bool deletePreset(uint16_t id, int bed = 0);
+    // Queues SET_TARGET to bed's preset id (linked: every bed goes there).
+    // False for an unknown id; ticket.id 0 if the queue was full.
+    bool applyPreset(uint16_t id, BedCommandTicket &ticket, int bed = 0);
+
+    // Driver settings by key, read and written straight through to NVS.
+    int32_t getSavedPos(const char* key, int32_t def, int bed = 0);
+    void setSavedPos(const char* key, int32_t val, int bed = 0);
+    std::string getSavedLabel(const char* key, const char* def, int bed = 0);
+    void setSavedLabel(const char* key, const std::string& val, int bed = 0);
 
 private:
     BedService() = default;
-    BedDriver* driver = nullptr;
+    BedDriver* drivers[BED_SERVICE_MAX_BEDS] = {};
+    TraceBedDriver* traces[BED_SERVICE_MAX_BEDS] = {};
+    int count = 0;
+    std::atomic<bool> linkedBeds{false};
+    // Held while update() ticks the beds and while a linked command is fanned
+    // out (only with more than one bed), so no tick sees half of it.
+    SemaphoreHandle_t tickLock = nullptr;
+
+    // Seqlock like BedControl's snapshot: odd while a writer (serialized by
+    // presetLock) updates presets; readers retry instead of blocking.
+    SemaphoreHandle_t presetLock = nullptr;
+    std::atomic<uint32_t> presetSeq{0};
+    PresetView presets[BED_SERVICE_MAX_BEDS][BED_SAVED_PRESETS] = {};
+    PresetStoreInfo presetInfo[BED_SERVICE_MAX_BEDS];
+
+    BedDriver* driverFor(int bed) const { return validBed(bed) ? drivers[bed] : nullptr; }
+    template <typename Fn> void fanOut(int bed, Fn &&fn);
+    void loadPresets(int bed);
+    void loadPreset(int bed, int i, PresetView &out);
+    void readPresetCache(int bed, int i, PresetView *view, PresetStoreInfo *info);
+    void refreshPreset(int bed, int i);     // i < 0: store info only
 };
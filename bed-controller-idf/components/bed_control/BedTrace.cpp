@@ -0,0 +1,243 @@
+#include "BedTrace.h"
+#include <cstring>
+
+static const char kMagic[3] = { 'B', 'T', 'R' };
+
+const char *traceOpName(TraceOp op) {
+    static const char *const kNames[kTraceOpCount] = {
+        "update", "opto_edge", "stop", "moveHead", "moveFoot", "moveAll", "setTarget", "submit",
+        "setSavedPos", "setSavedLabel", "saveScript", "clearScript", "setLimits", "setMotionModel",
+        "setArrivalPolicy", "reportMotorCurrent", "reportMotorCurrentMa",
+        "setOptoDebounce", "resetOptoDebounceStats", "setRemoteGestures", "savePreset", "deletePreset",
+        "end", "stats", "getLiveStatus", "getSavedPos", "getSavedLabel", "listPresets", "getPresetById",
+        "loadScript", "getLimits", "getMotionModel",
+        "getArrivalPolicy", "readTelemetry", "getMotionDirs", "getOptoStates", "getRemoteEventInfo",
+        "getOptoRawStates", "getRemoteEdgeInfo", "getOptoDebounce", "getRemoteGestures",
+        "readOptoEvents", "optoEventSeq", "getSnapshot",
+    };
+    return (size_t)op < kTraceOpCount ? kNames[(size_t)op] : "?";
+}
+
+void TraceHistogram::add(uint32_t v) {
+    int b = 0;
+    while (b < kBuckets - 1 && v >= (1u << b)) ++b;
+    buckets[b]++;
+    calls++;
+    total += v;
+    if (v > max) max = v;
+}
+
+uint32_t TraceHistogram::percentile(double q) const {
+    if (calls == 0) return 0;
+    const uint64_t want = (uint64_t)(q * calls + 0.5);
+    uint64_t seen = 0;
+    for (int b = 0; b < kBuckets; ++b) {
+        seen += buckets[b];
+        if (seen >= want && seen > 0) return b == kBuckets - 1 ? max : (1u << b);
+    }
+    return max;
+}
+
+void TraceWriter::uvar(uint64_t v) {
+    uint8_t tmp[10];
+    size_t n = 0;
+    do {
+        tmp[n] = (uint8_t)(v & 0x7F);
+        v >>= 7;
+        if (v) tmp[n] |= 0x80;
+        ++n;
+    } while (v);
+    bytes(tmp, n);
+}
+
+void TraceWriter::str(const char *s) {
+    const size_t n = s ? strnlen(s, 64) : 0;
+    uvar(n);
+    bytes(s, n);
+}
+
+void TraceWriter::bytes(const void *p, size_t n) {
+    if (overflow || n > cap - len) {
+        overflow = true;
+        return;
+    }
+    if (n) std::memcpy(buf + len, p, n);
+    len += n;
+}
+
+uint8_t TraceReader::u8() {
+    uint8_t v = 0;
+    bytes(&v, 1);
+    return v;
+}
+
+uint64_t TraceReader::uvar() {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const uint8_t b = u8();
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return v;
+    }
+    underflow = true;
+    return 0;
+}
+
+size_t TraceReader::str(char *out, size_t max) {
+    const size_t n = (size_t)uvar();
+    const size_t keep = n < max ? n : max - 1;
+    if (!bytes(out, keep) || n - keep > len - pos) {
+        underflow = true;
+        pos = len;
+        out[0] = '\0';
+        return 0;
+    }
+    pos += n - keep;
+    out[keep] = '\0';
+    return keep;
+}
+
+bool TraceReader::bytes(void *out, size_t n) {
+    if (underflow || n > len - pos) {
+        underflow = true;
+        pos = len;
+        std::memset(out, 0, n);
+        return false;
+    }
+    std::memcpy(out, buf + pos, n);
+    pos += n;
+    return true;
+}
+
+static void encodeModel(TraceWriter &w, const AxisMotionModel &m) {
+    w.svar(m.upRatePermille);
+    w.svar(m.downRatePermille);
+    w.svar(m.startLatencyMs);
+    w.svar(m.stopLatencyMs);
+}
+
+static void decodeModel(TraceReader &r, AxisMotionModel &m) {
+    m.upRatePermille = (int32_t)r.svar();
+    m.downRatePermille = (int32_t)r.svar();
+    m.startLatencyMs = (int32_t)r.svar();
+    m.stopLatencyMs = (int32_t)r.svar();
+}
+
+void encodeTraceHeader(TraceWriter &w, const TraceHeader &h) {
+    w.bytes(kMagic, sizeof(kMagic));
+    w.u8(TRACE_VERSION);
+    w.uvar((uint64_t)h.startUs);
+    w.svar(h.headPosMs);
+    w.svar(h.footPosMs);
+    w.svar(h.headMaxMs);
+    w.svar(h.footMaxMs);
+    w.svar((int)h.headDir);
+    w.svar((int)h.footDir);
+    w.svar((int)h.headEndStop);
+    w.svar((int)h.footEndStop);
+    w.svar(h.headUncertMs);
+    w.svar(h.footUncertMs);
+    encodeModel(w, h.headModel);
+    encodeModel(w, h.footModel);
+    w.u8((uint8_t)h.arrival);
+    w.uvar(h.presetMask);
+    for (int i = 0; i < BED_SAVED_PRESETS; ++i) {
+        if (h.presetMask & (1u << (2 * i))) w.svar(h.presetHeadMs[i]);
+        if (h.presetMask & (1u << (2 * i + 1))) w.svar(h.presetFootMs[i]);
+    }
+    for (const DebounceConfig &d : h.debounce) {
+        w.u8((uint8_t)d.mode);
+        w.uvar(d.thresholdMs);
+    }
+    const uint8_t bindings = h.gestures.count <= GestureMap::kMaxBindings ? h.gestures.count : 0;
+    w.u8(bindings);
+    w.bytes(h.gestures.bindings, bindings * sizeof(GestureBinding));
+    w.u8(h.scriptMask);
+    for (int s = 0; s < BED_SCRIPT_SLOTS; ++s) {
+        if (!(h.scriptMask & (1u << s))) continue;
+        w.u8(h.scripts[s].stepCount);
+        w.bytes(h.scripts[s].steps, h.scripts[s].stepCount * sizeof(ScriptStep));
+    }
+}
+
+bool decodeTraceHeader(TraceReader &r, TraceHeader &h) {
+    char magic[3];
+    r.bytes(magic, sizeof(magic));
+    if (std::memcmp(magic, kMagic, sizeof(magic)) != 0 || r.u8() != TRACE_VERSION) return false;
+    h = TraceHeader();
+    h.startUs = (int64_t)r.uvar();
+    h.headPosMs = (int32_t)r.svar();
+    h.footPosMs = (int32_t)r.svar();
+    h.headMaxMs = (int32_t)r.svar();
+    h.footMaxMs = (int32_t)r.svar();
+    h.headDir = static_cast<MotionDir>(r.svar());
+    h.footDir = static_cast<MotionDir>(r.svar());
+    h.headEndStop = static_cast<MotionDir>(r.svar());
+    h.footEndStop = static_cast<MotionDir>(r.svar());
+    h.headUncertMs = (int32_t)r.svar();
+    h.footUncertMs = (int32_t)r.svar();
+    decodeModel(r, h.headModel);
+    decodeModel(r, h.footModel);
+    h.arrival = static_cast<ArrivalPolicy>(r.u8());
+    h.presetMask = (uint16_t)r.uvar();
+    for (int i = 0; i < BED_SAVED_PRESETS; ++i) {
+        if (h.presetMask & (1u << (2 * i))) h.presetHeadMs[i] = (int32_t)r.svar();
+        if (h.presetMask & (1u << (2 * i + 1))) h.presetFootMs[i] = (int32_t)r.svar();
+    }
+    for (DebounceConfig &d : h.debounce) {
+        d.mode = static_cast<DebounceMode>(r.u8());
+        d.thresholdMs = (uint16_t)r.uvar();
+    }
+    h.gestures.count = r.u8();
+    if (h.gestures.count > GestureMap::kMaxBindings) return false;
+    r.bytes(h.gestures.bindings, h.gestures.count * sizeof(GestureBinding));
+    h.scriptMask = r.u8();
+    for (int s = 0; s < BED_SCRIPT_SLOTS; ++s) {
+        if (!(h.scriptMask & (1u << s))) continue;
+        h.scripts[s].stepCount = r.u8();
+        if (h.scripts[s].stepCount > MotionScript::kMaxSteps) return false;
+        r.bytes(h.scripts[s].steps, h.scripts[s].stepCount * sizeof(ScriptStep));
+    }
+    return r.ok();
+}
+
+void encodeTraceStats(TraceWriter &w, const TraceHistogram *hist, uint32_t dropped, uint32_t lostOptoEvents) {
+    uint8_t used = 0;
+    for (size_t op = 0; op < kTraceOpCount; ++op) used += hist[op].calls ? 1 : 0;
+    w.u8(used);
+    for (size_t op = 0; op < kTraceOpCount; ++op) {
+        const TraceHistogram &h = hist[op];
+        if (!h.calls) continue;
+        uint16_t mask = 0;
+        for (int b = 0; b < TraceHistogram::kBuckets; ++b) mask |= h.buckets[b] ? (uint16_t)(1u << b) : 0;
+        w.u8((uint8_t)op);
+        w.uvar(h.calls);
+        w.uvar(h.total);
+        w.uvar(h.max);
+        w.uvar(mask);
+        for (int b = 0; b < TraceHistogram::kBuckets; ++b) {
+            if (h.buckets[b]) w.uvar(h.buckets[b]);
+        }
+    }
+    w.uvar(dropped);
+    w.uvar(lostOptoEvents);
+}
+
+bool decodeTraceStats(TraceReader &r, TraceHistogram *hist, uint32_t &dropped, uint32_t &lostOptoEvents) {
+    for (size_t op = 0; op < kTraceOpCount; ++op) hist[op] = TraceHistogram();
+    const uint8_t used = r.u8();
+    for (uint8_t i = 0; i < used; ++i) {
+        const uint8_t op = r.u8();
+        if (op >= kTraceOpCount) return false;
+        TraceHistogram &h = hist[op];
+        h.calls = (uint32_t)r.uvar();
+        h.total = r.uvar();
+        h.max = (uint32_t)r.uvar();
+        const uint16_t mask = (uint16_t)r.uvar();
+        for (int b = 0; b < TraceHistogram::kBuckets; ++b) {
+            if (mask & (1u << b)) h.buckets[b] = (uint32_t)r.uvar();
+        }
+    }
+    dropped = (uint32_t)r.uvar();
+    lostOptoEvents = (uint32_t)r.uvar();
+    return r.ok();
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "BedDriver.h"
+#include "BedService.h"
+
+// Binary trace of a BedDriver session (see TraceBedDriver), shared by the
+// recorder on the device and the replayer on the host:
+//
+//   header:  "BTR" TRACE_VERSION, then TraceHeader (the state to replay from)
+//   records: u8 TraceOp, zigzag dt, varint durUs, op arguments
+//
+// dt is the record's time (call start, or edge time for OPTO_EDGE) minus the
+// previous record's, in us; it can be negative because calls from different
+// tasks finish out of order. Integers are LEB128 varints, signed ones
+// zigzagged first, so a motion-task tick costs about 5 bytes.
+#define TRACE_VERSION 3
+
+// Recorded ops come first and are replayed; the rest are getters, timed into
+// the histograms but not recorded.
+enum class TraceOp : uint8_t {
+    UPDATE = 0,             // varint sleepMs returned
+    OPTO_EDGE,              // u8 opto << 1 | level (dur 0)
+    STOP,
+    MOVE_HEAD,              // zigzag dir
+    MOVE_FOOT,
+    MOVE_ALL,
+    SET_TARGET,             // zigzag head, foot, returned waitMs
+    SUBMIT,                 // u8 type, zigzag dir, head, foot, u8 script, varint ticket id
+    SET_SAVED_POS,          // str key, zigzag val
+    SET_SAVED_LABEL,        // str key, str val
+    SAVE_SCRIPT,            // u8 slot, u8 stepCount, steps (6 bytes each)
+    CLEAR_SCRIPT,           // u8 slot
+    SET_LIMITS,             // zigzag head, foot
+    SET_MOTION_MODEL,       // 2 x 4 zigzag (AxisMotionModel field order)
+    SET_ARRIVAL,            // u8 policy
+    MOTOR_CURRENT,          // u8 active, zigzag sinceMs relative to startUs (ms)
+    MOTOR_CURRENT_MA,       // zigzag mA
+    SET_DEBOUNCE,           // u8 ch, u8 mode, varint thresholdMs
+    RESET_DEBOUNCE_STATS,
+    SET_GESTURES,           // u8 count, bindings (6 bytes each)
+    SAVE_PRESET,            // varint id, zigzag head, foot, str label, zigzag position, varint returned id
+    DELETE_PRESET,          // varint id, u8 ok
+    END,                    // zigzag head, foot: live positions when recording stopped
+    STATS,                  // trailer, see encodeTraceStats()
+    GET_LIVE_STATUS,
+    GET_SAVED_POS,
+    GET_SAVED_LABEL,
+    LIST_PRESETS,
+    GET_PRESET,
+    LOAD_SCRIPT,
+    GET_LIMITS,
+    GET_MOTION_MODEL,
+    GET_ARRIVAL,
+    READ_TELEMETRY,
+    GET_MOTION_DIRS,
+    GET_OPTO_STATES,
+    GET_REMOTE_EVENT_INFO,
+    GET_OPTO_RAW_STATES,
+    GET_REMOTE_EDGE_INFO,
+    GET_OPTO_DEBOUNCE,
+    GET_REMOTE_GESTURES,
+    READ_OPTO_EVENTS,
+    OPTO_EVENT_SEQ,
+    GET_SNAPSHOT,
+};
+constexpr size_t kTraceOpCount = (size_t)TraceOp::GET_SNAPSHOT + 1;
+constexpr TraceOp kTraceFirstRead = TraceOp::GET_LIVE_STATUS;
+
+const char *traceOpName(TraceOp op);
+
+// Call durations per op in log2 buckets: bucket 0 is < 1 unit, bucket b is
+// [2^(b-1), 2^b), the last one open-ended. The recorder counts us, the host
+// replayer ns.
+struct TraceHistogram {
+    static constexpr int kBuckets = 16;
+    uint32_t calls = 0;
+    uint64_t total = 0;
+    uint32_t max = 0;
+    uint32_t buckets[kBuckets] = {};
+
+    void add(uint32_t v);
+    // Upper edge of the bucket holding the q-th fraction of calls (0 if none).
+    uint32_t percentile(double q) const;
+};
+
+// Everything a replay starts from, read from the driver when recording starts.
+struct TraceHeader {
+    int64_t startUs = 0;                // esp_timer time of the first record's reference
+    int32_t headPosMs = 0;
+    int32_t footPosMs = 0;
+    int32_t headMaxMs = 0;
+    int32_t footMaxMs = 0;
+    MotionDir headDir = MotionDir::STOPPED;     // moving when recording started (replays as stopped)
+    MotionDir footDir = MotionDir::STOPPED;
+    MotionDir headEndStop = MotionDir::STOPPED;
+    MotionDir footEndStop = MotionDir::STOPPED;
+    int32_t headUncertMs = 0;
+    int32_t footUncertMs = 0;
+    AxisMotionModel headModel;
+    AxisMotionModel footModel;
+    ArrivalPolicy arrival = ArrivalPolicy::START_TOGETHER;
+    uint16_t presetMask = 0;            // bit 2i: presetHeadMs[i] saved, 2i+1: presetFootMs[i]
+    int32_t presetHeadMs[BED_SAVED_PRESETS] = {};   // BedService::presetSlotName() order
+    int32_t presetFootMs[BED_SAVED_PRESETS] = {};
+    DebounceConfig debounce[4];
+    GestureMap gestures;
+    uint8_t scriptMask = 0;             // bit n: scripts[n] is saved
+    MotionScript scripts[BED_SCRIPT_SLOTS];
+};
+
+// Appends into a caller's buffer; once something does not fit, everything
+// after it is dropped and ok() turns false.
+class TraceWriter {
+public:
+    TraceWriter(uint8_t *buf, size_t cap) : buf(buf), cap(cap) {}
+
+    void u8(uint8_t v) { bytes(&v, 1); }
+    void uvar(uint64_t v);
+    void svar(int64_t v) { uvar(((uint64_t)v << 1) ^ (uint64_t)(v >> 63)); }
+    void str(const char *s);            // varint length + bytes, cut at 64
+    void bytes(const void *p, size_t n);
+
+    size_t size() const { return len; }
+    bool ok() const { return !overflow; }
+
+private:
+    uint8_t *buf;
+    size_t cap;
+    size_t len = 0;
+    bool overflow = false;
+};
+
+// Reads what TraceWriter wrote; reading past the end returns zeros and turns
+// ok() false.
+class TraceReader {
+public:
+    TraceReader(const uint8_t *buf, size_t len) : buf(buf), len(len) {}
+
+    uint8_t u8();
+    uint64_t uvar();
+    int64_t svar() { const uint64_t v = uvar(); return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+    size_t str(char *out, size_t max);  // NUL-terminated, cut to max - 1
+    bool bytes(void *out, size_t n);
+
+    size_t offset() const { return pos; }
+    bool atEnd() const { return pos >= len; }
+    bool ok() const { return !underflow; }
+
+private:
+    const uint8_t *buf;
+    size_t len;
+    size_t pos = 0;
+    bool underflow = false;
+};
+
+void encodeTraceHeader(TraceWriter &w, const TraceHeader &h);
+// False on a bad magic, version or truncated header.
+bool decodeTraceHeader(TraceReader &r, TraceHeader &h);
+
+// STATS record body: u8 op count, then per op with calls: u8 op, varint
+// calls, total, max, bucket mask, one varint per set bucket; then varint
+// dropped records and opto events the recorder missed. At most
+// TRACE_STATS_MAX_BYTES.
+#define TRACE_STATS_MAX_BYTES (kTraceOpCount * (1 + 5 + 10 + 5 + 3 + 5 * TraceHistogram::kBuckets) + 16)
+void encodeTraceStats(TraceWriter &w, const TraceHistogram *hist, uint32_t dropped, uint32_t lostOptoEvents);
+bool decodeTraceStats(TraceReader &r, TraceHistogram *hist, uint32_t &dropped, uint32_t &lostOptoEvents);
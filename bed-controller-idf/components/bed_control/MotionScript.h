@@ -0,0 +1,49 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Multi-step preset run entirely by the motion task, e.g. "foot to 20 s,
+// wait 2 s, head to 10 s, then rock the head 3 times". Stored in NVS as a
+// compact blob (2 + 6 bytes per step).
+enum class ScriptOp : uint8_t {
+    MOVE = 0,   // headMs/footMs targets (SCRIPT_KEEP = leave that axis)
+    WAIT = 1,   // headMs = pause in ms
+    LOOP = 2,   // jump back to step headMs, count more times
+};
+
+#define SCRIPT_KEEP 0xFFFF
+#define BED_SCRIPT_SLOTS 4      // NVS keys "scr_0".."scr_3"
+
+struct ScriptStep {
+    ScriptOp op;
+    uint8_t count;      // LOOP repetitions
+    uint16_t headMs;
+    uint16_t footMs;
+};
+static_assert(sizeof(ScriptStep) == 6, "ScriptStep is stored packed in NVS");
+
+struct MotionScript {
+    static constexpr uint8_t kVersion = 1;
+    static constexpr uint8_t kMaxSteps = 16;
+
+    uint8_t version = kVersion;
+    uint8_t stepCount = 0;
+    ScriptStep steps[kMaxSteps] = {};
+
+    // Bytes actually written to NVS (unused steps are not stored).
+    size_t storedSize() const { return offsetof(MotionScript, steps) + stepCount * sizeof(ScriptStep); }
+
+    // Rejects unknown ops and loops that do not jump strictly backwards.
+    bool valid() const {
+        if (version != kVersion || stepCount == 0 || stepCount > kMaxSteps) return false;
+        for (uint8_t i = 0; i < stepCount; ++i) {
+            const ScriptStep &s = steps[i];
+            if (s.op == ScriptOp::LOOP) {
+                if (s.headMs >= i) return false;
+            } else if (s.op != ScriptOp::MOVE && s.op != ScriptOp::WAIT) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
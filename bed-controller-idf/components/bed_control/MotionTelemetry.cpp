@@ -0,0 +1,78 @@
+#include "MotionTelemetry.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+#include <stddef.h>
+
+static const char *TAG = "MOVE_TELEM";
+static const char *kBlobKey = "mtel";
+static const char *kBootKey = "mtel_boot";
+static const uint8_t kBlobVersion = 1;
+
+static uint32_t recordsCrc(const MoveRecord *records, size_t count) {
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(records), count * sizeof(MoveRecord));
+}
+
+void MotionTelemetry::begin(nvs_handle_t nvs) {
+    int32_t boots = 0;
+    nvs_get_i32(nvs, kBootKey, &boots);
+    boot = (uint16_t)(boots + 1);
+    if (nvs_set_i32(nvs, kBootKey, boot) == ESP_OK) nvs_commit(nvs);
+
+    size_t len = sizeof(pending);
+    if (nvs_get_blob(nvs, kBlobKey, &pending, &len) != ESP_OK) return;
+    const BlobHeader &h = pending.hdr;
+    if (len < sizeof(BlobHeader) || h.version != kBlobVersion || h.recordSize != sizeof(MoveRecord) ||
+        h.count > BED_TELEMETRY_RECORDS || len != offsetof(Blob, records) + h.count * sizeof(MoveRecord) ||
+        h.crc != recordsCrc(pending.records, h.count)) {
+        ESP_LOGW(TAG, "Stored telemetry invalid (%u bytes); starting empty", (unsigned)len);
+        return;
+    }
+    for (size_t i = 0; i < h.count; ++i) ring[i] = pending.records[i];
+    first = 0;
+    count = h.count;
+    lastSeq = count ? ring[count - 1].seq : 0;
+    ESP_LOGI(TAG, "Restored %u moves (last seq %u), boot %u", (unsigned)count, (unsigned)lastSeq, (unsigned)boot);
+}
+
+void MotionTelemetry::append(MoveRecord rec, int64_t nowMs) {
+    rec.seq = ++lastSeq;
+    rec.boot = boot;
+    if (count < BED_TELEMETRY_RECORDS) {
+        ring[(first + count++) % BED_TELEMETRY_RECORDS] = rec;
+    } else {
+        ring[first] = rec;
+        first = (first + 1) % BED_TELEMETRY_RECORDS;
+    }
+    if (unsaved++ == 0) unsavedSinceMs = nowMs;
+}
+
+size_t MotionTelemetry::read(uint32_t afterSeq, MoveRecord *out, size_t max) const {
+    size_t n = 0;
+    for (size_t i = 0; i < count && n < max; ++i) {
+        const MoveRecord &r = ring[(first + i) % BED_TELEMETRY_RECORDS];
+        // Signed difference so the comparison survives seq wrap-around.
+        if ((int32_t)(r.seq - afterSeq) > 0) out[n++] = r;
+    }
+    return n;
+}
+
+bool MotionTelemetry::takeFlush(int64_t nowMs, bool idle) {
+    if (unsaved == 0 || !idle) return false;
+    if (unsaved < TELEMETRY_FLUSH_RECORDS && nowMs - unsavedSinceMs < TELEMETRY_FLUSH_MAX_MS) return false;
+    for (size_t i = 0; i < count; ++i) pending.records[i] = ring[(first + i) % BED_TELEMETRY_RECORDS];
+    pending.hdr.version = kBlobVersion;
+    pending.hdr.recordSize = sizeof(MoveRecord);
+    pending.hdr.count = (uint16_t)count;
+    pending.hdr.crc = recordsCrc(pending.records, count);
+    unsaved = 0;
+    return true;
+}
+
+esp_err_t MotionTelemetry::flush(nvs_handle_t nvs) {
+    const size_t len = offsetof(Blob, records) + pending.hdr.count * sizeof(MoveRecord);
+    esp_err_t err = nvs_set_blob(nvs, kBlobKey, &pending, len);
+    if (err == ESP_OK) err = nvs_commit(nvs);
+    if (err != ESP_OK) ESP_LOGW(TAG, "Write %s failed: %s", kBlobKey, esp_err_to_name(err));
+    return err;
+}
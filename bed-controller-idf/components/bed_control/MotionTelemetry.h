@@ -0,0 +1,53 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "nvs.h"
+#include "BedConfig.h"
+#include "MoveRecord.h"
+
+// Per-move telemetry: a RAM ring of the last BED_TELEMETRY_RECORDS moves,
+// written behind to one NVS blob (CRC-checked) so the history survives a
+// reboot without a flash write per move. Not thread-safe: BedControl calls
+// append()/read()/takeFlush() with its mutex held and flush() from the motion
+// task only, outside the mutex.
+class MotionTelemetry {
+public:
+    // Restores the persisted ring (if its CRC checks out) and counts the boot.
+    void begin(nvs_handle_t nvs);
+    // Stamps seq/boot and appends; the oldest record drops out when full.
+    void append(MoveRecord rec, int64_t nowMs);
+    // Copies up to max records with seq > afterSeq, oldest first.
+    size_t read(uint32_t afterSeq, MoveRecord *out, size_t max) const;
+
+    // Write-behind: true once enough records are unsaved (or the oldest has
+    // waited long enough) and the bed is idle; the ring is then copied for
+    // flush().
+    bool takeFlush(int64_t nowMs, bool idle);
+    esp_err_t flush(nvs_handle_t nvs);
+
+private:
+    MoveRecord ring[BED_TELEMETRY_RECORDS] = {};
+    size_t first = 0;           // oldest record
+    size_t count = 0;
+    uint32_t lastSeq = 0;
+    uint16_t boot = 0;
+    uint32_t unsaved = 0;       // appended since the last takeFlush()
+    int64_t unsavedSinceMs = 0;
+
+    // NVS blob "mtel": this header, then `count` records oldest first. The
+    // CRC covers the records.
+    struct BlobHeader {
+        uint8_t version;
+        uint8_t recordSize;
+        uint16_t count;
+        uint32_t crc;
+    };
+    struct Blob {
+        BlobHeader hdr;
+        MoveRecord records[BED_TELEMETRY_RECORDS];
+    };
+    // Copy taken by takeFlush() (and the load buffer in begin()); only the
+    // motion task touches it.
+    Blob pending = {};
+};
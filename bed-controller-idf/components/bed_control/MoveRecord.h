@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+
+// What started a move.
+enum class MoveSource : uint8_t {
+    APP = 0,    // moveHead/moveFoot/moveAll (held button in the UI)
+    REMOTE,     // wired-remote press seen on the optos
+    PRESET,     // setTarget() leg, including script and re-home legs
+};
+
+inline const char* moveSourceName(MoveSource s) {
+    switch (s) {
+        case MoveSource::REMOTE: return "REMOTE";
+        case MoveSource::PRESET: return "PRESET";
+        default: return "APP";
+    }
+}
+
+// MoveRecord::flags
+#define MOVE_FLAG_END_STOP      0x01    // ended resting on an end stop (current drop or confirmed overrun)
+#define MOVE_FLAG_CALIBRATED    0x02    // the current drop re-measured the axis limit
+#define MOVE_FLAG_INTERRUPTED   0x04    // preset leg cut short by STOP or another command
+
+// One finished move of one axis, as kept in the telemetry ring and exported
+// by /rpc/Bed.Telemetry. Fixed size, naturally aligned, no padding: the
+// binary export is these records back to back (little-endian).
+struct MoveRecord {
+    int64_t startUs;        // motor relay closed / remote press began (esp_timer, us since boot)
+    uint32_t seq;           // 1, 2, ... across reboots
+    uint32_t runUs;         // start to booked end (endUs = startUs + runUs)
+    int32_t commandedMs;    // travel the preset leg planned (-1: open-ended app/remote hold)
+    int32_t travelMs;       // travel dead reckoning booked for the run
+    int32_t endPosMs;       // position estimate afterwards
+    uint16_t boot;          // boot counter: startUs only compares within one boot
+    uint16_t rampMs;        // DRV8871 soft start + soft stop (0 with relays)
+    uint16_t peakMa;        // ACS712 peak while driven, 0xFFFF = no reading
+    uint8_t axis;           // 0 = head, 1 = foot
+    int8_t dir;             // MotionDir
+    uint8_t source;         // MoveSource
+    uint8_t flags;          // MOVE_FLAG_*
+    uint16_t reserved;
+};
+static_assert(sizeof(MoveRecord) == 40, "MoveRecord is exported and stored as raw bytes");
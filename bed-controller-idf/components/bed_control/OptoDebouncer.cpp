@@ -0,0 +1,118 @@
+#include "OptoDebouncer.h"
+#include <algorithm>
+#include "BedConfig.h"
+
+OptoDebouncer::OptoDebouncer() {
+    for (Channel &c : chans) c.cfg.thresholdMs = OPTO_DEBOUNCE_MS;
+}
+
+void OptoDebouncer::reset() {
+    for (Channel &c : chans) {
+        const DebounceConfig cfg = c.cfg;
+        const DebounceStats stats = c.stats;
+        c = Channel{};
+        c.cfg = cfg;
+        c.stats = stats;
+    }
+}
+
+void OptoDebouncer::configure(int ch, DebounceConfig cfg) {
+    chans[ch].cfg = cfg;
+}
+
+void OptoDebouncer::resetStats() {
+    for (Channel &c : chans) c.stats = DebounceStats{};
+}
+
+bool OptoDebouncer::settle(int ch, int64_t nowUs, Change &out) {
+    Channel &c = chans[ch];
+    if (nowUs <= c.doneUs) return false;
+    const int64_t fromUs = c.doneUs;
+    c.doneUs = nowUs;
+    if (c.burstUs < 0) return false;
+    const int64_t thresholdUs = (int64_t)c.cfg.thresholdMs * 1000;
+
+    if (c.cfg.mode == DebounceMode::WINDOW) {
+        const int64_t settledUs = c.edgeUs + thresholdUs;
+        if (nowUs < settledUs) return false;
+        if (c.raw != c.stable) {
+            finishChange(c, settledUs, out);
+            return true;
+        }
+        c.stats.glitches++;
+        c.burstUs = -1;
+        return false;
+    }
+
+    // INTEGRATOR: raw has held its level since the last edge (or since the
+    // last settle()), so the whole span counts one way.
+    const int64_t spanUs = nowUs - fromUs;
+    if (c.raw != c.stable) {
+        if (c.integUs + spanUs < thresholdUs) {
+            c.integUs += spanUs;
+            return false;
+        }
+        finishChange(c, fromUs + (thresholdUs - c.integUs), out);
+        return true;
+    }
+    if (c.integUs > spanUs) {
+        c.integUs -= spanUs;
+        return false;
+    }
+    c.stats.glitches++;
+    c.burstUs = -1;
+    c.integUs = 0;
+    return false;
+}
+
+void OptoDebouncer::finishChange(Channel &c, int64_t atUs, Change &out) {
+    DebounceStats &st = c.stats;
+    const uint16_t bounces = c.edges > 0 ? c.edges - 1 : 0;
+    st.transitions++;
+    st.bounces += bounces;
+    st.maxBounces = std::max(st.maxBounces, bounces);
+    st.maxBounceMs = std::max<uint16_t>(st.maxBounceMs,
+        (uint16_t)std::min<int64_t>(UINT16_MAX, (c.edgeUs - c.burstUs) / 1000));
+    // The level that just ended held from its own first edge to this one's;
+    // the boot level has no start, so it is not counted.
+    if (c.changeUs > 0) {
+        const uint32_t heldMs = (uint32_t)std::min<int64_t>(UINT32_MAX - 1, (c.burstUs - c.changeUs) / 1000);
+        st.minStableMs = std::min(st.minStableMs, heldMs);
+        st.maxStableMs = std::max(st.maxStableMs, heldMs);
+    }
+
+    out.atUs = atUs;
+    out.firstEdgeUs = c.burstUs;
+    out.debounceMs = (int32_t)((atUs - c.burstUs) / 1000);
+    out.level = c.raw;
+    c.stable = c.raw;
+    c.changeUs = c.burstUs;
+    c.burstUs = -1;
+    c.integUs = 0;
+}
+
+bool OptoDebouncer::edge(int ch, int level, int64_t us) {
+    Channel &c = chans[ch];
+    if (level == c.raw) return false;
+    Change change;
+    us = std::max(us, c.doneUs);
+    settle(ch, us, change);     // callers settle first; this only moves doneUs up
+    c.raw = level;
+    c.edgeUs = us;
+    if (c.burstUs < 0) {
+        c.burstUs = us;
+        c.edges = 0;
+        c.integUs = 0;
+    }
+    if (c.edges < UINT16_MAX) c.edges++;
+    return true;
+}
+
+int64_t OptoDebouncer::dueUs(int ch) const {
+    const Channel &c = chans[ch];
+    if (c.burstUs < 0) return INT64_MAX;
+    const int64_t thresholdUs = (int64_t)c.cfg.thresholdMs * 1000;
+    if (c.cfg.mode == DebounceMode::WINDOW) return c.edgeUs + thresholdUs;
+    // INTEGRATOR: when it reaches the threshold, or drains back to a glitch.
+    return c.doneUs + (c.raw != c.stable ? thresholdUs - c.integUs : c.integUs);
+}
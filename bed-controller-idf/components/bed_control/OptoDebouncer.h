@@ -0,0 +1,103 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+// How a remote opto channel decides its level is stable.
+enum class DebounceMode : uint8_t {
+    WINDOW = 0,     // stable once thresholdMs pass with no edge; every bounce restarts the window
+    INTEGRATOR,     // stable once the raw level has spent thresholdMs more at the new level than
+                    // back at the old one since the burst began; a short spike only delays it
+};
+
+// Text form used by the RPC JSON; debounceModeFromName() returns false for
+// anything else.
+inline const char* debounceModeName(DebounceMode m) {
+    return m == DebounceMode::INTEGRATOR ? "INTEGRATOR" : "WINDOW";
+}
+
+inline bool debounceModeFromName(const char *name, DebounceMode &out) {
+    for (uint8_t i = 0; i <= (uint8_t)DebounceMode::INTEGRATOR; ++i) {
+        const DebounceMode m = static_cast<DebounceMode>(i);
+        if (strcmp(name, debounceModeName(m)) == 0) { out = m; return true; }
+    }
+    return false;
+}
+
+#define OPTO_DEBOUNCE_MIN_MS 1      // thresholds setOptoDebounce() accepts
+#define OPTO_DEBOUNCE_MAX_MS 100
+
+struct DebounceConfig {
+    DebounceMode mode = DebounceMode::WINDOW;
+    uint16_t thresholdMs = 0;
+};
+
+// Per-channel counters since boot (or the last resetStats()), for tuning the
+// threshold against a real remote.
+struct DebounceStats {
+    uint32_t transitions = 0;       // debounced level changes
+    uint32_t glitches = 0;          // bursts that settled back on the old level
+    uint32_t bounces = 0;           // edges past the first, summed over transitions
+    uint16_t maxBounces = 0;        // worst single transition
+    uint16_t maxBounceMs = 0;       // longest first-to-last edge of a transition
+    uint32_t minStableMs = UINT32_MAX;  // shortest time a debounced level held (UINT32_MAX = none yet)
+    uint32_t maxStableMs = 0;
+};
+
+// Debounces the four remote opto channels on ISR edge timestamps. Not
+// thread-safe: BedControl calls it with its mutex held. Times are esp_timer
+// us; a channel only moves forward, so late edges are clamped to the time it
+// already settled up to.
+class OptoDebouncer {
+public:
+    static constexpr int kChannels = 4;
+
+    struct Change {
+        int64_t atUs;           // when the level became stable
+        int64_t firstEdgeUs;    // first edge of the burst that changed it
+        int32_t debounceMs;     // first edge to stable
+        int level;
+    };
+
+    OptoDebouncer();     // every channel WINDOW with OPTO_DEBOUNCE_MS
+
+    // All channels idle (high, pull-ups) and settled; keeps the config.
+    void reset();
+    void configure(int ch, DebounceConfig cfg);
+    const DebounceConfig &config(int ch) const { return chans[ch].cfg; }
+
+    // Advances channel ch to nowUs. True (with out filled) if its level became
+    // stable at or before nowUs. Call before edge() so a change that finished
+    // before the edge is reported first.
+    bool settle(int ch, int64_t nowUs, Change &out);
+    // A raw level read at us. False if it is the level already held.
+    bool edge(int ch, int level, int64_t us);
+    // When settle() next has something to decide (INT64_MAX = settled).
+    int64_t dueUs(int ch) const;
+
+    int raw(int ch) const { return chans[ch].raw; }
+    int stable(int ch) const { return chans[ch].stable; }
+    int64_t edgeUs(int ch) const { return chans[ch].edgeUs; }     // latest raw edge
+    int64_t changeUs(int ch) const { return chans[ch].changeUs; } // first edge of the change that made stable()
+    bool pending(int ch) const { return chans[ch].burstUs >= 0; }
+    int64_t burstUs(int ch) const { return chans[ch].burstUs; }   // first edge of the unsettled burst (-1 = settled)
+
+    const DebounceStats &stats(int ch) const { return chans[ch].stats; }
+    void resetStats();
+
+private:
+    struct Channel {
+        DebounceConfig cfg;
+        DebounceStats stats;
+        int raw = 1;
+        int stable = 1;
+        int64_t edgeUs = 0;
+        int64_t burstUs = -1;       // first edge since the level was last stable (-1 = settled)
+        int64_t changeUs = 0;
+        int64_t doneUs = 0;         // settled up to here
+        int64_t integUs = 0;        // INTEGRATOR: net time at the new level
+        uint16_t edges = 0;         // in the current burst
+    };
+    Channel chans[kChannels];
+
+    void finishChange(Channel &c, int64_t atUs, Change &out);
+};
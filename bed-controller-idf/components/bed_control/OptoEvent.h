@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+
+// OptoEvent::kind
+#define OPTO_EVENT_EDGE     0   // raw level change, as the ISR (or polling) saw it
+#define OPTO_EVENT_STABLE   1   // debounced level change
+#define OPTO_EVENT_GESTURE  2   // remote gesture recognized (see RemoteGestures)
+
+// One entry of the opto event history (see BedDriver::readOptoEvents()).
+struct OptoEvent {
+    int64_t us;             // EDGE: ISR timestamp; STABLE: when the debounce window closed;
+                            // GESTURE: when it was recognized
+    uint32_t seq;           // 1, 2, ... since boot; a gap means the reader fell behind
+    int16_t debounceMs;     // STABLE: first edge of the burst to settled; GESTURE: HOLD time (0 otherwise)
+    uint8_t opto;           // 0..3 (OPTO_IN_1..4); GESTURE: REMOTE_BTN_* mask
+    uint8_t level;          // 0 = active/low, 1 = idle/high; GESTURE: GestureKind
+    uint8_t kind;           // OPTO_EVENT_*
+    uint8_t action;         // GESTURE: GestureAction
+    uint8_t script;         // GESTURE: slot of a SCRIPT action
+    uint8_t reserved[5];
+};
+static_assert(sizeof(OptoEvent) == 24, "OptoEvent is copied as raw bytes");
@@ -0,0 +1,32 @@
+#include "OptoEventLog.h"
+#include <string.h>
+
+void OptoEventLog::push(OptoEvent ev) {
+    const uint32_t seq = head.load(std::memory_order_relaxed) + 1;
+    ev.seq = seq;
+    Slot &slot = slots[seq & (OPTO_EVENT_LOG_LEN - 1)];
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&slot.ev, &ev, sizeof(ev));
+    slot.seq.store(seq, std::memory_order_release);
+    head.store(seq, std::memory_order_release);
+}
+
+size_t OptoEventLog::read(uint32_t afterSeq, OptoEvent *out, size_t max) const {
+    const uint32_t last = head.load(std::memory_order_acquire);
+    // Seqs wrap; compare by signed distance. Older than the ring: start at
+    // the oldest slot still held.
+    int32_t pending = (int32_t)(last - afterSeq);
+    if (pending <= 0) return 0;
+    if (pending > OPTO_EVENT_LOG_LEN) afterSeq = last - OPTO_EVENT_LOG_LEN;
+
+    size_t n = 0;
+    for (uint32_t seq = afterSeq + 1; n < max && (int32_t)(last - seq) >= 0; ++seq) {
+        const Slot &slot = slots[seq & (OPTO_EVENT_LOG_LEN - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != seq) continue;
+        memcpy(&out[n], &slot.ev, sizeof(OptoEvent));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == seq) ++n;
+    }
+    return n;
+}
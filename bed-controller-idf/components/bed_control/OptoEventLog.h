@@ -0,0 +1,35 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "BedConfig.h"
+#include "OptoEvent.h"
+
+// History of the last OPTO_EVENT_LOG_LEN opto events. One producer (the
+// motion task), any number of readers that never block it: each slot carries
+// the sequence number it holds, so a reader can tell a slot overwritten while
+// it copied it and skips that event instead of returning a torn one.
+class OptoEventLog {
+public:
+    // Producer only. Stamps the next sequence number.
+    void push(OptoEvent ev);
+
+    // Newest sequence number pushed (0 = none yet).
+    uint32_t lastSeq() const { return head.load(std::memory_order_acquire); }
+
+    // Copies up to max events with seq > afterSeq, oldest first. Events that
+    // were overwritten before the reader got to them are missing; the caller
+    // sees the gap in seq.
+    size_t read(uint32_t afterSeq, OptoEvent *out, size_t max) const;
+
+private:
+    static_assert((OPTO_EVENT_LOG_LEN & (OPTO_EVENT_LOG_LEN - 1)) == 0, "OPTO_EVENT_LOG_LEN must be a power of two");
+
+    struct Slot {
+        std::atomic<uint32_t> seq{0};   // seq of the event held, 0 while being written
+        OptoEvent ev;
+    };
+
+    Slot slots[OPTO_EVENT_LOG_LEN];
+    std::atomic<uint32_t> head{0};
+};
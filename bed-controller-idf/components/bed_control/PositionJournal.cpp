@@ -0,0 +1,46 @@
+#include "PositionJournal.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+#include <stddef.h>
+
+static const char *TAG = "POS_JOURNAL";
+static const char *kSlotKeys[2] = { "posj_a", "posj_b" };
+
+static uint32_t recordCrc(const PositionRecord &rec) {
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&rec), offsetof(PositionRecord, crc));
+}
+
+bool PositionJournal::load(nvs_handle_t nvs, PositionRecord &out) {
+    bool found = false;
+    for (uint8_t slot = 0; slot < 2; ++slot) {
+        PositionRecord rec = {};
+        size_t len = sizeof(rec);
+        if (nvs_get_blob(nvs, kSlotKeys[slot], &rec, &len) != ESP_OK || len != sizeof(rec)) continue;
+        if (rec.crc != recordCrc(rec)) {
+            ESP_LOGW(TAG, "Slot %s failed CRC (seq=%u); ignoring", kSlotKeys[slot], (unsigned)rec.seq);
+            continue;
+        }
+        // Signed difference so the comparison survives seq wrap-around.
+        if (!found || (int32_t)(rec.seq - out.seq) > 0) {
+            out = rec;
+            lastSeq = rec.seq;
+            nextSlot = slot ^ 1;
+            found = true;
+        }
+    }
+    return found;
+}
+
+esp_err_t PositionJournal::append(nvs_handle_t nvs, PositionRecord rec) {
+    rec.seq = ++lastSeq;
+    rec.crc = recordCrc(rec);
+    esp_err_t err = nvs_set_blob(nvs, kSlotKeys[nextSlot], &rec, sizeof(rec));
+    if (err == ESP_OK) err = nvs_commit(nvs);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Write %s failed: %s", kSlotKeys[nextSlot], esp_err_to_name(err));
+        return err;
+    }
+    nextSlot ^= 1;
+    return ESP_OK;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "nvs.h"
+
+// One persisted position. The CRC covers every field before it.
+struct PositionRecord {
+    uint32_t seq;
+    int32_t headPosMs;
+    int32_t footPosMs;
+    int8_t headEndStop;     // MotionDir the axis rests against (0 = in between)
+    int8_t footEndStop;
+    uint8_t headUncertDs;   // position uncertainty, 100 ms units (saturating)
+    uint8_t footUncertDs;
+    uint32_t crc;
+};
+static_assert(sizeof(PositionRecord) == 20, "PositionRecord is stored as an NVS blob");
+
+// Write-behind position store: two NVS blob slots written alternately, each
+// with a sequence number and CRC. A write torn by power loss only damages the
+// slot being written, so load() falls back to the previous record.
+class PositionJournal {
+public:
+    // Loads the newest slot whose CRC checks out; false if neither is valid.
+    bool load(nvs_handle_t nvs, PositionRecord &out);
+    // Assigns the next sequence number, writes the older slot and commits.
+    esp_err_t append(nvs_handle_t nvs, PositionRecord rec);
+
+private:
+    uint32_t lastSeq = 0;
+    uint8_t nextSlot = 0;
+};
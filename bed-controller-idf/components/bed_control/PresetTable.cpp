@@ -0,0 +1,274 @@
+#include "PresetTable.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+static const char *TAG = "PRESETS";
+static const char *kBlobKey = "presets";
+static const uint8_t kBlobVersion = 2;
+
+// Slot names (the legacy key prefixes) and first-boot presets, in slot order.
+static const char *kSlotNames[BED_SAVED_PRESETS] = { "zg", "snore", "legs", "p1", "p2" };
+static const PresetView kFactory[BED_SAVED_PRESETS] = {
+    { 10000, 40000, "Zero G" },
+    { 10000, 0, "Anti-Snore" },
+    { 0, 43000, "Legs Up" },
+    { 0, 0, "P1" },
+    { 0, 0, "P2" },
+};
+
+// Version 1 (the five built-ins, no ids): this header, then 5 PresetViews.
+struct BlobV1Header {
+    uint8_t version;
+    uint8_t entrySize;
+    uint16_t count;
+    uint32_t crc;       // over the entries
+};
+
+// Stored labels are zero-padded so the CRC only depends on the text.
+static void copyLabel(char *dst, const char *src) {
+    memset(dst, 0, BED_PRESET_LABEL_LEN);
+    memcpy(dst, src, strnlen(src, BED_PRESET_LABEL_LEN - 1));
+}
+
+// Moves entry from to position to, shifting the ones in between.
+static void moveEntry(PresetEntry *e, int from, int to) {
+    if (from == to) return;
+    const PresetEntry moved = e[from];
+    if (from < to) memmove(&e[from], &e[from + 1], (to - from) * sizeof(PresetEntry));
+    else memmove(&e[to + 1], &e[to], (from - to) * sizeof(PresetEntry));
+    e[to] = moved;
+}
+
+uint32_t PresetTable::crcOf(const Blob &b) {
+    const uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&b.hdr), offsetof(BlobHeader, crc));
+    return esp_rom_crc32_le(crc, reinterpret_cast<const uint8_t*>(b.entries), b.hdr.count * sizeof(PresetEntry));
+}
+
+const char* PresetTable::slotName(int i) {
+    return (i >= 0 && i < BED_SAVED_PRESETS) ? kSlotNames[i] : "";
+}
+
+int PresetTable::slotIndex(const char* name) {
+    for (int i = 0; i < BED_SAVED_PRESETS; ++i) {
+        if (strcmp(name, kSlotNames[i]) == 0) return i;
+    }
+    return -1;
+}
+
+const PresetView& PresetTable::factory(int i) {
+    return kFactory[i];
+}
+
+PresetTable::Origin PresetTable::load(nvs_handle_t nvs) {
+    bool present = false;
+    if (loadBlob(nvs, present)) return Origin::STORED;
+
+    Origin origin;
+    if (migrate(nvs)) {
+        origin = Origin::MIGRATED;
+    } else {
+        setBuiltins(kFactory);
+        origin = present ? Origin::RESET : Origin::FACTORY;
+    }
+    if (write(nvs) == ESP_OK && origin == Origin::MIGRATED) {
+        ESP_LOGI(TAG, "Migrated %d presets from per-field keys", BED_SAVED_PRESETS);
+    }
+    return origin;
+}
+
+bool PresetTable::loadBlob(nvs_handle_t nvs, bool &present) {
+    size_t len = sizeof(blob);
+    const esp_err_t err = nvs_get_blob(nvs, kBlobKey, &blob, &len);
+    present = err != ESP_ERR_NVS_NOT_FOUND;
+    if (err != ESP_OK) {
+        if (present) ESP_LOGW(TAG, "Read %s failed: %s", kBlobKey, esp_err_to_name(err));
+        return false;
+    }
+    if (len >= sizeof(BlobV1Header) && blob.hdr.version == 1) return loadVersion1(nvs, len);
+
+    const BlobHeader &h = blob.hdr;
+    bool ok = len >= sizeof(BlobHeader) && h.version == kBlobVersion && h.entrySize == sizeof(PresetEntry) &&
+              h.count >= BED_SAVED_PRESETS && h.count <= BED_PRESET_MAX &&
+              len == offsetof(Blob, entries) + h.count * sizeof(PresetEntry) && h.crc == crcOf(blob);
+    // Ids unique and issued, every built-in present.
+    int builtins = 0;
+    for (size_t i = 0; ok && i < h.count; ++i) {
+        const uint16_t id = blob.entries[i].id;
+        ok = id != 0 && id < h.nextId;
+        for (size_t j = 0; ok && j < i; ++j) ok = blob.entries[j].id != id;
+        builtins += builtin(id) ? 1 : 0;
+    }
+    if (!ok || builtins != BED_SAVED_PRESETS) {
+        ESP_LOGW(TAG, "Stored presets invalid (%u bytes); ignoring", (unsigned)len);
+        return false;
+    }
+    for (size_t i = 0; i < h.count; ++i) blob.entries[i].label[BED_PRESET_LABEL_LEN - 1] = '\0';
+    return true;
+}
+
+// The five built-ins as the previous build stored them; rewritten as version 2.
+bool PresetTable::loadVersion1(nvs_handle_t nvs, size_t len) {
+    BlobV1Header h;
+    PresetView views[BED_SAVED_PRESETS];
+    memcpy(&h, &blob, sizeof(h));
+    if (h.entrySize != sizeof(PresetView) || h.count != BED_SAVED_PRESETS || len != sizeof(h) + sizeof(views)) {
+        ESP_LOGW(TAG, "Stored presets invalid (%u bytes); ignoring", (unsigned)len);
+        return false;
+    }
+    memcpy(views, reinterpret_cast<const uint8_t*>(&blob) + sizeof(h), sizeof(views));
+    if (h.crc != esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(views), sizeof(views))) {
+        ESP_LOGW(TAG, "Stored presets invalid (%u bytes); ignoring", (unsigned)len);
+        return false;
+    }
+    for (PresetView &v : views) v.label[BED_PRESET_LABEL_LEN - 1] = '\0';
+    setBuiltins(views);
+    if (write(nvs) == ESP_OK) ESP_LOGI(TAG, "Converted version 1 presets");
+    return true;
+}
+
+// Reads the per-field keys of older builds. A missing key falls back the way
+// Bed.Status used to (factory position, "Preset"); false if none exist.
+bool PresetTable::migrate(nvs_handle_t nvs) {
+    bool found = false;
+    PresetView views[BED_SAVED_PRESETS];
+    char key[16];
+    for (int i = 0; i < BED_SAVED_PRESETS; ++i) {
+        PresetView &e = views[i];
+        e = kFactory[i];
+        snprintf(key, sizeof(key), "%s_head", kSlotNames[i]);
+        found |= nvs_get_i32(nvs, key, &e.headMs) == ESP_OK;
+        snprintf(key, sizeof(key), "%s_foot", kSlotNames[i]);
+        found |= nvs_get_i32(nvs, key, &e.footMs) == ESP_OK;
+
+        snprintf(key, sizeof(key), "%s_label", kSlotNames[i]);
+        size_t len = 0;
+        if (nvs_get_str(nvs, key, NULL, &len) == ESP_OK && len > 0) {
+            std::string label(len, '\0');
+            if (nvs_get_str(nvs, key, &label[0], &len) == ESP_OK) {
+                snprintf(e.label, sizeof(e.label), "%s", label.c_str());
+                found = true;
+                continue;
+            }
+        }
+        snprintf(e.label, sizeof(e.label), "Preset");
+    }
+    if (found) setBuiltins(views);
+    return found;
+}
+
+// Just the built-ins (ids 1..5), no other id issued yet. The revision carries
+// on, so a cache keyed on it never mistakes a reset table for the old one.
+void PresetTable::setBuiltins(const PresetView *views) {
+    const uint32_t rev = blob.hdr.version == kBlobVersion ? blob.hdr.rev : 0;
+    memset(&blob, 0, sizeof(blob));
+    for (int i = 0; i < BED_SAVED_PRESETS; ++i) {
+        PresetEntry &e = blob.entries[i];
+        e.id = (uint16_t)(i + 1);
+        e.headMs = views[i].headMs;
+        e.footMs = views[i].footMs;
+        copyLabel(e.label, views[i].label);
+    }
+    blob.hdr.count = BED_SAVED_PRESETS;
+    blob.hdr.nextId = BED_SAVED_PRESETS + 1;
+    blob.hdr.rev = rev;
+}
+
+PresetView PresetTable::get(int i) const {
+    const int pos = find((uint16_t)(i + 1));
+    if (pos < 0) return kFactory[i];
+    const PresetEntry &e = blob.entries[pos];
+    PresetView v;
+    v.headMs = e.headMs;
+    v.footMs = e.footMs;
+    memcpy(v.label, e.label, sizeof(v.label));
+    return v;
+}
+
+PresetStoreInfo PresetTable::info() const {
+    PresetStoreInfo out;
+    out.count = blob.hdr.count;
+    out.rev = blob.hdr.rev;
+    out.full = blob.hdr.count >= BED_PRESET_MAX || blob.hdr.nextId == UINT16_MAX;
+    return out;
+}
+
+int PresetTable::find(uint16_t id) const {
+    for (size_t i = 0; id != 0 && i < blob.hdr.count; ++i) {
+        if (blob.entries[i].id == id) return (int)i;
+    }
+    return -1;
+}
+
+uint16_t PresetTable::save(nvs_handle_t nvs, const PresetEntry &entry, int position) {
+    BlobHeader &h = blob.hdr;
+    PresetEntry next = {};
+    next.headMs = entry.headMs;
+    next.footMs = entry.footMs;
+    PresetEntry prev = {};
+    int pos;
+    if (entry.id == 0) {
+        if (h.count >= BED_PRESET_MAX || h.nextId == UINT16_MAX) return 0;
+        next.id = h.nextId++;
+        if (entry.label[0]) {
+            copyLabel(next.label, entry.label);
+        } else {
+            char label[BED_PRESET_LABEL_LEN];
+            snprintf(label, sizeof(label), "Preset %u", (unsigned)next.id);
+            copyLabel(next.label, label);
+        }
+        pos = h.count++;
+    } else {
+        pos = find(entry.id);
+        if (pos < 0) return 0;
+        next.id = entry.id;
+        copyLabel(next.label, entry.label);
+        const bool moves = position >= 0 && std::min<int>(position, h.count - 1) != pos;
+        if (!moves && memcmp(&blob.entries[pos], &next, sizeof(next)) == 0) return next.id;
+        prev = blob.entries[pos];
+    }
+    blob.entries[pos] = next;
+    const int to = position >= 0 ? std::min<int>(position, h.count - 1) : pos;
+    moveEntry(blob.entries, pos, to);
+    const uint32_t rev = h.rev;
+    if (write(nvs) == ESP_OK) return next.id;
+
+    // Undo, so the caller's failure and the next List agree with flash.
+    moveEntry(blob.entries, to, pos);
+    h.rev = rev;
+    if (entry.id == 0) {
+        h.count--;
+        h.nextId--;
+        memset(&blob.entries[h.count], 0, sizeof(PresetEntry));
+    } else {
+        blob.entries[pos] = prev;
+    }
+    return 0;
+}
+
+bool PresetTable::remove(nvs_handle_t nvs, uint16_t id) {
+    const int pos = find(id);
+    if (pos < 0 || builtin(id)) return false;
+    moveEntry(blob.entries, pos, blob.hdr.count - 1);
+    blob.hdr.count--;
+    memset(&blob.entries[blob.hdr.count], 0, sizeof(PresetEntry));
+    write(nvs);
+    return true;
+}
+
+esp_err_t PresetTable::write(nvs_handle_t nvs) {
+    BlobHeader &h = blob.hdr;
+    h.version = kBlobVersion;
+    h.entrySize = sizeof(PresetEntry);
+    h.rev++;
+    h.crc = crcOf(blob);
+    esp_err_t err = nvs_set_blob(nvs, kBlobKey, &blob, offsetof(Blob, entries) + h.count * sizeof(PresetEntry));
+    if (err == ESP_OK) err = nvs_commit(nvs);
+    if (err != ESP_OK) ESP_LOGW(TAG, "Write %s failed: %s", kBlobKey, esp_err_to_name(err));
+    return err;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "nvs.h"
+
+#define BED_SAVED_PRESETS       5       // built-in slots "zg", "snore", "legs", "p1", "p2" (ids 1-5)
+#define BED_PRESET_MAX          48      // built-ins plus user presets
+#define BED_PRESET_LABEL_LEN    32      // the UI allows 10; longer labels are cut
+
+// One built-in slot as BedService and Bed.Command presets see it.
+struct PresetView {
+    int32_t headMs;
+    int32_t footMs;
+    char label[BED_PRESET_LABEL_LEN];
+};
+
+// One stored preset. The id never changes and is not reused after a delete;
+// ids 1..BED_SAVED_PRESETS are the built-in slots, in slot order.
+struct PresetEntry {
+    uint16_t id;
+    uint16_t reserved;
+    int32_t headMs;
+    int32_t footMs;
+    char label[BED_PRESET_LABEL_LEN];   // NUL-terminated, zero-padded when stored
+};
+static_assert(sizeof(PresetEntry) == 44, "PresetEntry is stored in the preset blob");
+
+// Store size and change counter, for pagers and caches.
+struct PresetStoreInfo {
+    uint16_t count = 0;
+    uint32_t rev = 0;           // bumped by every change, persisted
+    bool full = false;          // no room or no id left for a new preset
+};
+
+// The saved presets of one base in display order, held in RAM and stored as
+// one NVS blob ("presets": version, entry size, count, next id, revision,
+// CRC, then the entries). A single nvs_set_blob() replaces the old value only
+// once the new one is written, so a save torn by power loss keeps the
+// previous table; the CRC catches the rest. load() migrates the version 1
+// blob (the five built-ins) and the 15 per-field keys of older builds, which
+// stay in place for a rollback. Not thread-safe: BedControl serializes access.
+class PresetTable {
+public:
+    enum class Origin : uint8_t {
+        STORED,     // blob loaded (a version 1 blob is rewritten as version 2)
+        MIGRATED,   // no valid blob; built from the legacy keys
+        FACTORY,    // nothing stored: first boot
+        RESET,      // blob failed its checks and no legacy keys; factory presets
+    };
+
+    // Loads the blob (or migrates/creates it) and writes it if it was not
+    // loaded as-is.
+    Origin load(nvs_handle_t nvs);
+
+    // Built-in slot i (0..BED_SAVED_PRESETS-1).
+    PresetView get(int i) const;
+
+    size_t count() const { return blob.hdr.count; }
+    PresetStoreInfo info() const;
+    const PresetEntry& at(size_t pos) const { return blob.entries[pos]; }
+    int find(uint16_t id) const;        // position, -1 if unknown
+    // Creates (id 0) or updates entry and moves it to position (clamped; < 0
+    // keeps an existing one in place and puts a new one last). Returns the
+    // id, 0 if the store is full, the id is unknown or the write failed (the
+    // change is then undone in RAM too).
+    uint16_t save(nvs_handle_t nvs, const PresetEntry &entry, int position);
+    // False for an unknown id or a built-in slot.
+    bool remove(nvs_handle_t nvs, uint16_t id);
+
+    static bool builtin(uint16_t id) { return id >= 1 && id <= BED_SAVED_PRESETS; }
+    static const char* slotName(int i);
+    static int slotIndex(const char* name);         // -1 if unknown
+    static const PresetView& factory(int i);
+
+private:
+    struct BlobHeader {
+        uint8_t version;
+        uint8_t entrySize;
+        uint16_t count;
+        uint16_t nextId;
+        uint16_t reserved;
+        uint32_t rev;
+        uint32_t crc;       // over the header fields before it, then the entries
+    };
+    struct Blob {
+        BlobHeader hdr;
+        PresetEntry entries[BED_PRESET_MAX];
+    };
+    // Also the load buffer, so the 2 KB table is never on a stack.
+    Blob blob = {};
+
+    bool loadBlob(nvs_handle_t nvs, bool &present);
+    bool loadVersion1(nvs_handle_t nvs, size_t len);
+    bool migrate(nvs_handle_t nvs);
+    void setBuiltins(const PresetView *views);
+    // Bumps the revision and writes the blob. A failed write is logged; the
+    // change stays in RAM and goes out with the next one.
+    esp_err_t write(nvs_handle_t nvs);
+    static uint32_t crcOf(const Blob &b);
+};
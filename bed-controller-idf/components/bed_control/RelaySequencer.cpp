@@ -0,0 +1,164 @@
+#include "RelaySequencer.h"
+#include "BedConfig.h"
+
+#include "driver/gpio.h"
+#include "esp_log.h"
+
+#include <algorithm>
+
+static const char *TAG = "RELAY_SEQ";
+
+// Per-relay dead-time: how long a relay stays open before it (or, for a motor
+// relay, the opposite direction of its axis) may close again.
+static const int32_t kRelayDeadMs[RELAY_CHANNELS] = {
+    HEAD_RELAY_DEAD_MS, HEAD_RELAY_DEAD_MS, FOOT_RELAY_DEAD_MS, FOOT_RELAY_DEAD_MS,
+    TRANSFER_RELAY_DEAD_MS, TRANSFER_RELAY_DEAD_MS, TRANSFER_RELAY_DEAD_MS, TRANSFER_RELAY_DEAD_MS,
+};
+
+static const char *kRelayNames[RELAY_CHANNELS] = { "HU", "HD", "FU", "FD", "THU", "THD", "TFU", "TFD" };
+
+static inline bool isMotor(int ch) { return ch < RELAY_TRANSFER_HEAD_UP; }
+
+// Whether transfer relay tc routes the motor behind motor relay mc.
+static inline bool feeds(int tc, int mc) {
+#if BED_TRANSFER_MODE_MULTI
+    return (tc - RELAY_TRANSFER_HEAD_UP) / 2 == mc / 2;
+#else
+    (void)mc;
+    return tc == RELAY_TRANSFER_HEAD_UP;
+#endif
+}
+
+int32_t RelaySequencer::startLeadMs(int order) {
+    return RELAY_TRANSFER_SETTLE_MS + order * RELAY_MOTOR_STAGGER_MS;
+}
+
+int32_t RelaySequencer::restMs() {
+    return std::max({ (int32_t)HEAD_RELAY_DEAD_MS, (int32_t)FOOT_RELAY_DEAD_MS,
+                      (int32_t)(RELAY_TRANSFER_SETTLE_MS + TRANSFER_RELAY_DEAD_MS) });
+}
+
+void RelaySequencer::begin(int64_t nowUs, const BedPins &pins) {
+    for (int i = 0; i < 4; ++i) {
+#if BED_MOTOR_DRIVER_DRV8871
+        // The bridges are driven by LEDC; these channels only gate the PWM ramp.
+        pin[RELAY_HEAD_UP + i] = -1;
+#else
+        pin[RELAY_HEAD_UP + i] = pins.motor[i];
+#endif
+        pin[RELAY_TRANSFER_HEAD_UP + i] = pins.transfer[i];
+    }
+    for (int ch = 0; ch < RELAY_CHANNELS; ++ch) {
+        want[ch] = false;
+        level[ch] = false;
+        changedUs[ch] = nowUs - (int64_t)restMs() * 1000;
+        dueUs[ch] = -1;
+        write(ch, false);
+    }
+    nextUs = -1;
+}
+
+void RelaySequencer::request(RelayChannel ch, bool closed) {
+    want[ch] = closed;
+    if (closed && isMotor(ch)) want[ch ^ 1] = false;
+}
+
+int64_t RelaySequencer::closeAtUs(RelayChannel ch) const {
+    if (!want[ch]) return -1;
+    return level[ch] ? changedUs[ch] : dueUs[ch];
+}
+
+// Earliest time channel ch may switch to its requested level, given the
+// levels and change times in lvl/changed; -1 while another switch has to
+// happen first.
+int64_t RelaySequencer::earliestUs(int ch, int64_t nowUs, const bool *lvl, const int64_t *changed) const {
+    int64_t t = nowUs;
+    auto notBefore = [&t](int64_t us) { if (us > t) t = us; };
+    if (isMotor(ch)) {
+        if (!want[ch]) return nowUs;
+        const int partner = ch ^ 1;
+        if (lvl[partner]) return -1;
+        notBefore(changed[ch] + (int64_t)kRelayDeadMs[ch] * 1000);
+        notBefore(changed[partner] + (int64_t)kRelayDeadMs[partner] * 1000);
+        for (int tc = RELAY_TRANSFER_HEAD_UP; tc < RELAY_CHANNELS; ++tc) {
+            if (!want[tc] || !feeds(tc, ch)) continue;
+            if (!lvl[tc]) return -1;
+            notBefore(changed[tc] + (int64_t)RELAY_TRANSFER_SETTLE_MS * 1000);
+        }
+        const int other = (ch < RELAY_FOOT_UP) ? RELAY_FOOT_UP : RELAY_HEAD_UP;
+        for (int oc = other; oc < other + 2; ++oc) {
+            if (lvl[oc]) notBefore(changed[oc] + (int64_t)RELAY_MOTOR_STAGGER_MS * 1000);
+        }
+        return t;
+    }
+    if (want[ch]) {
+        notBefore(changed[ch] + (int64_t)kRelayDeadMs[ch] * 1000);
+        return t;
+    }
+    for (int mc = 0; mc < RELAY_TRANSFER_HEAD_UP; ++mc) {
+        if (!feeds(ch, mc)) continue;
+        if (lvl[mc]) return -1;
+        notBefore(changed[mc] + (int64_t)RELAY_TRANSFER_SETTLE_MS * 1000);
+    }
+    return t;
+}
+
+// Replays the pending switches in the order they will happen (each one may
+// unblock the next: partner open before close, transfer before motor, first
+// motor before the second) and records when each is due.
+void RelaySequencer::plan(int64_t nowUs) {
+    bool lvl[RELAY_CHANNELS];
+    int64_t changed[RELAY_CHANNELS];
+    bool pending[RELAY_CHANNELS];
+    for (int ch = 0; ch < RELAY_CHANNELS; ++ch) {
+        lvl[ch] = level[ch];
+        changed[ch] = changedUs[ch];
+        pending[ch] = want[ch] != level[ch];
+        dueUs[ch] = -1;
+    }
+    nextUs = -1;
+    for (int n = 0; n < RELAY_CHANNELS; ++n) {
+        int best = -1;
+        int64_t bestUs = 0;
+        for (int ch = 0; ch < RELAY_CHANNELS; ++ch) {
+            if (!pending[ch]) continue;
+            const int64_t t = earliestUs(ch, nowUs, lvl, changed);
+            if (t >= 0 && (best < 0 || t < bestUs)) {
+                best = ch;
+                bestUs = t;
+            }
+        }
+        if (best < 0) break;
+        pending[best] = false;
+        dueUs[best] = bestUs;
+        lvl[best] = want[best];
+        changed[best] = bestUs;
+        if (nextUs < 0 || bestUs < nextUs) nextUs = bestUs;
+    }
+}
+
+int64_t RelaySequencer::service(int64_t nowUs) {
+    for (int n = 0; n <= RELAY_CHANNELS; ++n) {
+        plan(nowUs);
+        int ch = -1;
+        for (int c = 0; c < RELAY_CHANNELS; ++c) {
+            if (want[c] == level[c] || dueUs[c] < 0 || dueUs[c] > nowUs) continue;
+            // On a tie, open first: the plan may have let a close follow an
+            // opening in the same instant (next axis' motor after the last).
+            if (ch < 0 || dueUs[c] < dueUs[ch] || (dueUs[c] == dueUs[ch] && want[ch] && !want[c])) ch = c;
+        }
+        if (ch < 0) break;
+        level[ch] = want[ch];
+        changedUs[ch] = nowUs;
+        write(ch, level[ch]);
+    }
+    return nextUs;
+}
+
+void RelaySequencer::write(int ch, bool closed) {
+    if (pin[ch] >= 0) {
+        gpio_set_level((gpio_num_t)pin[ch], closed ? RELAY_ON : RELAY_OFF);
+        ESP_LOGD(TAG, "%s=%d", kRelayNames[ch], closed ? 1 : 0);
+    }
+    if (sink) sink(sinkCtx, (RelayChannel)ch, closed);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <stdint.h>
+#include "BedPins.h"
+
+// Relay outputs in sequencer order. Single-transfer builds drive the shared
+// transfer GPIO through RELAY_TRANSFER_HEAD_UP and never use the other three.
+enum RelayChannel : uint8_t {
+    RELAY_HEAD_UP = 0,
+    RELAY_HEAD_DOWN,
+    RELAY_FOOT_UP,
+    RELAY_FOOT_DOWN,
+    RELAY_TRANSFER_HEAD_UP,
+    RELAY_TRANSFER_HEAD_DOWN,
+    RELAY_TRANSFER_FOOT_UP,
+    RELAY_TRANSFER_FOOT_DOWN,
+    RELAY_CHANNELS
+};
+
+// Time-ordered relay switching. Callers say which relays should be closed;
+// service() switches each one as soon as the timing rules allow:
+//  - a motor relay opens immediately, always;
+//  - after a motor relay opens, neither relay of that axis closes again for
+//    its dead-time (break-before-make on reversal, no chatter on re-start);
+//  - a motor relay closes only once its transfer relays have been closed for
+//    RELAY_TRANSFER_SETTLE_MS, and a transfer relay opens only once its motor
+//    relays have been open that long, so transfer contacts never carry the
+//    switching current;
+//  - a motor relay closes no sooner than RELAY_MOTOR_STAGGER_MS after the
+//    other axis' relay closed, so the two inrush peaks never add up.
+// Not thread-safe: BedControl only calls it with its mutex held.
+class RelaySequencer {
+public:
+    // Sees every switch, after the GPIO write (if the channel has a GPIO); a
+    // backend without relay GPIOs follows the outputs through it. Runs with
+    // BedControl's mutex held, so it must not block.
+    typedef void (*Sink)(void *ctx, RelayChannel ch, bool closed);
+    void setSink(Sink fn, void *ctx) { sink = fn; sinkCtx = ctx; }
+
+    // Takes the base's relay GPIOs and opens every relay now, with all
+    // dead-times already served.
+    void begin(int64_t nowUs, const BedPins &pins);
+    // Closing one direction of an axis also requests the other one open.
+    void request(RelayChannel ch, bool closed);
+    bool requested(RelayChannel ch) const { return want[ch]; }
+    bool closed(RelayChannel ch) const { return level[ch]; }
+    // When an open relay opened (as of the last service()); -1 while closed.
+    int64_t openedAtUs(RelayChannel ch) const { return level[ch] ? -1 : changedUs[ch]; }
+
+    // Switches every relay that is due at nowUs. Returns when the next pending
+    // switch is due, or -1 once the outputs match the requests.
+    int64_t service(int64_t nowUs);
+    // When a requested relay closed, or is planned to close if still pending
+    // (as of the last service()); -1 if it is not requested closed.
+    int64_t closeAtUs(RelayChannel ch) const;
+
+    // Request-to-close delay of a motor relay starting from rest; order 0 for
+    // the first axis to start, 1 for the second.
+    static int32_t startLeadMs(int order);
+    // Time after everything opened until every relay is back at rest.
+    static int32_t restMs();
+
+private:
+    bool want[RELAY_CHANNELS] = {};
+    bool level[RELAY_CHANNELS] = {};
+    int64_t changedUs[RELAY_CHANNELS] = {};
+    int64_t dueUs[RELAY_CHANNELS] = {};
+    int64_t nextUs = -1;
+    int pin[RELAY_CHANNELS] = { -1, -1, -1, -1, -1, -1, -1, -1 };   // -1 = no GPIO
+    Sink sink = nullptr;
+    void *sinkCtx = nullptr;
+
+    int64_t earliestUs(int ch, int64_t nowUs, const bool *lvl, const int64_t *changed) const;
+    void plan(int64_t nowUs);
+    void write(int ch, bool closed);
+};
@@ -0,0 +1,105 @@
+#include "RemoteGestures.h"
+#include <algorithm>
+#include "BedConfig.h"
+
+static constexpr int64_t kTapMaxUs = (int64_t)GESTURE_TAP_MAX_MS * 1000;
+static constexpr int64_t kTapGapUs = (int64_t)GESTURE_TAP_GAP_MS * 1000;
+
+void RemoteGestures::setMap(const GestureMap &m) {
+    gestures = m;
+    held = pressMask = 0;
+    pressUs = 0;
+    pressSpent = false;
+    tapMask = taps = 0;
+    releaseUs = 0;
+    hasFired = false;
+}
+
+const GestureBinding *RemoteGestures::find(uint8_t buttons, GestureKind kind) const {
+    for (uint8_t i = 0; i < gestures.count; ++i) {
+        const GestureBinding &b = gestures.bindings[i];
+        if (b.buttons == buttons && b.kind == kind) return &b;
+    }
+    return nullptr;
+}
+
+// A HOLD is due while every button of the press is still down (one let go
+// and pressed again is a new shape, not a longer hold).
+int64_t RemoteGestures::holdDueUs() const {
+    if (held == 0 || pressSpent || held != pressMask) return INT64_MAX;
+    const GestureBinding *b = find(held, GestureKind::HOLD);
+    return b ? pressUs + (int64_t)b->holdMs * 1000 : INT64_MAX;
+}
+
+// The tap sequence is complete: fires its binding, if the count has one.
+void RemoteGestures::endTaps(int64_t atUs) {
+    const GestureBinding *b = nullptr;
+    if (taps == 2) b = find(tapMask, GestureKind::DOUBLE_TAP);
+    else if (taps >= 3) b = find(tapMask, GestureKind::TRIPLE_TAP);
+    if (b) {
+        fired.binding = *b;
+        fired.atUs = atUs;
+        hasFired = true;
+    }
+    taps = 0;
+}
+
+void RemoteGestures::change(int ch, bool active, int64_t us) {
+    const uint8_t bit = (uint8_t)(1u << ch);
+    if (active) {
+        if (held == 0) {
+            // A sequence whose gap ran out before this press is over; one
+            // still open waits to see whether this press is its next tap.
+            if (taps > 0 && us - releaseUs > kTapGapUs) endTaps(releaseUs + kTapGapUs);
+            pressUs = us;
+            pressMask = 0;
+            pressSpent = false;
+        }
+        held |= bit;
+        pressMask |= bit;
+        return;
+    }
+    if (!(held & bit)) return;
+    held &= (uint8_t)~bit;
+    if (held != 0 || pressSpent) return;
+
+    // The press is over. Anything but a matching tap cancels the sequence, so
+    // fine-adjusting with short nudges never fires a gesture late.
+    if (us - pressUs > kTapMaxUs) {
+        taps = 0;
+        return;
+    }
+    if (taps > 0 && pressMask == tapMask && pressUs - releaseUs <= kTapGapUs) {
+        ++taps;
+    } else {
+        taps = 1;
+        tapMask = pressMask;
+    }
+    releaseUs = us;
+    // Fire straight away when no longer sequence is bound.
+    const bool triple = find(tapMask, GestureKind::TRIPLE_TAP) != nullptr;
+    if (taps >= 3 || (taps == 2 && !triple)) endTaps(us);
+    else if (taps == 1 && !triple && !find(tapMask, GestureKind::DOUBLE_TAP)) taps = 0;
+}
+
+bool RemoteGestures::poll(int64_t settledUs, Fired &out) {
+    if (taps > 0 && held == 0 && settledUs >= releaseUs + kTapGapUs) endTaps(releaseUs + kTapGapUs);
+    const int64_t holdUs = holdDueUs();
+    if (holdUs <= settledUs) {
+        fired.binding = *find(held, GestureKind::HOLD);
+        fired.atUs = holdUs;
+        hasFired = true;
+        pressSpent = true;
+        taps = 0;
+    }
+    if (!hasFired) return false;
+    out = fired;
+    hasFired = false;
+    return true;
+}
+
+int64_t RemoteGestures::dueUs() const {
+    int64_t due = holdDueUs();
+    if (taps > 0 && held == 0) due = std::min(due, releaseUs + kTapGapUs);
+    return due;
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Wired-remote buttons as gesture masks: bit n = opto n.
+#define REMOTE_BTN_HEAD_UP      0x01
+#define REMOTE_BTN_HEAD_DOWN    0x02
+#define REMOTE_BTN_FOOT_UP      0x04
+#define REMOTE_BTN_FOOT_DOWN    0x08
+
+// Text form of one button (bit n of a mask) used by the RPC JSON.
+inline const char* remoteButtonName(int opto) {
+    static const char *const names[4] = { "HEAD_UP", "HEAD_DOWN", "FOOT_UP", "FOOT_DOWN" };
+    return opto >= 0 && opto < 4 ? names[opto] : "?";
+}
+
+inline bool remoteButtonFromName(const char *name, uint8_t &mask) {
+    for (int i = 0; i < 4; ++i) {
+        if (strcmp(name, remoteButtonName(i)) == 0) { mask = (uint8_t)(1u << i); return true; }
+    }
+    return false;
+}
+
+enum class GestureKind : uint8_t {
+    DOUBLE_TAP = 0,     // two taps of the same button(s)
+    TRIPLE_TAP,         // three taps
+    HOLD,               // held for holdMs
+};
+
+inline const char* gestureKindName(GestureKind k) {
+    switch (k) {
+        case GestureKind::TRIPLE_TAP: return "TRIPLE_TAP";
+        case GestureKind::HOLD: return "HOLD";
+        default: return "DOUBLE_TAP";
+    }
+}
+
+inline bool gestureKindFromName(const char *name, GestureKind &out) {
+    for (uint8_t i = 0; i <= (uint8_t)GestureKind::HOLD; ++i) {
+        const GestureKind k = static_cast<GestureKind>(i);
+        if (strcmp(name, gestureKindName(k)) == 0) { out = k; return true; }
+    }
+    return false;
+}
+
+// What a recognized gesture does. The presets are the Bed.Command ones of
+// the same name (saved positions resolved when the gesture fires).
+enum class GestureAction : uint8_t {
+    STOP = 0,
+    FLAT,
+    MAX,
+    ZERO_G,
+    ANTI_SNORE,
+    LEGS_UP,
+    P1,
+    P2,
+    SCRIPT,     // RUN_SCRIPT of GestureBinding::script
+};
+
+inline const char* gestureActionName(GestureAction a) {
+    switch (a) {
+        case GestureAction::FLAT: return "FLAT";
+        case GestureAction::MAX: return "MAX";
+        case GestureAction::ZERO_G: return "ZERO_G";
+        case GestureAction::ANTI_SNORE: return "ANTI_SNORE";
+        case GestureAction::LEGS_UP: return "LEGS_UP";
+        case GestureAction::P1: return "P1";
+        case GestureAction::P2: return "P2";
+        case GestureAction::SCRIPT: return "SCRIPT";
+        default: return "STOP";
+    }
+}
+
+inline bool gestureActionFromName(const char *name, GestureAction &out) {
+    for (uint8_t i = 0; i <= (uint8_t)GestureAction::SCRIPT; ++i) {
+        const GestureAction a = static_cast<GestureAction>(i);
+        if (strcmp(name, gestureActionName(a)) == 0) { out = a; return true; }
+    }
+    return false;
+}
+
+#define GESTURE_HOLD_MIN_MS     500     // shorter holds would fire on ordinary nudges
+#define GESTURE_HOLD_MAX_MS     10000
+
+struct GestureBinding {
+    uint8_t buttons;        // REMOTE_BTN_* mask, all pressed together
+    GestureKind kind;
+    GestureAction action;
+    uint8_t script;         // SCRIPT: slot
+    uint16_t holdMs;        // HOLD: how long (from the first button down)
+};
+static_assert(sizeof(GestureBinding) == 6, "GestureBinding is stored packed in NVS");
+
+// The whole gesture table, stored in NVS as one blob ("gestures"; 2 + 6
+// bytes per binding).
+struct GestureMap {
+    static constexpr uint8_t kVersion = 1;
+    static constexpr uint8_t kMaxBindings = 8;
+
+    uint8_t version = kVersion;
+    uint8_t count = 0;
+    GestureBinding bindings[kMaxBindings] = {};
+
+    size_t storedSize() const { return offsetof(GestureMap, bindings) + count * sizeof(GestureBinding); }
+
+    // Double-tap head-down: FLAT. Hold head-up and foot-up for 2 s: ZERO_G.
+    static GestureMap defaults() {
+        GestureMap m;
+        m.bindings[m.count++] = { REMOTE_BTN_HEAD_DOWN, GestureKind::DOUBLE_TAP, GestureAction::FLAT, 0, 0 };
+        m.bindings[m.count++] = { REMOTE_BTN_HEAD_UP | REMOTE_BTN_FOOT_UP, GestureKind::HOLD, GestureAction::ZERO_G, 0, 2000 };
+        return m;
+    }
+
+    // Rejects unknown kinds/actions, empty masks, hold times out of range and
+    // two bindings for the same buttons and kind.
+    bool valid(uint8_t scriptSlots) const {
+        if (version != kVersion || count > kMaxBindings) return false;
+        for (uint8_t i = 0; i < count; ++i) {
+            const GestureBinding &b = bindings[i];
+            if (b.buttons == 0 || b.buttons > 0x0F) return false;
+            if (b.kind > GestureKind::HOLD || b.action > GestureAction::SCRIPT) return false;
+            if (b.action == GestureAction::SCRIPT && b.script >= scriptSlots) return false;
+            if (b.kind == GestureKind::HOLD && (b.holdMs < GESTURE_HOLD_MIN_MS || b.holdMs > GESTURE_HOLD_MAX_MS)) return false;
+            for (uint8_t j = 0; j < i; ++j) {
+                if (bindings[j].buttons == b.buttons && bindings[j].kind == b.kind) return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Recognizes taps and holds on the debounced remote buttons. Not
+// thread-safe: BedControl feeds it with its mutex held, from the motion task.
+// Times are esp_timer us and come from the opto edges (the first edge of each
+// debounced change), so recognition does not depend on when the task ran.
+//
+// A press runs from the first button down to the last button up; its mask is
+// every button seen down in between. A press no longer than
+// GESTURE_TAP_MAX_MS is a tap. Taps of the same mask, each starting within
+// GESTURE_TAP_GAP_MS of the previous release, count up to a DOUBLE_TAP or
+// TRIPLE_TAP. A HOLD fires while its exact mask is still held. Anything
+// else (a longer press, an unbound count) is an ordinary remote press and
+// fires nothing.
+class RemoteGestures {
+public:
+    struct Fired {
+        GestureBinding binding;
+        int64_t atUs;           // when it was recognized (hold deadline, last release, gap end)
+    };
+
+    // Replaces the table; forgets any half-seen gesture.
+    void setMap(const GestureMap &m);
+    const GestureMap &map() const { return gestures; }
+
+    // A debounced change of opto ch (active = pressed) whose first edge was at us.
+    void change(int ch, bool active, int64_t us);
+    // Decides everything that is due by settledUs, the time up to which the
+    // inputs are known (no unsettled opto burst began before it). True once
+    // per recognized gesture, with out filled.
+    bool poll(int64_t settledUs, Fired &out);
+    // When poll() next has something to decide (INT64_MAX = nothing pending).
+    int64_t dueUs() const;
+
+private:
+    GestureMap gestures;
+    uint8_t held = 0;           // buttons down now
+    uint8_t pressMask = 0;      // every button down since the press began
+    int64_t pressUs = 0;        // first button down
+    bool pressSpent = false;    // a HOLD fired on this press; its release is not a tap
+    uint8_t tapMask = 0;        // taps counted so far, all of this mask
+    uint8_t taps = 0;
+    int64_t releaseUs = 0;      // end of the latest tap
+    bool hasFired = false;      // recognized in change(), handed out by the next poll()
+    Fired fired = {};
+
+    const GestureBinding *find(uint8_t buttons, GestureKind kind) const;
+    int64_t holdDueUs() const;
+    void endTaps(int64_t atUs);
+};
@@ -0,0 +1,119 @@
+#include "RfBedDriver.h"
+#include <cstring>
+#include "esp_log.h"
+#include "soc/soc_caps.h"
+
+static const char *TAG = "RF_BED";
+
+// The remote's head-up frame (mb-rf-tx "golden" capture), in us: a low sync
+// gap, then alternating high/low pulses ending high. Pulses 41-48 carry the
+// command nibble, MSB first: 1 = long-short, 0 = short-long.
+static const uint16_t kFrameUs[50] = {
+    12875, 1320, 350, 1320, 350, 420, 1250, 420, 1250, 420,
+    1250, 420, 1250, 1250, 420, 1250, 420, 1250, 420, 420,
+    1250, 1250, 420, 1250, 420, 1250, 420, 1250, 420, 1250,
+    420, 420, 1250, 420, 1250, 420, 1250, 420, 1250, 420,
+    1250, 420, 1250, 1250, 420, 420, 1250, 420, 1250, 420
+};
+static constexpr int kCmdPulse = 41;
+static constexpr uint16_t kShortUs = 420;
+static constexpr uint16_t kLongUs = 1250;
+
+RfBedDriver::RfBedDriver(const BedPins &pins, int txPin) : BedControl(pins), txPin(txPin) {
+    setRelaySink(&RfBedDriver::onRelay, this);
+}
+
+uint8_t RfBedDriver::commandFor(uint8_t motorMask) {
+    static const uint8_t kCodes[4] = { RF_CMD_HEAD_UP, RF_CMD_HEAD_DOWN, RF_CMD_FOOT_UP, RF_CMD_FOOT_DOWN };
+    uint8_t cmd = 0;
+    for (int ch = RELAY_HEAD_UP; ch <= RELAY_FOOT_DOWN; ++ch) {
+        if (motorMask & (1u << ch)) cmd |= kCodes[ch];
+    }
+    return cmd & 0x0F;
+}
+
+void RfBedDriver::encodeFrame(uint8_t cmd, rmt_symbol_word_t *out) {
+    uint16_t us[50];
+    std::memcpy(us, kFrameUs, sizeof(us));
+    for (int i = 0; i < 4; ++i) {
+        const bool one = (cmd >> (3 - i)) & 1;
+        us[kCmdPulse + 2 * i] = one ? kLongUs : kShortUs;
+        us[kCmdPulse + 2 * i + 1] = one ? kShortUs : kLongUs;
+    }
+    for (int s = 0; s < 25; ++s) {
+        out[s].level0 = 0;
+        out[s].duration0 = us[2 * s];
+        out[s].level1 = 1;
+        out[s].duration1 = us[2 * s + 1];
+    }
+    // Split in two: a zero duration would end the loop.
+    out[25].level0 = 0;
+    out[25].duration0 = RF_FRAME_GAP_US / 2;
+    out[25].level1 = 0;
+    out[25].duration1 = RF_FRAME_GAP_US - RF_FRAME_GAP_US / 2;
+}
+
+int32_t RfBedDriver::frameUs() {
+    int32_t total = 0;
+    for (uint16_t us : kFrameUs) total += us;
+    return total;
+}
+
+void RfBedDriver::begin() {
+    initRmt();
+    BedControl::begin();
+}
+
+void RfBedDriver::initRmt() {
+    for (uint8_t cmd = 0; cmd < 16; ++cmd) encodeFrame(cmd, frames[cmd]);
+
+    // A looped transmission must fit in the channel's own memory block.
+    static_assert(kFrameSymbols <= SOC_RMT_MEM_WORDS_PER_CHANNEL, "RF frame does not fit one RMT block");
+    rmt_tx_channel_config_t cfg = {};
+    cfg.gpio_num = (gpio_num_t)txPin;
+    cfg.clk_src = RMT_CLK_SRC_DEFAULT;
+    cfg.resolution_hz = 1000000;
+    cfg.mem_block_symbols = SOC_RMT_MEM_WORDS_PER_CHANNEL;
+    cfg.trans_queue_depth = 1;
+    esp_err_t err = rmt_new_tx_channel(&cfg, &chan);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "RF channel init failed on GPIO %d: %s; the bed will not move", txPin, esp_err_to_name(err));
+        return;
+    }
+    rmt_copy_encoder_config_t enc = {};
+    err = rmt_new_copy_encoder(&enc, &encoder);
+    if (err == ESP_OK) err = rmt_enable(chan);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "RF encoder/enable failed: %s; the bed will not move", esp_err_to_name(err));
+        return;
+    }
+    rfReady = true;
+    ESP_LOGI(TAG, "RF transmitter on GPIO %d (frame %d us + %d us gap)", txPin, (int)frameUs(), RF_FRAME_GAP_US);
+}
+
+// Swaps the looping frame (mutex held). A frame cut short by the swap is
+// dropped by the receiver; the next one starts right away.
+void RfBedDriver::hold(uint8_t cmd) {
+    if (cmd == sending) return;
+    if (!rfReady) return;
+    if (sending != 0) {
+        rmt_disable(chan);   // ends the loop
+        rmt_enable(chan);
+    }
+    sending = cmd;
+    if (cmd == 0) return;
+    rmt_transmit_config_t tx = {};
+    tx.loop_count = -1;
+    if (rmt_transmit(chan, encoder, frames[cmd], sizeof(frames[cmd]), &tx) != ESP_OK) {
+        ESP_LOGW(TAG, "RF transmit failed (cmd %u)", (unsigned)cmd);
+        sending = 0;
+    }
+}
+
+void RfBedDriver::onRelay(void *ctx, RelayChannel ch, bool closed) {
+    if (ch > RELAY_FOOT_DOWN) return;   // no transfer relays on an RF base
+    RfBedDriver *self = static_cast<RfBedDriver*>(ctx);
+    if (closed) self->motorMask |= (uint8_t)(1u << ch);
+    else self->motorMask &= (uint8_t)~(1u << ch);
+    self->hold(commandFor(self->motorMask));
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <stdint.h>
+#include "BedConfig.h"
+#include "BedControl.h"
+#include "driver/rmt_tx.h"
+
+// Backend for a base with no motor wiring: drives it through its own 433 MHz
+// remote (WL102 transmitter), using the frame captured in mb-rf-tx. Motion
+// planning, dead reckoning, presets, queue and journal are BedControl's; only
+// the motor relays are replaced. Whenever the set of closed motor relays
+// changes, the RMT channel starts looping the matching pre-encoded frame in
+// hardware (or goes quiet), so a held command costs no CPU until it ends.
+//
+// The receiver only moves after the first whole frame and keeps going until
+// frames stop, so the axes' start latency should be set to about frameUs()
+// (Bed.Command SET_MOTION_MODEL).
+class RfBedDriver : public BedControl {
+public:
+    static constexpr int kFrameSymbols = 26;   // 25 pulse pairs + inter-frame gap
+
+    explicit RfBedDriver(const BedPins &pins = BedPins::rf(), int txPin = RF_TX_PIN);
+
+    void begin() override;
+
+    // Command nibble for a set of closed motor relays (bit n = RelayChannel n);
+    // 0 = nothing to send.
+    static uint8_t commandFor(uint8_t motorMask);
+    // The captured frame carrying cmd, followed by RF_FRAME_GAP_US idle, as
+    // RMT symbols at 1 tick/us.
+    static void encodeFrame(uint8_t cmd, rmt_symbol_word_t *out);
+    // Frame length up to its last pulse (what the receiver needs to decode it).
+    static int32_t frameUs();
+
+private:
+    const int txPin;
+    rmt_channel_handle_t chan = nullptr;
+    rmt_encoder_handle_t encoder = nullptr;
+    bool rfReady = false;
+    rmt_symbol_word_t frames[16][kFrameSymbols];
+    uint8_t motorMask = 0;      // closed motor relays (mutex held)
+    uint8_t sending = 0;        // command being looped, 0 = quiet
+
+    void initRmt();
+    void hold(uint8_t cmd);
+    static void onRelay(void *ctx, RelayChannel ch, bool closed);
+};
@@ -0,0 +1,446 @@
+#include "TraceBedDriver.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "BED_TRACE";
+
+void TraceBedDriver::begin() {
+    mutex = xSemaphoreCreateMutex();
+    inner->begin();
+}
+
+bool TraceBedDriver::startTrace() {
+    if (!mutex) return false;
+    if (!buf) {
+        buf = static_cast<uint8_t *>(std::malloc(BED_TRACE_BYTES + kReserve));
+        if (!buf) {
+            ESP_LOGE(TAG, "No memory for a %d byte trace", (int)(BED_TRACE_BYTES + kReserve));
+            return false;
+        }
+    }
+    stopTrace();
+
+    // The state a replay starts from, read before anything is recorded.
+    TraceHeader h;
+    BedSnapshot snap;
+    inner->getSnapshot(snap);
+    h.headPosMs = snap.headPosMs;
+    h.footPosMs = snap.footPosMs;
+    h.headMaxMs = snap.headMaxMs;
+    h.footMaxMs = snap.footMaxMs;
+    h.headDir = snap.headDir;
+    h.footDir = snap.footDir;
+    h.headEndStop = snap.headEndStop;
+    h.footEndStop = snap.footEndStop;
+    h.headUncertMs = snap.headUncertMs;
+    h.footUncertMs = snap.footUncertMs;
+    h.headModel = snap.headModel;
+    h.footModel = snap.footModel;
+    h.arrival = snap.arrival;
+    for (int i = 0; i < BED_SAVED_PRESETS; ++i) {
+        PresetEntry p;
+        if (!inner->getPresetById((uint16_t)(i + 1), p)) continue;
+        h.presetHeadMs[i] = p.headMs;
+        h.presetFootMs[i] = p.footMs;
+        h.presetMask |= (uint16_t)(3u << (2 * i));
+    }
+    DebounceStats stats;
+    for (int ch = 0; ch < 4; ++ch) inner->getOptoDebounce(ch, h.debounce[ch], stats);
+    inner->getRemoteGestures(h.gestures);
+    for (int s = 0; s < BED_SCRIPT_SLOTS; ++s) {
+        if (inner->loadScript((uint8_t)s, h.scripts[s])) h.scriptMask |= (uint8_t)(1u << s);
+    }
+    // Positions are live at startUs; the snapshot may be a tick older.
+    inner->getLiveStatus(h.headPosMs, h.footPosMs);
+    h.startUs = esp_timer_get_time();
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    TraceWriter w(buf, BED_TRACE_BYTES);
+    encodeTraceHeader(w, h);
+    len = w.size();
+    startUs = h.startUs;
+    lastUs = h.startUs;
+    records = 0;
+    dropped = 0;
+    lostOptoEvents = 0;
+    optoSeq = inner->optoEventSeq();
+    for (TraceHistogram &hh : hist) hh = TraceHistogram();
+    recording.store(true, std::memory_order_release);
+    xSemaphoreGive(mutex);
+    if (h.headDir != MotionDir::STOPPED || h.footDir != MotionDir::STOPPED) {
+        ESP_LOGW(TAG, "Trace started while moving; a replay starts stopped");
+    }
+    ESP_LOGI(TAG, "Trace started (%d byte buffer)", (int)BED_TRACE_BYTES);
+    return true;
+}
+
+void TraceBedDriver::stopTrace() {
+    if (!recording.load(std::memory_order_acquire)) return;
+    int32_t head = 0, foot = 0;
+    inner->getLiveStatus(head, foot);
+    const int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    recording.store(false, std::memory_order_release);
+    uint8_t args[16];
+    TraceWriter end(args, sizeof(args));
+    end.svar(head);
+    end.svar(foot);
+    append(TraceOp::END, now, 0, args, end.size(), BED_TRACE_BYTES + kReserve);
+    TraceWriter w(buf + len, BED_TRACE_BYTES + kReserve - len);
+    w.u8((uint8_t)TraceOp::STATS);
+    w.svar(0);
+    w.uvar(0);
+    encodeTraceStats(w, hist, dropped, lostOptoEvents);
+    if (w.ok()) len += w.size();
+    const size_t bytes = len;
+    const uint32_t n = records, lost = dropped;
+    xSemaphoreGive(mutex);
+    ESP_LOGI(TAG, "Trace stopped: %u records, %u bytes, %u dropped", (unsigned)n, (unsigned)bytes, (unsigned)lost);
+}
+
+void TraceBedDriver::getTraceStatus(TraceStatus &out) {
+    out = TraceStatus();
+    if (!mutex) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    out.recording = recording.load(std::memory_order_relaxed);
+    out.bytes = len;
+    out.records = records;
+    out.dropped = dropped;
+    xSemaphoreGive(mutex);
+}
+
+size_t TraceBedDriver::readTrace(size_t offset, uint8_t *out, size_t max) {
+    if (!mutex) return 0;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    const size_t n = offset < len ? std::min(max, len - offset) : 0;
+    if (n) std::memcpy(out, buf + offset, n);
+    xSemaphoreGive(mutex);
+    return n;
+}
+
+// Appends one whole record if it fits below limit (mutex held). Once one
+// is dropped the rest are too, so a full trace is a clean prefix that still
+// replays; only END goes in after it (STATS counts the drops).
+void TraceBedDriver::append(TraceOp op, int64_t atUs, uint32_t durUs, const uint8_t *args, size_t argLen,
+                            size_t limit) {
+    uint8_t head[1 + 10 + 5];
+    TraceWriter h(head, sizeof(head));
+    h.u8((uint8_t)op);
+    h.svar(atUs - lastUs);
+    h.uvar(durUs);
+    if ((dropped && op != TraceOp::END) || len + h.size() + argLen > limit) {
+        dropped++;
+        return;
+    }
+    std::memcpy(buf + len, head, h.size());
+    if (argLen) std::memcpy(buf + len + h.size(), args, argLen);
+    len += h.size() + argLen;
+    lastUs = atUs;
+    records++;
+}
+
+// Runs call on the wrapped driver; while recording, books its duration and
+// appends it with the arguments args() writes (after the call, so results
+// can go in too).
+template <typename Call, typename Args>
+void TraceBedDriver::traced(TraceOp op, Call &&call, Args &&args) {
+    if (!recording.load(std::memory_order_acquire)) {
+        call();
+        return;
+    }
+    const int64_t t0 = esp_timer_get_time();
+    call();
+    const uint32_t durUs = (uint32_t)(esp_timer_get_time() - t0);
+    uint8_t rec[kArgsMax];
+    TraceWriter w(rec, sizeof(rec));
+    args(w);
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (recording.load(std::memory_order_relaxed)) {
+        hist[(size_t)op].add(durUs);
+        if (w.ok()) append(op, t0, durUs, rec, w.size(), BED_TRACE_BYTES);
+        else dropped++;
+    }
+    xSemaphoreGive(mutex);
+}
+
+template <typename Call>
+void TraceBedDriver::timed(TraceOp op, Call &&call) {
+    if (!recording.load(std::memory_order_acquire)) {
+        call();
+        return;
+    }
+    const int64_t t0 = esp_timer_get_time();
+    call();
+    const uint32_t durUs = (uint32_t)(esp_timer_get_time() - t0);
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (recording.load(std::memory_order_relaxed)) hist[(size_t)op].add(durUs);
+    xSemaphoreGive(mutex);
+}
+
+// Records the raw edges the driver accepted since the last tick, stamped
+// with their ISR time (motion task, after update()).
+void TraceBedDriver::drainOptoEdges() {
+    OptoEvent events[8];
+    size_t n;
+    while ((n = inner->readOptoEvents(optoSeq, events, 8)) > 0) {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        for (size_t i = 0; i < n; ++i) {
+            const OptoEvent &ev = events[i];
+            if (ev.seq != optoSeq + 1) lostOptoEvents += ev.seq - optoSeq - 1;
+            optoSeq = ev.seq;
+            if (ev.kind != OPTO_EVENT_EDGE || !recording.load(std::memory_order_relaxed)) continue;
+            const uint8_t arg = (uint8_t)(ev.opto << 1 | (ev.level & 1));
+            append(TraceOp::OPTO_EDGE, ev.us, 0, &arg, 1, BED_TRACE_BYTES);
+        }
+        xSemaphoreGive(mutex);
+    }
+}
+
+// --- BedDriver: recorded ---
+
+uint32_t TraceBedDriver::update() {
+    uint32_t sleepMs = 0;
+    traced(TraceOp::UPDATE, [&] { sleepMs = inner->update(); }, [&](TraceWriter &w) { w.uvar(sleepMs); });
+    if (recording.load(std::memory_order_acquire)) drainOptoEdges();
+    return sleepMs;
+}
+
+void TraceBedDriver::attachTask(TaskHandle_t task) { inner->attachTask(task); }
+
+void TraceBedDriver::stop() {
+    traced(TraceOp::STOP, [&] { inner->stop(); }, [](TraceWriter &) {});
+}
+
+void TraceBedDriver::moveHead(MotionDir dir) {
+    traced(TraceOp::MOVE_HEAD, [&] { inner->moveHead(dir); }, [&](TraceWriter &w) { w.svar((int)dir); });
+}
+
+void TraceBedDriver::moveFoot(MotionDir dir) {
+    traced(TraceOp::MOVE_FOOT, [&] { inner->moveFoot(dir); }, [&](TraceWriter &w) { w.svar((int)dir); });
+}
+
+void TraceBedDriver::moveAll(MotionDir dir) {
+    traced(TraceOp::MOVE_ALL, [&] { inner->moveAll(dir); }, [&](TraceWriter &w) { w.svar((int)dir); });
+}
+
+int32_t TraceBedDriver::setTarget(int32_t head, int32_t foot) {
+    int32_t waitMs = 0;
+    traced(TraceOp::SET_TARGET, [&] { waitMs = inner->setTarget(head, foot); },
+           [&](TraceWriter &w) { w.svar(head); w.svar(foot); w.svar(waitMs); });
+    return waitMs;
+}
+
+BedCommandTicket TraceBedDriver::submit(const BedCommand &cmd) {
+    BedCommandTicket ticket;
+    traced(TraceOp::SUBMIT, [&] { ticket = inner->submit(cmd); }, [&](TraceWriter &w) {
+        w.u8((uint8_t)cmd.type);
+        w.svar((int)cmd.dir);
+        w.svar(cmd.headMs);
+        w.svar(cmd.footMs);
+        w.u8(cmd.script);
+        w.uvar(ticket.id);
+    });
+    return ticket;
+}
+
+void TraceBedDriver::setSavedPos(const char* key, int32_t val) {
+    traced(TraceOp::SET_SAVED_POS, [&] { inner->setSavedPos(key, val); },
+           [&](TraceWriter &w) { w.str(key); w.svar(val); });
+}
+
+void TraceBedDriver::setSavedLabel(const char* key, std::string val) {
+    traced(TraceOp::SET_SAVED_LABEL, [&] { inner->setSavedLabel(key, val); },
+           [&](TraceWriter &w) { w.str(key); w.str(val.c_str()); });
+}
+
+uint16_t TraceBedDriver::savePreset(const PresetEntry &preset, int position) {
+    uint16_t id = 0;
+    traced(TraceOp::SAVE_PRESET, [&] { id = inner->savePreset(preset, position); }, [&](TraceWriter &w) {
+        w.uvar(preset.id);
+        w.svar(preset.headMs);
+        w.svar(preset.footMs);
+        w.str(preset.label);
+        w.svar(position);
+        w.uvar(id);
+    });
+    return id;
+}
+
+bool TraceBedDriver::deletePreset(uint16_t id) {
+    bool ok = false;
+    traced(TraceOp::DELETE_PRESET, [&] { ok = inner->deletePreset(id); },
+           [&](TraceWriter &w) { w.uvar(id); w.u8(ok ? 1 : 0); });
+    return ok;
+}
+
+bool TraceBedDriver::saveScript(uint8_t slot, const MotionScript &script) {
+    bool ok = false;
+    traced(TraceOp::SAVE_SCRIPT, [&] { ok = inner->saveScript(slot, script); }, [&](TraceWriter &w) {
+        const uint8_t steps = script.stepCount <= MotionScript::kMaxSteps ? script.stepCount : 0;
+        w.u8(slot);
+        w.u8(steps);
+        w.bytes(script.steps, steps * sizeof(ScriptStep));
+    });
+    return ok;
+}
+
+void TraceBedDriver::clearScript(uint8_t slot) {
+    traced(TraceOp::CLEAR_SCRIPT, [&] { inner->clearScript(slot); }, [&](TraceWriter &w) { w.u8(slot); });
+}
+
+void TraceBedDriver::setLimits(int32_t headMaxMs, int32_t footMaxMs) {
+    traced(TraceOp::SET_LIMITS, [&] { inner->setLimits(headMaxMs, footMaxMs); },
+           [&](TraceWriter &w) { w.svar(headMaxMs); w.svar(footMaxMs); });
+}
+
+void TraceBedDriver::setMotionModel(const AxisMotionModel &head, const AxisMotionModel &foot) {
+    traced(TraceOp::SET_MOTION_MODEL, [&] { inner->setMotionModel(head, foot); }, [&](TraceWriter &w) {
+        for (const AxisMotionModel *m : { &head, &foot }) {
+            w.svar(m->upRatePermille);
+            w.svar(m->downRatePermille);
+            w.svar(m->startLatencyMs);
+            w.svar(m->stopLatencyMs);
+        }
+    });
+}
+
+void TraceBedDriver::setArrivalPolicy(ArrivalPolicy policy) {
+    traced(TraceOp::SET_ARRIVAL, [&] { inner->setArrivalPolicy(policy); },
+           [&](TraceWriter &w) { w.u8((uint8_t)policy); });
+}
+
+void TraceBedDriver::reportMotorCurrent(bool active, int64_t sinceMs) {
+    traced(TraceOp::MOTOR_CURRENT, [&] { inner->reportMotorCurrent(active, sinceMs); },
+           [&](TraceWriter &w) { w.u8(active ? 1 : 0); w.svar(sinceMs - startUs / 1000); });
+}
+
+void TraceBedDriver::reportMotorCurrentMa(int32_t milliamps) {
+    traced(TraceOp::MOTOR_CURRENT_MA, [&] { inner->reportMotorCurrentMa(milliamps); },
+           [&](TraceWriter &w) { w.svar(milliamps); });
+}
+
+bool TraceBedDriver::setOptoDebounce(int ch, DebounceConfig cfg) {
+    bool ok = false;
+    traced(TraceOp::SET_DEBOUNCE, [&] { ok = inner->setOptoDebounce(ch, cfg); },
+           [&](TraceWriter &w) { w.u8((uint8_t)ch); w.u8((uint8_t)cfg.mode); w.uvar(cfg.thresholdMs); });
+    return ok;
+}
+
+void TraceBedDriver::resetOptoDebounceStats() {
+    traced(TraceOp::RESET_DEBOUNCE_STATS, [&] { inner->resetOptoDebounceStats(); }, [](TraceWriter &) {});
+}
+
+bool TraceBedDriver::setRemoteGestures(const GestureMap &map) {
+    bool ok = false;
+    traced(TraceOp::SET_GESTURES, [&] { ok = inner->setRemoteGestures(map); }, [&](TraceWriter &w) {
+        const uint8_t count = map.count <= GestureMap::kMaxBindings ? map.count : 0;
+        w.u8(count);
+        w.bytes(map.bindings, count * sizeof(GestureBinding));
+    });
+    return ok;
+}
+
+// --- BedDriver: timed only ---
+
+void TraceBedDriver::getLiveStatus(int32_t &head, int32_t &foot) {
+    timed(TraceOp::GET_LIVE_STATUS, [&] { inner->getLiveStatus(head, foot); });
+}
+
+int32_t TraceBedDriver::getSavedPos(const char* key, int32_t defaultVal) {
+    int32_t v = 0;
+    timed(TraceOp::GET_SAVED_POS, [&] { v = inner->getSavedPos(key, defaultVal); });
+    return v;
+}
+
+std::string TraceBedDriver::getSavedLabel(const char* key, const char* defaultVal) {
+    std::string v;
+    timed(TraceOp::GET_SAVED_LABEL, [&] { v = inner->getSavedLabel(key, defaultVal); });
+    return v;
+}
+
+size_t TraceBedDriver::listPresets(size_t first, PresetEntry *out, size_t max, PresetStoreInfo &info) {
+    size_t n = 0;
+    timed(TraceOp::LIST_PRESETS, [&] { n = inner->listPresets(first, out, max, info); });
+    return n;
+}
+
+bool TraceBedDriver::getPresetById(uint16_t id, PresetEntry &out) {
+    bool ok = false;
+    timed(TraceOp::GET_PRESET, [&] { ok = inner->getPresetById(id, out); });
+    return ok;
+}
+
+bool TraceBedDriver::loadScript(uint8_t slot, MotionScript &out) {
+    bool ok = false;
+    timed(TraceOp::LOAD_SCRIPT, [&] { ok = inner->loadScript(slot, out); });
+    return ok;
+}
+
+void TraceBedDriver::getLimits(int32_t &headMaxMs, int32_t &footMaxMs) {
+    timed(TraceOp::GET_LIMITS, [&] { inner->getLimits(headMaxMs, footMaxMs); });
+}
+
+void TraceBedDriver::getMotionModel(AxisMotionModel &head, AxisMotionModel &foot) {
+    timed(TraceOp::GET_MOTION_MODEL, [&] { inner->getMotionModel(head, foot); });
+}
+
+ArrivalPolicy TraceBedDriver::getArrivalPolicy() {
+    ArrivalPolicy p = ArrivalPolicy::START_TOGETHER;
+    timed(TraceOp::GET_ARRIVAL, [&] { p = inner->getArrivalPolicy(); });
+    return p;
+}
+
+size_t TraceBedDriver::readTelemetry(uint32_t afterSeq, MoveRecord *out, size_t max) {
+    size_t n = 0;
+    timed(TraceOp::READ_TELEMETRY, [&] { n = inner->readTelemetry(afterSeq, out, max); });
+    return n;
+}
+
+void TraceBedDriver::getMotionDirs(MotionDir &headDir, MotionDir &footDir) {
+    timed(TraceOp::GET_MOTION_DIRS, [&] { inner->getMotionDirs(headDir, footDir); });
+}
+
+void TraceBedDriver::getOptoStates(int &o1, int &o2, int &o3, int &o4) {
+    timed(TraceOp::GET_OPTO_STATES, [&] { inner->getOptoStates(o1, o2, o3, o4); });
+}
+
+void TraceBedDriver::getRemoteEventInfo(int64_t &eventMs, int32_t &debounceMs, int8_t &optoIdx) {
+    timed(TraceOp::GET_REMOTE_EVENT_INFO, [&] { inner->getRemoteEventInfo(eventMs, debounceMs, optoIdx); });
+}
+
+void TraceBedDriver::getOptoRawStates(int &o1, int &o2, int &o3, int &o4) {
+    timed(TraceOp::GET_OPTO_RAW_STATES, [&] { inner->getOptoRawStates(o1, o2, o3, o4); });
+}
+
+void TraceBedDriver::getRemoteEdgeInfo(int64_t &eventMs, int8_t &optoIdx, int8_t &optoState) {
+    timed(TraceOp::GET_REMOTE_EDGE_INFO, [&] { inner->getRemoteEdgeInfo(eventMs, optoIdx, optoState); });
+}
+
+void TraceBedDriver::getOptoDebounce(int ch, DebounceConfig &cfg, DebounceStats &stats) {
+    timed(TraceOp::GET_OPTO_DEBOUNCE, [&] { inner->getOptoDebounce(ch, cfg, stats); });
+}
+
+void TraceBedDriver::getRemoteGestures(GestureMap &out) {
+    timed(TraceOp::GET_REMOTE_GESTURES, [&] { inner->getRemoteGestures(out); });
+}
+
+size_t TraceBedDriver::readOptoEvents(uint32_t afterSeq, OptoEvent *out, size_t max) {
+    size_t n = 0;
+    timed(TraceOp::READ_OPTO_EVENTS, [&] { n = inner->readOptoEvents(afterSeq, out, max); });
+    return n;
+}
+
+uint32_t TraceBedDriver::optoEventSeq() {
+    uint32_t seq = 0;
+    timed(TraceOp::OPTO_EVENT_SEQ, [&] { seq = inner->optoEventSeq(); });
+    return seq;
+}
+
+void TraceBedDriver::getSnapshot(BedSnapshot &out) {
+    timed(TraceOp::GET_SNAPSHOT, [&] { inner->getSnapshot(out); });
+}
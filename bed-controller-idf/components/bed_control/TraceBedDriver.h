@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "BedConfig.h"
+#include "BedDriver.h"
+#include "BedTrace.h"
+
+// What Bed.Command TRACE_START/TRACE_STOP report.
+struct TraceStatus {
+    bool recording = false;
+    size_t bytes = 0;           // trace so far, header included
+    uint32_t records = 0;
+    uint32_t dropped = 0;       // records that no longer fit the buffer
+};
+
+// Decorator that records a session of another BedDriver for replay on a
+// Linux host (tools/bed_sim bed_trace_replay, see docs/bed-trace.md): every
+// state-changing call with its arguments and result, every motion-task tick,
+// and every opto edge the driver accepted, stamped with esp_timer time and
+// how long the call took. Getters are only timed into the per-op histograms.
+// While not recording, calls go straight through after one atomic load.
+//
+// The trace is one linear RAM buffer of BED_TRACE_BYTES, allocated on the
+// first startTrace(); once it is full, later records are counted as dropped
+// (the histograms keep counting). stopTrace() appends END and STATS from a
+// reserve kept for them.
+class TraceBedDriver : public BedDriver {
+public:
+    explicit TraceBedDriver(BedDriver *inner) : inner(inner) {}
+
+    // Starts a new trace from the driver's current state, discarding the
+    // previous one. False if the buffer cannot be allocated.
+    bool startTrace();
+    void stopTrace();
+    void getTraceStatus(TraceStatus &out);
+    // Copies trace bytes from offset; 0 past the end. A trace read while
+    // recording has no END/STATS yet.
+    size_t readTrace(size_t offset, uint8_t *out, size_t max);
+
+    // --- BedDriver ---
+    void begin() override;
+    uint32_t update() override;
+    void attachTask(TaskHandle_t task) override;
+    void stop() override;
+    void moveHead(MotionDir dir) override;
+    void moveFoot(MotionDir dir) override;
+    void moveAll(MotionDir dir) override;
+    int32_t setTarget(int32_t head, int32_t foot) override;
+    BedCommandTicket submit(const BedCommand &cmd) override;
+    void getLiveStatus(int32_t &head, int32_t &foot) override;
+    int32_t getSavedPos(const char* key, int32_t defaultVal) override;
+    void setSavedPos(const char* key, int32_t val) override;
+    std::string getSavedLabel(const char* key, const char* defaultVal) override;
+    void setSavedLabel(const char* key, std::string val) override;
+    size_t listPresets(size_t first, PresetEntry *out, size_t max, PresetStoreInfo &info) override;
+    bool getPresetById(uint16_t id, PresetEntry &out) override;
+    uint16_t savePreset(const PresetEntry &preset, int position) override;
+    bool deletePreset(uint16_t id) override;
+    bool loadScript(uint8_t slot, MotionScript &out) override;
+    bool saveScript(uint8_t slot, const MotionScript &script) override;
+    void clearScript(uint8_t slot) override;
+    void getLimits(int32_t &headMaxMs, int32_t &footMaxMs) override;
+    void setLimits(int32_t headMaxMs, int32_t footMaxMs) override;
+    void getMotionModel(AxisMotionModel &head, AxisMotionModel &foot) override;
+    void setMotionModel(const AxisMotionModel &head, const AxisMotionModel &foot) override;
+    ArrivalPolicy getArrivalPolicy() override;
+    void setArrivalPolicy(ArrivalPolicy policy) override;
+    void reportMotorCurrent(bool active, int64_t sinceMs) override;
+    void reportMotorCurrentMa(int32_t milliamps) override;
+    size_t readTelemetry(uint32_t afterSeq, MoveRecord *out, size_t max) override;
+    void getMotionDirs(MotionDir &headDir, MotionDir &footDir) override;
+    void getOptoStates(int &o1, int &o2, int &o3, int &o4) override;
+    void getRemoteEventInfo(int64_t &eventMs, int32_t &debounceMs, int8_t &optoIdx) override;
+    void getOptoRawStates(int &o1, int &o2, int &o3, int &o4) override;
+    void getRemoteEdgeInfo(int64_t &eventMs, int8_t &optoIdx, int8_t &optoState) override;
+    void getOptoDebounce(int ch, DebounceConfig &cfg, DebounceStats &stats) override;
+    bool setOptoDebounce(int ch, DebounceConfig cfg) override;
+    void resetOptoDebounceStats() override;
+    void getRemoteGestures(GestureMap &out) override;
+    bool setRemoteGestures(const GestureMap &map) override;
+    size_t readOptoEvents(uint32_t afterSeq, OptoEvent *out, size_t max) override;
+    uint32_t optoEventSeq() override;
+    void getSnapshot(BedSnapshot &out) override;
+
+private:
+    // Largest argument block of one record (SET_SAVED_LABEL: two strings).
+    static constexpr size_t kArgsMax = 160;
+    static constexpr size_t kReserve = 32 + TRACE_STATS_MAX_BYTES;   // END + STATS
+
+    BedDriver *const inner;
+    SemaphoreHandle_t mutex = nullptr;
+    std::atomic<bool> recording{false};
+    uint8_t *buf = nullptr;             // BED_TRACE_BYTES + kReserve
+    size_t len = 0;
+    int64_t startUs = 0;                // TraceHeader::startUs
+    int64_t lastUs = 0;                 // time of the previous record
+    uint32_t records = 0;
+    uint32_t dropped = 0;
+    uint32_t lostOptoEvents = 0;        // opto history the recorder fell behind on
+    uint32_t optoSeq = 0;               // last opto event drained
+    TraceHistogram hist[kTraceOpCount];
+
+    template <typename Call, typename Args> void traced(TraceOp op, Call &&call, Args &&args);
+    template <typename Call> void timed(TraceOp op, Call &&call);
+    void append(TraceOp op, int64_t atUs, uint32_t durUs, const uint8_t *args, size_t argLen, size_t limit);
+    void drainOptoEdges();
+};
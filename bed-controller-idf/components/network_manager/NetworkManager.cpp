@@ -17,7 +17,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #if APP_ROLE_BED
-#include "BedDriver.h"
+#include "BedService.h"
+#include "TraceBedDriver.h"
 #endif
 #include "build_info.h"
 #include "driver/gpio.h"
@@ -50,7 +51,7 @@ extern "C" uint32_t addressable_led_get_epoch();
 
 static const char *TAG = "NET_MGR";
 #if APP_ROLE_BED
-extern BedDriver* bedDriver;
+static BedService &bedService = BedService::instance();
 #endif
 
 struct LightWiringPreset {
@@ -221,6 +222,10 @@ static esp_err_t log_stats_handler(httpd_req_t *req);
 static esp_err_t file_server_handler(httpd_req_t *req);
 static esp_err_t rpc_command_handler(httpd_req_t *req);
 static esp_err_t rpc_status_handler(httpd_req_t *req);
+static esp_err_t rpc_telemetry_handler(httpd_req_t *req);
+static esp_err_t rpc_trace_handler(httpd_req_t *req);
+static esp_err_t rpc_debounce_handler(httpd_req_t *req);
+static esp_err_t rpc_preset_handler(httpd_req_t *req);
 static esp_err_t rpc_events_handler(httpd_req_t *req);
 static esp_err_t light_command_handler(httpd_req_t *req);
 static esp_err_t light_status_handler(httpd_req_t *req);
@@ -1816,6 +1821,13 @@ static const httpd_uri_t URI_SW     = { .uri = "/sw.js", .method = HTTP_GET, .ha
 static const httpd_uri_t URI_BRAND  = { .uri = "/branding.json", .method = HTTP_GET, .handler = file_server_handler, .user_ctx = NULL };
 static const httpd_uri_t URI_CMD    = { .uri = "/rpc/Bed.Command", .method = HTTP_POST, .handler = rpc_command_handler, .user_ctx = NULL };
 static const httpd_uri_t URI_STATUS = { .uri = "/rpc/Bed.Status",  .method = HTTP_POST, .handler = rpc_status_handler,  .user_ctx = NULL };
+static const httpd_uri_t URI_TELEMETRY = { .uri = "/rpc/Bed.Telemetry", .method = HTTP_GET, .handler = rpc_telemetry_handler, .user_ctx = NULL };
+static const httpd_uri_t URI_TRACE = { .uri = "/rpc/Bed.Trace", .method = HTTP_GET, .handler = rpc_trace_handler, .user_ctx = NULL };
+static const httpd_uri_t URI_DEBOUNCE_GET = { .uri = "/rpc/Bed.Debounce", .method = HTTP_GET, .handler = rpc_debounce_handler, .user_ctx = NULL };
+static const httpd_uri_t URI_DEBOUNCE_SET = { .uri = "/rpc/Bed.Debounce", .method = HTTP_POST, .handler = rpc_debounce_handler, .user_ctx = NULL };
+// One wildcard pair for Bed.Preset.List/Apply/Save/Delete; max_uri_handlers has little room left.
+static const httpd_uri_t URI_PRESET_GET = { .uri = "/rpc/Bed.Preset.*", .method = HTTP_GET, .handler = rpc_preset_handler, .user_ctx = NULL };
+static const httpd_uri_t URI_PRESET_SET = { .uri = "/rpc/Bed.Preset.*", .method = HTTP_POST, .handler = rpc_preset_handler, .user_ctx = NULL };
 static const httpd_uri_t URI_EVENTS = { .uri = "/rpc/Events", .method = HTTP_GET, .handler = rpc_events_handler, .user_ctx = NULL };
 static const httpd_uri_t URI_LIGHT_CMD = { .uri = "/rpc/Light.Command", .method = HTTP_POST, .handler = light_command_handler, .user_ctx = NULL };
 static const httpd_uri_t URI_LIGHT_STATUS = { .uri = "/rpc/Light.Status", .method = HTTP_POST, .handler = light_status_handler, .user_ctx = NULL };
@@ -4041,6 +4053,117 @@ static esp_err_t ota_upload_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+#if APP_ROLE_BED
+// Motion script JSON <-> MotionScript. Times in seconds like the rest of
+// Bed.Command; a step is one of
+//   {"head":10,"foot":20}   move (either axis may be omitted = keep)
+//   {"wait":2}              pause
+//   {"loop":3,"to":2}       jump back to step 2, 3 more times
+static bool script_from_json(cJSON *steps, MotionScript &out) {
+    if (!cJSON_IsArray(steps)) return false;
+    out = MotionScript{};
+    auto toMs = [](cJSON *it, uint16_t &ms) {
+        if (!cJSON_IsNumber(it) || it->valuedouble < 0 || it->valuedouble * 1000.0 >= SCRIPT_KEEP) return false;
+        ms = (uint16_t)(it->valuedouble * 1000.0 + 0.5);
+        return true;
+    };
+    cJSON *step = nullptr;
+    cJSON_ArrayForEach(step, steps) {
+        if (out.stepCount >= MotionScript::kMaxSteps) return false;
+        ScriptStep &s = out.steps[out.stepCount++];
+        s.headMs = s.footMs = SCRIPT_KEEP;
+        cJSON *wait = cJSON_GetObjectItem(step, "wait");
+        cJSON *loop = cJSON_GetObjectItem(step, "loop");
+        if (wait) {
+            s.op = ScriptOp::WAIT;
+            if (!toMs(wait, s.headMs)) return false;
+        } else if (loop) {
+            cJSON *to = cJSON_GetObjectItem(step, "to");
+            if (!cJSON_IsNumber(loop) || !cJSON_IsNumber(to) || loop->valueint < 0 || loop->valueint > 254 || to->valueint < 0) return false;
+            s.op = ScriptOp::LOOP;
+            s.count = (uint8_t)loop->valueint;
+            s.headMs = (uint16_t)to->valueint;
+        } else {
+            s.op = ScriptOp::MOVE;
+            cJSON *head = cJSON_GetObjectItem(step, "head");
+            cJSON *foot = cJSON_GetObjectItem(step, "foot");
+            if (!head && !foot) return false;
+            if (head && !toMs(head, s.headMs)) return false;
+            if (foot && !toMs(foot, s.footMs)) return false;
+        }
+    }
+    return out.valid();
+}
+
+static void script_add_json(cJSON *res, int slot, const MotionScript &script) {
+    cJSON *obj = cJSON_AddObjectToObject(res, "script");
+    cJSON_AddNumberToObject(obj, "slot", slot);
+    cJSON *steps = cJSON_AddArrayToObject(obj, "steps");
+    for (uint8_t i = 0; i < script.stepCount; ++i) {
+        const ScriptStep &s = script.steps[i];
+        cJSON *step = cJSON_CreateObject();
+        if (s.op == ScriptOp::WAIT) {
+            cJSON_AddNumberToObject(step, "wait", s.headMs / 1000.0);
+        } else if (s.op == ScriptOp::LOOP) {
+            cJSON_AddNumberToObject(step, "loop", s.count);
+            cJSON_AddNumberToObject(step, "to", s.headMs);
+        } else {
+            if (s.headMs != SCRIPT_KEEP) cJSON_AddNumberToObject(step, "head", s.headMs / 1000.0);
+            if (s.footMs != SCRIPT_KEEP) cJSON_AddNumberToObject(step, "foot", s.footMs / 1000.0);
+        }
+        cJSON_AddItemToArray(steps, step);
+    }
+}
+
+// Remote gesture binding JSON <-> GestureBinding, e.g.
+//   {"buttons":["HEAD_DOWN"],"gesture":"DOUBLE_TAP","action":"FLAT"}
+//   {"buttons":["HEAD_UP","FOOT_UP"],"gesture":"HOLD","ms":2000,"action":"ZERO_G"}
+//   {"buttons":["FOOT_DOWN"],"gesture":"TRIPLE_TAP","action":"SCRIPT","script":1}
+static bool gestures_from_json(cJSON *items, GestureMap &out) {
+    if (!cJSON_IsArray(items)) return false;
+    out = GestureMap{};
+    cJSON *item = nullptr;
+    cJSON_ArrayForEach(item, items) {
+        if (out.count >= GestureMap::kMaxBindings) return false;
+        GestureBinding &b = out.bindings[out.count++];
+        cJSON *buttons = cJSON_GetObjectItem(item, "buttons");
+        cJSON *gesture = cJSON_GetObjectItem(item, "gesture");
+        cJSON *action = cJSON_GetObjectItem(item, "action");
+        if (!cJSON_IsArray(buttons) || !cJSON_IsString(gesture) || !cJSON_IsString(action)) return false;
+        cJSON *btn = nullptr;
+        cJSON_ArrayForEach(btn, buttons) {
+            uint8_t bit = 0;
+            if (!cJSON_IsString(btn) || !remoteButtonFromName(btn->valuestring, bit)) return false;
+            b.buttons |= bit;
+        }
+        if (!gestureKindFromName(gesture->valuestring, b.kind)) return false;
+        if (!gestureActionFromName(action->valuestring, b.action)) return false;
+        if (b.kind == GestureKind::HOLD) {
+            cJSON *ms = cJSON_GetObjectItem(item, "ms");
+            if (!cJSON_IsNumber(ms) || ms->valueint < 0 || ms->valueint > UINT16_MAX) return false;
+            b.holdMs = (uint16_t)ms->valueint;
+        }
+        if (b.action == GestureAction::SCRIPT) {
+            cJSON *slot = cJSON_GetObjectItem(item, "script");
+            if (!cJSON_IsNumber(slot) || slot->valueint < 0 || slot->valueint > UINT8_MAX) return false;
+            b.script = (uint8_t)slot->valueint;
+        }
+    }
+    return out.valid(BED_SCRIPT_SLOTS);
+}
+
+static void gesture_add_json(cJSON *obj, const GestureBinding &b) {
+    cJSON *buttons = cJSON_AddArrayToObject(obj, "buttons");
+    for (int i = 0; i < 4; ++i) {
+        if (b.buttons & (1u << i)) cJSON_AddItemToArray(buttons, cJSON_CreateString(remoteButtonName(i)));
+    }
+    cJSON_AddStringToObject(obj, "gesture", gestureKindName(b.kind));
+    if (b.kind == GestureKind::HOLD) cJSON_AddNumberToObject(obj, "ms", b.holdMs);
+    cJSON_AddStringToObject(obj, "action", gestureActionName(b.action));
+    if (b.action == GestureAction::SCRIPT) cJSON_AddNumberToObject(obj, "script", b.script);
+}
+#endif
+
 static esp_err_t rpc_command_handler(httpd_req_t *req) {
 #if !APP_ROLE_BED
     add_cors(req);
@@ -4048,7 +4171,7 @@ static esp_err_t rpc_command_handler(httpd_req_t *req) {
     return ESP_OK;
 #else
     add_cors(req);
-    char buf[512];
+    char buf[1024];   // SET_SCRIPT and SET_GESTURES bodies run to ~600-700 bytes
     int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
     if (ret <= 0) {
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No body");
@@ -4075,61 +4198,182 @@ static esp_err_t rpc_command_handler(httpd_req_t *req) {
 
     std::string cmd = cmdItem->valuestring;
     std::string label = (cJSON_IsString(lblItem)) ? lblItem->valuestring : "";
+
+    // Split king: {"bed":1} addresses the second base (default 0). While the
+    // beds are linked, motion commands move both.
+    cJSON *bedItem = cJSON_GetObjectItem(root, "bed");
+    const int bed = cJSON_IsNumber(bedItem) ? bedItem->valueint : 0;
+    if (!bedService.validBed(bed)) {
+        cJSON_Delete(root);
+        return httpd_send_json_error(req, "400 Bad Request", "Unknown bed");
+    }
     
     long maxWait = 0;
     std::string savedSlot = ""; // Track which slot was modified
+    int scriptSlot = -1;        // SET/GET/RUN_SCRIPT: echo the script back
+    const char *cmdError = nullptr;
+
+    // Motion commands are queued for the motion task so this httpd worker
+    // never waits on the motion mutex, relays or NVS; the reply carries the
+    // command id and the predicted completion instead.
+    BedCommandTicket ticket;
+    bool queued = false;
+    auto queueMotion = [&](BedCommandType type, MotionDir dir = MotionDir::STOPPED, int32_t headMs = 0, int32_t footMs = 0) {
+        BedCommand bc;
+        bc.type = type;
+        bc.dir = dir;
+        bc.headMs = headMs;
+        bc.footMs = footMs;
+        ticket = bedService.submit(bc, bed);
+        maxWait = ticket.durationMs;
+        queued = true;
+    };
+    // Saved presets come from BedService's cache, not NVS.
+    auto queuePreset = [&](const char *slot) {
+        PresetView p;
+        bedService.getPreset(BedService::presetSlotIndex(slot), p, bed);
+        queueMotion(BedCommandType::SET_TARGET, MotionDir::STOPPED, p.headMs, p.footMs);
+    };
 
     int32_t headMaxMs = 0, footMaxMs = 0;
-    bedDriver->getLimits(headMaxMs, footMaxMs);
+    bedService.getLimits(headMaxMs, footMaxMs, bed);
 
     const int64_t now_ms = esp_timer_get_time() / 1000;
     ESP_LOGI(TAG, "Bed.Command recv cmd=%s label=%s ts=%lld", cmd.c_str(), label.c_str(), (long long)now_ms);
 
     // --- COMMAND LOGIC ---
-    if (cmd == "STOP") { bedDriver->stop(); activeCommandLog = "IDLE"; } 
-    else if (cmd == "HEAD_UP") { bedDriver->moveHead("UP"); activeCommandLog = "HEAD_UP"; }
-    else if (cmd == "HEAD_DOWN") { bedDriver->moveHead("DOWN"); activeCommandLog = "HEAD_DOWN"; }
-    else if (cmd == "FOOT_UP") { bedDriver->moveFoot("UP"); activeCommandLog = "FOOT_UP"; }
-    else if (cmd == "FOOT_DOWN") { bedDriver->moveFoot("DOWN"); activeCommandLog = "FOOT_DOWN"; }
-    else if (cmd == "ALL_UP") { bedDriver->moveAll("UP"); activeCommandLog = "ALL_UP"; }
-    else if (cmd == "ALL_DOWN") { bedDriver->moveAll("DOWN"); activeCommandLog = "ALL_DOWN"; }
+    if (cmd == "STOP") { queueMotion(BedCommandType::STOP); activeCommandLog = "IDLE"; } 
+    else if (cmd == "HEAD_UP") { queueMotion(BedCommandType::MOVE_HEAD, MotionDir::UP); activeCommandLog = "HEAD_UP"; }
+    else if (cmd == "HEAD_DOWN") { queueMotion(BedCommandType::MOVE_HEAD, MotionDir::DOWN); activeCommandLog = "HEAD_DOWN"; }
+    else if (cmd == "FOOT_UP") { queueMotion(BedCommandType::MOVE_FOOT, MotionDir::UP); activeCommandLog = "FOOT_UP"; }
+    else if (cmd == "FOOT_DOWN") { queueMotion(BedCommandType::MOVE_FOOT, MotionDir::DOWN); activeCommandLog = "FOOT_DOWN"; }
+    else if (cmd == "ALL_UP") { queueMotion(BedCommandType::MOVE_ALL, MotionDir::UP); activeCommandLog = "ALL_UP"; }
+    else if (cmd == "ALL_DOWN") { queueMotion(BedCommandType::MOVE_ALL, MotionDir::DOWN); activeCommandLog = "ALL_DOWN"; }
     
     // Fixed Presets
-    else if (cmd == "FLAT") { maxWait = bedDriver->setTarget(0, 0); activeCommandLog = "FLAT"; }
-    else if (cmd == "MAX") { maxWait = bedDriver->setTarget(headMaxMs, footMaxMs); activeCommandLog = "MAX"; }
+    else if (cmd == "FLAT") { queueMotion(BedCommandType::SET_TARGET, MotionDir::STOPPED, 0, 0); activeCommandLog = "FLAT"; }
+    else if (cmd == "MAX") { queueMotion(BedCommandType::SET_TARGET, MotionDir::STOPPED, headMaxMs, footMaxMs); activeCommandLog = "MAX"; }
 
     else if (cmd == "SET_LIMITS") {
         int32_t newHeadMs = headMaxMs;
         int32_t newFootMs = footMaxMs;
         if (cJSON_IsNumber(headMaxItem)) newHeadMs = (int32_t)(headMaxItem->valuedouble * 1000);
         if (cJSON_IsNumber(footMaxItem)) newFootMs = (int32_t)(footMaxItem->valuedouble * 1000);
-        bedDriver->setLimits(newHeadMs, newFootMs);
-        bedDriver->getLimits(headMaxMs, footMaxMs);
+        bedService.setLimits(newHeadMs, newFootMs, bed);
+        bedService.getLimits(headMaxMs, footMaxMs, bed);
         activeCommandLog = "SET_LIMITS";
     }
+
+    // Motion model: rates are ratios (travel per relay-on time, 1.0 = nominal),
+    // latencies in ms. Omitted fields keep their current value.
+    else if (cmd == "SET_MOTION_MODEL") {
+        AxisMotionModel hm, fm;
+        bedService.getMotionModel(hm, fm, bed);
+        auto readRate = [root](const char *key, int32_t &out) {
+            cJSON *it = cJSON_GetObjectItem(root, key);
+            if (cJSON_IsNumber(it)) out = (int32_t)(it->valuedouble * 1000.0 + 0.5);
+        };
+        auto readMs = [root](const char *key, int32_t &out) {
+            cJSON *it = cJSON_GetObjectItem(root, key);
+            if (cJSON_IsNumber(it)) out = (int32_t)it->valuedouble;
+        };
+        readRate("headUpRate", hm.upRatePermille);
+        readRate("headDownRate", hm.downRatePermille);
+        readMs("headStartMs", hm.startLatencyMs);
+        readMs("headStopMs", hm.stopLatencyMs);
+        readRate("footUpRate", fm.upRatePermille);
+        readRate("footDownRate", fm.downRatePermille);
+        readMs("footStartMs", fm.startLatencyMs);
+        readMs("footStopMs", fm.stopLatencyMs);
+        bedService.setMotionModel(hm, fm, bed);
+        activeCommandLog = "SET_MOTION_MODEL";
+    }
+    // Preset leg scheduling: {"arrival":"ARRIVE_TOGETHER"} (see ArrivalPolicy)
+    else if (cmd == "SET_ARRIVAL") {
+        cJSON *arrivalItem = cJSON_GetObjectItem(root, "arrival");
+        ArrivalPolicy policy;
+        if (!cJSON_IsString(arrivalItem) || !arrivalPolicyFromName(arrivalItem->valuestring, policy)) {
+            cmdError = "Invalid arrival policy";
+        } else {
+            bedService.setArrivalPolicy(policy, bed);
+        }
+        activeCommandLog = "SET_ARRIVAL";
+    }
+    // Split king: {"linked":true} moves both bases in lockstep
+    else if (cmd == "SET_LINKED") {
+        cJSON *linkedItem = cJSON_GetObjectItem(root, "linked");
+        if (!cJSON_IsBool(linkedItem)) cmdError = "Missing linked";
+        else if (!bedService.setLinked(cJSON_IsTrue(linkedItem))) cmdError = "Only one bed";
+        activeCommandLog = "SET_LINKED";
+    }
+    // Remote gestures: {"gestures":[...]} replaces the whole table (see
+    // gestures_from_json); GESTURES reads it. Both echo "gestures".
+    else if (cmd == "SET_GESTURES") {
+        GestureMap map;
+        if (!gestures_from_json(cJSON_GetObjectItem(root, "gestures"), map)) cmdError = "Invalid gestures";
+        else if (!bedService.setRemoteGestures(map, bed)) cmdError = "Gesture save failed";
+        activeCommandLog = "SET_GESTURES";
+    }
+    // Call trace for replay on a host: TRACE_START, reproduce the problem,
+    // TRACE_STOP, then GET /rpc/Bed.Trace. Both echo "trace".
+    else if (cmd == "TRACE_START") {
+        if (!bedService.startTrace(bed)) cmdError = "Trace unavailable";
+        activeCommandLog = "TRACE_START";
+    }
+    else if (cmd == "TRACE_STOP") {
+        bedService.stopTrace(bed);
+        activeCommandLog = "TRACE_STOP";
+    }
     
     // Saved Presets
     else if (cmd == "ZERO_G") {
-        maxWait = bedDriver->setTarget(bedDriver->getSavedPos("zg_head", 10000), bedDriver->getSavedPos("zg_foot", 40000));
+        queuePreset("zg");
         activeCommandLog = "ZERO_G";
     }
     else if (cmd == "ANTI_SNORE") {
-        maxWait = bedDriver->setTarget(bedDriver->getSavedPos("snore_head", 10000), bedDriver->getSavedPos("snore_foot", 0));
+        queuePreset("snore");
         activeCommandLog = "ANTI_SNORE";
     }
     else if (cmd == "LEGS_UP") {
-        maxWait = bedDriver->setTarget(bedDriver->getSavedPos("legs_head", 0), bedDriver->getSavedPos("legs_foot", 43000));
+        queuePreset("legs");
         activeCommandLog = "LEGS_UP";
     }
     else if (cmd == "P1") {
-        maxWait = bedDriver->setTarget(bedDriver->getSavedPos("p1_head", 0), bedDriver->getSavedPos("p1_foot", 0));
+        queuePreset("p1");
         activeCommandLog = "P1";
     }
     else if (cmd == "P2") {
-        maxWait = bedDriver->setTarget(bedDriver->getSavedPos("p2_head", 0), bedDriver->getSavedPos("p2_foot", 0));
+        queuePreset("p2");
         activeCommandLog = "P2";
     }
 
+    // Motion scripts: {"cmd":"SET_SCRIPT","script":0,"steps":[...]}, then
+    // RUN_SCRIPT / GET_SCRIPT / CLEAR_SCRIPT with {"script":0}.
+    else if (cmd == "SET_SCRIPT" || cmd == "RUN_SCRIPT" || cmd == "GET_SCRIPT" || cmd == "CLEAR_SCRIPT") {
+        cJSON *slotItem = cJSON_GetObjectItem(root, "script");
+        if (!cJSON_IsNumber(slotItem) || slotItem->valueint < 0 || slotItem->valueint >= BED_SCRIPT_SLOTS) {
+            cmdError = "Invalid script slot";
+        } else if (cmd == "SET_SCRIPT") {
+            MotionScript script;
+            if (!script_from_json(cJSON_GetObjectItem(root, "steps"), script)) cmdError = "Invalid script steps";
+            else if (!bedService.saveScript((uint8_t)slotItem->valueint, script, bed)) cmdError = "Script save failed";
+            else scriptSlot = slotItem->valueint;
+        } else if (cmd == "RUN_SCRIPT") {
+            BedCommand bc;
+            bc.type = BedCommandType::RUN_SCRIPT;
+            bc.script = (uint8_t)slotItem->valueint;
+            ticket = bedService.submit(bc, bed);
+            maxWait = ticket.durationMs;
+            queued = true;
+            scriptSlot = slotItem->valueint;
+        } else if (cmd == "GET_SCRIPT") {
+            scriptSlot = slotItem->valueint;
+        } else {
+            bedService.clearScript((uint8_t)slotItem->valueint, bed);
+        }
+        activeCommandLog = cmd;
+    }
+
     // --- SAVE LOGIC ---
     else if (cmd.find("SET_") == 0) {
         // Example: SET_P1_POS or SET_ZG_LABEL
@@ -4141,45 +4385,69 @@ static esp_err_t rpc_command_handler(httpd_req_t *req) {
         if (endPos != std::string::npos) {
             std::string slot = cmd.substr(4, endPos - 4);
             std::transform(slot.begin(), slot.end(), slot.begin(), ::tolower); // p1
-            savedSlot = slot;
-
-            if (cmd.find("_POS") != std::string::npos) {
-                int32_t h, f;
-                bedDriver->getLiveStatus(h, f);
-                bedDriver->setSavedPos((slot + "_head").c_str(), h);
-                bedDriver->setSavedPos((slot + "_foot").c_str(), f);
-            } 
-            else if (cmd.find("_LABEL") != std::string::npos) {
-                // FIX: Now actually saving the label to NVS
-                bedDriver->setSavedLabel((slot + "_label").c_str(), label);
+            const int i = BedService::presetSlotIndex(slot.c_str());
+            if (i < 0) {
+                cmdError = "Unknown preset slot";
+            } else {
+                savedSlot = slot;
+                PresetView p;
+                bedService.getPreset(i, p, bed);
+                if (cmd.find("_POS") != std::string::npos) {
+                    bedService.getLiveStatus(p.headMs, p.footMs, bed);
+                } else {
+                    snprintf(p.label, sizeof(p.label), "%s", label.c_str());
+                }
+                bedService.setPreset(i, p, bed);
             }
         }
     }
     
     // --- RESET LOGIC ---
     else if (cmd.find("RESET_") == 0) {
-        std::string slot = cmd.substr(6); // Reset RESET_P1 -> P1
+        // RESET_P1_POS / RESET_ZG_LABEL (what the UI sends) or RESET_P1 for both.
+        std::string slot = cmd.substr(6);
+        const bool resetLabel = slot.size() > 6 && slot.compare(slot.size() - 6, 6, "_LABEL") == 0;
+        const bool resetPos = slot.size() > 4 && slot.compare(slot.size() - 4, 4, "_POS") == 0;
+        if (resetLabel || resetPos) slot.erase(slot.size() - (resetLabel ? 6 : 4));
         std::transform(slot.begin(), slot.end(), slot.begin(), ::tolower);
-        savedSlot = slot;
-        
-        bedDriver->setSavedPos((slot + "_head").c_str(), 0);
-        bedDriver->setSavedPos((slot + "_foot").c_str(), 0);
-        
-        // Restore Default Labels
-        std::string defLbl = "Preset";
-        if(slot=="zg") defLbl="Zero G"; else if(slot=="snore") defLbl="Anti-Snore"; 
-        else if(slot=="legs") defLbl="Legs Up"; else if(slot=="p1") defLbl="P1"; else if(slot=="p2") defLbl="P2";
-        
-        bedDriver->setSavedLabel((slot + "_label").c_str(), defLbl);
+        const int i = BedService::presetSlotIndex(slot.c_str());
+        if (i < 0) {
+            cmdError = "Unknown preset slot";
+        } else {
+            savedSlot = slot;
+            const PresetView &def = PresetTable::factory(i);
+            PresetView p;
+            bedService.getPreset(i, p, bed);
+            if (!resetLabel) {
+                p.headMs = def.headMs;
+                p.footMs = def.footMs;
+            }
+            if (!resetPos) memcpy(p.label, def.label, sizeof(p.label));
+            bedService.setPreset(i, p, bed);
+        }
     }
 
     cJSON_Delete(root);
 
+    if (cmdError) {
+        return httpd_send_json_error(req, "400 Bad Request", cmdError);
+    }
+    if (queued && ticket.id == 0) {
+        return httpd_send_json_error(req, "503 Service Unavailable", "Command queue full");
+    }
+
     // --- BUILD RESPONSE ---
     cJSON *res = cJSON_CreateObject();
 
     int32_t h, f;
-    bedDriver->getLiveStatus(h, f);
+    if (queued) {
+        BedSnapshot snap;
+        bedService.getSnapshot(snap, bed);
+        h = snap.headPosMs;
+        f = snap.footPosMs;
+    } else {
+        bedService.getLiveStatus(h, f, bed);
+    }
 
     // Boot Time
     time_t now;
@@ -4193,9 +4461,61 @@ static esp_err_t rpc_command_handler(httpd_req_t *req) {
     cJSON_AddNumberToObject(res, "headPos", h / 1000.0);
     cJSON_AddNumberToObject(res, "footPos", f / 1000.0);
     cJSON_AddNumberToObject(res, "maxWait", maxWait);
+    if (queued) {
+        cJSON_AddNumberToObject(res, "cmdId", (double)ticket.id);
+        cJSON_AddNumberToObject(res, "etaMs", (double)ticket.etaMs);
+    }
     cJSON_AddNumberToObject(res, "headMax", headMaxMs / 1000.0);
     cJSON_AddNumberToObject(res, "footMax", footMaxMs / 1000.0);
+    if (bedService.bedCount() > 1) {
+        cJSON_AddNumberToObject(res, "bed", bed);
+        cJSON_AddBoolToObject(res, "linked", bedService.linked());
+    }
+
+    if (cmd == "SET_MOTION_MODEL" || cmd == "MOTION_MODEL") {
+        AxisMotionModel hm, fm;
+        bedService.getMotionModel(hm, fm, bed);
+        cJSON *model = cJSON_AddObjectToObject(res, "model");
+        cJSON_AddNumberToObject(model, "headUpRate", hm.upRatePermille / 1000.0);
+        cJSON_AddNumberToObject(model, "headDownRate", hm.downRatePermille / 1000.0);
+        cJSON_AddNumberToObject(model, "headStartMs", hm.startLatencyMs);
+        cJSON_AddNumberToObject(model, "headStopMs", hm.stopLatencyMs);
+        cJSON_AddNumberToObject(model, "footUpRate", fm.upRatePermille / 1000.0);
+        cJSON_AddNumberToObject(model, "footDownRate", fm.downRatePermille / 1000.0);
+        cJSON_AddNumberToObject(model, "footStartMs", fm.startLatencyMs);
+        cJSON_AddNumberToObject(model, "footStopMs", fm.stopLatencyMs);
+    }
+    
+    if (cmd == "TRACE_START" || cmd == "TRACE_STOP") {
+        TraceStatus ts;
+        bedService.getTraceStatus(ts, bed);
+        cJSON *trace = cJSON_AddObjectToObject(res, "trace");
+        cJSON_AddBoolToObject(trace, "recording", ts.recording);
+        cJSON_AddNumberToObject(trace, "bytes", (double)ts.bytes);
+        cJSON_AddNumberToObject(trace, "records", (double)ts.records);
+        cJSON_AddNumberToObject(trace, "dropped", (double)ts.dropped);
+    }
+
+    if (cmd == "SET_ARRIVAL" || cmd == "ARRIVAL") {
+        cJSON_AddStringToObject(res, "arrival", arrivalPolicyName(bedService.getArrivalPolicy(bed)));
+    }
+
+    if (cmd == "SET_GESTURES" || cmd == "GESTURES") {
+        GestureMap map;
+        bedService.getRemoteGestures(map, bed);
+        cJSON *list = cJSON_AddArrayToObject(res, "gestures");
+        for (uint8_t i = 0; i < map.count; ++i) {
+            cJSON *item = cJSON_CreateObject();
+            gesture_add_json(item, map.bindings[i]);
+            cJSON_AddItemToArray(list, item);
+        }
+    }
     
+    if (scriptSlot >= 0) {
+        MotionScript script;
+        if (bedService.loadScript((uint8_t)scriptSlot, script, bed)) script_add_json(res, scriptSlot, script);
+    }
+
     // FIX: Send back the saved data so the UI updates immediately
     if (!savedSlot.empty()) {
         // JS looks for 'saved_label' or 'saved_pos' to trigger updates
@@ -4205,10 +4525,12 @@ static esp_err_t rpc_command_handler(httpd_req_t *req) {
              cJSON_AddStringToObject(res, "saved_pos", savedSlot.c_str());
         }
         
-        // Fetch the NEW values from NVS to confirm they stuck
-        cJSON_AddNumberToObject(res, (savedSlot + "_head").c_str(), bedDriver->getSavedPos((savedSlot+"_head").c_str(), 0));
-        cJSON_AddNumberToObject(res, (savedSlot + "_foot").c_str(), bedDriver->getSavedPos((savedSlot+"_foot").c_str(), 0));
-        cJSON_AddStringToObject(res, (savedSlot + "_label").c_str(), bedDriver->getSavedLabel((savedSlot+"_label").c_str(), "Preset").c_str());
+        // Send back the stored values to confirm they stuck
+        PresetView p;
+        bedService.getPreset(BedService::presetSlotIndex(savedSlot.c_str()), p, bed);
+        cJSON_AddNumberToObject(res, (savedSlot + "_head").c_str(), p.headMs);
+        cJSON_AddNumberToObject(res, (savedSlot + "_foot").c_str(), p.footMs);
+        cJSON_AddStringToObject(res, (savedSlot + "_label").c_str(), p.label);
     }
 
     char *jsonStr = cJSON_PrintUnformatted(res);
@@ -4222,6 +4544,18 @@ static esp_err_t rpc_command_handler(httpd_req_t *req) {
 #endif
 }
 
+#if APP_ROLE_BED
+// Split king: the base a Bed.* request addresses via ?bed=N (default 0, -1
+// if there is no such bed).
+static int bed_from_query(httpd_req_t *req) {
+    int bed = 0;
+    const char *q = strchr(req->uri, '?');
+    char param[8] = {};
+    if (q && httpd_query_key_value(q + 1, "bed", param, sizeof(param)) == ESP_OK) bed = atoi(param);
+    return bedService.validBed(bed) ? bed : -1;
+}
+#endif
+
 static esp_err_t rpc_status_handler(httpd_req_t *req) {
 #if !APP_ROLE_BED
     add_cors(req);
@@ -4229,20 +4563,26 @@ static esp_err_t rpc_status_handler(httpd_req_t *req) {
     return ESP_OK;
 #else
     add_cors(req);
+    // Split king: ?bed=1 or {"bed":1} reads the second base (default 0).
+    int bed = bed_from_query(req);
+    if (bed == 0 && req->content_len > 0) {
+        char buf[64] = {};
+        int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+        cJSON *body = ret > 0 ? cJSON_Parse(buf) : nullptr;
+        cJSON *bedItem = cJSON_GetObjectItem(body, "bed");
+        if (cJSON_IsNumber(bedItem)) bed = bedService.validBed(bedItem->valueint) ? bedItem->valueint : -1;
+        cJSON_Delete(body);
+    }
+    if (bed < 0) {
+        return httpd_send_json_error(req, "400 Bad Request", "Unknown bed");
+    }
     cJSON *res = cJSON_CreateObject();
 
-    int32_t h, f;
-    bedDriver->getLiveStatus(h, f);
-    std::string hDir = "STOPPED", fDir = "STOPPED";
-    bedDriver->getMotionDirs(hDir, fDir);
-    int o1=1,o2=1,o3=1,o4=1;
-    bedDriver->getOptoStates(o1,o2,o3,o4);
-    int64_t remoteEventMs = 0;
-    int32_t remoteDebounceMs = 0;
-    int8_t remoteOptoIdx = -1;
-    bedDriver->getRemoteEventInfo(remoteEventMs, remoteDebounceMs, remoteOptoIdx);
-    int32_t headMaxMs = 0, footMaxMs = 0;
-    bedDriver->getLimits(headMaxMs, footMaxMs);
+    // One lock-free view (snapshot + cached preset store info) instead of a
+    // mutex round-trip per field and an NVS read per preset key.
+    StatusView view;
+    bedService.getStatusView(view, bed);
+    const BedSnapshot &snap = view.snap;
 
     time_t now;
     time(&now);
@@ -4259,40 +4599,413 @@ static esp_err_t rpc_status_handler(httpd_req_t *req) {
     int64_t statusMs = esp_timer_get_time() / 1000;
     cJSON_AddNumberToObject(res, "uptime", (double)statusMs / 1000.0);
     cJSON_AddNumberToObject(res, "statusMs", (double)statusMs);
-    cJSON_AddNumberToObject(res, "headPos", h / 1000.0);
-    cJSON_AddNumberToObject(res, "footPos", f / 1000.0);
-    cJSON_AddNumberToObject(res, "headMax", headMaxMs / 1000.0);
-    cJSON_AddNumberToObject(res, "footMax", footMaxMs / 1000.0);
-    cJSON_AddStringToObject(res, "headDir", hDir.c_str());
-    cJSON_AddStringToObject(res, "footDir", fDir.c_str());
-    cJSON_AddNumberToObject(res, "opto1", o1);
-    cJSON_AddNumberToObject(res, "opto2", o2);
-    cJSON_AddNumberToObject(res, "opto3", o3);
-    cJSON_AddNumberToObject(res, "opto4", o4);
-    cJSON_AddNumberToObject(res, "remoteEventMs", (double)remoteEventMs);
-    cJSON_AddNumberToObject(res, "remoteDebounceMs", remoteDebounceMs);
-    cJSON_AddNumberToObject(res, "remoteOpto", remoteOptoIdx);
-
-    static int64_t last_remote_event_ms = -1;
-    if (remoteEventMs > 0 && remoteEventMs != last_remote_event_ms) {
-        last_remote_event_ms = remoteEventMs;
-    }
-
-    const char *slots[] = {"zg", "snore", "legs", "p1", "p2"};
-    for (int i = 0; i < 5; ++i) {
-        std::string base = slots[i];
-        cJSON_AddNumberToObject(res, (base + "_head").c_str(), bedDriver->getSavedPos((base + "_head").c_str(), 0));
-        cJSON_AddNumberToObject(res, (base + "_foot").c_str(), bedDriver->getSavedPos((base + "_foot").c_str(), 0));
-        
-        // Fetch Label from NVS
-        std::string lbl = bedDriver->getSavedLabel((base + "_label").c_str(), "Preset");
-        cJSON_AddStringToObject(res, (base + "_label").c_str(), lbl.c_str());
+    cJSON_AddNumberToObject(res, "headPos", snap.headPosMs / 1000.0);
+    cJSON_AddNumberToObject(res, "footPos", snap.footPosMs / 1000.0);
+    cJSON_AddNumberToObject(res, "headMax", snap.headMaxMs / 1000.0);
+    cJSON_AddNumberToObject(res, "footMax", snap.footMaxMs / 1000.0);
+    cJSON_AddStringToObject(res, "headDir", motionDirName(snap.headDir));
+    cJSON_AddStringToObject(res, "footDir", motionDirName(snap.footDir));
+    cJSON_AddNumberToObject(res, "opto1", snap.optoStable[0]);
+    cJSON_AddNumberToObject(res, "opto2", snap.optoStable[1]);
+    cJSON_AddNumberToObject(res, "opto3", snap.optoStable[2]);
+    cJSON_AddNumberToObject(res, "opto4", snap.optoStable[3]);
+    cJSON_AddNumberToObject(res, "remoteEventMs", (double)snap.remoteEventMs);
+    cJSON_AddNumberToObject(res, "remoteDebounceMs", snap.remoteDebounceMs);
+    cJSON_AddNumberToObject(res, "remoteOpto", snap.remoteOptoIdx);
+    if (snap.motorCurrentActive >= 0) {
+        cJSON_AddStringToObject(res, "motorCurrent", snap.motorCurrentActive ? "ACTIVE" : "IDLE");
+    }
+    cJSON_AddStringToObject(res, "headEndStop", motionDirName(snap.headEndStop));
+    cJSON_AddStringToObject(res, "footEndStop", motionDirName(snap.footEndStop));
+    cJSON_AddNumberToObject(res, "headUncertainty", snap.headUncertMs / 1000.0);
+    cJSON_AddNumberToObject(res, "footUncertainty", snap.footUncertMs / 1000.0);
+    cJSON_AddBoolToObject(res, "headRehomeDue", snap.headRehomeDue);
+    cJSON_AddBoolToObject(res, "footRehomeDue", snap.footRehomeDue);
+    cJSON_AddStringToObject(res, "arrival", arrivalPolicyName(snap.arrival));
+    cJSON_AddNumberToObject(res, "lastCmdId", (double)snap.lastCommandId);
+    if (snap.scriptSlot >= 0) {
+        cJSON_AddNumberToObject(res, "scriptSlot", snap.scriptSlot);
+        cJSON_AddNumberToObject(res, "scriptStep", snap.scriptStep);
+    }
+    if (bedService.bedCount() > 1) {
+        cJSON_AddNumberToObject(res, "bed", bed);
+        cJSON_AddNumberToObject(res, "beds", bedService.bedCount());
+        cJSON_AddBoolToObject(res, "linked", bedService.linked());
+    }
+
+    // The presets themselves come from Bed.Preset.List; clients re-fetch
+    // when presetRev changes.
+    cJSON_AddNumberToObject(res, "presetRev", (double)view.presets.rev);
+    cJSON_AddNumberToObject(res, "presets", view.presets.count);
+
+    char *jsonStr = cJSON_PrintUnformatted(res);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, jsonStr, HTTPD_RESP_USE_STRLEN);
+
+    free(jsonStr);
+    cJSON_Delete(res);
+    return ESP_OK;
+#endif
+}
+
+// GET /rpc/Bed.Telemetry?format=csv|bin&since=SEQ[&bed=N]: the move records with
+// seq > since (default 0 = the whole ring), oldest first, sent in chunks.
+// bin: an 8-byte header ("BMT", version 1, record size u16, 2 reserved),
+// then raw little-endian MoveRecords until the stream ends.
+static esp_err_t rpc_telemetry_handler(httpd_req_t *req) {
+#if !APP_ROLE_BED
+    add_cors(req);
+    httpd_resp_send_err(req, HTTPD_501_METHOD_NOT_IMPLEMENTED, "Bed role not enabled");
+    return ESP_OK;
+#else
+    add_cors(req);
+    const int bed = bed_from_query(req);
+    if (bed < 0) return httpd_send_json_error(req, "400 Bad Request", "Unknown bed");
+    bool binary = false;
+    uint32_t since = 0;
+    const char *q = strchr(req->uri, '?');
+    if (q) {
+        char format[8] = {};
+        if (httpd_query_key_value(q + 1, "format", format, sizeof(format)) == ESP_OK) {
+            binary = (strcmp(format, "bin") == 0);
+        }
+        char param[16] = {};
+        if (httpd_query_key_value(q + 1, "since", param, sizeof(param)) == ESP_OK) {
+            since = (uint32_t)strtoul(param, nullptr, 10);
+        }
     }
 
+    // Each chunk re-reads from the last seq sent, so the bed mutex is only
+    // held for one small copy at a time and no heap buffer is needed.
+    MoveRecord recs[32];
+    size_t n = bedService.readTelemetry(since, recs, 32, bed);
+    if (binary) {
+        httpd_resp_set_type(req, "application/octet-stream");
+        const uint8_t header[8] = { 'B', 'M', 'T', 1, (uint8_t)sizeof(MoveRecord), 0, 0, 0 };
+        if (httpd_resp_send_chunk(req, (const char *)header, sizeof(header)) != ESP_OK) return ESP_FAIL;
+    } else {
+        httpd_resp_set_type(req, "text/csv");
+        static const char kCsvHeader[] =
+            "seq,boot,axis,dir,source,start_us,end_us,commanded_ms,travel_ms,end_pos_ms,ramp_ms,peak_ma,flags\n";
+        if (httpd_resp_send_chunk(req, kCsvHeader, sizeof(kCsvHeader) - 1) != ESP_OK) return ESP_FAIL;
+    }
+    while (n > 0) {
+        if (binary) {
+            if (httpd_resp_send_chunk(req, (const char *)recs, n * sizeof(MoveRecord)) != ESP_OK) return ESP_FAIL;
+        } else {
+            std::string csv;
+            csv.reserve(n * 96);
+            for (size_t i = 0; i < n; ++i) {
+                const MoveRecord &r = recs[i];
+                char line[160];
+                snprintf(line, sizeof(line), "%" PRIu32 ",%u,%s,%s,%s,%" PRId64 ",%" PRId64 ",%" PRId32 ",%" PRId32
+                         ",%" PRId32 ",%u,%d,%u\n",
+                         r.seq, (unsigned)r.boot, r.axis == 0 ? "head" : "foot",
+                         motionDirName(static_cast<MotionDir>(r.dir)),
+                         moveSourceName(static_cast<MoveSource>(r.source)),
+                         r.startUs, r.startUs + (int64_t)r.runUs, r.commandedMs, r.travelMs, r.endPosMs,
+                         (unsigned)r.rampMs, r.peakMa == 0xFFFF ? -1 : (int)r.peakMa, (unsigned)r.flags);
+                csv += line;
+            }
+            if (httpd_resp_send_chunk(req, csv.c_str(), csv.size()) != ESP_OK) return ESP_FAIL;
+        }
+        if (n < 32) break;
+        since = recs[n - 1].seq;
+        n = bedService.readTelemetry(since, recs, 32, bed);
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+#endif
+}
+
+// GET /rpc/Bed.Trace[?bed=N]: the call trace recorded since TRACE_START
+// (BedTrace.h format) for tools/bed_sim bed_trace_replay, sent in chunks. A
+// trace fetched while still recording ends without its END/STATS records.
+static esp_err_t rpc_trace_handler(httpd_req_t *req) {
+#if !APP_ROLE_BED
+    add_cors(req);
+    httpd_resp_send_err(req, HTTPD_501_METHOD_NOT_IMPLEMENTED, "Bed role not enabled");
+    return ESP_OK;
+#else
+    add_cors(req);
+    const int bed = bed_from_query(req);
+    if (bed < 0) return httpd_send_json_error(req, "400 Bad Request", "Unknown bed");
+    TraceStatus ts;
+    if (!bedService.getTraceStatus(ts, bed) || ts.bytes == 0) {
+        return httpd_send_json_error(req, "404 Not Found", "No trace recorded");
+    }
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"bed.trace\"");
+    // The trace lock is held for one chunk copy at a time.
+    uint8_t chunk[1024];
+    size_t offset = 0, n;
+    while ((n = bedService.readTrace(offset, chunk, sizeof(chunk), bed)) > 0) {
+        if (httpd_resp_send_chunk(req, (const char *)chunk, n) != ESP_OK) return ESP_FAIL;
+        offset += n;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+#endif
+}
+
+// GET /rpc/Bed.Debounce[?bed=N]: per-opto debounce config and bounce statistics.
+// POST sets one channel ({"opto":0-3,"mode":"WINDOW"|"INTEGRATOR","ms":N};
+// without "opto", all four) and/or clears the counters ({"reset":true}),
+// then answers like GET.
+static esp_err_t rpc_debounce_handler(httpd_req_t *req) {
+#if !APP_ROLE_BED
+    add_cors(req);
+    httpd_resp_send_err(req, HTTPD_501_METHOD_NOT_IMPLEMENTED, "Bed role not enabled");
+    return ESP_OK;
+#else
+    add_cors(req);
+    const int bed = bed_from_query(req);
+    if (bed < 0) return httpd_send_json_error(req, "400 Bad Request", "Unknown bed");
+    if (req->method == HTTP_POST) {
+        char buf[128] = {0};
+        int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+        if (ret > 0) buf[ret] = '\0';
+        cJSON *root = cJSON_Parse(buf);
+        if (!root) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad JSON");
+            return ESP_FAIL;
+        }
+        cJSON *optoItem = cJSON_GetObjectItem(root, "opto");
+        cJSON *modeItem = cJSON_GetObjectItem(root, "mode");
+        cJSON *msItem = cJSON_GetObjectItem(root, "ms");
+        const char *error = nullptr;
+        if (modeItem || msItem) {
+            const int first = cJSON_IsNumber(optoItem) ? optoItem->valueint : 0;
+            const int last = cJSON_IsNumber(optoItem) ? optoItem->valueint : 3;
+            if (optoItem && (!cJSON_IsNumber(optoItem) || first < 0 || first > 3)) error = "Invalid opto";
+            for (int ch = first; !error && ch <= last; ++ch) {
+                DebounceConfig cfg;
+                DebounceStats stats;
+                bedService.getOptoDebounce(ch, cfg, stats, bed);
+                if (modeItem && (!cJSON_IsString(modeItem) || !debounceModeFromName(modeItem->valuestring, cfg.mode))) {
+                    error = "Invalid mode";
+                } else if (msItem && !cJSON_IsNumber(msItem)) {
+                    error = "Invalid ms";
+                } else {
+                    if (msItem) cfg.thresholdMs = (uint16_t)std::max(0, std::min(0xFFFF, msItem->valueint));
+                    if (!bedService.setOptoDebounce(ch, cfg, bed)) error = "ms out of range";
+                }
+            }
+        }
+        cJSON *resetItem = cJSON_GetObjectItem(root, "reset");
+        if (!error && cJSON_IsTrue(resetItem)) bedService.resetOptoDebounceStats(bed);
+        cJSON_Delete(root);
+        if (error) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, error);
+            return ESP_FAIL;
+        }
+    }
+
+    cJSON *res = cJSON_CreateObject();
+    cJSON_AddNumberToObject(res, "minMs", OPTO_DEBOUNCE_MIN_MS);
+    cJSON_AddNumberToObject(res, "maxMs", OPTO_DEBOUNCE_MAX_MS);
+    cJSON *optos = cJSON_AddArrayToObject(res, "optos");
+    for (int ch = 0; ch < 4; ++ch) {
+        DebounceConfig cfg;
+        DebounceStats st;
+        bedService.getOptoDebounce(ch, cfg, st, bed);
+        cJSON *o = cJSON_CreateObject();
+        cJSON_AddNumberToObject(o, "opto", ch);
+        cJSON_AddStringToObject(o, "mode", debounceModeName(cfg.mode));
+        cJSON_AddNumberToObject(o, "ms", cfg.thresholdMs);
+        cJSON_AddNumberToObject(o, "transitions", st.transitions);
+        cJSON_AddNumberToObject(o, "glitches", st.glitches);
+        cJSON_AddNumberToObject(o, "bounces", st.bounces);
+        cJSON_AddNumberToObject(o, "bouncesPerTransition", st.transitions ? (double)st.bounces / st.transitions : 0.0);
+        cJSON_AddNumberToObject(o, "maxBounces", st.maxBounces);
+        cJSON_AddNumberToObject(o, "maxBounceMs", st.maxBounceMs);
+        if (st.minStableMs != UINT32_MAX) {
+            cJSON_AddNumberToObject(o, "minStableMs", st.minStableMs);
+            cJSON_AddNumberToObject(o, "maxStableMs", st.maxStableMs);
+        }
+        cJSON_AddItemToArray(optos, o);
+    }
     char *jsonStr = cJSON_PrintUnformatted(res);
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, jsonStr, HTTPD_RESP_USE_STRLEN);
+    free(jsonStr);
+    cJSON_Delete(res);
+    return ESP_OK;
+#endif
+}
+
+#if APP_ROLE_BED
+#define PRESET_PAGE_MAX 16
+
+static void preset_add_json(cJSON *o, const PresetEntry &p) {
+    cJSON_AddNumberToObject(o, "id", p.id);
+    cJSON_AddStringToObject(o, "label", p.label);
+    cJSON_AddNumberToObject(o, "head", p.headMs);
+    cJSON_AddNumberToObject(o, "foot", p.footMs);
+    if (PresetTable::builtin(p.id)) cJSON_AddStringToObject(o, "slot", BedService::presetSlotName(p.id - 1));
+}
+
+// Bed.Preset.List: one page of presets in display order. "next" is the
+// offset of the following page, absent on the last one.
+static cJSON *preset_list_json(size_t offset, size_t limit, int bed) {
+    PresetEntry page[PRESET_PAGE_MAX];
+    PresetStoreInfo info;
+    const size_t n = bedService.listPresets(offset, page, std::min<size_t>(limit, PRESET_PAGE_MAX), info, bed);
+    cJSON *res = cJSON_CreateObject();
+    cJSON_AddNumberToObject(res, "rev", (double)info.rev);
+    cJSON_AddNumberToObject(res, "total", info.count);
+    cJSON_AddNumberToObject(res, "offset", (double)offset);
+    cJSON *list = cJSON_AddArrayToObject(res, "presets");
+    for (size_t i = 0; i < n; ++i) {
+        cJSON *item = cJSON_CreateObject();
+        preset_add_json(item, page[i]);
+        cJSON_AddItemToArray(list, item);
+    }
+    if (offset + n < info.count) cJSON_AddNumberToObject(res, "next", (double)(offset + n));
+    return res;
+}
+#endif
+
+// /rpc/Bed.Preset.<Method>[?bed=N]: the named preset store, paged so a
+// status poll no longer carries every preset.
+//   List    GET ?offset=&limit= or POST {"offset","limit"}; at most 16 a page
+//   Apply   POST {"id"}: queues the move like Bed.Command presets
+//   Save    POST {"id"?, "label"?, "head"?, "foot"?, "position"?}: no id
+//           creates one; head/foot default to the live position
+//   Delete  POST {"id"}; the five built-in slots cannot be deleted
+// "bed" may also come in the body.
+static esp_err_t rpc_preset_handler(httpd_req_t *req) {
+#if !APP_ROLE_BED
+    add_cors(req);
+    httpd_resp_send_err(req, HTTPD_501_METHOD_NOT_IMPLEMENTED, "Bed role not enabled");
+    return ESP_OK;
+#else
+    add_cors(req);
+    static const char kPrefix[] = "/rpc/Bed.Preset.";
+    const char *name = req->uri + sizeof(kPrefix) - 1;
+    const size_t nameLen = strcspn(name, "?");
+    std::string method(name, nameLen);
+    int bed = bed_from_query(req);
+    size_t offset = 0, limit = PRESET_PAGE_MAX;
+    const char *q = strchr(req->uri, '?');
+    char param[16] = {};
+    if (q && httpd_query_key_value(q + 1, "offset", param, sizeof(param)) == ESP_OK) offset = strtoul(param, nullptr, 10);
+    if (q && httpd_query_key_value(q + 1, "limit", param, sizeof(param)) == ESP_OK) limit = strtoul(param, nullptr, 10);
 
+    cJSON *root = nullptr;
+    if (req->method == HTTP_POST && req->content_len > 0) {
+        char buf[256] = {0};
+        int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+        if (ret > 0) buf[ret] = '\0';
+        root = cJSON_Parse(buf);
+        if (!root) return httpd_send_json_error(req, "400 Bad Request", "Bad JSON");
+        cJSON *bedItem = cJSON_GetObjectItem(root, "bed");
+        if (cJSON_IsNumber(bedItem)) bed = bedService.validBed(bedItem->valueint) ? bedItem->valueint : -1;
+    } else if (req->method != HTTP_GET || method != "List") {
+        return httpd_send_json_error(req, "405 Method Not Allowed", "Use POST");
+    }
+    if (bed < 0) {
+        cJSON_Delete(root);
+        return httpd_send_json_error(req, "400 Bad Request", "Unknown bed");
+    }
+    cJSON *idItem = cJSON_GetObjectItem(root, "id");
+    const uint16_t id = cJSON_IsNumber(idItem) && idItem->valueint > 0 && idItem->valueint < UINT16_MAX
+                            ? (uint16_t)idItem->valueint : 0;
+
+    cJSON *res = nullptr;
+    const char *status = "400 Bad Request";
+    const char *error = nullptr;
+    if (method == "List") {
+        cJSON *offsetItem = cJSON_GetObjectItem(root, "offset");
+        cJSON *limitItem = cJSON_GetObjectItem(root, "limit");
+        if (cJSON_IsNumber(offsetItem)) offset = (size_t)std::max(0, offsetItem->valueint);
+        if (cJSON_IsNumber(limitItem)) limit = (size_t)std::max(0, limitItem->valueint);
+        res = preset_list_json(offset, limit, bed);
+    } else if (method == "Apply") {
+        BedCommandTicket ticket;
+        if (!id) {
+            error = "Missing id";
+        } else if (!bedService.applyPreset(id, ticket, bed)) {
+            status = "404 Not Found";
+            error = "Unknown preset";
+        } else if (ticket.id == 0) {
+            status = "503 Service Unavailable";
+            error = "Command queue full";
+        } else {
+            res = cJSON_CreateObject();
+            cJSON_AddNumberToObject(res, "id", id);
+            cJSON_AddNumberToObject(res, "cmdId", (double)ticket.id);
+            cJSON_AddNumberToObject(res, "maxWait", ticket.durationMs);
+            cJSON_AddNumberToObject(res, "etaMs", (double)ticket.etaMs);
+        }
+    } else if (method == "Save") {
+        PresetEntry p = {};
+        if (idItem && !id) {
+            error = "Invalid id";
+        } else if (id && !bedService.getPresetById(id, p, bed)) {
+            status = "404 Not Found";
+            error = "Unknown preset";
+        } else {
+            // A new preset takes the live position, an existing one only with
+            // "capture":true; {"id","position"} just moves the entry.
+            cJSON *headItem = cJSON_GetObjectItem(root, "head");
+            cJSON *footItem = cJSON_GetObjectItem(root, "foot");
+            cJSON *labelItem = cJSON_GetObjectItem(root, "label");
+            cJSON *posItem = cJSON_GetObjectItem(root, "position");
+            const bool capture = !id || cJSON_IsTrue(cJSON_GetObjectItem(root, "capture"));
+            const int position = cJSON_IsNumber(posItem) ? posItem->valueint : -1;
+            uint16_t saved = 0;
+            if (!capture && !headItem && !footItem && !labelItem) {
+                saved = bedService.movePreset(id, position, bed) ? id : 0;
+            } else {
+                if (capture) bedService.getLiveStatus(p.headMs, p.footMs, bed);
+                if (cJSON_IsNumber(headItem)) p.headMs = headItem->valueint;
+                if (cJSON_IsNumber(footItem)) p.footMs = footItem->valueint;
+                if (cJSON_IsString(labelItem)) snprintf(p.label, sizeof(p.label), "%s", labelItem->valuestring);
+                p.id = id;
+                saved = bedService.savePreset(p, position, bed);
+            }
+            PresetStoreInfo info;
+            bedService.listPresets(0, nullptr, 0, info, bed);
+            if (!saved && !id && info.full) {
+                status = "507 Insufficient Storage";
+                error = "Preset store full";
+            } else if (!saved) {
+                status = "500 Internal Server Error";
+                error = "Preset write failed";
+            } else if (bedService.getPresetById(saved, p, bed)) {
+                res = cJSON_CreateObject();
+                preset_add_json(res, p);
+                cJSON_AddNumberToObject(res, "rev", (double)info.rev);
+            }
+        }
+    } else if (method == "Delete") {
+        if (!id) {
+            error = "Missing id";
+        } else if (PresetTable::builtin(id)) {
+            status = "409 Conflict";
+            error = "Built-in presets cannot be deleted";
+        } else if (!bedService.deletePreset(id, bed)) {
+            status = "404 Not Found";
+            error = "Unknown preset";
+        } else {
+            PresetStoreInfo info;
+            bedService.listPresets(0, nullptr, 0, info, bed);
+            res = cJSON_CreateObject();
+            cJSON_AddNumberToObject(res, "id", id);
+            cJSON_AddNumberToObject(res, "rev", (double)info.rev);
+            cJSON_AddNumberToObject(res, "total", info.count);
+        }
+    } else {
+        status = "404 Not Found";
+        error = "Unknown method";
+    }
+    cJSON_Delete(root);
+    if (!res) return httpd_send_json_error(req, status, error ? error : "Preset not saved");
+
+    char *jsonStr = cJSON_PrintUnformatted(res);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, jsonStr, HTTPD_RESP_USE_STRLEN);
     free(jsonStr);
     cJSON_Delete(res);
     return ESP_OK;
@@ -4322,7 +5035,14 @@ static void sse_task(void *arg) {
     const int64_t kPingIntervalMs = 15000;
     const int64_t kPollIntervalMs = 100;
     int64_t lastPingMs = 0;
-    int64_t lastEventMs = -1;
+#if APP_ROLE_BED
+    // Per bed: each base has its own wired remote and event history.
+    bool optoPrimed = false;
+    uint32_t lastOptoSeqs[BED_SERVICE_MAX_BEDS] = {};
+    int stables[BED_SERVICE_MAX_BEDS][4];   // opto levels as of lastOptoSeqs
+    int raws[BED_SERVICE_MAX_BEDS][4];
+    const int beds = bedService.bedCount();
+#endif
 
     while (!ctx->stop) {
         int64_t nowMs = esp_timer_get_time() / 1000;
@@ -4339,64 +5059,90 @@ static void sse_task(void *arg) {
         }
 
 #if APP_ROLE_BED
-        if (bedDriver) {
-            int64_t remoteEventMs = 0;
-            int32_t remoteDebounceMs = 0;
-            int8_t remoteOptoIdx = -1;
-            bedDriver->getRemoteEventInfo(remoteEventMs, remoteDebounceMs, remoteOptoIdx);
-            int64_t edgeEventMs = 0;
-            int8_t edgeOptoIdx = -1;
-            int8_t edgeOptoState = 1;
-            bedDriver->getRemoteEdgeInfo(edgeEventMs, edgeOptoIdx, edgeOptoState);
-            int ro1=1,ro2=1,ro3=1,ro4=1;
-            bedDriver->getOptoRawStates(ro1, ro2, ro3, ro4);
-            if (remoteEventMs > 0 && remoteEventMs != lastEventMs) {
-                int o1=1,o2=1,o3=1,o4=1;
-                bedDriver->getOptoStates(o1,o2,o3,o4);
-                std::string hDir = "STOPPED", fDir = "STOPPED";
-                bedDriver->getMotionDirs(hDir, fDir);
-
-                cJSON *ev = cJSON_CreateObject();
-                cJSON_AddStringToObject(ev, "type", "remote_event");
-                cJSON_AddNumberToObject(ev, "eventMs", (double)remoteEventMs);
-                cJSON_AddNumberToObject(ev, "debounceMs", remoteDebounceMs);
-                cJSON_AddNumberToObject(ev, "statusMs", (double)nowMs);
-                cJSON_AddNumberToObject(ev, "opto", remoteOptoIdx);
-                cJSON_AddNumberToObject(ev, "opto1", o1);
-                cJSON_AddNumberToObject(ev, "opto2", o2);
-                cJSON_AddNumberToObject(ev, "opto3", o3);
-                cJSON_AddNumberToObject(ev, "opto4", o4);
-                cJSON_AddStringToObject(ev, "headDir", hDir.c_str());
-                cJSON_AddStringToObject(ev, "footDir", fDir.c_str());
-
-                char *jsonStr = cJSON_PrintUnformatted(ev);
-                esp_err_t err = send_sse_event(ctx->req, "remote_event", jsonStr);
-                free(jsonStr);
-                cJSON_Delete(ev);
-                if (err != ESP_OK) break;
-                lastEventMs = remoteEventMs;
+        if (!optoPrimed) {
+            // Start at the newest event; the snapshot supplies the levels the
+            // events that follow are applied to.
+            for (int bed = 0; bed < beds; ++bed) {
+                lastOptoSeqs[bed] = bedService.optoEventSeq(bed);
+                BedSnapshot snap;
+                bedService.getSnapshot(snap, bed);
+                for (int i = 0; i < 4; ++i) {
+                    stables[bed][i] = snap.optoStable[i];
+                    raws[bed][i] = snap.optoRaw[i];
+                }
             }
-
-            static int64_t lastEdgeMs = -1;
-            if (edgeEventMs > 0 && edgeEventMs != lastEdgeMs) {
-                cJSON *ev = cJSON_CreateObject();
-                cJSON_AddStringToObject(ev, "type", "remote_edge");
-                cJSON_AddNumberToObject(ev, "eventMs", (double)edgeEventMs);
-                cJSON_AddNumberToObject(ev, "statusMs", (double)nowMs);
-                cJSON_AddNumberToObject(ev, "opto", edgeOptoIdx);
-                cJSON_AddNumberToObject(ev, "state", edgeOptoState);
-                cJSON_AddNumberToObject(ev, "raw1", ro1);
-                cJSON_AddNumberToObject(ev, "raw2", ro2);
-                cJSON_AddNumberToObject(ev, "raw3", ro3);
-                cJSON_AddNumberToObject(ev, "raw4", ro4);
-                char *jsonStr = cJSON_PrintUnformatted(ev);
-                esp_err_t err = send_sse_event(ctx->req, "remote_edge", jsonStr);
-                free(jsonStr);
-                cJSON_Delete(ev);
-                if (err != ESP_OK) break;
-                lastEdgeMs = edgeEventMs;
+            optoPrimed = true;
+        }
+        bool sendFailed = false;
+        for (int bed = 0; bed < beds && !sendFailed; ++bed) {
+            uint32_t &lastOptoSeq = lastOptoSeqs[bed];
+            int *stable = stables[bed];
+            int *raw = raws[bed];
+            // Drain the edge history by sequence number so every edge of the
+            // last poll period goes out once, not just the newest one.
+            OptoEvent events[8];
+            size_t n;
+            while (!sendFailed && (n = bedService.readOptoEvents(lastOptoSeq, events, 8, bed)) > 0) {
+                BedSnapshot snap;
+                bedService.getSnapshot(snap, bed);
+                for (size_t k = 0; k < n && !sendFailed; ++k) {
+                    const OptoEvent &oe = events[k];
+                    const uint32_t lost = oe.seq - lastOptoSeq - 1;
+                    lastOptoSeq = oe.seq;
+                    if (oe.kind != OPTO_EVENT_GESTURE && oe.opto >= 4) continue;
+                    cJSON *ev = cJSON_CreateObject();
+                    const char *name;
+                    if (oe.kind == OPTO_EVENT_GESTURE) {
+                        name = "remote_gesture";
+                        cJSON_AddStringToObject(ev, "type", name);
+                        cJSON_AddNumberToObject(ev, "eventMs", (double)(oe.us / 1000));
+                        cJSON_AddNumberToObject(ev, "statusMs", (double)nowMs);
+                        GestureBinding b = {};
+                        b.buttons = oe.opto;
+                        b.kind = static_cast<GestureKind>(oe.level);
+                        b.action = static_cast<GestureAction>(oe.action);
+                        b.script = oe.script;
+                        b.holdMs = (uint16_t)oe.debounceMs;
+                        gesture_add_json(ev, b);
+                    } else if (oe.kind == OPTO_EVENT_STABLE) {
+                        stable[oe.opto] = oe.level;
+                        name = "remote_event";
+                        cJSON_AddStringToObject(ev, "type", name);
+                        cJSON_AddNumberToObject(ev, "eventMs", (double)(oe.us / 1000));
+                        cJSON_AddNumberToObject(ev, "debounceMs", oe.debounceMs);
+                        cJSON_AddNumberToObject(ev, "statusMs", (double)nowMs);
+                        cJSON_AddNumberToObject(ev, "opto", oe.opto);
+                        cJSON_AddNumberToObject(ev, "opto1", stable[0]);
+                        cJSON_AddNumberToObject(ev, "opto2", stable[1]);
+                        cJSON_AddNumberToObject(ev, "opto3", stable[2]);
+                        cJSON_AddNumberToObject(ev, "opto4", stable[3]);
+                        cJSON_AddStringToObject(ev, "headDir", motionDirName(snap.headDir));
+                        cJSON_AddStringToObject(ev, "footDir", motionDirName(snap.footDir));
+                    } else {
+                        raw[oe.opto] = oe.level;
+                        name = "remote_edge";
+                        cJSON_AddStringToObject(ev, "type", name);
+                        cJSON_AddNumberToObject(ev, "eventMs", (double)(oe.us / 1000));
+                        cJSON_AddNumberToObject(ev, "statusMs", (double)nowMs);
+                        cJSON_AddNumberToObject(ev, "opto", oe.opto);
+                        cJSON_AddNumberToObject(ev, "state", oe.level);
+                        cJSON_AddNumberToObject(ev, "raw1", raw[0]);
+                        cJSON_AddNumberToObject(ev, "raw2", raw[1]);
+                        cJSON_AddNumberToObject(ev, "raw3", raw[2]);
+                        cJSON_AddNumberToObject(ev, "raw4", raw[3]);
+                    }
+                    cJSON_AddNumberToObject(ev, "seq", oe.seq);
+                    if (beds > 1) cJSON_AddNumberToObject(ev, "bed", bed);
+                    if (lost) cJSON_AddNumberToObject(ev, "lost", lost);
+
+                    char *jsonStr = cJSON_PrintUnformatted(ev);
+                    sendFailed = send_sse_event(ctx->req, name, jsonStr) != ESP_OK;
+                    free(jsonStr);
+                    cJSON_Delete(ev);
+                }
             }
         }
+        if (sendFailed) break;
 #endif
 
         vTaskDelay(pdMS_TO_TICKS(kPollIntervalMs));
@@ -4789,7 +5535,7 @@ void NetworkManager::startSntp() {
 
 void NetworkManager::startWebServer() {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.max_uri_handlers = 64; // allow extra endpoints
+    config.max_uri_handlers = 72; // allow extra endpoints
     config.uri_match_fn = httpd_uri_match_wildcard;
     config.lru_purge_enable = true;
     config.stack_size = 12288;
@@ -4824,6 +5570,12 @@ void NetworkManager::startWebServer() {
 #if APP_ROLE_BED
         httpd_register_uri_handler(server, &URI_CMD);
         httpd_register_uri_handler(server, &URI_STATUS);
+        httpd_register_uri_handler(server, &URI_TELEMETRY);
+        httpd_register_uri_handler(server, &URI_TRACE);
+        httpd_register_uri_handler(server, &URI_DEBOUNCE_GET);
+        httpd_register_uri_handler(server, &URI_DEBOUNCE_SET);
+        httpd_register_uri_handler(server, &URI_PRESET_GET);
+        httpd_register_uri_handler(server, &URI_PRESET_SET);
         httpd_register_uri_handler(server, &URI_EVENTS);
 #else
         httpd_register_uri_handler(server, &URI_BED_CMD_DISABLED);
@@ -4140,6 +4140,27 @@ function logUiAndMotion() {
 }
 
 var isFirstPoll = true; 
+var presetRev = null;
+
+// Pages through /rpc/Bed.Preset.List and shows the built-in slots.
+function loadPresetList(base, offset) {
+    fetch(base + '/rpc/Bed.Preset.List?offset=' + offset)
+    .then(function(response) { return response.json(); })
+    .then(function(page) {
+        (page.presets || []).forEach(function(p) {
+            if (!p.slot) return;
+            presetData[p.slot] = { head: p.head, foot: p.foot, label: p.label, id: p.id };
+            updatePresetButton(p.slot, p.head, p.foot, p.label);
+        });
+        if (page.next !== undefined) loadPresetList(base, page.next);
+        else updateModalDropdown();
+    })
+    .catch(function(err) {
+        console.error("Preset list failed", err);
+        presetRev = null;
+    });
+}
+
 function pollStatus() {
     if (!isRoleAvailable('bed')) return;
     if (!currentBedTargetId || !bedTargetsById[currentBedTargetId]) return;
@@ -4151,21 +4172,12 @@ function pollStatus() {
         var result = status.result || status; 
         if (result) {
             updateStatusDisplay(result);
-            if (isFirstPoll) {
-                presetData = {
-                    zg: { head: result.zg_head, foot: result.zg_foot, label: result.zg_label },
-                    snore: { head: result.snore_head, foot: result.snore_foot, label: result.snore_label },
-                    legs: { head: result.legs_head, foot: result.legs_foot, label: result.legs_label },
-                    p1: { head: result.p1_head, foot: result.p1_foot, label: result.p1_label },
-                    p2: { head: result.p2_head, foot: result.p2_foot, label: result.p2_label }
-                };
-                updatePresetButton('zg', result.zg_head, result.zg_foot, result.zg_label);
-                updatePresetButton('snore', result.snore_head, result.snore_foot, result.snore_label);
-                updatePresetButton('legs', result.legs_head, result.legs_foot, result.legs_label);
-                updatePresetButton('p1', result.p1_head, result.p1_foot, result.p1_label);
-                updatePresetButton('p2', result.p2_head, result.p2_foot, result.p2_label);
-                updateModalDropdown();
+            // Presets are no longer in the status; fetch them once and
+            // again whenever the store's revision moves.
+            if (isFirstPoll || result.presetRev !== presetRev) {
                 isFirstPoll = false;
+                presetRev = result.presetRev;
+                loadPresetList(base, 0);
             }
         }
     })
@@ -33,9 +33,22 @@
 #include "BedControl.h"
 #include "BedDriver.h"
 #include "BedService.h"
+#include "TraceBedDriver.h"
+#if BED_DRIVER_RF
+#include "RfBedDriver.h"
+#endif
 
+#if BED_DRIVER_RF
+RfBedDriver bed;                       // bed 0 over its RF remote (WL102 on RF_TX_PIN)
+#else
 BedControl bed;
-BedDriver* bedDriver = &bed;
+#endif
+static TraceBedDriver bedTrace(&bed);  // records bed 0 between TRACE_START and TRACE_STOP
+static BedDriver* bedDriver = &bedTrace;   // bound to BedService in app_main(); use the service
+#if BED_COUNT > 1
+static BedControl bed2(BedPins::secondary());   // split king: second base on the BED2_* pins
+static TraceBedDriver bed2Trace(&bed2);
+#endif
 #endif
 NetworkManager net;
 
@@ -1135,6 +1148,7 @@ static void acs712_log_task(void* pv) {
     const int kActiveOffMv = 20;
     const int64_t kIdleConfirmUs = 300 * 1000;
     const float kEmaAlpha = 0.25f;
+    const float kMvPerAmp = 185.0f;  // ACS712-05B sensitivity, for the move telemetry peak
     bool baseline_ready = false;
     float ema_mv = 0.0f;
     float baseline_mv = 0.0f;
@@ -1171,9 +1185,13 @@ static void acs712_log_task(void* pv) {
                             // Slowly track baseline when idle.
                             baseline_mv = 0.98f * baseline_mv + 0.02f * ema_mv;
                         }
+                        BedService::instance().reportMotorCurrentMa(delta_mv > 0.0f ? (int32_t)(delta_mv * 1000.0f / kMvPerAmp) : 0);
                         if (active != last_active) {
                             ESP_LOGI(TAG_MAIN, "ACS712 state=%s mv=%.1f baseline=%.1f delta=%.1f raw=%d",
                                      active ? "ACTIVE" : "IDLE", ema_mv, baseline_mv, delta_mv, raw);
+                            // Report when the drop began, not when it was confirmed,
+                            // so end-stop travel times aren't inflated by kIdleConfirmUs.
+                            BedService::instance().reportMotorCurrent(active, (active ? now_us : idle_since_us) / 1000);
                             last_active = active;
                         }
                     } else {
@@ -1335,9 +1353,14 @@ static void wifi_status_handler(void*, esp_event_base_t event_base, int32_t even
 
 #if APP_ROLE_BED
 void bed_task(void *pvParameter) {
+    // Sleeps until a command, opto edge or preset deadline notifies us, or
+    // until the interval update() asks for (short only while ramping/debouncing).
+    // With two bases, both notify this task and every pass ticks both.
+    BedService &svc = BedService::instance();
+    svc.attachTask(xTaskGetCurrentTaskHandle());
     while (1) {
-        bedDriver->update();
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        uint32_t sleepMs = svc.update();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleepMs));
     }
 }
 #endif
@@ -1406,6 +1429,10 @@ extern "C" void app_main() {
 #endif
 #if APP_ROLE_BED
     BedService::instance().begin(bedDriver);
+    BedService::instance().attachTrace(&bedTrace);
+#if BED_COUNT > 1
+    BedService::instance().attachTrace(&bed2Trace, BedService::instance().addBed(&bed2Trace));
+#endif
 #if APP_MATTER
     MatterManager::instance().begin();
     g_led_state = MatterManager::instance().isCommissioned() ? LedState::COMMISSIONED : LedState::IDLE;
@@ -0,0 +1,279 @@
+#include "SimBedDriver.h"
+#include "BedConfig.h"
+#include "SimHal.h"
+#include "driver/ledc.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Same cadence as acs712_log_task in main.cpp.
+static const int64_t kCurrentSampleUs = 200 * 1000;
+static const int64_t kCurrentIdleConfirmUs = 300 * 1000;
+static const int32_t kMotorCurrentMa = 1800;  // one actuator under load
+
+SimBedDriver::SimBedDriver(const BedPins &pins) : pins(pins), ctrl(pins) {
+    headAxis.travelMs = HEAD_MAX_MS_DEFAULT;
+    footAxis.travelMs = FOOT_MAX_MS_DEFAULT;
+}
+
+SimBedDriver::~SimBedDriver() {
+    sim::setOutputHook(this, nullptr);
+    sim::setEdgeHook(this, nullptr);
+}
+
+void SimBedDriver::begin() {
+    sim::setOutputHook(this, [this]() { integratePlant(); });
+    sim::setEdgeHook(this, [this](int gpio, int level) { auditEdge(gpio, level); });
+    plantUs = sim::nowUs();
+    ctrl.attachTask(xTaskGetCurrentTaskHandle());
+    ctrl.begin();
+    int32_t h = 0, f = 0;
+    ctrl.getLiveStatus(h, f);
+    headAxis.posMs = h;
+    footAxis.posMs = f;
+    plantUs = sim::nowUs();
+    nextTickUs = plantUs;
+
+    if (currentSense && !currentTimer) {
+        esp_timer_create_args_t args = {};
+        args.callback = [](void *arg) { static_cast<SimBedDriver *>(arg)->sampleCurrent(); };
+        args.arg = this;
+        args.name = "sim_acs712";
+        esp_timer_create(&args, &currentTimer);
+        esp_timer_start_once(currentTimer, kCurrentSampleUs);
+    }
+}
+
+// Powered and past the start lag, and not stalled against the end it drives into.
+bool SimBedDriver::axisMoving(const Axis &a) const {
+    if (a.driveSign == 0) return false;
+    if (sim::nowUs() < a.driveSinceUs + (int64_t)(a.startLatencyMs * 1000.0)) return false;
+    if (a.driveSign > 0 && a.posMs >= a.travelMs) return false;
+    if (a.driveSign < 0 && a.posMs <= 0.0) return false;
+    return true;
+}
+
+void SimBedDriver::sampleCurrent() {
+    integratePlant();
+    const int64_t now = sim::nowUs();
+    const int moving = (axisMoving(headAxis) ? 1 : 0) + (axisMoving(footAxis) ? 1 : 0);
+    outer->reportMotorCurrentMa(moving * kMotorCurrentMa);
+    if (moving > 0) {
+        idleSinceUs = -1;
+        if (!currentActive) {
+            currentActive = true;
+            outer->reportMotorCurrent(true, now / 1000);
+        }
+    } else if (currentActive) {
+        if (idleSinceUs < 0) idleSinceUs = now;
+        if (now - idleSinceUs >= kCurrentIdleConfirmUs) {
+            currentActive = false;
+            outer->reportMotorCurrent(false, idleSinceUs / 1000);
+        }
+    }
+    esp_timer_start_once(currentTimer, kCurrentSampleUs);
+}
+
+// Checks each relay edge against the ones before it: no UP/DOWN overlap, and
+// the gaps around reversals, between the two motor starts and between the
+// transfer and motor relays.
+void SimBedDriver::auditEdge(int gpio, int level) {
+    const int *kMotorPins = pins.motor;
+    const int *kTransferPins = pins.transfer;
+#if BED_TRANSFER_MODE_MULTI
+    auto feeds = [](int t, int m) { return t / 2 == m / 2; };
+#else
+    auto feeds = [](int t, int) { return t == 0; };
+#endif
+    auto keepMin = [](int64_t &slot, int64_t v) { if (slot < 0 || v < slot) slot = v; };
+    const int64_t now = sim::nowUs();
+    const bool closed = level == RELAY_ON;
+
+    for (int m = 0; m < 4; ++m) {
+        if (kMotorPins[m] != gpio) continue;
+        audit.edges++;
+        RelayPin &r = motorRelay[m];
+        if (closed) {
+            const RelayPin &partner = motorRelay[m ^ 1];
+            if (partner.closed) audit.overlaps++;
+            else if (partner.changedUs > r.changedUs) keepMin(audit.minReverseUs, now - partner.changedUs);
+            for (int o = (m < 2) ? 2 : 0, end = o + 2; o < end; ++o) {
+                if (motorRelay[o].closed) keepMin(audit.minStaggerUs, now - motorRelay[o].changedUs);
+            }
+            for (int t = 0; t < 4; ++t) {
+                if (kTransferPins[t] >= 0 && feeds(t, m) && transferRelay[t].closed) {
+                    keepMin(audit.minTransferLeadUs, now - transferRelay[t].changedUs);
+                }
+            }
+        }
+        r.closed = closed;
+        r.changedUs = now;
+        return;
+    }
+    for (int t = 0; t < 4; ++t) {
+        if (kTransferPins[t] != gpio) continue;
+        audit.edges++;
+        if (!closed) {
+            for (int m = 0; m < 4; ++m) {
+                if (!feeds(t, m)) continue;
+                if (motorRelay[m].closed) audit.hotTransfers++;
+                else if (motorRelay[m].changedUs >= 0) keepMin(audit.minTransferTrailUs, now - motorRelay[m].changedUs);
+            }
+        }
+        transferRelay[t].closed = closed;
+        transferRelay[t].changedUs = now;
+        return;
+    }
+}
+
+// Signed drive (-1..1) of one axis from the current outputs. App drive wins;
+// the wired remote only moves the motor while its transfer relay is released.
+double SimBedDriver::axisDrive(bool head) const {
+#if BED_MOTOR_DRIVER_DRV8871
+    // Up drives the channel of the DOWN pin (see applyAxisPWM)
+    const uint32_t upDuty = sim::ledcDuty(pins.motorLedc[head ? 1 : 3]);
+    const uint32_t downDuty = sim::ledcDuty(pins.motorLedc[head ? 0 : 2]);
+    double app = ((double)upDuty - (double)downDuty) / MOTOR_PWM_DUTY_MAX;
+#else
+    const bool up = sim::level(pins.motor[head ? 0 : 2]) == RELAY_ON;
+    const bool down = sim::level(pins.motor[head ? 1 : 3]) == RELAY_ON;
+    double app = (up && !down) ? 1.0 : ((down && !up) ? -1.0 : 0.0);
+#endif
+    if (app != 0.0) return app;
+
+#if BED_TRANSFER_MODE_MULTI
+    const bool upIsolated = sim::level(pins.transfer[head ? 0 : 2]) == RELAY_ON;
+    const bool downIsolated = sim::level(pins.transfer[head ? 1 : 3]) == RELAY_ON;
+#else
+    const bool upIsolated = sim::level(pins.transfer[0]) == RELAY_ON;
+    const bool downIsolated = upIsolated;
+#endif
+    const bool remoteUp = remotePressed[head ? 0 : 2] && !upIsolated;
+    const bool remoteDown = remotePressed[head ? 1 : 3] && !downIsolated;
+    if (remoteUp && !remoteDown) return 1.0;
+    if (remoteDown && !remoteUp) return -1.0;
+    return 0.0;
+}
+
+// Outputs only change right after the output hook ran, so the drive read here
+// has been constant since plantUs. A new drive direction starts moving after
+// startLatencyMs; releasing a moving axis lets it coast for stopLatencyMs.
+void SimBedDriver::integratePlant() {
+    const int64_t now = sim::nowUs();
+    const int64_t t0 = plantUs;
+    plantUs = now;
+    if (now <= t0) return;
+    Axis *axes[2] = { &headAxis, &footAxis };
+    for (int i = 0; i < 2; ++i) {
+        Axis &a = *axes[i];
+        const double drive = axisDrive(i == 0);
+        const int sign = (drive > 0) - (drive < 0);
+        if (sign != a.driveSign) {
+            const int64_t startUs = a.driveSinceUs + (int64_t)(a.startLatencyMs * 1000.0);
+            if (a.driveSign != 0 && t0 > startUs) {
+                a.coastSign = a.driveSign;
+                a.coastUntilUs = t0 + (int64_t)(a.stopLatencyMs * 1000.0);
+            }
+            a.driveSign = sign;
+            a.driveSinceUs = t0;
+        }
+        if (sign != 0) a.coastSign = 0;
+
+        double moveMs = 0.0;
+        if (sign != 0) {
+            const int64_t from = std::max(t0, a.driveSinceUs + (int64_t)(a.startLatencyMs * 1000.0));
+            if (now > from) moveMs = drive * (double)(now - from) / 1000.0;
+        } else if (a.coastSign != 0 && a.coastUntilUs > t0) {
+            moveMs = a.coastSign * (double)(std::min(now, a.coastUntilUs) - t0) / 1000.0;
+        }
+        if (moveMs > 0) a.posMs += moveMs * a.upRate;
+        else if (moveMs < 0) a.posMs += moveMs * a.downRate;
+        a.posMs = std::max(0.0, std::min((double)a.travelMs, a.posMs));
+        if ((sign > 0 && a.posMs >= a.travelMs) || (sign < 0 && a.posMs <= 0.0)) {
+            a.stallMs += (double)(now - t0) / 1000.0;
+        }
+    }
+}
+
+uint32_t SimBedDriver::update() {
+    integratePlant();
+    const auto t0 = std::chrono::steady_clock::now();
+    const uint32_t sleepMs = ctrl.update();
+    const auto t1 = std::chrono::steady_clock::now();
+    const uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    stats.ticks++;
+    stats.totalNs += ns;
+    if (ns > stats.maxNs) stats.maxNs = ns;
+    nextTickUs = sim::nowUs() + (int64_t)sleepMs * 1000;
+    return sleepMs;
+}
+
+void SimBedDriver::attachTask(TaskHandle_t task) { ctrl.attachTask(task); }
+
+void SimBedDriver::runForMs(int64_t ms) { runForUs(ms * 1000); }
+
+void SimBedDriver::runForUs(int64_t us) {
+    const int64_t end = sim::nowUs() + us;
+    for (;;) {
+        if (sim::takeNotify() || nextTickUs <= sim::nowUs()) {
+            outer->update();
+            continue;
+        }
+        const int64_t now = sim::nowUs();
+        if (now >= end) break;
+        sim::advanceUs(std::min(nextTickUs, end) - now, true);
+    }
+    integratePlant();
+}
+
+void SimBedDriver::setRemote(int optoIdx, bool pressed) {
+    if (optoIdx < 0 || optoIdx > 3) return;
+    integratePlant();
+    remotePressed[optoIdx] = pressed;
+    sim::setInput(pins.opto[optoIdx], pressed ? 0 : 1);
+}
+
+void SimBedDriver::stop() { ctrl.stop(); }
+void SimBedDriver::moveHead(MotionDir dir) { ctrl.moveHead(dir); }
+void SimBedDriver::moveFoot(MotionDir dir) { ctrl.moveFoot(dir); }
+void SimBedDriver::moveAll(MotionDir dir) { ctrl.moveAll(dir); }
+int32_t SimBedDriver::setTarget(int32_t head, int32_t foot) { return ctrl.setTarget(head, foot); }
+BedCommandTicket SimBedDriver::submit(const BedCommand &cmd) { return ctrl.submit(cmd); }
+bool SimBedDriver::loadScript(uint8_t slot, MotionScript &out) { return ctrl.loadScript(slot, out); }
+bool SimBedDriver::saveScript(uint8_t slot, const MotionScript &script) { return ctrl.saveScript(slot, script); }
+void SimBedDriver::clearScript(uint8_t slot) { ctrl.clearScript(slot); }
+void SimBedDriver::getLiveStatus(int32_t &head, int32_t &foot) { ctrl.getLiveStatus(head, foot); }
+int32_t SimBedDriver::getSavedPos(const char* key, int32_t defaultVal) { return ctrl.getSavedPos(key, defaultVal); }
+void SimBedDriver::setSavedPos(const char* key, int32_t val) { ctrl.setSavedPos(key, val); }
+std::string SimBedDriver::getSavedLabel(const char* key, const char* defaultVal) { return ctrl.getSavedLabel(key, defaultVal); }
+void SimBedDriver::setSavedLabel(const char* key, std::string val) { ctrl.setSavedLabel(key, val); }
+size_t SimBedDriver::listPresets(size_t first, PresetEntry *out, size_t max, PresetStoreInfo &info) {
+    return ctrl.listPresets(first, out, max, info);
+}
+bool SimBedDriver::getPresetById(uint16_t id, PresetEntry &out) { return ctrl.getPresetById(id, out); }
+uint16_t SimBedDriver::savePreset(const PresetEntry &preset, int position) { return ctrl.savePreset(preset, position); }
+bool SimBedDriver::deletePreset(uint16_t id) { return ctrl.deletePreset(id); }
+void SimBedDriver::getLimits(int32_t &headMaxMs, int32_t &footMaxMs) { ctrl.getLimits(headMaxMs, footMaxMs); }
+void SimBedDriver::setLimits(int32_t headMaxMs, int32_t footMaxMs) { ctrl.setLimits(headMaxMs, footMaxMs); }
+void SimBedDriver::getMotionModel(AxisMotionModel &head, AxisMotionModel &foot) { ctrl.getMotionModel(head, foot); }
+void SimBedDriver::setMotionModel(const AxisMotionModel &head, const AxisMotionModel &foot) { ctrl.setMotionModel(head, foot); }
+ArrivalPolicy SimBedDriver::getArrivalPolicy() { return ctrl.getArrivalPolicy(); }
+void SimBedDriver::setArrivalPolicy(ArrivalPolicy policy) { ctrl.setArrivalPolicy(policy); }
+void SimBedDriver::reportMotorCurrent(bool active, int64_t sinceMs) { ctrl.reportMotorCurrent(active, sinceMs); }
+void SimBedDriver::reportMotorCurrentMa(int32_t milliamps) { ctrl.reportMotorCurrentMa(milliamps); }
+size_t SimBedDriver::readTelemetry(uint32_t afterSeq, MoveRecord *out, size_t max) {
+    return ctrl.readTelemetry(afterSeq, out, max);
+}
+void SimBedDriver::getMotionDirs(MotionDir &headDir, MotionDir &footDir) { ctrl.getMotionDirs(headDir, footDir); }
+void SimBedDriver::getOptoStates(int &o1, int &o2, int &o3, int &o4) { ctrl.getOptoStates(o1, o2, o3, o4); }
+void SimBedDriver::getRemoteEventInfo(int64_t &eventMs, int32_t &debounceMs, int8_t &optoIdx) { ctrl.getRemoteEventInfo(eventMs, debounceMs, optoIdx); }
+void SimBedDriver::getOptoRawStates(int &o1, int &o2, int &o3, int &o4) { ctrl.getOptoRawStates(o1, o2, o3, o4); }
+void SimBedDriver::getRemoteEdgeInfo(int64_t &eventMs, int8_t &optoIdx, int8_t &optoState) { ctrl.getRemoteEdgeInfo(eventMs, optoIdx, optoState); }
+void SimBedDriver::getOptoDebounce(int ch, DebounceConfig &cfg, DebounceStats &stats) { ctrl.getOptoDebounce(ch, cfg, stats); }
+bool SimBedDriver::setOptoDebounce(int ch, DebounceConfig cfg) { return ctrl.setOptoDebounce(ch, cfg); }
+void SimBedDriver::resetOptoDebounceStats() { ctrl.resetOptoDebounceStats(); }
+void SimBedDriver::getRemoteGestures(GestureMap &out) { ctrl.getRemoteGestures(out); }
+bool SimBedDriver::setRemoteGestures(const GestureMap &map) { return ctrl.setRemoteGestures(map); }
+size_t SimBedDriver::readOptoEvents(uint32_t afterSeq, OptoEvent *out, size_t max) { return ctrl.readOptoEvents(afterSeq, out, max); }
+uint32_t SimBedDriver::optoEventSeq() { return ctrl.optoEventSeq(); }
+void SimBedDriver::getSnapshot(BedSnapshot &out) { ctrl.getSnapshot(out); }
@@ -0,0 +1,149 @@
+#pragma once
+#include "BedControl.h"
+#include "BedDriver.h"
+#include "BedPins.h"
+#include <stdint.h>
+
+// Host-side BedDriver: runs the real BedControl against the simulated HAL
+// (SimHal) and a simple actuator model driven by the relay/PWM outputs and
+// the wired remote. Time only moves when runForMs() is called, so runs are
+// deterministic and much faster than real time. The motion task is modelled
+// like bed_task: it wakes on a notification or when update()'s sleep expires.
+class SimBedDriver : public BedDriver {
+public:
+    // Physical actuator model for one axis. Rates are travel-ms per real ms.
+    struct Axis {
+        double upRate = 1.0;
+        double downRate = 1.0;
+        int32_t travelMs = 0;     // physical end stop
+        double startLatencyMs = 0.0;  // drive on -> moving
+        double stopLatencyMs = 0.0;   // drive off -> stopped (coast)
+        double posMs = 0.0;       // true position
+        double stallMs = 0.0;     // time spent driven into an end stop
+
+        // Plant-internal latency tracking.
+        int driveSign = 0;
+        int64_t driveSinceUs = 0;
+        int coastSign = 0;
+        int64_t coastUntilUs = 0;
+    };
+
+    struct TickStats {
+        uint64_t ticks = 0;       // motion task wakeups
+        uint64_t totalNs = 0;     // wall-clock time spent inside update()
+        uint64_t maxNs = 0;
+    };
+
+    // Relay timing seen on the output pins (relay builds). Gaps are the
+    // smallest observed, -1 if the situation never came up.
+    struct RelayAudit {
+        uint64_t edges = 0;
+        uint32_t overlaps = 0;            // UP and DOWN of one axis closed together
+        uint32_t hotTransfers = 0;        // transfer relay opened under a closed motor relay
+        int64_t minReverseUs = -1;        // one direction opening -> the other closing
+        int64_t minStaggerUs = -1;        // one axis' motor relay closing -> the other's
+        int64_t minTransferLeadUs = -1;   // transfer relay closing -> its motor relay closing
+        int64_t minTransferTrailUs = -1;  // motor relay opening -> its transfer relay opening
+    };
+
+    // A base wired to pins; several can share the simulated board as long as
+    // their pins, LEDC channels and NVS namespaces differ.
+    explicit SimBedDriver(const BedPins &pins = BedPins::primary());
+    ~SimBedDriver() override;
+
+    // --- BedDriver ---
+    void begin() override;
+    uint32_t update() override;
+    void attachTask(TaskHandle_t task) override;
+    void stop() override;
+    void moveHead(MotionDir dir) override;
+    void moveFoot(MotionDir dir) override;
+    void moveAll(MotionDir dir) override;
+    int32_t setTarget(int32_t head, int32_t foot) override;
+    BedCommandTicket submit(const BedCommand &cmd) override;
+    void getLiveStatus(int32_t &head, int32_t &foot) override;
+    int32_t getSavedPos(const char* key, int32_t defaultVal) override;
+    void setSavedPos(const char* key, int32_t val) override;
+    std::string getSavedLabel(const char* key, const char* defaultVal) override;
+    void setSavedLabel(const char* key, std::string val) override;
+    size_t listPresets(size_t first, PresetEntry *out, size_t max, PresetStoreInfo &info) override;
+    bool getPresetById(uint16_t id, PresetEntry &out) override;
+    uint16_t savePreset(const PresetEntry &preset, int position) override;
+    bool deletePreset(uint16_t id) override;
+    bool loadScript(uint8_t slot, MotionScript &out) override;
+    bool saveScript(uint8_t slot, const MotionScript &script) override;
+    void clearScript(uint8_t slot) override;
+    void getLimits(int32_t &headMaxMs, int32_t &footMaxMs) override;
+    void setLimits(int32_t headMaxMs, int32_t footMaxMs) override;
+    void getMotionModel(AxisMotionModel &head, AxisMotionModel &foot) override;
+    void setMotionModel(const AxisMotionModel &head, const AxisMotionModel &foot) override;
+    ArrivalPolicy getArrivalPolicy() override;
+    void setArrivalPolicy(ArrivalPolicy policy) override;
+    void reportMotorCurrent(bool active, int64_t sinceMs) override;
+    void reportMotorCurrentMa(int32_t milliamps) override;
+    size_t readTelemetry(uint32_t afterSeq, MoveRecord *out, size_t max) override;
+    void getMotionDirs(MotionDir &headDir, MotionDir &footDir) override;
+    void getOptoStates(int &o1, int &o2, int &o3, int &o4) override;
+    void getRemoteEventInfo(int64_t &eventMs, int32_t &debounceMs, int8_t &optoIdx) override;
+    void getOptoRawStates(int &o1, int &o2, int &o3, int &o4) override;
+    void getRemoteEdgeInfo(int64_t &eventMs, int8_t &optoIdx, int8_t &optoState) override;
+    void getOptoDebounce(int ch, DebounceConfig &cfg, DebounceStats &stats) override;
+    bool setOptoDebounce(int ch, DebounceConfig cfg) override;
+    void resetOptoDebounceStats() override;
+    void getRemoteGestures(GestureMap &out) override;
+    bool setRemoteGestures(const GestureMap &map) override;
+    size_t readOptoEvents(uint32_t afterSeq, OptoEvent *out, size_t max) override;
+    uint32_t optoEventSeq() override;
+    void getSnapshot(BedSnapshot &out) override;
+
+    // --- Simulation ---
+    // Advances the virtual clock, calling update() whenever bed_task would wake.
+    void runForMs(int64_t ms);
+    void runForUs(int64_t us);
+    // Presses/releases a wired-remote button (opto index 0-3: HU, HD, FU, FD).
+    void setRemote(int optoIdx, bool pressed);
+    // Models the ACS712 task (call before begin()): samples every 200 ms,
+    // ACTIVE while any actuator is moving, IDLE after 300 ms without motion;
+    // each sample reads kMotorCurrentMa per moving actuator.
+    void enableCurrentSense(bool enable) { currentSense = enable; }
+    // Sends the modelled bed_task ticks and ACS712 reports through drv (a
+    // decorator around this driver, e.g. TraceBedDriver) instead of straight
+    // to the controller, as the device does through BedService.
+    void routeThrough(BedDriver *drv) { outer = drv ? drv : this; }
+    // Brings the actuator model up to the virtual clock; runForUs() does this
+    // on return, callers ticking update() themselves call it before reading.
+    void integratePlant();
+
+    Axis &head() { return headAxis; }
+    Axis &foot() { return footAxis; }
+    BedControl &control() { return ctrl; }
+    const TickStats &tickStats() const { return stats; }
+    const RelayAudit &relayAudit() const { return audit; }
+
+private:
+    const BedPins pins;
+    BedControl ctrl;
+    Axis headAxis;
+    Axis footAxis;
+    TickStats stats;
+    RelayAudit audit;
+    struct RelayPin {
+        bool closed = false;
+        int64_t changedUs = -1;
+    };
+    RelayPin motorRelay[4];       // HU, HD, FU, FD
+    RelayPin transferRelay[4];    // same order; single-transfer builds use [0]
+    int64_t nextTickUs = 0;
+    int64_t plantUs = 0;
+    bool remotePressed[4] = {};
+    bool currentSense = false;
+    bool currentActive = false;
+    int64_t idleSinceUs = -1;
+    esp_timer_handle_t currentTimer = nullptr;
+    BedDriver *outer = this;
+
+    double axisDrive(bool head) const;
+    bool axisMoving(const Axis &a) const;
+    void sampleCurrent();
+    void auditEdge(int gpio, int level);
+};
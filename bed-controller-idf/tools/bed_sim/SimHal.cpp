@@ -0,0 +1,522 @@
+#include "SimHal.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "driver/rmt_tx.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "esp_rom_crc.h"
+#include "StatusLed.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+struct sim_esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    int64_t deadlineUs;   // -1 when not armed
+};
+
+struct sim_rmt_channel {
+    int gpio;
+    bool enabled;
+};
+
+struct sim_queue {
+    size_t length;
+    size_t itemSize;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+namespace {
+
+constexpr int kGpioCount = 64;
+
+struct NvsValue {
+    enum Kind { I32, STR, BLOB } kind;
+    int32_t i32;
+    std::vector<uint8_t> bytes;   // STR includes the trailing NUL
+};
+
+struct World {
+    int64_t nowUs = 0;
+    int levels[kGpioCount];
+    uint32_t duties[LEDC_CHANNEL_MAX] = {};
+    std::map<int, sim::RmtTx> rmt;            // by GPIO
+    std::map<std::string, NvsValue> nvs;      // "<ns>/<key>"
+    std::vector<std::string> namespaces;
+    std::vector<sim_esp_timer *> timers;
+    std::vector<sim_queue *> queues;
+    // Keyed by owner (one plant per simulated base)
+    std::map<const void *, std::function<void()>> hooks;
+    std::map<const void *, std::function<void(int, int)>> edgeHooks;
+    sim::Counters counters;
+    int logLevel = 0;
+    int mutexToken = 0;
+    int mutexesHeld = 0;          // takes not yet given back, any mutex
+    int taskToken = 0;
+    bool notifyPending = false;
+    bool nvsWritesFail = false;
+    bool isrService = false;
+    gpio_int_type_t intrTypes[kGpioCount] = {};
+    gpio_isr_t isrs[kGpioCount] = {};
+    void *isrArgs[kGpioCount] = {};
+
+    World() { resetLevels(); }
+    void resetLevels() { for (int &l : levels) l = 1; }
+};
+
+World &world() {
+    static World w;
+    return w;
+}
+
+std::string nvsKey(nvs_handle_t h, const char *key) {
+    World &w = world();
+    std::string ns = (h < w.namespaces.size()) ? w.namespaces[h] : "?";
+    return ns + "/" + key;
+}
+
+} // namespace
+
+namespace sim {
+
+void reset() {
+    World &w = world();
+    w.nowUs = 0;
+    w.resetLevels();
+    std::memset(w.duties, 0, sizeof(w.duties));
+    w.rmt.clear();
+    w.nvs.clear();
+    w.namespaces.clear();
+    for (sim_esp_timer *t : w.timers) t->deadlineUs = -1;
+    for (sim_queue *q : w.queues) q->items.clear();
+    w.notifyPending = false;
+    w.nvsWritesFail = false;
+    w.mutexesHeld = 0;
+    w.counters = Counters();
+}
+
+int64_t nowUs() { return world().nowUs; }
+
+void advanceUs(int64_t us, bool stopOnNotify) {
+    World &w = world();
+    const int64_t end = w.nowUs + us;
+    for (;;) {
+        // Fire the earliest due timer, then rescan (callbacks may re-arm).
+        sim_esp_timer *next = nullptr;
+        for (sim_esp_timer *t : w.timers) {
+            if (t->deadlineUs >= 0 && t->deadlineUs <= end &&
+                (!next || t->deadlineUs < next->deadlineUs)) {
+                next = t;
+            }
+        }
+        if (!next) break;
+        if (next->deadlineUs > w.nowUs) w.nowUs = next->deadlineUs;
+        next->deadlineUs = -1;
+        next->callback(next->arg);
+        if (stopOnNotify && w.notifyPending) return;
+    }
+    if (end > w.nowUs) w.nowUs = end;
+}
+
+bool takeNotify() {
+    World &w = world();
+    const bool pending = w.notifyPending;
+    w.notifyPending = false;
+    return pending;
+}
+
+void setInput(int gpio, int level) {
+    World &w = world();
+    if (gpio < 0 || gpio >= kGpioCount) return;
+    const int next = level ? 1 : 0;
+    if (w.levels[gpio] == next) return;
+    w.levels[gpio] = next;
+    if (w.isrs[gpio] && w.intrTypes[gpio] != GPIO_INTR_DISABLE) w.isrs[gpio](w.isrArgs[gpio]);
+}
+
+int level(int gpio) {
+    return (gpio >= 0 && gpio < kGpioCount) ? world().levels[gpio] : 1;
+}
+
+uint32_t ledcDuty(int channel) {
+    return (channel >= 0 && channel < LEDC_CHANNEL_MAX) ? world().duties[channel] : 0;
+}
+
+const RmtTx &rmtTx(int gpio) {
+    static const RmtTx kNone;
+    const auto it = world().rmt.find(gpio);
+    return it == world().rmt.end() ? kNone : it->second;
+}
+
+void setOutputHook(const void *owner, std::function<void()> hook) {
+    if (hook) world().hooks[owner] = std::move(hook);
+    else world().hooks.erase(owner);
+}
+
+void setEdgeHook(const void *owner, std::function<void(int, int)> hook) {
+    if (hook) world().edgeHooks[owner] = std::move(hook);
+    else world().edgeHooks.erase(owner);
+}
+
+Counters &counters() { return world().counters; }
+
+void setNvsWritesFail(bool fail) { world().nvsWritesFail = fail; }
+
+void setLogLevel(int level) { world().logLevel = level; }
+
+} // namespace sim
+
+// --- esp_log / esp_err ---
+
+extern "C" void sim_log(int level, const char *tag, const char *fmt, ...) {
+    World &w = world();
+    if (level > w.logLevel) return;
+    static const char kLetters[] = "?EWIDV";
+    std::printf("%c (%lld) %s: ", kLetters[level], (long long)(w.nowUs / 1000), tag);
+    va_list ap;
+    va_start(ap, fmt);
+    std::vprintf(fmt, ap);
+    va_end(ap);
+    std::printf("\n");
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_NOT_ENOUGH_SPACE: return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        default: return "ESP_FAIL";
+    }
+}
+
+// --- FreeRTOS ---
+
+void vTaskDelay(TickType_t ticks) { sim::advanceUs((int64_t)ticks * portTICK_PERIOD_MS * 1000); }
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return &world().mutexToken; }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) {
+    world().counters.mutexTakes++;
+    world().mutexesHeld++;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t) {
+    if (world().mutexesHeld > 0) world().mutexesHeld--;
+    return pdTRUE;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) { return &world().taskToken; }
+
+BaseType_t xTaskNotifyGive(TaskHandle_t) {
+    world().notifyPending = true;
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t, BaseType_t *higherPriorityTaskWoken) {
+    world().notifyPending = true;
+    if (higherPriorityTaskWoken) *higherPriorityTaskWoken = pdTRUE;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    sim_queue *q = new sim_queue{ length, itemSize, {} };
+    world().queues.push_back(q);
+    return q;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *higherPriorityTaskWoken) {
+    if (!q || q->items.size() >= q->length) return pdFAIL;
+    const uint8_t *p = static_cast<const uint8_t *>(item);
+    q->items.emplace_back(p, p + q->itemSize);
+    if (higherPriorityTaskWoken) *higherPriorityTaskWoken = pdFALSE;
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *out, TickType_t) {
+    if (!q || q->items.empty()) return pdFAIL;
+    std::memcpy(out, q->items.front().data(), q->itemSize);
+    q->items.pop_front();
+    return pdPASS;
+}
+
+// --- esp_timer ---
+
+int64_t esp_timer_get_time(void) { return world().nowUs; }
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out) {
+    if (!args || !out) return ESP_ERR_INVALID_ARG;
+    sim_esp_timer *t = new sim_esp_timer{ args->callback, args->arg, -1 };
+    world().timers.push_back(t);
+    *out = t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    if (timer->deadlineUs >= 0) return ESP_ERR_INVALID_STATE;
+    timer->deadlineUs = world().nowUs + (int64_t)timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    if (timer->deadlineUs < 0) return ESP_ERR_INVALID_STATE;
+    timer->deadlineUs = -1;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    std::vector<sim_esp_timer *> &timers = world().timers;
+    for (size_t i = 0; i < timers.size(); ++i) {
+        if (timers[i] == timer) {
+            timers.erase(timers.begin() + i);
+            delete timer;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+// --- GPIO / LEDC ---
+
+esp_err_t gpio_config(const gpio_config_t *cfg) {
+    if (!cfg) return ESP_ERR_INVALID_ARG;
+    World &w = world();
+    for (int i = 0; i < kGpioCount; ++i) {
+        if (cfg->pin_bit_mask & (1ULL << i)) w.intrTypes[i] = cfg->intr_type;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int) {
+    World &w = world();
+    if (w.isrService) return ESP_ERR_INVALID_STATE;
+    w.isrService = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t isr_handler, void *args) {
+    World &w = world();
+    if (!w.isrService) return ESP_ERR_INVALID_STATE;
+    if (gpio < 0 || gpio >= kGpioCount) return ESP_ERR_INVALID_ARG;
+    w.isrs[gpio] = isr_handler;
+    w.isrArgs[gpio] = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio) {
+    if (gpio < 0 || gpio >= kGpioCount) return ESP_ERR_INVALID_ARG;
+    world().isrs[gpio] = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level) {
+    World &w = world();
+    if (gpio < 0 || gpio >= kGpioCount) return ESP_ERR_INVALID_ARG;
+    w.counters.gpioWrites++;
+    if (w.levels[gpio] == (int)(level ? 1 : 0)) return ESP_OK;
+    for (auto &h : w.hooks) h.second();
+    w.levels[gpio] = level ? 1 : 0;
+    for (auto &h : w.edgeHooks) h.second(gpio, w.levels[gpio]);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio) { return sim::level(gpio); }
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *) { return ESP_OK; }
+esp_err_t ledc_channel_config(const ledc_channel_config_t *) { return ESP_OK; }
+
+esp_err_t ledc_set_duty(ledc_mode_t, ledc_channel_t channel, uint32_t duty) {
+    World &w = world();
+    if (channel < 0 || channel >= LEDC_CHANNEL_MAX) return ESP_ERR_INVALID_ARG;
+    if (w.duties[channel] != duty) {
+        for (auto &h : w.hooks) h.second();
+    }
+    w.duties[channel] = duty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t, ledc_channel_t) {
+    world().counters.ledcUpdates++;
+    return ESP_OK;
+}
+
+// --- RMT (TX, copy encoder) ---
+esp_err_t rmt_new_tx_channel(const rmt_tx_channel_config_t *config, rmt_channel_handle_t *ret_chan) {
+    if (!config || !ret_chan || config->gpio_num < 0 || config->gpio_num >= kGpioCount) return ESP_ERR_INVALID_ARG;
+    *ret_chan = new sim_rmt_channel{ config->gpio_num, false };
+    return ESP_OK;
+}
+
+esp_err_t rmt_del_channel(rmt_channel_handle_t channel) {
+    delete channel;
+    return ESP_OK;
+}
+
+esp_err_t rmt_new_copy_encoder(const rmt_copy_encoder_config_t *, rmt_encoder_handle_t *ret_encoder) {
+    static int token;
+    *ret_encoder = reinterpret_cast<rmt_encoder_handle_t>(&token);
+    return ESP_OK;
+}
+
+esp_err_t rmt_del_encoder(rmt_encoder_handle_t) { return ESP_OK; }
+
+esp_err_t rmt_enable(rmt_channel_handle_t channel) {
+    if (!channel || channel->enabled) return ESP_ERR_INVALID_STATE;
+    channel->enabled = true;
+    return ESP_OK;
+}
+
+// Aborts whatever the channel is sending, loops included.
+esp_err_t rmt_disable(rmt_channel_handle_t channel) {
+    World &w = world();
+    if (!channel || !channel->enabled) return ESP_ERR_INVALID_STATE;
+    channel->enabled = false;
+    auto it = w.rmt.find(channel->gpio);
+    if (it != w.rmt.end() && it->second.sendingAt(w.nowUs)) {
+        for (auto &h : w.hooks) h.second();
+        it->second.endUs = w.nowUs;
+    }
+    return ESP_OK;
+}
+
+// Transmissions start at once (a real channel queues behind the running one;
+// the RF backend never has two in flight).
+esp_err_t rmt_transmit(rmt_channel_handle_t channel, rmt_encoder_handle_t, const void *payload,
+                       size_t payload_bytes, const rmt_transmit_config_t *config) {
+    World &w = world();
+    if (!channel || !channel->enabled || !payload || !config) return ESP_ERR_INVALID_STATE;
+    for (auto &h : w.hooks) h.second();
+    sim::RmtTx &tx = w.rmt[channel->gpio];
+    tx.symbols.assign(static_cast<const uint32_t *>(payload),
+                      static_cast<const uint32_t *>(payload) + payload_bytes / sizeof(uint32_t));
+    tx.startUs = w.nowUs;
+    if (config->loop_count < 0) {
+        tx.endUs = -1;
+    } else {
+        int64_t passUs = 0;
+        for (uint32_t v : tx.symbols) {
+            rmt_symbol_word_t s;
+            s.val = v;
+            passUs += s.duration0 + s.duration1;
+        }
+        tx.endUs = w.nowUs + passUs * (config->loop_count + 1);
+    }
+    w.counters.rmtTransmits++;
+    return ESP_OK;
+}
+
+// --- NVS ---
+
+esp_err_t nvs_flash_init(void) { return ESP_OK; }
+esp_err_t nvs_flash_erase(void) { world().nvs.clear(); return ESP_OK; }
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t, nvs_handle_t *out) {
+    std::vector<std::string> &names = world().namespaces;
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (names[i] == ns) { *out = (nvs_handle_t)i; return ESP_OK; }
+    }
+    names.push_back(ns);
+    *out = (nvs_handle_t)(names.size() - 1);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t h, const char *key, int32_t *out) {
+    World &w = world();
+    w.counters.nvsReads++;
+    auto it = w.nvs.find(nvsKey(h, key));
+    if (it == w.nvs.end() || it->second.kind != NvsValue::I32) return ESP_ERR_NVS_NOT_FOUND;
+    *out = it->second.i32;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t h, const char *key, int32_t val) {
+    World &w = world();
+    w.counters.nvsWrites++;
+    if (w.nvsWritesFail) return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    NvsValue &v = w.nvs[nvsKey(h, key)];
+    v.kind = NvsValue::I32;
+    v.i32 = val;
+    return ESP_OK;
+}
+
+static esp_err_t nvs_get_bytes(nvs_handle_t h, const char *key, NvsValue::Kind kind, void *out, size_t *len) {
+    World &w = world();
+    w.counters.nvsReads++;
+    auto it = w.nvs.find(nvsKey(h, key));
+    if (it == w.nvs.end() || it->second.kind != kind) return ESP_ERR_NVS_NOT_FOUND;
+    const std::vector<uint8_t> &bytes = it->second.bytes;
+    if (!out) { *len = bytes.size(); return ESP_OK; }
+    if (*len < bytes.size()) return ESP_ERR_NVS_INVALID_LENGTH;
+    std::memcpy(out, bytes.data(), bytes.size());
+    *len = bytes.size();
+    return ESP_OK;
+}
+
+static esp_err_t nvs_set_bytes(nvs_handle_t h, const char *key, NvsValue::Kind kind, const void *val, size_t len) {
+    World &w = world();
+    w.counters.nvsWrites++;
+    if (w.nvsWritesFail) return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    NvsValue &v = w.nvs[nvsKey(h, key)];
+    v.kind = kind;
+    const uint8_t *p = static_cast<const uint8_t *>(val);
+    v.bytes.assign(p, p + len);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out, size_t *len) {
+    return nvs_get_bytes(h, key, NvsValue::STR, out, len);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *val) {
+    return nvs_set_bytes(h, key, NvsValue::STR, val, std::strlen(val) + 1);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len) {
+    return nvs_get_bytes(h, key, NvsValue::BLOB, out, len);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *val, size_t len) {
+    return nvs_set_bytes(h, key, NvsValue::BLOB, val, len);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *key) {
+    return world().nvs.erase(nvsKey(h, key)) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t) {
+    world().counters.nvsCommits++;
+    if (world().mutexesHeld > 0) world().counters.nvsCommitsLocked++;
+    return ESP_OK;
+}
+
+// --- ROM CRC ---
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+// --- Status LED (implemented by main.cpp on target) ---
+
+void status_led_override(uint8_t, uint8_t, uint8_t, uint32_t) {}
+void status_led_clear_override() {}
@@ -0,0 +1,66 @@
+#pragma once
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+// Simulated ESP-IDF hardware layer backing the headers in shim/.
+// Everything runs on one thread against a virtual microsecond clock.
+namespace sim {
+
+struct Counters {
+    uint64_t mutexTakes = 0;
+    uint64_t gpioWrites = 0;
+    uint64_t ledcUpdates = 0;
+    uint64_t nvsWrites = 0;
+    uint64_t nvsCommits = 0;
+    uint64_t nvsCommitsLocked = 0;    // issued while a mutex was held
+    uint64_t nvsReads = 0;
+    uint64_t rmtTransmits = 0;
+};
+
+// Latest transmission of an RMT TX channel (copy encoder: the symbols as
+// given). It runs from startUs until endUs; -1 = looping until rmt_disable().
+struct RmtTx {
+    std::vector<uint32_t> symbols;    // rmt_symbol_word_t values
+    int64_t startUs = -1;
+    int64_t endUs = -1;
+    bool sendingAt(int64_t us) const { return startUs >= 0 && us >= startUs && (endUs < 0 || us < endUs); }
+};
+
+// Clears the clock, GPIO levels, LEDC duties, NVS contents, timers and counters.
+void reset();
+
+int64_t nowUs();
+// Moves the virtual clock forward, firing any esp_timer deadlines on the way.
+// With stopOnNotify, returns right after a timer callback that notified a task.
+void advanceUs(int64_t us, bool stopOnNotify = false);
+
+// Returns and clears the pending task notification (xTaskNotifyGive and the
+// GPIO ISR path both set it).
+bool takeNotify();
+
+// Input pins default to 1 (pull-up idle). A level change runs the pin's GPIO
+// ISR handler when one is installed with interrupts enabled.
+void setInput(int gpio, int level);
+int level(int gpio);
+uint32_t ledcDuty(int channel);
+// Empty (startUs -1) if nothing was sent on gpio.
+const RmtTx &rmtTx(int gpio);
+
+// Called after every output-level, LEDC duty or RMT transmission change (before it takes effect
+// in the model) so a plant model can integrate up to the current instant.
+// One hook per owner; an empty hook removes the owner's.
+void setOutputHook(const void *owner, std::function<void()> hook);
+// Called right after an output pin changed level, e.g. to audit relay timing.
+void setEdgeHook(const void *owner, std::function<void(int gpio, int level)> hook);
+
+Counters &counters();
+
+// While set, every nvs_set_*() fails with ESP_ERR_NVS_NOT_ENOUGH_SPACE and
+// stores nothing (a full or worn-out NVS partition).
+void setNvsWritesFail(bool fail);
+
+// 0 = silent (default), 3 = ESP_LOGI and above.
+void setLogLevel(int level);
+
+} // namespace sim
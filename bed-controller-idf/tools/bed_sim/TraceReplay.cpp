@@ -0,0 +1,312 @@
+#include "TraceReplay.h"
+#include "SimHal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+
+static bool decodeArgs(TraceReader &r, TraceRecord &rec) {
+    switch (rec.op) {
+        case TraceOp::UPDATE:
+            rec.v[0] = (int64_t)r.uvar();
+            break;
+        case TraceOp::OPTO_EDGE:
+        case TraceOp::CLEAR_SCRIPT:
+        case TraceOp::SET_ARRIVAL:
+            rec.v[0] = r.u8();
+            break;
+        case TraceOp::STOP:
+        case TraceOp::RESET_DEBOUNCE_STATS:
+            break;
+        case TraceOp::MOVE_HEAD:
+        case TraceOp::MOVE_FOOT:
+        case TraceOp::MOVE_ALL:
+        case TraceOp::MOTOR_CURRENT_MA:
+            rec.v[0] = r.svar();
+            break;
+        case TraceOp::SET_TARGET:
+            for (int i = 0; i < 3; ++i) rec.v[i] = r.svar();
+            break;
+        case TraceOp::SUBMIT:
+            rec.v[0] = r.u8();
+            for (int i = 1; i < 4; ++i) rec.v[i] = r.svar();
+            rec.v[4] = r.u8();
+            rec.v[5] = (int64_t)r.uvar();
+            break;
+        case TraceOp::SET_SAVED_POS: {
+            char key[65];
+            r.str(key, sizeof(key));
+            rec.key = key;
+            rec.v[0] = r.svar();
+            break;
+        }
+        case TraceOp::SET_SAVED_LABEL: {
+            char s[65];
+            r.str(s, sizeof(s));
+            rec.key = s;
+            r.str(s, sizeof(s));
+            rec.text = s;
+            break;
+        }
+        case TraceOp::SAVE_SCRIPT:
+            rec.v[0] = r.u8();
+            rec.script.stepCount = r.u8();
+            if (rec.script.stepCount > MotionScript::kMaxSteps) return false;
+            r.bytes(rec.script.steps, rec.script.stepCount * sizeof(ScriptStep));
+            break;
+        case TraceOp::SET_LIMITS:
+            rec.v[0] = r.svar();
+            rec.v[1] = r.svar();
+            break;
+        case TraceOp::SET_MOTION_MODEL:
+            for (int i = 0; i < 8; ++i) rec.v[i] = r.svar();
+            break;
+        case TraceOp::MOTOR_CURRENT:
+            rec.v[0] = r.u8();
+            rec.v[1] = r.svar();
+            break;
+        case TraceOp::SET_DEBOUNCE:
+            rec.v[0] = r.u8();
+            rec.v[1] = r.u8();
+            rec.v[2] = (int64_t)r.uvar();
+            break;
+        case TraceOp::SET_GESTURES:
+            rec.gestures.count = r.u8();
+            if (rec.gestures.count > GestureMap::kMaxBindings) return false;
+            r.bytes(rec.gestures.bindings, rec.gestures.count * sizeof(GestureBinding));
+            break;
+        case TraceOp::SAVE_PRESET: {
+            char s[65];
+            rec.v[0] = (int64_t)r.uvar();
+            rec.v[1] = r.svar();
+            rec.v[2] = r.svar();
+            r.str(s, sizeof(s));
+            rec.text = s;
+            rec.v[3] = r.svar();
+            rec.v[4] = (int64_t)r.uvar();
+            break;
+        }
+        case TraceOp::DELETE_PRESET:
+            rec.v[0] = (int64_t)r.uvar();
+            rec.v[1] = r.u8();
+            break;
+        case TraceOp::END:
+            rec.v[0] = r.svar();
+            rec.v[1] = r.svar();
+            break;
+        default:
+            return false;   // getters are never recorded
+    }
+    return r.ok();
+}
+
+bool parseTrace(const uint8_t *buf, size_t len, Trace &out, std::string &error) {
+    out = Trace();
+    TraceReader r(buf, len);
+    if (!decodeTraceHeader(r, out.header)) {
+        error = "not a version " + std::to_string(TRACE_VERSION) + " bed trace";
+        return false;
+    }
+    int64_t us = out.header.startUs;
+    size_t lastUpdate = 0;
+    while (!r.atEnd()) {
+        const size_t at = r.offset();
+        TraceRecord rec;
+        rec.op = static_cast<TraceOp>(r.u8());
+        us += r.svar();
+        rec.us = us;
+        rec.durUs = (uint32_t)r.uvar();
+        if (rec.op == TraceOp::STATS) {
+            out.hasStats = decodeTraceStats(r, out.hist, out.dropped, out.lostOptoEvents);
+            if (!out.hasStats && !r.ok()) {
+                out.cut = true;
+            } else if (!out.hasStats) {
+                error = "bad STATS record at byte " + std::to_string(at);
+                return false;
+            }
+            break;
+        }
+        if (!decodeArgs(r, rec)) {
+            if (!r.ok()) {
+                out.cut = true;     // partial download: keep the whole records
+                break;
+            }
+            char msg[64];
+            std::snprintf(msg, sizeof(msg), "bad record (op %u) at byte %u", (unsigned)rec.op, (unsigned)at);
+            error = msg;
+            return false;
+        }
+        if (rec.op == TraceOp::END) {
+            out.ended = true;
+            out.endUs = rec.us;
+            out.endHeadMs = (int32_t)rec.v[0];
+            out.endFootMs = (int32_t)rec.v[1];
+            continue;
+        }
+        // Edges are drained after the tick that consumed them, stamped with
+        // their (earlier) ISR time: on equal us they go right before that tick.
+        rec.anchor = out.records.size();
+        if (rec.op == TraceOp::UPDATE) lastUpdate = rec.anchor;
+        else if (rec.op == TraceOp::OPTO_EDGE) rec.anchor = lastUpdate;
+        out.records.push_back(std::move(rec));
+    }
+    std::stable_sort(out.records.begin(), out.records.end(), [](const TraceRecord &a, const TraceRecord &b) {
+        if (a.us != b.us) return a.us < b.us;
+        if (a.anchor != b.anchor) return a.anchor < b.anchor;
+        return a.op == TraceOp::OPTO_EDGE && b.op != TraceOp::OPTO_EDGE;
+    });
+    return true;
+}
+
+void seedReplay(SimBedDriver &drv, const TraceHeader &h) {
+    drv.setLimits(h.headMaxMs, h.footMaxMs);
+    drv.setMotionModel(h.headModel, h.footModel);
+    drv.setArrivalPolicy(h.arrival);
+    for (int i = 0; i < BED_SAVED_PRESETS; ++i) {
+        PresetEntry p;
+        if (!drv.getPresetById((uint16_t)(i + 1), p)) continue;
+        if (h.presetMask & (1u << (2 * i))) p.headMs = h.presetHeadMs[i];
+        if (h.presetMask & (1u << (2 * i + 1))) p.footMs = h.presetFootMs[i];
+        drv.savePreset(p, -1);
+    }
+    for (int s = 0; s < BED_SCRIPT_SLOTS; ++s) {
+        if (h.scriptMask & (1u << s)) drv.saveScript((uint8_t)s, h.scripts[s]);
+        else drv.clearScript((uint8_t)s);
+    }
+    for (int ch = 0; ch < 4; ++ch) drv.setOptoDebounce(ch, h.debounce[ch]);
+    drv.setRemoteGestures(h.gestures);
+
+    BedSnapshot snap = {};
+    snap.headPosMs = h.headPosMs;
+    snap.footPosMs = h.footPosMs;
+    snap.headEndStop = h.headEndStop;
+    snap.footEndStop = h.footEndStop;
+    snap.headUncertMs = h.headUncertMs;
+    snap.footUncertMs = h.footUncertMs;
+    drv.control().restorePosition(snap);
+    drv.integratePlant();
+    drv.head().posMs = h.headPosMs;
+    drv.foot().posMs = h.footPosMs;
+}
+
+ReplayResult replayTrace(const Trace &trace, SimBedDriver &drv) {
+    ReplayResult res;
+    const TraceHeader &h = trace.header;
+    // Same sub-ms phase as the recorder, so millis() moves on the same calls.
+    const int64_t phaseUs = ((h.startUs - sim::nowUs()) % 1000 + 1000) % 1000;
+    if (phaseUs) sim::advanceUs(phaseUs);
+    const int64_t baseUs = sim::nowUs();
+    auto at = [&](int64_t us) { return baseUs + (us - h.startUs); };
+    bool haveIdOffset = false;
+    uint32_t idOffset = 0;
+    // Presets the trace created get the replay's own ids; the built-ins and
+    // presets older than the trace keep theirs.
+    std::map<uint16_t, uint16_t> presetIds;
+    auto presetId = [&](int64_t recorded) {
+        const auto it = presetIds.find((uint16_t)recorded);
+        return it != presetIds.end() ? it->second : (uint16_t)recorded;
+    };
+    const auto wallStart = std::chrono::steady_clock::now();
+
+    for (const TraceRecord &rec : trace.records) {
+        const int64_t t = at(rec.us);
+        if (t > sim::nowUs()) sim::advanceUs(t - sim::nowUs());
+        const auto t0 = std::chrono::steady_clock::now();
+        switch (rec.op) {
+            case TraceOp::UPDATE:
+                // Wakeups came from the recording; drop the ones timers raised here.
+                sim::takeNotify();
+                if ((int64_t)drv.update() != rec.v[0]) res.sleepMismatches++;
+                break;
+            case TraceOp::OPTO_EDGE:
+                drv.setRemote((int)(rec.v[0] >> 1), (rec.v[0] & 1) == 0);
+                break;
+            case TraceOp::STOP: drv.stop(); break;
+            case TraceOp::MOVE_HEAD: drv.moveHead(static_cast<MotionDir>(rec.v[0])); break;
+            case TraceOp::MOVE_FOOT: drv.moveFoot(static_cast<MotionDir>(rec.v[0])); break;
+            case TraceOp::MOVE_ALL: drv.moveAll(static_cast<MotionDir>(rec.v[0])); break;
+            case TraceOp::SET_TARGET:
+                if (drv.setTarget((int32_t)rec.v[0], (int32_t)rec.v[1]) != rec.v[2]) res.waitMismatches++;
+                break;
+            case TraceOp::SUBMIT: {
+                BedCommand cmd;
+                cmd.type = static_cast<BedCommandType>(rec.v[0]);
+                cmd.dir = static_cast<MotionDir>(rec.v[1]);
+                cmd.headMs = (int32_t)rec.v[2];
+                cmd.footMs = (int32_t)rec.v[3];
+                cmd.script = (uint8_t)rec.v[4];
+                const BedCommandTicket ticket = drv.submit(cmd);
+                const uint32_t recorded = (uint32_t)rec.v[5];
+                if ((ticket.id == 0) != (recorded == 0)) {
+                    res.ticketMismatches++;
+                } else if (ticket.id != 0) {
+                    if (!haveIdOffset) {
+                        idOffset = ticket.id - recorded;
+                        haveIdOffset = true;
+                    } else if (ticket.id - recorded != idOffset) {
+                        res.ticketMismatches++;
+                    }
+                }
+                break;
+            }
+            case TraceOp::SET_SAVED_POS: drv.setSavedPos(rec.key.c_str(), (int32_t)rec.v[0]); break;
+            case TraceOp::SET_SAVED_LABEL: drv.setSavedLabel(rec.key.c_str(), rec.text); break;
+            case TraceOp::SAVE_SCRIPT: drv.saveScript((uint8_t)rec.v[0], rec.script); break;
+            case TraceOp::CLEAR_SCRIPT: drv.clearScript((uint8_t)rec.v[0]); break;
+            case TraceOp::SET_LIMITS: drv.setLimits((int32_t)rec.v[0], (int32_t)rec.v[1]); break;
+            case TraceOp::SET_MOTION_MODEL: {
+                AxisMotionModel m[2];
+                for (int i = 0; i < 2; ++i) {
+                    m[i].upRatePermille = (int32_t)rec.v[4 * i];
+                    m[i].downRatePermille = (int32_t)rec.v[4 * i + 1];
+                    m[i].startLatencyMs = (int32_t)rec.v[4 * i + 2];
+                    m[i].stopLatencyMs = (int32_t)rec.v[4 * i + 3];
+                }
+                drv.setMotionModel(m[0], m[1]);
+                break;
+            }
+            case TraceOp::SET_ARRIVAL: drv.setArrivalPolicy(static_cast<ArrivalPolicy>(rec.v[0])); break;
+            case TraceOp::MOTOR_CURRENT: drv.reportMotorCurrent(rec.v[0] != 0, rec.v[1] + baseUs / 1000); break;
+            case TraceOp::MOTOR_CURRENT_MA: drv.reportMotorCurrentMa((int32_t)rec.v[0]); break;
+            case TraceOp::SET_DEBOUNCE: {
+                DebounceConfig cfg;
+                cfg.mode = static_cast<DebounceMode>(rec.v[1]);
+                cfg.thresholdMs = (uint16_t)rec.v[2];
+                drv.setOptoDebounce((int)rec.v[0], cfg);
+                break;
+            }
+            case TraceOp::RESET_DEBOUNCE_STATS: drv.resetOptoDebounceStats(); break;
+            case TraceOp::SET_GESTURES: drv.setRemoteGestures(rec.gestures); break;
+            case TraceOp::SAVE_PRESET: {
+                PresetEntry p = {};
+                p.id = presetId(rec.v[0]);
+                p.headMs = (int32_t)rec.v[1];
+                p.footMs = (int32_t)rec.v[2];
+                std::snprintf(p.label, sizeof(p.label), "%s", rec.text.c_str());
+                const uint16_t id = drv.savePreset(p, (int)rec.v[3]);
+                if ((id == 0) != (rec.v[4] == 0)) res.presetMismatches++;
+                if (id && rec.v[0] == 0) presetIds[(uint16_t)rec.v[4]] = id;
+                break;
+            }
+            case TraceOp::DELETE_PRESET:
+                if (drv.deletePreset(presetId(rec.v[0])) != (rec.v[1] != 0)) res.presetMismatches++;
+                break;
+            default: break;
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        res.hist[(size_t)rec.op].add((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+        res.calls++;
+    }
+
+    // A full trace stops early; END is after the gap then.
+    const bool toEnd = trace.ended && trace.dropped == 0;
+    const int64_t lastUs = toEnd ? trace.endUs : (trace.records.empty() ? h.startUs : trace.records.back().us);
+    if (at(lastUs) > sim::nowUs()) sim::advanceUs(at(lastUs) - sim::nowUs());
+    sim::takeNotify();
+    drv.integratePlant();
+    drv.getLiveStatus(res.headMs, res.footMs);
+    res.spanUs = lastUs - h.startUs;
+    res.wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    return res;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "BedTrace.h"
+#include "SimBedDriver.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Host side of TraceBedDriver (see docs/bed-trace.md): parses a recorded
+// trace and replays it against a SimBedDriver on the virtual clock, timing
+// every call with the host's clock.
+
+// One recorded op with its arguments decoded.
+struct TraceRecord {
+    TraceOp op = TraceOp::UPDATE;
+    int64_t us = 0;             // recorder's esp_timer time
+    uint32_t durUs = 0;
+    int64_t v[8] = {};          // integer arguments in record order
+    std::string key;            // SET_SAVED_POS / SET_SAVED_LABEL
+    std::string text;           // SET_SAVED_LABEL / SAVE_PRESET label
+    MotionScript script;        // SAVE_SCRIPT (v[0] = slot)
+    GestureMap gestures;        // SET_GESTURES
+    size_t anchor = 0;          // replay order on equal us (see parseTrace)
+};
+
+struct Trace {
+    TraceHeader header;
+    std::vector<TraceRecord> records;   // replay order
+    bool ended = false;                 // END present (recording stopped cleanly)
+    bool cut = false;                   // data ends inside a record
+    int64_t endUs = 0;
+    int32_t endHeadMs = 0;              // live positions at END
+    int32_t endFootMs = 0;
+    bool hasStats = false;
+    TraceHistogram hist[kTraceOpCount]; // device call times (us), from STATS
+    uint32_t dropped = 0;
+    uint32_t lostOptoEvents = 0;
+};
+
+// False with a reason on a bad header or a record that does not decode; a
+// trace read while still recording parses without END/STATS, one cut short
+// up to its last whole record.
+bool parseTrace(const uint8_t *buf, size_t len, Trace &out, std::string &error);
+
+struct ReplayResult {
+    size_t calls = 0;               // records applied
+    uint32_t sleepMismatches = 0;   // update() asked for another sleep than recorded
+    uint32_t waitMismatches = 0;    // setTarget() predicted another run time
+    uint32_t ticketMismatches = 0;  // submit() accepted/dropped differently (ids compared by offset)
+    uint32_t presetMismatches = 0;  // savePreset()/deletePreset() succeeded/failed differently
+    int32_t headMs = 0;             // live positions at the END time (last record if truncated)
+    int32_t footMs = 0;
+    int64_t spanUs = 0;             // recorder time covered
+    double wallSec = 0.0;
+    TraceHistogram hist[kTraceOpCount];   // host call times (ns)
+};
+
+// Loads the header's limits, model, arrival policy, saved presets and
+// scripts, debounce and gestures into drv (begun, idle), then puts the
+// estimate and the actuator model at the recorded positions.
+void seedReplay(SimBedDriver &drv, const TraceHeader &h);
+// Replays from the current virtual time; timers fire on the way and
+// update() only runs where the recorder ticked.
+ReplayResult replayTrace(const Trace &trace, SimBedDriver &drv);
@@ -0,0 +1,1749 @@
+// Replays random preset/stop/manual/remote sequences against SimBedDriver,
+// checks the dead-reckoned position against the actuator model, and reports
+// the cost of BedControl::update() per tick.
+#include "BedConfig.h"
+#include "BedService.h"
+#include "esp_rom_crc.h"
+#include "RfBedDriver.h"
+#include "SimBedDriver.h"
+#include "SimHal.h"
+#include "TraceBedDriver.h"
+#include "TraceReplay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+struct BenchOptions {
+    uint32_t seed = 1;
+    int commands = 5000;
+    double maxErrorMs = -1.0;     // < 0: report only
+    double headUpRate = 1.0;
+    double headDownRate = 1.0;
+    double footUpRate = 1.0;
+    double footDownRate = 1.0;
+    double headStartMs = 0.0, headStopMs = 0.0;
+    double footStartMs = 0.0, footStopMs = 0.0;
+    bool model = false;           // load the plant parameters into the controller
+    bool currentSense = false;
+    int32_t headTravelMs = 0;     // physical travel; 0 = configured default
+    int32_t footTravelMs = 0;
+    bool queue = false;           // send commands through submit() instead of direct calls
+    int taps = 10000;             // short app taps at random microsecond instants
+    ArrivalPolicy arrival = ArrivalPolicy::START_TOGETHER;   // for the random run
+    const char *traceOut = nullptr;   // benchTrace()'s recording, for bed_trace_replay
+    int logLevel = 0;
+};
+
+struct ErrorStats {
+    double maxHeadMs = 0.0;
+    double maxFootMs = 0.0;
+    double sumAbsMs = 0.0;
+    uint64_t samples = 0;
+    uint64_t withinBound = 0;     // samples where |error| <= reported uncertainty
+
+    void sample(SimBedDriver &bed) {
+        int32_t h = 0, f = 0;
+        bed.getLiveStatus(h, f);
+        BedSnapshot snap;
+        bed.getSnapshot(snap);
+        const double eh = std::fabs(h - bed.head().posMs);
+        const double ef = std::fabs(f - bed.foot().posMs);
+        if (eh > maxHeadMs) maxHeadMs = eh;
+        if (ef > maxFootMs) maxFootMs = ef;
+        sumAbsMs += eh + ef;
+        samples += 2;
+        withinBound += (eh <= snap.headUncertMs + 1) + (ef <= snap.footUncertMs + 1);
+    }
+};
+
+static void usage(const char *prog) {
+    std::printf("usage: %s [--seed N] [--commands N] [--max-error-ms MS]\n"
+                "          [--head-rates UP DOWN] [--foot-rates UP DOWN]\n"
+                "          [--head-latency START STOP] [--foot-latency START STOP] [--model]\n"
+                "          [--current-sense] [--head-travel MS] [--foot-travel MS]\n"
+                "          [--queue] [--taps N] [--arrival START_TOGETHER|ARRIVE_TOGETHER|FASTEST_FIRST]\n"
+                "          [--trace-out FILE] [-v]\n", prog);
+}
+
+static bool parseArgs(int argc, char **argv, BenchOptions &opt) {
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        const bool more = i + 1 < argc;
+        if (!std::strcmp(a, "--seed") && more) opt.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(a, "--commands") && more) opt.commands = std::atoi(argv[++i]);
+        else if (!std::strcmp(a, "--max-error-ms") && more) opt.maxErrorMs = std::atof(argv[++i]);
+        else if (!std::strcmp(a, "--head-rates") && i + 2 < argc) {
+            opt.headUpRate = std::atof(argv[++i]);
+            opt.headDownRate = std::atof(argv[++i]);
+        } else if (!std::strcmp(a, "--foot-rates") && i + 2 < argc) {
+            opt.footUpRate = std::atof(argv[++i]);
+            opt.footDownRate = std::atof(argv[++i]);
+        } else if (!std::strcmp(a, "--head-latency") && i + 2 < argc) {
+            opt.headStartMs = std::atof(argv[++i]);
+            opt.headStopMs = std::atof(argv[++i]);
+        } else if (!std::strcmp(a, "--foot-latency") && i + 2 < argc) {
+            opt.footStartMs = std::atof(argv[++i]);
+            opt.footStopMs = std::atof(argv[++i]);
+        } else if (!std::strcmp(a, "--model")) opt.model = true;
+        else if (!std::strcmp(a, "--current-sense")) opt.currentSense = true;
+        else if (!std::strcmp(a, "--head-travel") && more) opt.headTravelMs = std::atoi(argv[++i]);
+        else if (!std::strcmp(a, "--foot-travel") && more) opt.footTravelMs = std::atoi(argv[++i]);
+        else if (!std::strcmp(a, "--queue")) opt.queue = true;
+        else if (!std::strcmp(a, "--taps") && more) opt.taps = std::atoi(argv[++i]);
+        else if (!std::strcmp(a, "--arrival") && more) {
+            if (!arrivalPolicyFromName(argv[++i], opt.arrival)) return false;
+        }
+        else if (!std::strcmp(a, "--trace-out") && more) opt.traceOut = argv[++i];
+        else if (!std::strcmp(a, "-v")) opt.logLevel = 3;
+        else return false;
+    }
+    return true;
+}
+
+// Presets an older build left as per-slot keys (PresetTable migrates them),
+// none of them the factory values, so a boot cache that stayed zeroed or
+// fell back to the defaults cannot match.
+static const PresetView kSeededPresets[BED_SAVED_PRESETS] = {
+    { 11000, 31000, "Seeded ZG" },
+    { 9000, 1000, "Seeded Snore" },
+    { 2000, 41000, "Seeded Legs" },
+    { 15000, 5000, "Seeded P1" },
+    { 7000, 22000, "Seeded P2" },
+};
+
+static void seedLegacyPresets(const char *nvsNamespace) {
+    nvs_handle_t nvs;
+    nvs_open(nvsNamespace, NVS_READWRITE, &nvs);
+    char key[16];
+    for (int i = 0; i < BED_SAVED_PRESETS; ++i) {
+        const char *name = PresetTable::slotName(i);
+        std::snprintf(key, sizeof(key), "%s_head", name);
+        nvs_set_i32(nvs, key, kSeededPresets[i].headMs);
+        std::snprintf(key, sizeof(key), "%s_foot", name);
+        nvs_set_i32(nvs, key, kSeededPresets[i].footMs);
+        std::snprintf(key, sizeof(key), "%s_label", name);
+        nvs_set_str(nvs, key, kSeededPresets[i].label);
+    }
+    nvs_commit(nvs);
+}
+
+// The service's preset cache straight after BedService::begin(), before
+// anything is saved through it: every slot must hold what the driver loaded
+// from NVS (the seeded presets), and the status view's store size and
+// revision must be the driver's.
+static bool benchPresetBoot(SimBedDriver &bed) {
+    BedService &svc = BedService::instance();
+    int same = 0;
+    for (int i = 0; i < BED_SAVED_PRESETS; ++i) {
+        PresetView cached;
+        svc.getPreset(i, cached);
+        PresetEntry stored = {};
+        const bool found = bed.getPresetById((uint16_t)(i + 1), stored);
+        const PresetView &seeded = kSeededPresets[i];
+        if (found && cached.headMs == stored.headMs && cached.footMs == stored.footMs &&
+            !std::strcmp(cached.label, stored.label) && cached.headMs == seeded.headMs &&
+            cached.footMs == seeded.footMs && !std::strcmp(cached.label, seeded.label)) {
+            ++same;
+        }
+    }
+    StatusView view;
+    svc.getStatusView(view);
+    PresetStoreInfo info;
+    bed.listPresets(0, nullptr, 0, info);
+    const bool infoSame = view.presets.count == info.count && view.presets.rev == info.rev;
+    const bool ok = same == BED_SAVED_PRESETS && infoSame;
+    std::printf("preset cache at boot: %d/%d slots match the driver  store %u presets rev %u (driver %u rev %u)  %s\n",
+                same, BED_SAVED_PRESETS, (unsigned)view.presets.count, (unsigned)view.presets.rev,
+                (unsigned)info.count, (unsigned)info.rev, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Lock contention seen by the motion task during a preset, with one UI open:
+// Bed.Status once a second and the SSE poll ten times a second, built from
+// the getters they used before the snapshot (4 and 3 mutex takes) and then
+// from getSnapshot(). Both passes run the same preset, so update() takes the
+// lock equally often in each; the snapshot pass must add no takes of its own.
+static bool benchStatusContention(SimBedDriver &bed) {
+    int32_t headMax = 0, footMax = 0, head0 = 0, foot0 = 0;
+    bed.getLimits(headMax, footMax);
+    bed.getLiveStatus(head0, foot0);
+    struct Pass { uint64_t motionTakes = 0, readerTakes = 0; int64_t ms = 0; };
+    auto run = [&](bool snapshot) {
+        Pass pass;
+        const int32_t wait = bed.setTarget(head0 > headMax / 2 ? 0 : headMax, foot0 > footMax / 2 ? 0 : footMax);
+        for (int64_t t = 100; t <= wait; t += 100) {
+            uint64_t before = sim::counters().mutexTakes;
+            bed.runForMs(100);
+            pass.motionTakes += sim::counters().mutexTakes - before;
+            before = sim::counters().mutexTakes;
+            const bool statusDue = t % 1000 == 0;
+            if (snapshot) {
+                BedSnapshot snap;
+                bed.getSnapshot(snap);
+                if (statusDue) bed.getSnapshot(snap);
+            } else {
+                int64_t ev; int32_t db; int8_t idx, st; int o1, o2, o3, o4;
+                bed.getRemoteEventInfo(ev, db, idx);
+                bed.getRemoteEdgeInfo(ev, idx, st);
+                bed.getOptoRawStates(o1, o2, o3, o4);
+                if (statusDue) {
+                    int32_t h, f;
+                    MotionDir hd, fd;
+                    bed.getLiveStatus(h, f);
+                    bed.getMotionDirs(hd, fd);
+                    bed.getOptoStates(o1, o2, o3, o4);
+                    bed.getRemoteEventInfo(ev, db, idx);
+                }
+            }
+            pass.readerTakes += sim::counters().mutexTakes - before;
+            pass.ms += 100;
+        }
+        bed.runForMs(1000);
+        bed.setTarget(head0, foot0);
+        bed.runForMs(std::max(headMax, footMax) + 1000);
+        return pass;
+    };
+    const Pass getters = run(false);
+    const Pass snapshot = run(true);
+    auto perSec = [](uint64_t n, int64_t ms) { return ms > 0 ? n * 1000.0 / ms : 0.0; };
+    const bool ok = getters.ms > 0 && snapshot.readerTakes == 0;
+    std::printf("status contention: %.1f s preset  update() %.1f takes/s  readers via getters %.1f takes/s  "
+                "via snapshot %.1f takes/s  %s\n",
+                getters.ms / 1000.0, perSec(getters.motionTakes, getters.ms), perSec(getters.readerTakes, getters.ms),
+                perSec(snapshot.readerTakes, snapshot.ms), ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Status build through the per-field getters vs. one snapshot.
+static bool benchStatusLocks(SimBedDriver &bed) {
+    const int kReads = 1000;
+    uint64_t before = sim::counters().mutexTakes;
+    for (int i = 0; i < kReads; ++i) {
+        int32_t h, f;
+        bed.getLiveStatus(h, f);
+        MotionDir hd, fd;
+        bed.getMotionDirs(hd, fd);
+        int o1, o2, o3, o4;
+        bed.getOptoStates(o1, o2, o3, o4);
+        int64_t ev; int32_t db; int8_t idx;
+        bed.getRemoteEventInfo(ev, db, idx);
+        int8_t st;
+        bed.getRemoteEdgeInfo(ev, idx, st);
+        bed.getOptoRawStates(o1, o2, o3, o4);
+    }
+    const uint64_t getterTakes = sim::counters().mutexTakes - before;
+    before = sim::counters().mutexTakes;
+    for (int i = 0; i < kReads; ++i) {
+        BedSnapshot snap;
+        bed.getSnapshot(snap);
+    }
+    const uint64_t snapshotTakes = sim::counters().mutexTakes - before;
+    std::printf("status reads: %d  mutex takes via getters: %llu (%.1f/read)  via snapshot: %llu\n",
+                kReads, (unsigned long long)getterTakes, (double)getterTakes / kReads,
+                (unsigned long long)snapshotTakes);
+
+    // One Bed.Status request as rpc_status_handler used to build it (snapshot,
+    // then a driver read per preset slot) against
+    // BedService::getStatusView(), which now carries only the preset store's
+    // revision and size. The service's slot cache must still hold the
+    // driver's presets (benchPresetBoot() checked it straight after boot) and
+    // must follow every slot saved through the service, the view's revision
+    // must follow the driver's, and neither path may read NVS.
+    BedService &svc = BedService::instance();
+    auto cacheSame = [&]() {
+        bool ok = true;
+        for (int p = 0; p < BED_SAVED_PRESETS; ++p) {
+            PresetView cached;
+            PresetEntry stored;
+            svc.getPreset(p, cached);
+            ok = ok && bed.getPresetById((uint16_t)(p + 1), stored) && cached.headMs == stored.headMs &&
+                 cached.footMs == stored.footMs && std::strcmp(cached.label, stored.label) == 0;
+        }
+        return ok;
+    };
+    const bool bootSame = cacheSame();
+    for (int p = 0; p < BED_SAVED_PRESETS; ++p) {
+        PresetView slot = { 1000 * (p + 1), 2000 * (p + 1), {} };
+        std::snprintf(slot.label, sizeof(slot.label), "Slot %d", p);
+        svc.setPreset(p, slot);
+    }
+    PresetView reading;
+    svc.getPreset(BedService::presetSlotIndex("p1"), reading);
+    reading.headMs = 12000;
+    std::snprintf(reading.label, sizeof(reading.label), "Reading");
+    svc.setPreset(BedService::presetSlotIndex("p1"), reading);
+    struct Cost { double ns, nvsReads, mutexTakes; };
+    auto measure = [&](auto &&request) {
+        const sim::Counters before = sim::counters();
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kReads; ++i) request();
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        const sim::Counters &after = sim::counters();
+        return Cost{ ns / kReads, (double)(after.nvsReads - before.nvsReads) / kReads,
+                     (double)(after.mutexTakes - before.mutexTakes) / kReads };
+    };
+    BedSnapshot oldSnap;
+    PresetView old[BED_SAVED_PRESETS] = {};
+    const Cost direct = measure([&]() {
+        bed.getSnapshot(oldSnap);
+        for (int p = 0; p < BED_SAVED_PRESETS; ++p) {
+            PresetEntry e;
+            bed.getPresetById((uint16_t)(p + 1), e);
+            old[p].headMs = e.headMs;
+            old[p].footMs = e.footMs;
+            std::memcpy(old[p].label, e.label, sizeof(old[p].label));
+        }
+    });
+    StatusView view = {};
+    const Cost batched = measure([&]() { svc.getStatusView(view); });
+    PresetStoreInfo info;
+    bed.listPresets(0, nullptr, 0, info);
+    PresetView p1;
+    svc.getPreset(BedService::presetSlotIndex("p1"), p1);
+    const bool same = cacheSame() && p1.headMs == 12000 && std::strcmp(p1.label, "Reading") == 0 &&
+                      view.presets.rev == info.rev && view.presets.count == info.count;
+    std::printf("status request: driver %.0f ns  %.1f nvs reads  %.1f mutex takes   status view %.0f ns  %.1f nvs reads  "
+                "%.1f mutex takes  presets %s (at boot %s, rev %u)\n",
+                direct.ns, direct.nvsReads, direct.mutexTakes, batched.ns, batched.nvsReads, batched.mutexTakes,
+                same ? "match" : "MISMATCH", bootSame ? "match" : "MISMATCH", (unsigned)view.presets.rev);
+    return same && bootSame && direct.nvsReads == 0 && batched.nvsReads == 0 && batched.mutexTakes == 0;
+}
+
+// Runs a stored script ("foot to 20 s, wait 2 s, head to 10 s, rock the head
+// 10 <-> 15 s three times") and compares its run time with the prediction
+// returned by submit(). Steps chain inside the motion task, so the only
+// slack between segments is timer latency.
+static bool benchScript(SimBedDriver &bed) {
+    MotionScript s;
+    auto add = [&s](ScriptOp op, uint16_t head, uint16_t foot, uint8_t count = 0) {
+        s.steps[s.stepCount++] = ScriptStep{op, count, head, foot};
+    };
+    add(ScriptOp::MOVE, SCRIPT_KEEP, 20000);
+    add(ScriptOp::WAIT, 2000, 0);
+    add(ScriptOp::MOVE, 10000, SCRIPT_KEEP);
+    add(ScriptOp::MOVE, 15000, SCRIPT_KEEP);
+    add(ScriptOp::MOVE, 10000, SCRIPT_KEEP);
+    add(ScriptOp::LOOP, 3, 0, 2);
+    if (!bed.saveScript(0, s)) {
+        std::printf("script: save failed\n");
+        return false;
+    }
+    BedCommand cmd;
+    cmd.type = BedCommandType::RUN_SCRIPT;
+    cmd.script = 0;
+    const int64_t startUs = sim::nowUs();
+    const BedCommandTicket t = bed.submit(cmd);
+    BedSnapshot snap;
+    int64_t doneUs = -1;
+    for (int ms = 0; ms < 600000; ms += 10) {
+        bed.runForMs(10);
+        bed.getSnapshot(snap);
+        if (snap.scriptSlot < 0 && snap.lastCommandId == t.id) { doneUs = sim::nowUs(); break; }
+    }
+    if (doneUs < 0) {
+        std::printf("script: did not finish\n");
+        return false;
+    }
+    const double ranMs = (doneUs - startUs) / 1000.0;
+    std::printf("script: %u steps (%llu bytes in NVS)  ran %.0f ms  predicted %d ms  end head %.0f foot %.0f ms\n",
+                (unsigned)s.stepCount, (unsigned long long)s.storedSize(), ranMs, (int)t.durationMs,
+                bed.head().posMs, bed.foot().posMs);
+    // Completion is only sampled every 10 ms here.
+    return std::fabs(ranMs - t.durationMs) <= 20.0;
+}
+
+// Many short app taps ("nudge the head up a bit") starting and stopping at
+// random microsecond instants, steered away from the ends so nothing
+// re-homes. Any rounding in the per-run position accounting adds up here, so
+// the estimate must not drift from the actuator by more than the 1 ms the
+// status API resolves (plus that resolution once more for the reference).
+static bool benchTaps(SimBedDriver &bed, std::mt19937 &rng, int taps, int settleMs) {
+    if (taps <= 0) return true;
+    auto randInt = [&rng](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+    bed.stop();
+    bed.runForMs(1000 + settleMs);
+    int32_t headMax = 0, footMax = 0;
+    bed.getLimits(headMax, footMax);
+    auto drift = [&bed](double &head, double &foot) {
+        int32_t h = 0, f = 0;
+        bed.getLiveStatus(h, f);
+        head = h - bed.head().posMs;
+        foot = f - bed.foot().posMs;
+    };
+    double head0 = 0, foot0 = 0;
+    drift(head0, foot0);
+    double maxDrift = 0.0, head = 0, foot = 0;
+    for (int i = 0; i < taps; ++i) {
+        int32_t h = 0, f = 0;
+        bed.getLiveStatus(h, f);
+        const int axis = randInt(0, 2);
+        const int32_t pos = axis == 1 ? f : h;
+        const int32_t maxMs = axis == 1 ? footMax : headMax;
+        MotionDir dir = randInt(0, 1) ? MotionDir::UP : MotionDir::DOWN;
+        if (pos < 3000 || (axis == 2 && f < 3000)) dir = MotionDir::UP;
+        if (pos > maxMs - 3000 || (axis == 2 && f > footMax - 3000)) dir = MotionDir::DOWN;
+        bed.runForUs(randInt(0, 999));
+        if (axis == 0) bed.moveHead(dir);
+        else if (axis == 1) bed.moveFoot(dir);
+        else bed.moveAll(dir);
+        bed.runForUs(randInt(300000, 900000));
+        bed.stop();
+        bed.runForUs(randInt(100000, 400000) + settleMs * 1000);
+        drift(head, foot);
+        maxDrift = std::max({ maxDrift, std::fabs(head - head0), std::fabs(foot - foot0) });
+    }
+    std::printf("taps: %d  position drift max %.2f ms  end head %+.2f foot %+.2f ms\n",
+                taps, maxDrift, head - head0, foot - foot0);
+    return maxDrift <= 2.0;
+}
+
+// Wired-remote presses and releases with contact bounce (up to 4 extra edges
+// within 3 ms), plus lone glitches shorter than the debounce window. Every
+// press and release must give exactly one stable change, stamped
+// OPTO_DEBOUNCE_MS after its last bounce. A glitch must give none.
+static bool benchOpto(SimBedDriver &bed, std::mt19937 &rng, int presses) {
+    auto randInt = [&rng](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+    int64_t eventMs = 0;
+    int32_t debounceMs = 0;
+    int8_t optoIdx = -1;
+    int changes = 0, offWindow = 0, glitches = 0, glitchesPassed = 0;
+    double sumLatencyMs = 0.0, maxLatencyMs = 0.0, minLatencyMs = 1e9;
+    // A history reader polled once per press cycle, the way sse_task drains
+    // it: it must see every driven edge and every stable change exactly once.
+    uint32_t lastSeq = bed.optoEventSeq();
+    int edgesDriven = 0, edgesRead = 0, stableRead = 0, gesturesRead = 0, seqGaps = 0;
+    auto drainEvents = [&]() {
+        OptoEvent events[16];
+        size_t n;
+        while ((n = bed.readOptoEvents(lastSeq, events, 16)) > 0) {
+            for (size_t k = 0; k < n; ++k) {
+                if (events[k].seq != lastSeq + 1) seqGaps++;
+                lastSeq = events[k].seq;
+                if (events[k].kind == OPTO_EVENT_EDGE) edgesRead++;
+                else if (events[k].kind == OPTO_EVENT_STABLE) stableRead++;
+                else gesturesRead++;
+            }
+        }
+    };
+    auto drive = [&](int idx, bool pressed) {
+        bed.setRemote(idx, pressed);
+        edgesDriven++;
+    };
+    // Drives one bouncy transition of opto idx to `pressed` and checks the event.
+    auto transition = [&](int idx, bool pressed) {
+        const int64_t firstUs = sim::nowUs();
+        drive(idx, pressed);
+        const int bounces = randInt(0, 2) * 2;
+        for (int b = 0; b < bounces; ++b) {
+            bed.runForUs(randInt(100, 1500 / std::max(1, bounces / 2)));
+            drive(idx, (b % 2) ? pressed : !pressed);
+        }
+        const int64_t lastUs = sim::nowUs();
+        bed.runForMs(OPTO_DEBOUNCE_MS + BED_TICK_FAST_MS);
+        bed.getRemoteEventInfo(eventMs, debounceMs, optoIdx);
+        const double latencyMs = eventMs - firstUs / 1000.0;
+        sumLatencyMs += latencyMs;
+        maxLatencyMs = std::max(maxLatencyMs, latencyMs);
+        minLatencyMs = std::min(minLatencyMs, latencyMs);
+        if (optoIdx != idx || eventMs != (lastUs + OPTO_DEBOUNCE_MS * 1000) / 1000) offWindow++;
+        changes++;
+    };
+    for (int i = 0; i < presses; ++i) {
+        const int idx = randInt(0, 3);
+        transition(idx, true);
+        bed.runForMs(randInt(100, 800));
+        transition(idx, false);
+        bed.runForMs(randInt(50, 300));
+
+        const int64_t before = eventMs;
+        drive(idx, true);
+        bed.runForUs(randInt(100, OPTO_DEBOUNCE_MS * 1000 - 500));
+        drive(idx, false);
+        bed.runForMs(OPTO_DEBOUNCE_MS + BED_TICK_FAST_MS);
+        bed.getRemoteEventInfo(eventMs, debounceMs, optoIdx);
+        glitches++;
+        if (eventMs != before) glitchesPassed++;
+        bed.runForMs(randInt(50, 300));
+        drainEvents();
+    }
+    std::printf("opto: %d changes  latency from first edge min %.1f avg %.1f max %.1f ms  off the window %d  "
+                "glitches %d passed %d\n",
+                changes, minLatencyMs, changes ? sumLatencyMs / changes : 0.0, maxLatencyMs, offWindow,
+                glitches, glitchesPassed);
+    std::printf("opto history: %d edges driven, read %d  stable changes read %d/%d  gestures %d  seq gaps %d\n",
+                edgesDriven, edgesRead, stableRead, changes, gesturesRead, seqGaps);
+    return offWindow == 0 && glitchesPassed == 0 &&
+           edgesRead == edgesDriven && stableRead == changes && seqGaps == 0;
+}
+
+// Presses with a dirty contact (short dropouts while held), then a short
+// glitch, under each debounce mode: the integrator should settle through the
+// dropouts that keep restarting the window, reject the same glitches, and the
+// per-channel counters must add up to what was driven.
+static bool benchDebounce(SimBedDriver &bed, std::mt19937 &rng, int presses) {
+    auto randInt = [&rng](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+    bool ok = true;
+    std::printf("debounce:");
+    for (uint8_t m = 0; m <= (uint8_t)DebounceMode::INTEGRATOR; ++m) {
+        const DebounceMode mode = static_cast<DebounceMode>(m);
+        for (int ch = 0; ch < 4; ++ch) bed.setOptoDebounce(ch, { mode, OPTO_DEBOUNCE_MS });
+        bed.resetOptoDebounceStats();
+        int dropouts = 0, glitchesPassed = 0, late = 0;
+        double sumLatencyMs = 0.0, maxLatencyMs = 0.0;
+        int64_t eventMs = 0;
+        int32_t debounceMs = 0;
+        int8_t optoIdx = -1;
+        bed.getRemoteEventInfo(eventMs, debounceMs, optoIdx);
+        for (int i = 0; i < presses; ++i) {
+            const int idx = randInt(0, 3);
+            const int64_t firstUs = sim::nowUs();
+            const int64_t before = eventMs;
+            bed.setRemote(idx, true);
+            const int n = randInt(0, 4);
+            for (int k = 0; k < n; ++k) {
+                bed.runForUs(randInt(2000, 4000));
+                bed.setRemote(idx, false);
+                bed.runForUs(randInt(200, 600));
+                bed.setRemote(idx, true);
+            }
+            dropouts += n;
+            for (int ms = 0; ms < 100 && eventMs == before; ++ms) {
+                bed.runForMs(1);
+                bed.getRemoteEventInfo(eventMs, debounceMs, optoIdx);
+            }
+            if (eventMs == before) late++;
+            const double latencyMs = eventMs - firstUs / 1000.0;
+            sumLatencyMs += latencyMs;
+            maxLatencyMs = std::max(maxLatencyMs, latencyMs);
+            bed.runForMs(randInt(100, 500));
+            bed.setRemote(idx, false);
+            bed.runForMs(randInt(50, 300));
+            bed.getRemoteEventInfo(eventMs, debounceMs, optoIdx);
+
+            const int64_t beforeGlitch = eventMs;
+            bed.setRemote(idx, true);
+            bed.runForUs(randInt(100, OPTO_DEBOUNCE_MS * 1000 - 500));
+            bed.setRemote(idx, false);
+            bed.runForMs(3 * OPTO_DEBOUNCE_MS);
+            bed.getRemoteEventInfo(eventMs, debounceMs, optoIdx);
+            if (eventMs != beforeGlitch) glitchesPassed++;
+            bed.runForMs(randInt(50, 300));
+        }
+        DebounceStats total;
+        uint32_t minStableMs = UINT32_MAX, maxStableMs = 0;
+        uint16_t maxBounces = 0, maxBounceMs = 0;
+        for (int ch = 0; ch < 4; ++ch) {
+            DebounceConfig cfg;
+            DebounceStats st;
+            bed.getOptoDebounce(ch, cfg, st);
+            total.transitions += st.transitions;
+            total.glitches += st.glitches;
+            total.bounces += st.bounces;
+            maxBounces = std::max(maxBounces, st.maxBounces);
+            maxBounceMs = std::max(maxBounceMs, st.maxBounceMs);
+            minStableMs = std::min(minStableMs, st.minStableMs);
+            maxStableMs = std::max(maxStableMs, st.maxStableMs);
+        }
+        // A dropout is either two bounces of the press or, once the press
+        // has already settled, a rejected glitch of its own.
+        const uint32_t dropoutGlitches = total.glitches - presses;
+        std::printf("\n  %-10s latency avg %5.1f max %5.1f ms  transitions %u/%d  glitches %u (%d + %u dropouts) passed %d  "
+                    "bounces %u (max %u in %u ms)  stable %u-%u ms",
+                    debounceModeName(mode), sumLatencyMs / presses, maxLatencyMs,
+                    (unsigned)total.transitions, 2 * presses, (unsigned)total.glitches, presses,
+                    (unsigned)dropoutGlitches, glitchesPassed,
+                    (unsigned)total.bounces, (unsigned)maxBounces, (unsigned)maxBounceMs,
+                    (unsigned)minStableMs, (unsigned)maxStableMs);
+        ok = ok && late == 0 && glitchesPassed == 0 && total.transitions == (uint32_t)(2 * presses) &&
+             total.glitches >= (uint32_t)presses && total.bounces + 2 * dropoutGlitches == (uint32_t)(2 * dropouts);
+    }
+    std::printf("\n");
+    for (int ch = 0; ch < 4; ++ch) bed.setOptoDebounce(ch, { DebounceMode::WINDOW, OPTO_DEBOUNCE_MS });
+    return ok;
+}
+
+// Taps and holds on the remote, with contact bounce, against a table that
+// binds every kind. A bound gesture must fire exactly once, stamped from the
+// edge times (last release, gap end or hold deadline) rather than the tick
+// that noticed it; near misses (a slow second tap, a long press, a hold let
+// go early) must fire nothing. A press still held when the gesture's preset
+// closes the transfer relays is booked up to that moment, so after every
+// trial the estimate must be within 250 ms of the actuator. Not with plant
+// latency: the plant restarts it on every contact bounce, which the
+// controller (booking from the first edge) rightly does not model.
+static bool benchGestures(SimBedDriver &bed, std::mt19937 &rng, int trials) {
+    auto randInt = [&rng](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+    GestureMap map = GestureMap::defaults();
+    map.bindings[map.count++] = { REMOTE_BTN_FOOT_UP, GestureKind::DOUBLE_TAP, GestureAction::LEGS_UP, 0, 0 };
+    map.bindings[map.count++] = { REMOTE_BTN_FOOT_UP, GestureKind::TRIPLE_TAP, GestureAction::MAX, 0, 0 };
+    map.bindings[map.count++] = { REMOTE_BTN_FOOT_DOWN, GestureKind::HOLD, GestureAction::STOP, 0, 1500 };
+    if (!bed.setRemoteGestures(map)) {
+        std::printf("gestures: table rejected\n");
+        return false;
+    }
+    bed.stop();
+    bed.runForMs(1000);
+
+    // Drives a level with 0-4 bounce edges within 1.5 ms; returns the first edge.
+    auto edge = [&](int idx, bool pressed) {
+        const int64_t firstUs = sim::nowUs();
+        bed.setRemote(idx, pressed);
+        const int bounces = randInt(0, 2) * 2;
+        for (int b = 0; b < bounces; ++b) {
+            bed.runForUs(randInt(100, 700));
+            bed.setRemote(idx, (b % 2) ? pressed : !pressed);
+        }
+        return firstUs;
+    };
+    // Taps of opto idx; returns the first edge of the last release.
+    auto taps = [&](int idx, int n, int gapLo, int gapHi) {
+        int64_t releaseUs = 0;
+        for (int t = 0; t < n; ++t) {
+            if (t > 0) bed.runForMs(randInt(gapLo, gapHi));
+            const int64_t pressUs = edge(idx, true);
+            bed.runForUs(pressUs + randInt(60, 300) * 1000LL - sim::nowUs());
+            releaseUs = edge(idx, false);
+        }
+        return releaseUs;
+    };
+
+    uint32_t lastSeq = bed.optoEventSeq();
+    int expected = 0, fired = 0, wrong = 0, spurious = 0, offTime = 0;
+    double maxOffPlantMs = 0.0;     // estimate vs. actuator after each trial
+    const char *kinds[] = { "double", "triple", "gap", "hold", "stop", "slow", "long", "early" };
+    for (int i = 0; i < trials; ++i) {
+        const int kind = randInt(0, 7);
+        GestureAction want = GestureAction::STOP;
+        int64_t wantUs = -1;    // -1: nothing may fire
+        switch (kind) {
+            case 0:     // HEAD_DOWN x2, no triple bound: fires on the last release
+                wantUs = taps(1, 2, 80, 350);
+                want = GestureAction::FLAT;
+                break;
+            case 1:     // FOOT_UP x3: fires on the last release
+                wantUs = taps(2, 3, 80, 350);
+                want = GestureAction::MAX;
+                break;
+            case 2:     // FOOT_UP x2 with a triple bound: fires once the gap runs out
+                wantUs = taps(2, 2, 80, 350) + GESTURE_TAP_GAP_MS * 1000LL;
+                want = GestureAction::LEGS_UP;
+                break;
+            case 3: {   // HEAD_UP then FOOT_UP, held 2 s from the first
+                const int64_t pressUs = edge(0, true);
+                bed.runForMs(randInt(10, 150));
+                edge(2, true);
+                bed.runForUs(pressUs + randInt(2050, 2800) * 1000LL - sim::nowUs());
+                edge(0, false);
+                bed.runForMs(randInt(0, 50));
+                edge(2, false);
+                wantUs = pressUs + 2000000;
+                want = GestureAction::ZERO_G;
+                break;
+            }
+            case 4: {   // FOOT_DOWN held 1.5 s
+                const int64_t pressUs = edge(3, true);
+                bed.runForUs(pressUs + randInt(1550, 2500) * 1000LL - sim::nowUs());
+                edge(3, false);
+                wantUs = pressUs + 1500000;
+                want = GestureAction::STOP;
+                break;
+            }
+            case 5:     // second tap too late
+                taps(1, 2, GESTURE_TAP_GAP_MS + 50, 800);
+                break;
+            case 6: {   // a tap, then a press too long to be one
+                taps(1, 1, 0, 0);
+                bed.runForMs(randInt(80, 350));
+                edge(1, true);
+                bed.runForMs(randInt(GESTURE_TAP_MAX_MS + 50, 900));
+                edge(1, false);
+                break;
+            }
+            default: {  // the hold let go early
+                edge(0, true);
+                bed.runForMs(randInt(10, 150));
+                edge(2, true);
+                bed.runForMs(randInt(900, 1800));
+                edge(2, false);
+                edge(0, false);
+                break;
+            }
+        }
+        if (wantUs >= 0) expected++;
+        // Watch for the gesture until the gap has certainly run out.
+        int seen = 0;
+        for (int ms = 0; ms < GESTURE_TAP_GAP_MS + 200; ++ms) {
+            OptoEvent events[16];
+            const size_t n = bed.readOptoEvents(lastSeq, events, 16);
+            for (size_t k = 0; k < n; ++k) {
+                lastSeq = events[k].seq;
+                if (events[k].kind != OPTO_EVENT_GESTURE) continue;
+                if (++seen > 1 || wantUs < 0) {
+                    spurious++;
+                    std::printf("gestures: %s trial %d fired %s\n", kinds[kind], i,
+                                gestureActionName((GestureAction)events[k].action));
+                    continue;
+                }
+                fired++;
+                if ((GestureAction)events[k].action != want) wrong++;
+                if (events[k].us != wantUs) offTime++;
+            }
+            bed.runForMs(1);
+        }
+        bed.stop();
+        bed.runForMs(randInt(50, 300));
+        int32_t head = 0, foot = 0;
+        bed.getLiveStatus(head, foot);
+        maxOffPlantMs = std::max({ maxOffPlantMs, std::fabs(head - bed.head().posMs), std::fabs(foot - bed.foot().posMs) });
+    }
+    std::printf("gestures: %d trials  fired %d/%d  wrong action %d  spurious %d  off the edge times %d  position off by max %.1f ms\n",
+                trials, fired, expected, wrong, spurious, offTime, maxOffPlantMs);
+    bed.setRemoteGestures(GestureMap::defaults());
+    const bool latency = bed.head().startLatencyMs > 0 || bed.head().stopLatencyMs > 0 ||
+                         bed.foot().startLatencyMs > 0 || bed.foot().stopLatencyMs > 0;
+    return fired == expected && wrong == 0 && spurious == 0 && offTime == 0 && (latency || maxOffPlantMs < 250.0);
+}
+
+// Runs the same two presets (head leg longer, then foot leg longer) under
+// each arrival policy and reports when each actuator actually came to rest:
+// ARRIVE_TOGETHER must land both within a few ms, and every policy must end
+// when setTarget() said it would. Switching the policy must not commit NVS
+// under the mutex.
+static bool benchArrival(SimBedDriver &bed, int settleMs) {
+    const ArrivalPolicy before = bed.getArrivalPolicy();
+    const uint64_t lockedBefore = sim::counters().nvsCommitsLocked;
+    struct Leg { int32_t fromHead, fromFoot, toHead, toFoot; };
+    const Leg legs[] = { { 5000, 5000, 20000, 10000 }, { 5000, 5000, 8000, 30000 } };
+    bool ok = true;
+    std::printf("arrival:");
+    for (uint8_t i = 0; i <= (uint8_t)ArrivalPolicy::FASTEST_FIRST; ++i) {
+        const ArrivalPolicy policy = static_cast<ArrivalPolicy>(i);
+        double maxSkewMs = 0.0, maxLateMs = 0.0, maxMissMs = 0.0, totalMs = 0.0;
+        for (const Leg &l : legs) {
+            bed.setArrivalPolicy(ArrivalPolicy::START_TOGETHER);
+            bed.runForMs(bed.setTarget(l.fromHead, l.fromFoot) + 1000 + settleMs);
+            bed.setArrivalPolicy(policy);
+            const int64_t startUs = sim::nowUs();
+            const int32_t wait = bed.setTarget(l.toHead, l.toFoot);
+            double head = bed.head().posMs, foot = bed.foot().posMs;
+            int64_t headRestUs = startUs, footRestUs = startUs;
+            for (int ms = 0; ms < wait + 1000 + settleMs; ++ms) {
+                bed.runForMs(1);
+                if (bed.head().posMs != head) { head = bed.head().posMs; headRestUs = sim::nowUs(); }
+                if (bed.foot().posMs != foot) { foot = bed.foot().posMs; footRestUs = sim::nowUs(); }
+            }
+            // The plant keeps coasting for its stop latency after the leg ends.
+            const double headEndMs = (headRestUs - startUs) / 1000.0 - bed.head().stopLatencyMs;
+            const double footEndMs = (footRestUs - startUs) / 1000.0 - bed.foot().stopLatencyMs;
+            maxSkewMs = std::max(maxSkewMs, std::fabs(headEndMs - footEndMs));
+            maxLateMs = std::max(maxLateMs, std::fabs(std::max(headEndMs, footEndMs) - wait));
+            totalMs += std::max(headEndMs, footEndMs);
+            maxMissMs = std::max({ maxMissMs, std::fabs(head - l.toHead), std::fabs(foot - l.toFoot) });
+        }
+        std::printf("\n  %-15s skew %5.0f ms  run %5.0f ms  maxWait off %2.0f ms  target missed by %.1f ms",
+                    arrivalPolicyName(policy), maxSkewMs, totalMs, maxLateMs, maxMissMs);
+        // A soft stop's last duty step lands up to one fast tick before the
+        // deadline; leg deadlines are whole ms of a scaled rate.
+        ok = ok && maxLateMs <= BED_TICK_FAST_MS + 1 && maxMissMs <= 5.0 &&
+             (policy != ArrivalPolicy::ARRIVE_TOGETHER || maxSkewMs <= 5.0);
+    }
+    bed.setArrivalPolicy(before);
+    const uint64_t locked = sim::counters().nvsCommitsLocked - lockedBefore;
+    std::printf("\n  nvs commits under the mutex: %llu\n", (unsigned long long)locked);
+    return ok && locked == 0;
+}
+
+// Summarises the move telemetry ring after the random run: moves per source,
+// how far finished preset legs booked from the travel they were planned for,
+// and whether each move carries a current peak. Seqs must run without gaps.
+static bool benchTelemetry(SimBedDriver &bed, bool currentSense) {
+    MoveRecord recs[BED_TELEMETRY_RECORDS];
+    const size_t n = bed.readTelemetry(0, recs, BED_TELEMETRY_RECORDS);
+    int bySource[3] = {}, legs = 0, endStops = 0, withPeak = 0;
+    int32_t maxLegOffMs = 0;
+    bool ok = n > 0;
+    for (size_t i = 0; i < n; ++i) {
+        const MoveRecord &r = recs[i];
+        if (i > 0 && r.seq != recs[i - 1].seq + 1) ok = false;
+        if (r.source <= (uint8_t)MoveSource::PRESET) bySource[r.source]++;
+        if (r.flags & MOVE_FLAG_END_STOP) endStops++;
+        if (r.peakMa != 0xFFFF) withPeak++;
+        if (r.source == (uint8_t)MoveSource::PRESET && !(r.flags & MOVE_FLAG_INTERRUPTED) && r.commandedMs >= 0) {
+            legs++;
+            maxLegOffMs = std::max(maxLegOffMs, std::abs(r.travelMs - r.commandedMs));
+        }
+    }
+    std::printf("telemetry: last %u moves (seq %u-%u): app %d  remote %d  preset %d  end stop %d  "
+                "finished legs %d off plan by max %d ms  current peak on %d\n",
+                (unsigned)n, n ? (unsigned)recs[0].seq : 0u, n ? (unsigned)recs[n - 1].seq : 0u,
+                bySource[0], bySource[1], bySource[2], endStops, legs, (int)maxLegOffMs, withPeak);
+    return ok && (!currentSense || withPeak > 0);
+}
+
+// After a reboot the restored ring must match what the old controller held,
+// minus at most the moves still waiting for their lazy flush.
+static bool benchTelemetryRestore(SimBedDriver &bed, BedControl &rebooted) {
+    static MoveRecord before[BED_TELEMETRY_RECORDS], after[BED_TELEMETRY_RECORDS];
+    const size_t nBefore = bed.readTelemetry(0, before, BED_TELEMETRY_RECORDS);
+    const size_t nAfter = rebooted.readTelemetry(0, after, BED_TELEMETRY_RECORDS);
+    size_t matched = 0, overlap = 0;
+    for (size_t i = 0; i < nAfter; ++i) {
+        if (nBefore == 0 || (int32_t)(after[i].seq - before[0].seq) < 0) continue;
+        overlap++;
+        for (size_t j = 0; j < nBefore; ++j) {
+            if (before[j].seq == after[i].seq && std::memcmp(&before[j], &after[i], sizeof(MoveRecord)) == 0) {
+                matched++;
+                break;
+            }
+        }
+    }
+    const uint32_t lastBefore = nBefore ? before[nBefore - 1].seq : 0;
+    const uint32_t lastAfter = nAfter ? after[nAfter - 1].seq : 0;
+    const bool ok = nAfter > 0 && matched == overlap && lastBefore - lastAfter <= TELEMETRY_FLUSH_RECORDS;
+    std::printf("telemetry reboot: %u/%u records restored (last seq %u -> %u)  %s\n",
+                (unsigned)matched, (unsigned)nBefore, (unsigned)lastBefore, (unsigned)lastAfter,
+                ok ? "restored" : "MISMATCH");
+    return ok;
+}
+
+// Presets are one CRC-checked NVS blob (PresetTable, see bed-preset-store.md).
+// The rebooted controller must load what bed saved, a save that changes
+// nothing must not write, and the per-field keys of older builds must migrate
+// into the blob (and stay for a rollback). A damaged blob falls back to those
+// keys, or to the factory presets once they are gone.
+static bool benchPresetStore(SimBedDriver &bed, BedControl &rebooted) {
+    bool restored = true;
+    for (int i = 0; i < BED_SAVED_PRESETS; ++i) {
+        PresetEntry a, b;
+        restored = restored && bed.getPresetById((uint16_t)(i + 1), a) && rebooted.getPresetById((uint16_t)(i + 1), b) &&
+                   a.headMs == b.headMs && a.footMs == b.footMs && std::strcmp(a.label, b.label) == 0;
+    }
+
+    const uint16_t p1Id = (uint16_t)(BedService::presetSlotIndex("p1") + 1);
+    PresetEntry p1;
+    sim::Counters before = sim::counters();
+    rebooted.getPresetById(p1Id, p1);
+    rebooted.savePreset(p1, -1);
+    const uint64_t unchangedWrites = sim::counters().nvsWrites - before.nvsWrites;
+    const uint64_t reads = sim::counters().nvsReads - before.nvsReads;
+    before = sim::counters();
+    ++p1.headMs;
+    rebooted.savePreset(p1, -1);
+    const uint64_t changedWrites = sim::counters().nvsWrites - before.nvsWrites;
+    const uint64_t changedCommits = sim::counters().nvsCommits - before.nvsCommits;
+    --p1.headMs;
+    rebooted.savePreset(p1, -1);
+
+    // Older build's layout, in a namespace of its own. The p2 label is longer
+    // than a stored label; snore has no keys left and takes the old fallbacks.
+    nvs_handle_t nvs;
+    nvs_open("prmig", NVS_READWRITE, &nvs);
+    nvs_set_i32(nvs, "zg_head", 12000);
+    nvs_set_i32(nvs, "zg_foot", 30000);
+    nvs_set_str(nvs, "zg_label", "Reading");
+    nvs_set_i32(nvs, "p2_foot", 7000);
+    nvs_set_str(nvs, "p2_label", "A label longer than thirty-one characters");
+    nvs_commit(nvs);
+    PresetTable migrated;
+    const PresetTable::Origin origin = migrated.load(nvs);
+    const PresetView &zg = migrated.get(0), &snore = migrated.get(1), &p2 = migrated.get(4);
+    int32_t i32;
+    size_t len = 0;
+    const bool migrateOk = origin == PresetTable::Origin::MIGRATED && zg.headMs == 12000 && zg.footMs == 30000 &&
+                           std::strcmp(zg.label, "Reading") == 0 && snore.headMs == PresetTable::factory(1).headMs &&
+                           std::strcmp(snore.label, "Preset") == 0 && p2.footMs == 7000 &&
+                           std::strlen(p2.label) == BED_PRESET_LABEL_LEN - 1 &&
+                           nvs_get_i32(nvs, "zg_head", &i32) == ESP_OK && nvs_get_str(nvs, "p2_label", nullptr, &len) == ESP_OK;
+
+    PresetTable reloaded;
+    bool reloadOk = reloaded.load(nvs) == PresetTable::Origin::STORED;
+    for (int i = 0; i < BED_SAVED_PRESETS; ++i) {
+        reloadOk = reloadOk && reloaded.get(i).headMs == migrated.get(i).headMs &&
+                   reloaded.get(i).footMs == migrated.get(i).footMs &&
+                   std::strcmp(reloaded.get(i).label, migrated.get(i).label) == 0;
+    }
+
+    size_t blobBytes = 0;
+    nvs_get_blob(nvs, "presets", nullptr, &blobBytes);
+    auto damage = [&]() {
+        std::vector<uint8_t> blob(blobBytes);
+        size_t n = blobBytes;
+        nvs_get_blob(nvs, "presets", blob.data(), &n);
+        blob[n - 1] ^= 0x5a;
+        nvs_set_blob(nvs, "presets", blob.data(), n);
+    };
+    damage();
+    PresetTable fromKeys;
+    bool resetOk = fromKeys.load(nvs) == PresetTable::Origin::MIGRATED && fromKeys.get(0).headMs == 12000;
+    for (const char *key : { "zg_head", "zg_foot", "zg_label", "p2_foot", "p2_label" }) nvs_erase_key(nvs, key);
+    damage();
+    PresetTable damaged;
+    resetOk = resetOk && damaged.load(nvs) == PresetTable::Origin::RESET &&
+              damaged.get(0).headMs == PresetTable::factory(0).headMs &&
+              std::strcmp(damaged.get(0).label, PresetTable::factory(0).label) == 0 &&
+              PresetTable().load(nvs) == PresetTable::Origin::STORED;
+
+    const bool ok = restored && unchangedWrites == 0 && reads == 0 && changedWrites == 1 && changedCommits == 1 &&
+                    migrateOk && reloadOk && resetOk;
+    std::printf("presets: one %u-byte blob  reboot %s  reads %u nvs  unchanged save %u writes  changed save %u write %u commit  "
+                "legacy keys %s  reload %s  damaged blob %s\n",
+                (unsigned)blobBytes, restored ? "restored" : "MISMATCH", (unsigned)reads, (unsigned)unchangedWrites,
+                (unsigned)changedWrites, (unsigned)changedCommits, migrateOk ? "migrated" : "MISMATCH",
+                reloadOk ? "match" : "MISMATCH", resetOk ? "-> legacy keys, then factory" : "MISMATCH");
+    return ok;
+}
+
+// Named presets with stable ids (PresetTable version 2, Bed.Preset.*). In a
+// scratch namespace: fill the store to BED_PRESET_MAX, delete one, create
+// another (its id is new, never the deleted one), move it to the front, and
+// check that a reload keeps ids, order and revision; built-ins cannot be
+// deleted, a version 1 blob converts once, and a failed write is undone. Through the service: a new
+// preset's ticket runs the bed there, the status view's revision follows
+// every change, a reorder keeps the preset's values, and List pages cover
+// the store once.
+static bool benchNamedPresets(SimBedDriver &bed, int settleMs) {
+    nvs_handle_t nvs;
+    nvs_open("prnamed", NVS_READWRITE, &nvs);
+    static PresetTable table;
+    table.load(nvs);
+    PresetEntry e = {};
+    uint16_t lastId = 0;
+    size_t created = 0;
+    for (int i = 0; i < BED_PRESET_MAX; ++i) {
+        e.headMs = 100 * i;
+        e.footMs = 200 * i;
+        const uint16_t id = table.save(nvs, e, -1);
+        if (!id) break;
+        created++;
+        lastId = id;
+    }
+    const bool filled = created == BED_PRESET_MAX - BED_SAVED_PRESETS && table.count() == BED_PRESET_MAX &&
+                        lastId == BED_PRESET_MAX && std::strcmp(table.at(BED_PRESET_MAX - 1).label, "Preset 48") == 0;
+    const bool builtinKept = !table.remove(nvs, 1) && table.find(1) == 0;
+    const sim::Counters before = sim::counters();
+    const bool removed = table.remove(nvs, 10) && table.find(10) < 0 && table.count() == BED_PRESET_MAX - 1;
+    std::snprintf(e.label, sizeof(e.label), "Reading");
+    const uint16_t fresh = table.save(nvs, e, 0);
+    const uint64_t writes = sim::counters().nvsWrites - before.nvsWrites;
+    const uint64_t commits = sim::counters().nvsCommits - before.nvsCommits;
+    const bool ordered = fresh == BED_PRESET_MAX + 1 && table.at(0).id == fresh && table.at(1).id == 1 &&
+                         table.find(11) == 10;
+    e.id = fresh;
+    const uint32_t revBefore = table.info().rev;
+    const bool unchanged = table.save(nvs, e, 0) == fresh && table.info().rev == revBefore;
+
+    static PresetTable reloaded;
+    bool reloadOk = reloaded.load(nvs) == PresetTable::Origin::STORED && reloaded.count() == table.count() &&
+                    reloaded.info().rev == table.info().rev;
+    for (size_t i = 0; reloadOk && i < table.count(); ++i) {
+        reloadOk = std::memcmp(&reloaded.at(i), &table.at(i), sizeof(PresetEntry)) == 0;
+    }
+    e.id = 0;
+    const bool afterReload = reloaded.remove(nvs, fresh) && reloaded.save(nvs, e, -1) == BED_PRESET_MAX + 2;
+
+    // A version 1 blob (the previous build's five built-ins) in a namespace of its own.
+    struct { uint8_t version, entrySize; uint16_t count; uint32_t crc; PresetView entries[BED_SAVED_PRESETS]; } v1 = {};
+    v1.version = 1;
+    v1.entrySize = sizeof(PresetView);
+    v1.count = BED_SAVED_PRESETS;
+    for (int i = 0; i < BED_SAVED_PRESETS; ++i) {
+        v1.entries[i] = PresetTable::factory(i);
+        v1.entries[i].headMs = 1000 + i;
+    }
+    v1.crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(v1.entries), sizeof(v1.entries));
+    nvs_handle_t old;
+    nvs_open("prv1", NVS_READWRITE, &old);
+    nvs_set_blob(old, "presets", &v1, sizeof(v1));
+    static PresetTable converted;
+    bool v1Ok = converted.load(old) == PresetTable::Origin::STORED && converted.count() == BED_SAVED_PRESETS;
+    for (int i = 0; v1Ok && i < BED_SAVED_PRESETS; ++i) {
+        v1Ok = converted.at(i).id == i + 1 && converted.get(i).headMs == 1000 + i &&
+               std::strcmp(converted.get(i).label, PresetTable::factory(i).label) == 0;
+    }
+    const uint64_t convertWrites = sim::counters().nvsWrites;
+    v1Ok = v1Ok && converted.load(old) == PresetTable::Origin::STORED && sim::counters().nvsWrites == convertWrites &&
+           converted.save(old, e, -1) == BED_SAVED_PRESETS + 1;
+
+    // A save whose write fails (NVS full) is undone in RAM: no entry, no id
+    // used up, no move, same revision. Only the 48-entry table reports full.
+    const PresetStoreInfo infoBefore = converted.info();
+    PresetEntry moved = converted.at(0);
+    moved.headMs += 500;
+    sim::setNvsWritesFail(true);
+    const bool failed = converted.save(old, e, 0) == 0 && converted.save(old, moved, 3) == 0;
+    sim::setNvsWritesFail(false);
+    const PresetStoreInfo infoAfter = converted.info();
+    const bool rolledBack = failed && infoAfter.count == infoBefore.count && infoAfter.rev == infoBefore.rev &&
+                            !infoAfter.full && table.info().full && converted.at(0).id == moved.id &&
+                            converted.at(0).headMs == moved.headMs - 500 &&
+                            converted.save(old, e, -1) == BED_SAVED_PRESETS + 2;
+
+    // Through the service, on bed 0.
+    BedService &svc = BedService::instance();
+    StatusView view;
+    svc.getStatusView(view);
+    const uint32_t rev0 = view.presets.rev;
+    int32_t headMax = 0, footMax = 0;
+    bed.getLimits(headMax, footMax);
+    PresetEntry p = {};
+    p.headMs = headMax / 3;
+    p.footMs = footMax / 4;
+    const uint16_t id = svc.savePreset(p, -1);
+    svc.getStatusView(view);
+    const bool revMoved = id > BED_SAVED_PRESETS && view.presets.rev == rev0 + 1 && view.presets.count == BED_SAVED_PRESETS + 1;
+    BedCommandTicket ticket;
+    bool applied = svc.applyPreset(id, ticket) && ticket.id != 0;
+    bed.runForMs(ticket.durationMs + settleMs + 500);
+    BedSnapshot snap;
+    bed.getSnapshot(snap);
+    applied = applied && snap.lastCommandId == ticket.id && !svc.applyPreset(BED_PRESET_MAX + 100, ticket);
+    // A reorder ({"id","position"}) keeps the stored values while the bed
+    // sits somewhere else.
+    PresetEntry zgBefore, zgAfter, front[2];
+    PresetStoreInfo moveInfo;
+    svc.getPresetById(1, zgBefore);
+    bool reordered = (zgBefore.headMs != snap.headPosMs || zgBefore.footMs != snap.footPosMs) && svc.movePreset(1, 1) &&
+                     svc.listPresets(0, front, 2, moveInfo) == 2 && front[1].id == 1 && svc.getPresetById(1, zgAfter) &&
+                     zgAfter.headMs == zgBefore.headMs && zgAfter.footMs == zgBefore.footMs &&
+                     std::strcmp(zgAfter.label, zgBefore.label) == 0;
+    reordered = reordered && svc.movePreset(1, 0) && !svc.movePreset(BED_PRESET_MAX + 100, 0);
+    for (int i = 0; i < 20; ++i) svc.savePreset(p, -1);
+    PresetEntry page[16];
+    PresetStoreInfo info;
+    size_t listed = 0, pages = 0, n;
+    bool unique = true;
+    std::vector<uint16_t> ids;
+    while ((n = svc.listPresets(listed, page, 16, info)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            unique = unique && std::find(ids.begin(), ids.end(), page[i].id) == ids.end();
+            ids.push_back(page[i].id);
+        }
+        listed += n;
+        pages++;
+    }
+    PresetView slot;
+    PresetEntry zg;
+    svc.getPreset(0, slot);
+    const bool deleted = svc.deletePreset(id) && !svc.deletePreset(id) && !svc.deletePreset(1);
+    svc.getStatusView(view);
+    const bool paged = unique && listed == info.count && pages == (info.count + 15) / 16 && deleted &&
+                       view.presets.count == info.count - 1 && bed.getPresetById(1, zg) && slot.headMs == zg.headMs;
+    for (uint16_t drop : ids) {
+        if (!PresetTable::builtin(drop)) svc.deletePreset(drop);
+    }
+
+    const bool ok = filled && builtinKept && removed && writes == 2 && commits == 2 && ordered && unchanged &&
+                    reloadOk && afterReload && v1Ok && rolledBack && revMoved && applied && reordered && paged;
+    std::printf("named presets: %u in a %u-byte blob  ids %s  built-in delete %s  %u writes for delete+create  "
+                "reload %s  version 1 %s  failed write %s  apply %s  reorder %s  rev %s  list %u in %u pages %s\n",
+                (unsigned)table.count(), (unsigned)(16 + table.count() * sizeof(PresetEntry)),
+                filled && removed && ordered && afterReload ? "stable" : "MISMATCH", builtinKept ? "refused" : "MISMATCH",
+                (unsigned)writes, reloadOk && unchanged ? "match" : "MISMATCH", v1Ok ? "converted" : "MISMATCH",
+                rolledBack ? "undone" : "MISMATCH", applied ? "arrived" : "MISMATCH", reordered ? "keeps values" : "MISMATCH", revMoved ? "follows" : "MISMATCH", (unsigned)listed, (unsigned)pages,
+                paged ? "match" : "MISMATCH");
+    return ok;
+}
+
+// Model learning from current-sensed end-to-end runs (bed-motion-model.md).
+// A base whose head moves up at 0.85 and down at 1.1 (foot 0.9 / 1.05) on a
+// controller that starts from the symmetric default model runs each axis end
+// to end three times each way. The learned up/down ratio must match the
+// plant's within 1%, no NVS commit may land while an axis is moving, and the
+// learned model and limits must be in NVS once the bed is idle. Then 20 presets
+// alternate between 30% and 70% of the travel; each return to 30% must put
+// the actuator within 500 ms of where the first one did. The learning
+// deadband leaves up to ~1% of up/down mismatch, some 40 ms per round trip;
+// the symmetric default model would lose 2.5 s per round trip on the head.
+static bool benchLearn(SimBedDriver &bed) {
+    bed.head().upRate = 0.85;
+    bed.head().downRate = 1.1;
+    bed.foot().upRate = 0.9;
+    bed.foot().downRate = 1.05;
+    bed.enableCurrentSense(true);
+    bed.begin();
+    uint64_t motionCommits = 0;
+    auto moving = [](const BedSnapshot &s) { return s.headDir != MotionDir::STOPPED || s.footDir != MotionDir::STOPPED; };
+    auto step = [&](int64_t ms) {
+        BedSnapshot before, after;
+        bed.getSnapshot(before);
+        const uint64_t commits = sim::counters().nvsCommits;
+        bed.runForMs(ms);
+        bed.getSnapshot(after);
+        if (moving(before) && moving(after)) motionCommits += sim::counters().nvsCommits - commits;
+        return moving(after);
+    };
+    auto runToEnd = [&](bool head, MotionDir dir) {
+        head ? bed.moveHead(dir) : bed.moveFoot(dir);
+        for (int i = 0; i < 6000 && step(10); ++i) {}
+        bed.runForMs(1000);
+    };
+    for (const bool head : { true, false }) {
+        runToEnd(head, MotionDir::UP);      // finds the top; not timed
+        for (int i = 0; i < 3; ++i) {
+            runToEnd(head, MotionDir::DOWN);
+            runToEnd(head, MotionDir::UP);
+        }
+    }
+    AxisMotionModel hm, fm;
+    bed.getMotionModel(hm, fm);
+    const double headRatio = (double)hm.upRatePermille / hm.downRatePermille / (0.85 / 1.1);
+    const double footRatio = (double)fm.upRatePermille / fm.downRatePermille / (0.9 / 1.05);
+    int32_t headMax = 0, footMax = 0;
+    bed.getLimits(headMax, footMax);
+    const bool saved = bed.getSavedPos("head_max_ms", 0) == headMax && bed.getSavedPos("foot_max_ms", 0) == footMax &&
+                       bed.getSavedPos("h_up_rate", 0) == hm.upRatePermille &&
+                       bed.getSavedPos("h_dn_rate", 0) == hm.downRatePermille &&
+                       bed.getSavedPos("f_up_rate", 0) == fm.upRatePermille &&
+                       bed.getSavedPos("f_dn_rate", 0) == fm.downRatePermille;
+
+    double firstHead = 0, firstFoot = 0, drift = 0;
+    for (int i = 0; i < 20; ++i) {
+        const bool low = i % 2 == 0;
+        const int32_t wait = bed.setTarget(low ? headMax * 3 / 10 : headMax * 7 / 10, low ? footMax * 3 / 10 : footMax * 7 / 10);
+        for (int64_t t = 0; t < wait + 1000 && step(10); t += 10) {}
+        bed.runForMs(500);
+        if (!low) continue;
+        if (i == 0) {
+            firstHead = bed.head().posMs;
+            firstFoot = bed.foot().posMs;
+        }
+        drift = std::max({ drift, std::fabs(bed.head().posMs - firstHead), std::fabs(bed.foot().posMs - firstFoot) });
+    }
+    const bool learned = std::fabs(headRatio - 1.0) < 0.01 && std::fabs(footRatio - 1.0) < 0.01;
+    const bool ok = learned && saved && motionCommits == 0 && drift < 500.0;
+    std::printf("learned model: head up %d down %d  foot up %d down %d permille (up/down off the plant by %+.1f%% / %+.1f%%)  "
+                "limits %d / %d ms  in nvs %s  commits while moving %llu  preset return drift %.1f ms  %s\n",
+                (int)hm.upRatePermille, (int)hm.downRatePermille, (int)fm.upRatePermille, (int)fm.downRatePermille,
+                (headRatio - 1.0) * 100, (footRatio - 1.0) * 100, (int)headMax, (int)footMax, saved ? "yes" : "NO",
+                (unsigned long long)motionCommits, drift, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Reverses each axis without a STOP in between and starts both axes at once
+// (moveAll, a two-axis preset), so the relay audit covers those cases even
+// when the random sequence did not produce them.
+static bool benchRelays(SimBedDriver &bed) {
+    bed.stop();
+    bed.runForMs(1000);
+    bed.moveHead(MotionDir::UP);
+    bed.runForMs(800);
+    bed.moveHead(MotionDir::DOWN);
+    bed.runForMs(800);
+    bed.moveFoot(MotionDir::DOWN);
+    bed.runForMs(800);
+    bed.moveFoot(MotionDir::UP);
+    bed.runForMs(800);
+    bed.moveAll(MotionDir::DOWN);
+    bed.runForMs(1500);
+    bed.stop();
+    bed.runForMs(1000);
+    int32_t headMax = 0, footMax = 0;
+    bed.getLimits(headMax, footMax);
+    bed.runForMs(bed.setTarget(headMax / 2, footMax / 2) + 50);
+    bed.stop();
+    bed.runForMs(1000);
+
+    const SimBedDriver::RelayAudit &a = bed.relayAudit();
+    auto ms = [](int64_t us) { return us < 0 ? -1.0 : us / 1000.0; };
+    std::printf("relays: %llu edges  up/down overlaps %u  opened under load %u  min gaps: reversal %.0f ms  "
+                "motor starts %.0f ms  transfer lead %.0f ms  trail %.0f ms\n",
+                (unsigned long long)a.edges, (unsigned)a.overlaps, (unsigned)a.hotTransfers,
+                ms(a.minReverseUs), ms(a.minStaggerUs), ms(a.minTransferLeadUs), ms(a.minTransferTrailUs));
+#if BED_MOTOR_DRIVER_DRV8871
+    // No motor relays: the bridges are PWM-driven and ramp instead.
+    return a.overlaps == 0 && a.hotTransfers == 0;
+#else
+    // -1: never observed, which benchRelays() rules out for every gap.
+    auto atLeast = [](int64_t us, int32_t ms) { return us >= (int64_t)ms * 1000; };
+    return a.overlaps == 0 && a.hotTransfers == 0 &&
+           atLeast(a.minReverseUs, std::min(HEAD_RELAY_DEAD_MS, FOOT_RELAY_DEAD_MS)) &&
+           atLeast(a.minStaggerUs, RELAY_MOTOR_STAGGER_MS) &&
+           atLeast(a.minTransferLeadUs, RELAY_TRANSFER_SETTLE_MS) &&
+           atLeast(a.minTransferTrailUs, RELAY_TRANSFER_SETTLE_MS);
+#endif
+}
+
+// Records a random session through the TraceBedDriver in front of bed (app
+// calls, queued commands, bouncy remote presses, double taps, a preset save
+// and its recall), replays the trace into a second controller on scratch
+// pins and checks that it ends where the recorder did and books the same moves.
+static bool benchTrace(TraceBedDriver &trace, SimBedDriver &bed, SimBedDriver &replay, std::mt19937 &rng,
+                       int steps, int settleMs, const char *saveAs) {
+    auto randInt = [&rng](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+    trace.stop();
+    bed.runForMs(1000 + settleMs);
+    MoveRecord before[1];
+    uint32_t seqBefore = 0;
+    for (size_t n; (n = bed.readTelemetry(seqBefore, before, 1)) > 0;) seqBefore = before[0].seq;
+    if (!trace.startTrace()) {
+        std::printf("trace: FAIL (no buffer)\n");
+        return false;
+    }
+    auto press = [&](int idx, int holdMs) {
+        for (int b = 0, bounces = randInt(0, 2) * 2; b <= bounces; ++b) {
+            bed.setRemote(idx, b % 2 == 0);
+            bed.runForUs(randInt(100, 700));
+        }
+        bed.runForMs(holdMs);
+        bed.setRemote(idx, false);
+    };
+    int32_t headMax = 0, footMax = 0;
+    trace.getLimits(headMax, footMax);
+    for (int i = 0; i < steps; ++i) {
+        const MotionDir dir = randInt(0, 1) ? MotionDir::UP : MotionDir::DOWN;
+        switch (randInt(0, 7)) {
+            case 0:
+            case 1: {
+                const int32_t wait = trace.setTarget(randInt(0, headMax), randInt(0, footMax));
+                bed.runForMs(randInt(0, 3) ? wait + 50 : randInt(1, wait + 1));
+                break;
+            }
+            case 2: {
+                BedCommand cmd;
+                cmd.type = BedCommandType::SET_TARGET;
+                cmd.headMs = randInt(0, headMax);
+                cmd.footMs = randInt(0, footMax);
+                bed.runForMs(trace.submit(cmd).durationMs + 50);
+                break;
+            }
+            case 3:
+                randInt(0, 1) ? trace.moveHead(dir) : trace.moveAll(dir);
+                bed.runForMs(randInt(20, 3000));
+                break;
+            case 4:
+            case 5:
+                press(randInt(0, 3), randInt(20, 3000));
+                break;
+            case 6: {
+                // Double tap head-down: FLAT (default gesture table), left to
+                // finish; the tap's own run may still be coasting into it.
+                press(1, randInt(40, 200));
+                bed.runForMs(randInt(60, 200));
+                press(1, randInt(40, 200));
+                MotionDir hd = MotionDir::UP, fd = MotionDir::UP;
+                for (int ms = 0; ms < 90000 && (hd != MotionDir::STOPPED || fd != MotionDir::STOPPED); ms += 100) {
+                    bed.runForMs(100);
+                    trace.getMotionDirs(hd, fd);
+                }
+                break;
+            }
+            default: {
+                // Through the service, which keeps its preset view in step.
+                BedService &svc = BedService::instance();
+                int32_t h = 0, f = 0;
+                trace.getLiveStatus(h, f);
+                const PresetView p2 = { h, f, "Traced" };
+                svc.setPreset(BedService::presetSlotIndex("p2"), p2);
+                PresetEntry named = {};
+                named.headMs = h;
+                named.footMs = f;
+                svc.deletePreset(svc.savePreset(named, 0));
+                PresetEntry zg = {};
+                trace.getPresetById(1, zg);
+                bed.runForMs(trace.setTarget(zg.headMs, zg.footMs) + 50);
+                bed.runForMs(trace.setTarget(h, f) + 50);
+                break;
+            }
+        }
+        trace.stop();
+        bed.runForMs(randInt(30, 500) + settleMs);
+    }
+    bed.runForMs(1000 + settleMs);
+    trace.stopTrace();
+
+    TraceStatus status;
+    trace.getTraceStatus(status);
+    std::vector<uint8_t> bytes(status.bytes);
+    for (size_t off = 0, n; off < bytes.size() && (n = trace.readTrace(off, bytes.data() + off, 1024)) > 0;) off += n;
+    if (saveAs) {
+        FILE *f = std::fopen(saveAs, "wb");
+        if (!f || std::fwrite(bytes.data(), 1, bytes.size(), f) != bytes.size()) std::printf("trace: cannot write %s\n", saveAs);
+        if (f) std::fclose(f);
+    }
+    Trace parsed;
+    std::string error;
+    if (!parseTrace(bytes.data(), bytes.size(), parsed, error)) {
+        std::printf("trace: FAIL (%s)\n", error.c_str());
+        return false;
+    }
+
+    for (SimBedDriver::Axis *a : { &replay.head(), &replay.foot() }) {
+        const SimBedDriver::Axis &src = a == &replay.head() ? bed.head() : bed.foot();
+        a->upRate = src.upRate;
+        a->downRate = src.downRate;
+        a->startLatencyMs = src.startLatencyMs;
+        a->stopLatencyMs = src.stopLatencyMs;
+        a->travelMs = src.travelMs;
+    }
+    replay.begin();
+    seedReplay(replay, parsed.header);
+    const ReplayResult res = replayTrace(parsed, replay);
+
+    // Same moves, booked alike (the replay's clock and seq start elsewhere).
+    // The header holds whole-ms positions, so a leg may plan 1 ms more or
+    // less; at ARRIVE_TOGETHER's lowest duty that runs 2.5 ms.
+    static MoveRecord recorded[BED_TELEMETRY_RECORDS], replayed[BED_TELEMETRY_RECORDS];
+    const size_t nRec = bed.readTelemetry(seqBefore, recorded, BED_TELEMETRY_RECORDS);
+    const size_t nRep = replay.readTelemetry(0, replayed, BED_TELEMETRY_RECORDS);
+    size_t sameMoves = 0;
+    for (size_t i = 0; i < std::min(nRec, nRep); ++i) {
+        const MoveRecord &a = recorded[i], &b = replayed[i];
+        if (a.axis == b.axis && a.dir == b.dir && a.source == b.source && a.flags == b.flags &&
+            std::abs(a.travelMs - b.travelMs) <= 1 && std::abs((int64_t)a.runUs - (int64_t)b.runUs) <= 3000) {
+            sameMoves++;
+        }
+    }
+    uint32_t calls = 0;
+    uint64_t deviceUs = 0, hostNs = 0;
+    for (size_t op = 0; op < kTraceOpCount; ++op) {
+        calls += parsed.hist[op].calls;
+        deviceUs += parsed.hist[op].total;
+        hostNs += res.hist[op].total;
+    }
+    const bool endOk = parsed.ended && std::abs(res.headMs - parsed.endHeadMs) <= 1 &&
+                       std::abs(res.footMs - parsed.endFootMs) <= 1;
+    std::printf("trace: %u records in %u bytes (%.1f B/record, %u calls timed)  dropped %u  "
+                "replay %.0f s in %.3f s wall (%.0fx)  host %.0f ns/call\n",
+                (unsigned)status.records, (unsigned)status.bytes, (double)status.bytes / std::max<uint32_t>(1, status.records),
+                (unsigned)calls, (unsigned)status.dropped, res.spanUs / 1e6, res.wallSec,
+                res.wallSec > 0 ? res.spanUs / 1e6 / res.wallSec : 0.0, res.calls ? (double)hostNs / res.calls : 0.0);
+    std::printf("trace replay: end head %d/%d foot %d/%d ms  moves %u/%u alike (%u replayed)  "
+                "diverged sleep %u wait %u ticket %u preset %u  %s\n",
+                (int)res.headMs, (int)parsed.endHeadMs, (int)res.footMs, (int)parsed.endFootMs,
+                (unsigned)sameMoves, (unsigned)nRec, (unsigned)nRep, (unsigned)res.sleepMismatches,
+                (unsigned)res.waitMismatches, (unsigned)res.ticketMismatches, (unsigned)res.presetMismatches,
+                endOk ? "match" : "MISMATCH");
+    (void)deviceUs;
+    return endOk && status.dropped == 0 && nRec > 0 && sameMoves == nRec && nRep == nRec && res.presetMismatches == 0;
+}
+
+// Split king: a second base on the BED2_* pins joins the service, and linked
+// presets addressed to either bed must move both. The loop stands in for
+// bed_task ticking the service, so both bases run on the same passes: their
+// first motor relays must close within a ms of each other, both must land on
+// the target, and each keeps its own presets in its own NVS namespace.
+static bool benchLinked(SimBedDriver &bed, SimBedDriver &bedB, int settleMs) {
+#if BED_MOTOR_DRIVER_DRV8871
+    (void)bed; (void)bedB; (void)settleMs;
+    std::printf("linked beds: skipped (two bases are a relay-build feature)\n");
+    return true;
+#else
+    BedService &svc = BedService::instance();
+    if (svc.addBed(&bedB) != 1 || !svc.setLinked(true)) {
+        std::printf("linked beds: FAIL (second bed not added)\n");
+        return false;
+    }
+    const BedPins pinsA = BedPins::primary(), pinsB = BedPins::secondary();
+    int64_t nextUs = sim::nowUs();
+    auto runMs = [&](int64_t ms) {
+        const int64_t end = sim::nowUs() + ms * 1000;
+        for (;;) {
+            if (sim::takeNotify() || nextUs <= sim::nowUs()) {
+                nextUs = sim::nowUs() + (int64_t)svc.update() * 1000;
+                continue;
+            }
+            const int64_t now = sim::nowUs();
+            if (now >= end) break;
+            sim::advanceUs(std::min(nextUs, end) - now, true);
+        }
+        bed.integratePlant();
+        bedB.integratePlant();
+    };
+    auto motorOn = [](const BedPins &p) {
+        for (int i = 0; i < 4; ++i) {
+            if (sim::level(p.motor[i]) == RELAY_ON) return true;
+        }
+        return false;
+    };
+
+    struct Target { int32_t head, foot; int bed; };
+    const Target targets[] = { { 6000, 9000, 0 }, { 15000, 4000, 1 }, { 2000, 20000, 0 }, { 9000, 12000, 1 } };
+    int64_t maxStartSkewUs = 0;
+    double maxMissMs = 0.0;
+    bool started = true;
+    for (const Target &t : targets) {
+        const int32_t wait = svc.setTarget(t.head, t.foot, t.bed);
+        const int64_t startUs = sim::nowUs();
+        int64_t onA = -1, onB = -1;
+        for (int ms = 0; ms < wait + 1000 + settleMs; ++ms) {
+            runMs(1);
+            if (onA < 0 && motorOn(pinsA)) onA = sim::nowUs() - startUs;
+            if (onB < 0 && motorOn(pinsB)) onB = sim::nowUs() - startUs;
+        }
+        started = started && onA >= 0 && onB >= 0;
+        maxStartSkewUs = std::max(maxStartSkewUs, onA > onB ? onA - onB : onB - onA);
+        maxMissMs = std::max({ maxMissMs, std::fabs(bed.head().posMs - t.head), std::fabs(bed.foot().posMs - t.foot),
+                               std::fabs(bedB.head().posMs - t.head), std::fabs(bedB.foot().posMs - t.foot) });
+    }
+
+    // Presets stay per bed: bed 1's p2 must not show on bed 0, nor its NVS.
+    const int p2 = BedService::presetSlotIndex("p2");
+    PresetView before, a, b;
+    PresetEntry stored;
+    svc.getPreset(p2, before, 0);
+    svc.getPreset(p2, b, 1);
+    b.headMs = before.headMs + 1234;
+    svc.setPreset(p2, b, 1);
+    svc.getPreset(p2, a, 0);
+    svc.getPreset(p2, b, 1);
+    const bool separate = a.headMs == before.headMs && b.headMs == before.headMs + 1234 &&
+                          bed.getPresetById((uint16_t)(p2 + 1), stored) && stored.headMs == before.headMs;
+    svc.setLinked(false);
+
+    std::printf("linked beds: %zu presets  first motor relay skew %lld us  target missed by %.1f ms  presets %s\n",
+                sizeof(targets) / sizeof(targets[0]), (long long)maxStartSkewUs, maxMissMs,
+                separate ? "separate" : "SHARED");
+    return started && maxStartSkewUs <= 1000 && maxMissMs <= 5.0 && separate;
+#endif
+}
+
+// Receiver side of the RF bench: an axis starts once a whole frame carrying
+// its code has arrived and runs while that code stays on the air. A frame cut
+// short by a change to another code that still carries it does not stop it.
+struct RfPlant {
+    int gpio;
+    int64_t frameUs;
+    int32_t headMaxMs, footMaxMs;
+    double headMs = 0.0, footMs = 0.0;
+    double airMs = 0.0;           // time a frame was looping
+    int64_t lastUs = 0;
+    int64_t seenStartUs = -1;
+    int64_t codeSinceUs[4] = { -1, -1, -1, -1 };   // HU, HD, FU, FD
+
+    static uint8_t decode(const sim::RmtTx &tx) {
+        if (tx.symbols.size() != RfBedDriver::kFrameSymbols) return 0;
+        rmt_symbol_word_t frame[RfBedDriver::kFrameSymbols];
+        for (uint8_t cmd = 1; cmd < 16; ++cmd) {
+            RfBedDriver::encodeFrame(cmd, frame);
+            if (std::memcmp(frame, tx.symbols.data(), sizeof(frame)) == 0) return cmd;
+        }
+        return 0;
+    }
+
+    // Runs right before every transmission change, so a new transmission
+    // always starts at lastUs.
+    void integrate() {
+        static const uint8_t kCodes[4] = { RF_CMD_HEAD_UP, RF_CMD_HEAD_DOWN, RF_CMD_FOOT_UP, RF_CMD_FOOT_DOWN };
+        const int64_t now = sim::nowUs();
+        const sim::RmtTx &tx = sim::rmtTx(gpio);
+        if (tx.startUs != seenStartUs) {
+            seenStartUs = tx.startUs;
+            const uint8_t cmd = decode(tx);
+            for (int i = 0; i < 4; ++i) {
+                if (!(cmd & kCodes[i])) codeSinceUs[i] = -1;
+                else if (codeSinceUs[i] < 0) codeSinceUs[i] = tx.startUs;
+            }
+        }
+        const int64_t endUs = tx.endUs < 0 ? now : std::min(now, tx.endUs);
+        if (tx.startUs >= 0 && endUs > std::max(lastUs, tx.startUs)) airMs += (endUs - std::max(lastUs, tx.startUs)) / 1000.0;
+        auto drive = [&](double &pos, int up, int down, int32_t maxMs) {
+            for (int i : { up, down }) {
+                if (codeSinceUs[i] < 0) continue;
+                const int64_t from = std::max(lastUs, codeSinceUs[i] + frameUs);
+                if (endUs > from) pos += (i == up ? 1 : -1) * (endUs - from) / 1000.0;
+            }
+            pos = std::max(0.0, std::min((double)maxMs, pos));
+        };
+        drive(headMs, 0, 1, headMaxMs);
+        drive(footMs, 2, 3, footMaxMs);
+        // Frames stopped with nothing sent after them.
+        if (tx.endUs >= 0 && now > tx.endUs) {
+            for (int64_t &since : codeSinceUs) since = -1;
+        }
+        lastUs = now;
+    }
+};
+
+// RF backend: RfBedDriver on its own NVS namespace sends presets and manual
+// moves as looping RMT frames to RfPlant. The motion model's start latency
+// is one frame, and the dead-reckoned positions must follow the receiver
+// within a few ms. Reports how often the CPU touched the transmitter against
+// how long mb-rf-tx's send_raw_signal() would have busy-waited for the same
+// frames.
+static bool benchRf(RfBedDriver &rf) {
+#if BED_MOTOR_DRIVER_DRV8871
+    (void)rf;
+    std::printf("rf: skipped (the RF backend replaces relays)\n");
+    return true;
+#else
+    RfPlant plant{ RF_TX_PIN, RfBedDriver::frameUs(), HEAD_MAX_MS_DEFAULT, FOOT_MAX_MS_DEFAULT };
+    plant.lastUs = sim::nowUs();
+    sim::setOutputHook(&plant, [&plant]() { plant.integrate(); });
+    rf.begin();
+    AxisMotionModel model;
+    model.startLatencyMs = (int32_t)std::lround(RfBedDriver::frameUs() / 1000.0);
+    rf.setMotionModel(model, model);
+    int32_t h = 0, f = 0;
+    rf.getLiveStatus(h, f);
+    plant.headMs = h;
+    plant.footMs = f;
+
+    int64_t nextUs = sim::nowUs();
+    auto runMs = [&](int64_t ms) {
+        const int64_t end = sim::nowUs() + ms * 1000;
+        for (;;) {
+            if (sim::takeNotify() || nextUs <= sim::nowUs()) {
+                nextUs = sim::nowUs() + (int64_t)rf.update() * 1000;
+                continue;
+            }
+            const int64_t now = sim::nowUs();
+            if (now >= end) break;
+            sim::advanceUs(std::min(nextUs, end) - now, true);
+        }
+        plant.integrate();
+    };
+    double maxErrMs = 0.0;
+    int moves = 0;
+    auto sample = [&]() {
+        runMs(500);
+        rf.getLiveStatus(h, f);
+        maxErrMs = std::max({ maxErrMs, std::fabs(h - plant.headMs), std::fabs(f - plant.footMs) });
+        moves++;
+    };
+    const uint64_t transmitsBefore = sim::counters().rmtTransmits;
+    const int32_t targets[][2] = { { 12000, 30000 }, { 5000, 10000 }, { 20000, 5000 }, { 0, 0 }, { 8000, 15000 } };
+    for (const auto &t : targets) {
+        runMs(rf.setTarget(t[0], t[1]) + 100);
+        sample();
+    }
+    rf.moveHead(MotionDir::UP);
+    runMs(3000);
+    rf.stop();
+    sample();
+    rf.moveAll(MotionDir::DOWN);
+    runMs(2000);
+    rf.stop();
+    sample();
+    sim::setOutputHook(&plant, nullptr);
+
+    const uint64_t transmits = sim::counters().rmtTransmits - transmitsBefore;
+    const double framePeriodMs = (RfBedDriver::frameUs() + RF_FRAME_GAP_US) / 1000.0;
+    std::printf("rf: %d moves  rmt_transmit %llu (%.1f/move)  frames looped %.0f (%.1f s on air, send_raw_signal "
+                "would busy-wait %.1f s)  position error max %.1f ms\n",
+                moves, (unsigned long long)transmits, (double)transmits / moves, plant.airMs / framePeriodMs,
+                plant.airMs / 1000.0, plant.airMs * RfBedDriver::frameUs() / 1000.0 / framePeriodMs / 1000.0, maxErrMs);
+    return maxErrMs <= 5.0 && transmits <= 4u * moves;
+#endif
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opt;
+    if (!parseArgs(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    sim::reset();
+    sim::setLogLevel(opt.logLevel);
+    SimBedDriver bed;
+    SimBedDriver bedB(BedPins::secondary());   // joins in benchLinked()
+    // Scratch pins for benchTrace()'s replay. DRV8871: the status LED's
+    // channels, which bed only rewrites on its next tick.
+    BedPins replayPins = {
+        { 50, 51, 52, 53 }, { 54, 55, 56, 57 }, { 58, 59, 60, 61 },
+        { LEDC_CHANNEL_0, LEDC_CHANNEL_1, LEDC_CHANNEL_2, LEDC_CHANNEL_7 }, "trreplay", false,
+    };
+    SimBedDriver replay(replayPins);
+    BedPins learnPins = replayPins;           // benchLearn(), once the replay is done with them
+    learnPins.nvsNamespace = "learnbed";
+    SimBedDriver learner(learnPins);
+    TraceBedDriver trace(&bed);                // the service drives bed through it, as on the device
+    bed.routeThrough(&trace);
+    bed.head().upRate = opt.headUpRate;
+    bed.head().downRate = opt.headDownRate;
+    bed.foot().upRate = opt.footUpRate;
+    bed.foot().downRate = opt.footDownRate;
+    bed.head().startLatencyMs = opt.headStartMs;
+    bed.head().stopLatencyMs = opt.headStopMs;
+    bed.foot().startLatencyMs = opt.footStartMs;
+    bed.foot().stopLatencyMs = opt.footStopMs;
+    if (opt.headTravelMs > 0) bed.head().travelMs = opt.headTravelMs;
+    if (opt.footTravelMs > 0) bed.foot().travelMs = opt.footTravelMs;
+    bed.enableCurrentSense(opt.currentSense);
+    seedLegacyPresets(BedPins::primary().nvsNamespace);
+    BedService::instance().begin(&trace);
+    const bool bootPresetsOk = benchPresetBoot(bed);
+    if (opt.model) {
+        AxisMotionModel hm, fm;
+        hm.upRatePermille = (int32_t)std::lround(opt.headUpRate * 1000);
+        hm.downRatePermille = (int32_t)std::lround(opt.headDownRate * 1000);
+        hm.startLatencyMs = (int32_t)std::lround(opt.headStartMs);
+        hm.stopLatencyMs = (int32_t)std::lround(opt.headStopMs);
+        fm.upRatePermille = (int32_t)std::lround(opt.footUpRate * 1000);
+        fm.downRatePermille = (int32_t)std::lround(opt.footDownRate * 1000);
+        fm.startLatencyMs = (int32_t)std::lround(opt.footStartMs);
+        fm.stopLatencyMs = (int32_t)std::lround(opt.footStopMs);
+        bed.setMotionModel(hm, fm);
+    }
+    bed.setArrivalPolicy(opt.arrival);
+
+    int32_t headMax = 0, footMax = 0;
+    bed.getLimits(headMax, footMax);
+
+    std::mt19937 rng(opt.seed);
+    auto randInt = [&rng](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+
+    // --queue: every command goes through submit(); some presets are preceded
+    // by a decoy that the real one must supersede before the motion task runs.
+    uint64_t submits = 0, submitMutexTakes = 0, decoys = 0;
+    uint32_t lastTicketId = 0;
+    auto submit = [&](BedCommandType type, MotionDir dir = MotionDir::STOPPED, int32_t h = 0, int32_t f = 0) {
+        BedCommand cmd;
+        cmd.type = type;
+        cmd.dir = dir;
+        cmd.headMs = h;
+        cmd.footMs = f;
+        const uint64_t before = sim::counters().mutexTakes;
+        const BedCommandTicket t = bed.submit(cmd);
+        submitMutexTakes += sim::counters().mutexTakes - before;
+        submits++;
+        if (t.id) lastTicketId = t.id;
+        return t;
+    };
+    auto stopBed = [&]() { if (opt.queue) submit(BedCommandType::STOP); else bed.stop(); };
+
+    const int settleMs = (int)std::ceil(std::max(opt.headStopMs, opt.footStopMs));
+    ErrorStats err;
+    int presets = 0, manual = 0, remote = 0;
+    const int64_t simStartUs = sim::nowUs();
+    const auto wallStart = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < opt.commands; ++i) {
+        bed.getLimits(headMax, footMax);   // end-stop calibration may move them
+        const int kind = randInt(0, 9);
+        if (kind < 4) {
+            // Preset; every few land on an end stop to exercise re-homing.
+            int32_t h = randInt(0, 4) == 0 ? (randInt(0, 1) ? 0 : headMax) : randInt(0, headMax);
+            int32_t f = randInt(0, 4) == 0 ? (randInt(0, 1) ? 0 : footMax) : randInt(0, footMax);
+            int32_t wait;
+            if (opt.queue) {
+                if (randInt(0, 3) == 0) {
+                    submit(BedCommandType::SET_TARGET, MotionDir::STOPPED, randInt(0, headMax), randInt(0, footMax));
+                    decoys++;
+                }
+                wait = submit(BedCommandType::SET_TARGET, MotionDir::STOPPED, h, f).durationMs;
+            } else {
+                wait = bed.setTarget(h, f);
+            }
+            // Occasionally interrupt the preset with STOP.
+            if (wait > 0 && randInt(0, 5) == 0) {
+                bed.runForMs(randInt(1, wait));
+                stopBed();
+            } else {
+                bed.runForMs(wait + 50);
+            }
+            presets++;
+        } else if (kind < 7) {
+            const MotionDir dir = randInt(0, 1) ? MotionDir::UP : MotionDir::DOWN;
+            switch (randInt(0, 2)) {
+                case 0: opt.queue ? (void)submit(BedCommandType::MOVE_HEAD, dir) : bed.moveHead(dir); break;
+                case 1: opt.queue ? (void)submit(BedCommandType::MOVE_FOOT, dir) : bed.moveFoot(dir); break;
+                default: opt.queue ? (void)submit(BedCommandType::MOVE_ALL, dir) : bed.moveAll(dir); break;
+            }
+            bed.runForMs(randInt(20, 4000));
+            stopBed();
+            manual++;
+        } else {
+            const int idx = randInt(0, 3);
+            bed.setRemote(idx, true);
+            bed.runForMs(randInt(20, 4000));
+            bed.setRemote(idx, false);
+            remote++;
+        }
+        // Settle past any coast so the sample compares resting positions.
+        bed.runForMs(randInt(30, 500) + settleMs);
+        err.sample(bed);
+    }
+
+    const auto wallEnd = std::chrono::steady_clock::now();
+    const double wallSec = std::chrono::duration<double>(wallEnd - wallStart).count();
+    const double simSec = (double)(sim::nowUs() - simStartUs) / 1e6;
+    const SimBedDriver::TickStats &ts = bed.tickStats();
+    const sim::Counters &c = sim::counters();
+
+    std::printf("commands: %d (preset %d, manual %d, remote %d) seed %u\n",
+                opt.commands, presets, manual, remote, opt.seed);
+    std::printf("virtual time: %.1f s  wall: %.3f s  (%.0fx real time, %.0f commands/s)\n",
+                simSec, wallSec, simSec / wallSec, opt.commands / wallSec);
+    std::printf("update(): %llu wakeups (%.1f/s virtual)  avg %.0f ns  max %llu ns\n",
+                (unsigned long long)ts.ticks, simSec > 0 ? ts.ticks / simSec : 0.0,
+                ts.ticks ? (double)ts.totalNs / ts.ticks : 0.0, (unsigned long long)ts.maxNs);
+    std::printf("position error: max head %.1f ms  max foot %.1f ms  mean %.1f ms  within uncertainty %.1f%%\n",
+                err.maxHeadMs, err.maxFootMs, err.samples ? err.sumAbsMs / err.samples : 0.0,
+                err.samples ? 100.0 * err.withinBound / err.samples : 100.0);
+    std::printf("nvs: %llu writes  %llu commits (%llu under a mutex)  %llu reads   mutex takes: %llu   gpio writes: %llu\n",
+                (unsigned long long)c.nvsWrites, (unsigned long long)c.nvsCommits, (unsigned long long)c.nvsCommitsLocked,
+                (unsigned long long)c.nvsReads, (unsigned long long)c.mutexTakes,
+                (unsigned long long)c.gpioWrites);
+    bed.getLimits(headMax, footMax);
+    std::printf("end stops: driven while stalled head %.1f s  foot %.1f s   limits head %d ms (travel %d)  foot %d ms (travel %d)\n",
+                bed.head().stallMs / 1000.0, bed.foot().stallMs / 1000.0,
+                (int)headMax, (int)bed.head().travelMs, (int)footMax, (int)bed.foot().travelMs);
+    if (opt.queue) {
+        BedSnapshot snap;
+        bed.getSnapshot(snap);
+        std::printf("queue: %llu submits (%llu superseded decoys)  mutex takes in submit: %llu  last applied id %u/%u\n",
+                    (unsigned long long)submits, (unsigned long long)decoys,
+                    (unsigned long long)submitMutexTakes, (unsigned)snap.lastCommandId, (unsigned)lastTicketId);
+    }
+    const bool telemetryOk = benchTelemetry(bed, opt.currentSense);
+    const bool scriptOk = benchScript(bed);
+    const bool relaysOk = benchRelays(bed);
+    const bool tapsOk = benchTaps(bed, rng, opt.taps, settleMs);
+    const bool optoOk = benchOpto(bed, rng, 1000);
+    const bool debounceOk = benchDebounce(bed, rng, 1000);
+    const bool gesturesOk = benchGestures(bed, rng, 400);
+    const bool arrivalOk = benchArrival(bed, settleMs);
+    const bool contentionOk = benchStatusContention(bed);
+    const bool statusOk = benchStatusLocks(bed);
+    const bool traceOk = benchTrace(trace, bed, replay, rng, 10, settleMs, opt.traceOut);
+    const bool learnOk = benchLearn(learner);
+    const bool linkedOk = benchLinked(bed, bedB, settleMs);
+    const bool namedOk = benchNamedPresets(bed, settleMs);
+
+    // Power cut once the journal's idle flush is due: a fresh controller booting
+    // on the same NVS must come back at the positions the old one last held.
+    bed.runForMs(POS_JOURNAL_IDLE_MS + BED_TICK_IDLE_MS);
+    int32_t headBefore = 0, footBefore = 0, headAfter = 0, footAfter = 0;
+    bed.getLiveStatus(headBefore, footBefore);
+    const DebounceConfig tuned = { DebounceMode::INTEGRATOR, 12 };
+    const uint64_t lockedBefore = sim::counters().nvsCommitsLocked;
+    bed.setOptoDebounce(3, tuned);
+    const uint64_t debounceLocked = sim::counters().nvsCommitsLocked - lockedBefore;
+    BedControl rebooted;
+    rebooted.begin();
+    rebooted.getLiveStatus(headAfter, footAfter);
+    const bool restored = headAfter == headBefore && footAfter == footBefore;
+    std::printf("reboot: head %d -> %d ms  foot %d -> %d ms  %s\n",
+                (int)headBefore, (int)headAfter, (int)footBefore, (int)footAfter,
+                restored ? "restored" : "MISMATCH");
+    const bool telemetryRestored = benchTelemetryRestore(bed, rebooted);
+    const bool presetsOk = benchPresetStore(bed, rebooted);
+    DebounceConfig debounceAfter;
+    DebounceStats debounceStats;
+    rebooted.getOptoDebounce(3, debounceAfter, debounceStats);
+    const bool debounceRestored = debounceAfter.mode == tuned.mode && debounceAfter.thresholdMs == tuned.thresholdMs &&
+                                  debounceLocked == 0;
+    std::printf("debounce reboot: opto 4 %s %u ms  commits under the mutex %llu  %s\n", debounceModeName(debounceAfter.mode),
+                (unsigned)debounceAfter.thresholdMs, (unsigned long long)debounceLocked,
+                debounceRestored ? "restored" : "MISMATCH");
+
+    BedPins rfPins = BedPins::rf();
+    rfPins.nvsNamespace = "rfbench";
+    rfPins.statusLed = false;
+    RfBedDriver rfBed(rfPins);
+    const bool rfOk = benchRf(rfBed);
+
+    if (opt.maxErrorMs >= 0.0 && (err.maxHeadMs > opt.maxErrorMs || err.maxFootMs > opt.maxErrorMs)) {
+        std::printf("FAIL: position error exceeds %.1f ms\n", opt.maxErrorMs);
+        return 1;
+    }
+    return (bootPresetsOk && restored && telemetryOk && telemetryRestored && debounceRestored && presetsOk && scriptOk && relaysOk && tapsOk && optoOk && debounceOk && gesturesOk && arrivalOk && contentionOk && statusOk && traceOk && learnOk && linkedOk && namedOk && rfOk) ? 0 : 1;
+}
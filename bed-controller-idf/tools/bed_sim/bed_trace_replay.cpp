@@ -0,0 +1,136 @@
+// Replays a trace recorded on the device (Bed.Command TRACE_START/TRACE_STOP,
+// then GET /rpc/Bed.Trace) against the real bed_control code on the host:
+// prints what the device measured per call, what the same calls cost here,
+// and where the replayed estimate and the actuator model end up.
+//   bed_trace_replay trace.bin [--head-rates UP DOWN] [--foot-rates UP DOWN]
+//                              [--head-latency START STOP] [--foot-latency START STOP] [-v]
+#include "BedTrace.h"
+#include "SimBedDriver.h"
+#include "SimHal.h"
+#include "TraceReplay.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static void usage(const char *prog) {
+    std::printf("usage: %s TRACE [--head-rates UP DOWN] [--foot-rates UP DOWN]\n"
+                "          [--head-latency START STOP] [--foot-latency START STOP] [-v]\n", prog);
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> &out) {
+    FILE *f = std::fopen(path, "rb");
+    if (!f) return false;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0) out.insert(out.end(), chunk, chunk + n);
+    const bool ok = !std::ferror(f);
+    std::fclose(f);
+    return ok;
+}
+
+// One line per op that was called: count, mean, p50, p99 and max.
+static void printHistograms(const char *title, const TraceHistogram *hist, const char *unit) {
+    std::printf("%s\n", title);
+    std::printf("  %-24s %8s %10s %10s %10s %10s\n", "op", "calls", "mean", "p50 <", "p99 <", "max");
+    for (size_t op = 0; op < kTraceOpCount; ++op) {
+        const TraceHistogram &h = hist[op];
+        if (!h.calls) continue;
+        std::printf("  %-24s %8u %8.1f%-2s %8u%-2s %8u%-2s %8u%-2s\n", traceOpName(static_cast<TraceOp>(op)),
+                    (unsigned)h.calls, (double)h.total / h.calls, unit, (unsigned)h.percentile(0.5), unit,
+                    (unsigned)h.percentile(0.99), unit, (unsigned)h.max, unit);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 2;
+    }
+    double rates[4] = { 1.0, 1.0, 1.0, 1.0 };       // head up/down, foot up/down
+    double latency[4] = { 0.0, 0.0, 0.0, 0.0 };     // head start/stop, foot start/stop
+    int logLevel = 0;
+    for (int i = 2; i < argc; ++i) {
+        const char *a = argv[i];
+        double *pair = nullptr;
+        if (!std::strcmp(a, "--head-rates")) pair = &rates[0];
+        else if (!std::strcmp(a, "--foot-rates")) pair = &rates[2];
+        else if (!std::strcmp(a, "--head-latency")) pair = &latency[0];
+        else if (!std::strcmp(a, "--foot-latency")) pair = &latency[2];
+        else if (!std::strcmp(a, "-v")) { logLevel = 3; continue; }
+        if (!pair || i + 2 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        pair[0] = std::atof(argv[++i]);
+        pair[1] = std::atof(argv[++i]);
+    }
+
+    std::vector<uint8_t> bytes;
+    if (!readFile(argv[1], bytes)) {
+        std::printf("%s: cannot read\n", argv[1]);
+        return 1;
+    }
+    Trace trace;
+    std::string error;
+    if (!parseTrace(bytes.data(), bytes.size(), trace, error)) {
+        std::printf("%s: %s\n", argv[1], error.c_str());
+        return 1;
+    }
+    const TraceHeader &h = trace.header;
+    std::printf("trace: %u bytes  %u records  %.1f s  %s  dropped %u  opto events missed %u\n",
+                (unsigned)bytes.size(), (unsigned)trace.records.size(),
+                ((trace.ended ? trace.endUs : (trace.records.empty() ? h.startUs : trace.records.back().us)) - h.startUs) / 1e6,
+                trace.ended ? (trace.cut ? "complete, STATS cut short" : "complete")
+                            : (trace.cut ? "cut short" : "no END (read while recording)"),
+                (unsigned)trace.dropped, (unsigned)trace.lostOptoEvents);
+    std::printf("start: head %d/%d ms  foot %d/%d ms  uncertainty %d/%d ms  arrival %s  presets 0x%03x  scripts 0x%02x\n",
+                (int)h.headPosMs, (int)h.headMaxMs, (int)h.footPosMs, (int)h.footMaxMs,
+                (int)h.headUncertMs, (int)h.footUncertMs, arrivalPolicyName(h.arrival),
+                (unsigned)h.presetMask, (unsigned)h.scriptMask);
+    if (h.headDir != MotionDir::STOPPED || h.footDir != MotionDir::STOPPED) {
+        std::printf("note: recording started while moving; the replay starts stopped\n");
+    }
+    if (trace.hasStats) printHistograms("device call times:", trace.hist, "us");
+
+    sim::reset();
+    sim::setLogLevel(logLevel);
+    SimBedDriver drv;
+    drv.head().upRate = rates[0];
+    drv.head().downRate = rates[1];
+    drv.foot().upRate = rates[2];
+    drv.foot().downRate = rates[3];
+    drv.head().startLatencyMs = latency[0];
+    drv.head().stopLatencyMs = latency[1];
+    drv.foot().startLatencyMs = latency[2];
+    drv.foot().stopLatencyMs = latency[3];
+    drv.head().travelMs = h.headMaxMs;
+    drv.foot().travelMs = h.footMaxMs;
+    drv.begin();
+    seedReplay(drv, h);
+    const ReplayResult res = replayTrace(trace, drv);
+
+    printHistograms("host call times:", res.hist, "ns");
+    std::printf("replay: %u calls  %.1f s in %.3f s wall (%.0fx real time)\n", (unsigned)res.calls,
+                res.spanUs / 1e6, res.wallSec, res.wallSec > 0 ? res.spanUs / 1e6 / res.wallSec : 0.0);
+    std::printf("diverged: update sleep %u  setTarget wait %u  submit ticket %u  preset %u\n",
+                (unsigned)res.sleepMismatches, (unsigned)res.waitMismatches, (unsigned)res.ticketMismatches,
+                (unsigned)res.presetMismatches);
+    const double plantHead = drv.head().posMs, plantFoot = drv.foot().posMs;
+    const bool compare = trace.ended && trace.dropped == 0;
+    if (compare) {
+        std::printf("end: head %d ms (device %d)  foot %d ms (device %d)\n", (int)res.headMs,
+                    (int)trace.endHeadMs, (int)res.footMs, (int)trace.endFootMs);
+    } else {
+        if (trace.dropped) std::printf("note: buffer filled up; replayed up to the last record kept\n");
+        std::printf("end: head %d ms  foot %d ms\n", (int)res.headMs, (int)res.footMs);
+    }
+    std::printf("estimate vs actuator model: head %.1f ms  foot %.1f ms\n",
+                std::fabs(res.headMs - plantHead), std::fabs(res.footMs - plantFoot));
+    const bool same = !compare || (std::abs(res.headMs - trace.endHeadMs) <= 1 &&
+                                       std::abs(res.footMs - trace.endFootMs) <= 1);
+    return same ? 0 : 1;
+}
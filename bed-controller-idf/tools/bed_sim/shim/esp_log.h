@@ -0,0 +1,17 @@
+#pragma once
+// Host shim: routes ESP_LOGx through sim_log(), which is silent unless the
+// simulator verbosity is raised (sim::setLogLevel).
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void sim_log(int level, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+#ifdef __cplusplus
+}
+#endif
+
+#define ESP_LOGE(tag, fmt, ...) sim_log(1, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) sim_log(2, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) sim_log(3, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) sim_log(4, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) sim_log(5, tag, fmt, ##__VA_ARGS__)
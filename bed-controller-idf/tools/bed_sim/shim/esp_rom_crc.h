@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+// Same semantics as the ROM routine: CRC-32 (0xEDB88320), ~crc applied on entry and exit.
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
@@ -0,0 +1,18 @@
+#pragma once
+// Host shim: just enough FreeRTOS for bed_control to compile and run
+// single-threaded against the simulator's virtual clock.
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define portMAX_DELAY       ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS  1
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              1
+#define pdFAIL              0
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define IRAM_ATTR
@@ -0,0 +1,10 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef struct sim_queue *QueueHandle_t;
+
+// Fixed-length FIFO of fixed-size items. Receives never block: the simulator
+// is single-threaded, so a wait could never be satisfied.
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higherPriorityTaskWoken);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *out, TickType_t ticks);
@@ -0,0 +1,10 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef void* SemaphoreHandle_t;
+
+// The simulator is single-threaded: takes always succeed and are counted
+// (sim::counters().mutexTakes) so lock traffic can be benchmarked.
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
@@ -0,0 +1,15 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef void* TaskHandle_t;
+
+// Advances the virtual clock instead of sleeping.
+void vTaskDelay(TickType_t ticks);
+
+// Notifications only set a pending flag; SimBedDriver::runForMs() polls it
+// with sim::takeNotify() to decide when the motion task wakes.
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
+
+#define portYIELD_FROM_ISR(x) ((void)(x))
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY = 0, NVS_READWRITE } nvs_open_mode_t;
+
+// In-memory NVS; writes and commits are counted in sim::counters().
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out);
+esp_err_t nvs_get_i32(nvs_handle_t h, const char *key, int32_t *out);
+esp_err_t nvs_set_i32(nvs_handle_t h, const char *key, int32_t val);
+esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out, size_t *len);
+esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *val);
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len);
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *val, size_t len);
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *key);
+esp_err_t nvs_commit(nvs_handle_t h);
@@ -0,0 +1,4 @@
+#pragma once
+
+// ESP32-S3 values
+#define SOC_RMT_MEM_WORDS_PER_CHANNEL   48